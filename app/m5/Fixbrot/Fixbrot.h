@@ -4,14 +4,14 @@
 #ifndef FIXBROT_HPP
 #define FIXBROT_HPP
 
-// #include "fixbrot/array_queue.hpp"
+// #include "fixbrot/arena.hpp"
 
-#ifndef FIXBROT_QUEUE_HPP
-#define FIXBROT_QUEUE_HPP
+#ifndef FIXBROT_ARENA_HPP
+#define FIXBROT_ARENA_HPP
 
 #ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
 #include <stdint.h>
-#include <stdlib.h>
 #endif
 
 // #include "fixbrot/common.hpp"
@@ -27,6 +27,11 @@
 #define FIXBROT_ARGB4444_BSWAP (0)
 #endif
 
+// byte order of pixels handed to the application differs from col_t
+#ifndef FIXBROT_BYTE_SWAP
+#define FIXBROT_BYTE_SWAP (0)
+#endif
+
 #ifndef FIXBROT_NO_STDLIB
 #include <stdint.h>
 #endif
@@ -376,6 +381,9 @@ enum class result_t : uint16_t {
   ERROR_QUEUE_OVERFLOW,
   ERROR_BUSY,
   ERROR_TOO_MANY_TOUCHES,
+  ERROR_IO,
+  ERROR_BAD_SNAPSHOT,
+  ERROR_OUT_OF_MEMORY,
 };
 
 #define FIXBROT_TRY(expr)                    \
@@ -396,6 +404,20 @@ static FIXBROT_INLINE real_t real_exp2(int exp) {
   return fixed64_t::from_raw((int64_t)1 << (fixed64_t::FRAC_BITS + exp));
 }
 
+// index of the lowest set bit of `x`, which must not be zero
+static FIXBROT_INLINE int count_trailing_zeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(x);
+#else
+  int n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
 struct vec_t {
   pos_t x;
   pos_t y;
@@ -534,6 +556,23 @@ static FIXBROT_INLINE constexpr col_t color_div2(col_t c) {
 #endif
 }
 
+static FIXBROT_INLINE constexpr col_t color_bswap(col_t c) {
+  return ((c >> 8) & 0x00FF) | ((c << 8) & 0xFF00);
+}
+
+// converts a color to the byte order of the display, see FIXBROT_BYTE_SWAP
+static FIXBROT_INLINE constexpr col_t color_to_display(col_t c) {
+#if FIXBROT_BYTE_SWAP
+  return color_bswap(c);
+#else
+  return c;
+#endif
+}
+
+static FIXBROT_INLINE constexpr col_t color_from_display(col_t c) {
+  return color_to_display(c);
+}
+
 template <typename T>
 static FIXBROT_INLINE T clamp(T min, T max, T val) {
   if (val < min) return min;
@@ -550,9 +589,82 @@ static constexpr int DEFAULT_PALETTE_SLOPE = 2;
 
 static constexpr int MIN_SCALE_EXP = -3;
 
+// supplied by the application, used for time budgets
+uint64_t get_time_us();
+static constexpr uint64_t NO_DEADLINE = ~(uint64_t)0;
+
+}  // namespace fixbrot
+
+#endif
+
+namespace fixbrot {
+
+// Bump allocator that carves buffers out of one block supplied by the
+// application, e.g. static storage sized by the get_arena_bytes() of the
+// objects constructed from it. Nothing is ever freed; the block must
+// outlive those objects and be aligned to ALIGN.
+//
+// A default-constructed arena has no block and only adds up the bytes
+// requested, which is how the get_arena_bytes() plans are computed from the
+// same sequence of alloc() calls that constructs the object.
+class Arena {
+ public:
+  static constexpr size_t ALIGN = 8;
+
+  static FIXBROT_INLINE constexpr size_t align_up(size_t bytes) {
+    return (bytes + ALIGN - 1) & ~(ALIGN - 1);
+  }
+
+ private:
+  uint8_t *base = nullptr;
+  size_t capacity = 0;
+  size_t used = 0;
+  bool overflowed = false;
+
+ public:
+  constexpr Arena() {}
+  Arena(void *base, size_t capacity)
+      : base((uint8_t *)base), capacity(capacity) {}
+
+  // Buffer of `n` elements, aligned to ALIGN. nullptr when counting, or if
+  // the block is exhausted, after which every later alloc() fails as well.
+  template <typename T>
+  constexpr T *alloc(size_t n) {
+    size_t offset = align_up(used);
+    used = offset + sizeof(T) * n;
+    if (!base) return nullptr;
+    if (used > capacity) {
+      overflowed = true;
+      return nullptr;
+    }
+    return reinterpret_cast<T *>(base + offset);
+  }
+
+  // bytes taken so far, including padding up to the next buffer
+  FIXBROT_INLINE constexpr size_t get_used() const { return align_up(used); }
+  FIXBROT_INLINE size_t get_capacity() const { return capacity; }
+
+  // true if an alloc() did not fit, meaning the block is smaller than planned
+  FIXBROT_INLINE bool has_overflowed() const { return overflowed; }
+};
+
 }  // namespace fixbrot
 
 #endif
+// #include "fixbrot/array_queue.hpp"
+
+#ifndef FIXBROT_QUEUE_HPP
+#define FIXBROT_QUEUE_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+// #include "fixbrot/arena.hpp"
+
+// #include "fixbrot/common.hpp"
+
 
 namespace fixbrot {
 
@@ -568,9 +680,28 @@ class ArrayQueue {
 
   TData *array;
 
-  ArrayQueue(index_t depth) : depth(depth) { array = new TData[depth]; }
+ private:
+  bool owns_array = false;
+
+ public:
+  // `array` of `depth` entries is supplied by the caller
+  ArrayQueue(index_t depth, TData *array) : depth(depth), array(array) {}
+
+  ArrayQueue(index_t depth, Arena &arena)
+      : depth(depth), array(arena.alloc<TData>(depth)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  ArrayQueue(index_t depth)
+      : depth(depth), array(new TData[depth]), owns_array(true) {}
+
+  ~ArrayQueue() {
+    if (owns_array) delete[] array;
+  }
+#endif
 
-  ~ArrayQueue() { delete[] array; }
+  static constexpr size_t get_arena_bytes(index_t depth) {
+    return Arena::align_up(sizeof(TData) * depth);
+  }
 
   FIXBROT_INLINE index_t size() const {
     index_t rp = rd_ptr;
@@ -625,6 +756,19 @@ class ArrayQueue {
 
 #endif// #include "fixbrot/common.hpp"
 
+// #include "fixbrot/display_sink.hpp"
+
+#ifndef FIXBROT_DISPLAY_SINK_HPP
+#define FIXBROT_DISPLAY_SINK_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
+
+// #include "fixbrot/arena.hpp"
+
+// #include "fixbrot/common.hpp"
+
 // #include "fixbrot/gui.hpp"
 
 #ifndef FIXBROT_GBUI_HPP
@@ -636,6 +780,8 @@ class ArrayQueue {
 #include <string.h>
 #endif
 
+// #include "fixbrot/arena.hpp"
+
 // #include "fixbrot/common.hpp"
 
 // #include "fixbrot/packed_bitmap.hpp"
@@ -645,6 +791,8 @@ class ArrayQueue {
 
 #include <gfxfont.h>
 
+// #include "fixbrot/arena.hpp"
+
 // #include "fixbrot/common.hpp"
 
 
@@ -657,36 +805,75 @@ class PackedBitmap {
  public:
   static constexpr int BPP = prm_BPP;
   static constexpr int PIXS_PER_BYTE = 8 / BPP;
+
+  // colors of the pixels packed in each possible byte value
+  struct expansion_t {
+    col_t pixels[256][PIXS_PER_BYTE];
+  };
+
   const pos_t width;
   const pos_t height;
   const pos_t stride;
 
  private:
   uint8_t *buff;
+  bool owns_buff = false;
 
  public:
+  PackedBitmap(pos_t width, pos_t height, Arena &arena)
+      : width(width),
+        height(height),
+        stride((width * BPP + 7) / 8),
+        buff(arena.alloc<uint8_t>(stride * height)) {}
+
+#ifndef FIXBROT_NO_STDLIB
   PackedBitmap(pos_t width, pos_t height)
       : width(width),
         height(height),
         stride((width * BPP + 7) / 8),
-        buff(new uint8_t[stride * height]) {}
+        buff(new uint8_t[stride * height]),
+        owns_buff(true) {}
+
+  ~PackedBitmap() {
+    if (owns_buff) delete[] buff;
+  }
+#endif
 
-  ~PackedBitmap() { delete[] buff; }
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height) {
+    return Arena::align_up((size_t)((width * BPP + 7) / 8) * height);
+  }
+
+  // false if the arena given to the constructor was too small
+  FIXBROT_INLINE bool has_buffer() const { return buff != nullptr; }
 
   FIXBROT_INLINE uint8_t *pixel_pointer(pos_t x, pos_t y) {
     return buff + (y * stride) + (x / PIXS_PER_BYTE);
   }
 
+  FIXBROT_INLINE const uint8_t *pixel_pointer(pos_t x, pos_t y) const {
+    return buff + (y * stride) + (x / PIXS_PER_BYTE);
+  }
+
+  static void build_expansion(const col_t *palette, expansion_t *exp) {
+    for (int byte = 0; byte < 256; byte++) {
+      for (int i = 0; i < PIXS_PER_BYTE; i++) {
+        int shift = (PIXS_PER_BYTE - 1 - i) * BPP;
+        exp->pixels[byte][i] = palette[(byte >> shift) & ((1 << BPP) - 1)];
+      }
+    }
+  }
+
   void render_to(pos_t sx, pos_t sy, pos_t w, pos_t h, col_t *dest_buff,
-                 int dest_stride, const col_t *palette) {
-    uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
+                 int dest_stride, const col_t *palette) const {
+    const uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
     for (pos_t iy = 0; iy < h; iy++) {
-      uint8_t *rd_ptr = rd_line_ptr;
+      const uint8_t *rd_ptr = rd_line_ptr;
       uint8_t rd_byte = *(rd_ptr++);
       rd_byte <<= (sx % PIXS_PER_BYTE) * BPP;
       col_t *wr_ptr = dest_buff;
       for (pos_t ix = 0; ix < w; ix++) {
-        uint8_t color = (rd_byte >> 6) & ((1 << BPP) - 1);
+        uint8_t color = (rd_byte >> (8 - BPP)) & ((1 << BPP) - 1);
         *(wr_ptr++) = palette[color];
         rd_byte <<= BPP;
         if (((sx + ix + 1) % PIXS_PER_BYTE) == 0) {
@@ -698,6 +885,48 @@ class PackedBitmap {
     }
   }
 
+  // same as above, expands whole source bytes through a table made by
+  // build_expansion()
+  void render_to(pos_t sx, pos_t sy, pos_t w, pos_t h, col_t *dest_buff,
+                 int dest_stride, const expansion_t &exp) const {
+    const uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
+    pos_t head = (PIXS_PER_BYTE - sx % PIXS_PER_BYTE) % PIXS_PER_BYTE;
+    if (head > w) head = w;
+    pos_t num_bytes = (w - head) / PIXS_PER_BYTE;
+    pos_t tail = w - head - num_bytes * PIXS_PER_BYTE;
+    for (pos_t iy = 0; iy < h; iy++) {
+      const uint8_t *rd_ptr = rd_line_ptr;
+      col_t *wr_ptr = dest_buff;
+
+      // unaligned pixels of the first byte
+      if (head > 0) {
+        const col_t *e = exp.pixels[*(rd_ptr++)] + (sx % PIXS_PER_BYTE);
+        for (pos_t i = 0; i < head; i++) {
+          *(wr_ptr++) = e[i];
+        }
+      }
+
+      // whole bytes, the compiler merges the copy into wide stores
+      for (pos_t ib = 0; ib < num_bytes; ib++) {
+        const col_t *e = exp.pixels[*(rd_ptr++)];
+        for (int i = 0; i < PIXS_PER_BYTE; i++) {
+          wr_ptr[i] = e[i];
+        }
+        wr_ptr += PIXS_PER_BYTE;
+      }
+
+      if (tail > 0) {
+        const col_t *e = exp.pixels[*rd_ptr];
+        for (pos_t i = 0; i < tail; i++) {
+          *(wr_ptr++) = e[i];
+        }
+      }
+
+      rd_line_ptr += stride;
+      dest_buff += dest_stride;
+    }
+  }
+
   void clear(uint8_t color = 0) {
     color = extend_pixel(color);
     uint8_t *line_ptr = buff;
@@ -838,17 +1067,29 @@ class PackedBitmap {
 
 class MonoBitmap : public PackedBitmap<1> {
  public:
+  MonoBitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<1>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   MonoBitmap(pos_t width, pos_t height) : PackedBitmap<1>(width, height) {}
+#endif
 };
 
 class Gray2Bitmap : public PackedBitmap<2> {
  public:
+  Gray2Bitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<2>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   Gray2Bitmap(pos_t width, pos_t height) : PackedBitmap<2>(width, height) {}
+#endif
 };
 
 class Gray4Bitmap : public PackedBitmap<4> {
  public:
+  Gray4Bitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<4>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   Gray4Bitmap(pos_t width, pos_t height) : PackedBitmap<4>(width, height) {}
+#endif
 };
 
 }  // namespace fixbrot
@@ -865,6 +1106,8 @@ class Gray4Bitmap : public PackedBitmap<4> {
 #include <string.h>
 #endif
 
+// #include "fixbrot/arena.hpp"
+
 // #include "fixbrot/array_queue.hpp"
 
 // #include "fixbrot/common.hpp"
@@ -1647,164 +1890,1357 @@ class Mandelbrot {
 }  // namespace fixbrot
 
 #endif
+// #include "fixbrot/pixel_format.hpp"
 
-namespace fixbrot {
+#ifndef FIXBROT_PIXEL_FORMAT_HPP
+#define FIXBROT_PIXEL_FORMAT_HPP
 
-void on_render_start(const scene_t &scene);
-void on_render_finished(result_t res);
-bool on_collect(cell_t *resp);
-uint64_t get_time_ms();
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
 
-class Renderer {
- public:
-  const pos_t width;
-  const pos_t height;
-  static constexpr int ZOOM_DURATION_MS = 200;
+// #include "fixbrot/common.hpp"
 
- private:
-  uint64_t last_ms = 0;
 
-  int busy_items = 0;
-  ArrayQueue<vec_t> queue;
-#if FIXBROT_ITER_12BIT
-  const pos_t stride;
-  uint8_t *work_buff;
-  uint8_t *copy_buff;
-#else
-  iter_t *work_buff;
-#endif
+namespace fixbrot {
 
-  scene_t scene;
-  int scale_exp = -2;
-  int screen_size_clog2 = 0;
-  bool vert_flip = false;
-  uint32_t iter_accum = 0;
+// 8 bits per channel color, 0x00RRGGBB
+using rgb888_t = uint32_t;
 
-  pos_t correct_x = 0;
-  pos_t correct_y = height;
+static FIXBROT_INLINE constexpr rgb888_t rgb888_pack(uint8_t r, uint8_t g,
+                                                     uint8_t b) {
+  return ((rgb888_t)r << 16) | ((rgb888_t)g << 8) | b;
+}
 
-  col_t palette[MAX_PALETTE_SIZE] = {0};
-  col_t max_iter_color = 0x0000;
-  int palette_slope = 0;
-  int palette_phase = 0;
-  int palette_size = MAX_PALETTE_SIZE;
+static FIXBROT_INLINE constexpr uint8_t rgb888_r(rgb888_t c) {
+  return (c >> 16) & 0xFF;
+}
+static FIXBROT_INLINE constexpr uint8_t rgb888_g(rgb888_t c) {
+  return (c >> 8) & 0xFF;
+}
+static FIXBROT_INLINE constexpr uint8_t rgb888_b(rgb888_t c) {
+  return c & 0xFF;
+}
 
-  bool paint_requested = false;
-  bool paint_zoom_inprog = false;
-  bool paint_zoom_dir_in = false;
-  uint64_t paint_zoom_end_ms = 0;
-  pos_t *paint_x_buff;
-  float paint_scale = 1.0f;
+static FIXBROT_INLINE constexpr rgb888_t rgb888_div2(rgb888_t c) {
+  return (c >> 1) & 0x7F7F7F;
+}
 
- public:
-  Renderer(pos_t width, pos_t height)
-      : width(width),
-        height(height),
-        queue((width + height) * 16),
-#if FIXBROT_ITER_12BIT
-        stride(width * 3 / 2),
-        work_buff(new uint8_t[stride * height]),
-        copy_buff(new uint8_t[stride]),
-#else
-        work_buff(new iter_t[width * height]),
-#endif
-        paint_x_buff(new pos_t[width]) {
+// Output pixel formats of Renderer::paint_rect_as(). Each format receives
+// both the color and the palette index of a pixel and uses one of them,
+// see Renderer::export_palette8() for the meaning of indices.
+
+struct indexed8_format_t {
+  using pixel_t = uint8_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t, uint8_t index) {
+    return index;
   }
+};
 
-  ~Renderer() {
-    delete[] work_buff;
-    delete[] paint_x_buff;
+struct rgb565_format_t {
+  using pixel_t = uint16_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return ((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F);
   }
+};
 
-  real_t get_center_re() const { return scene.real; }
-  real_t get_center_im() const { return scene.imag; }
-  int get_scale_exp() const { return scale_exp; }
+struct argb4444_format_t {
+  using pixel_t = uint16_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return 0xF000 | ((c >> 12) & 0x0F00) | ((c >> 8) & 0x00F0) |
+           ((c >> 4) & 0x000F);
+  }
+};
 
-  result_t init() {
-    scene.formula = formula_t::MANDELBROT;
-    scene.real = -0.5f;
-    scene.imag = 0;
-    scene.max_iter = 200;
+// bytes R, G, B, A in memory on little-endian hosts
+struct rgba8888_format_t {
+  using pixel_t = uint32_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return 0xFF000000 | ((c >> 16) & 0xFF) | (c & 0xFF00) |
+           ((c & 0xFF) << 16);
+  }
+};
 
-    scale_exp = -2;
-    screen_size_clog2 = 0;
-    pos_t p = width > height ? width : height;
-    while (p > 0) {
-      screen_size_clog2++;
-      p /= 2;
-    }
-    update_pixel_step();
+}  // namespace fixbrot
 
-    palette_load_heatmap(DEFAULT_PALETTE_SLOPE);
+#endif
+// #include "fixbrot/snapshot.hpp"
 
-    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
-    FIXBROT_TRY(start_render(true));
-    paint_requested = true;
+#ifndef FIXBROT_SNAPSHOT_HPP
+#define FIXBROT_SNAPSHOT_HPP
 
-    return result_t::SUCCESS;
-  }
+#ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
+#include <stdint.h>
+#endif
 
-  result_t service() {
-    uint64_t now_ms = get_time_ms();
-    last_ms = now_ms;
+// #include "fixbrot/common.hpp"
 
-    if (is_busy()) {
-      FIXBROT_TRY(iterate());
-    }
 
-    // zoom animation
-    paint_scale = 1.0f;
-    if (paint_zoom_inprog) {
-      int32_t t = (int32_t)(paint_zoom_end_ms - now_ms);
-      if (t < 0) {
-        t = 0;
-        paint_zoom_inprog = false;
-      }
-      paint_requested = true;
-      if (paint_zoom_dir_in) {
-        paint_scale = 1.0f + (float)t / ZOOM_DURATION_MS;
-      } else {
-        paint_scale = 1.0f - (float)t / (ZOOM_DURATION_MS * 2);
-      }
-    }
+namespace fixbrot {
 
-    return result_t::SUCCESS;
-  }
+// Snapshot of a view saved by Renderer::save_snapshot(). All integers are
+// little-endian:
+//
+//   u32 magic "FXBS"    u16 version        u16 width, height
+//   u8  formula         u8  vert_flip      u8  palette, palette_slope
+//   u16 palette_phase   i32 scale_exp      i64 real, imag, step (raw)
+//   u16 max_iter
+//   runs of pixels in row-major order: u16 iteration count followed by the
+//     run length minus one as LEB128, until width * height pixels
+//   u32 FNV-1a hash of the run bytes
+//
+// Iteration counts are stored with SNAPSHOT_ITER_MAX and
+// SNAPSHOT_ITER_QUEUED for the special values, so that snapshots are
+// exchangeable between 12 and 16 bit builds as long as max_iter fits.
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x53425846;
+static constexpr uint16_t SNAPSHOT_VERSION = 1;
+static constexpr uint16_t SNAPSHOT_ITER_MAX = 0xFFFD;
+static constexpr uint16_t SNAPSHOT_ITER_QUEUED = 0xFFFE;
+
+static FIXBROT_INLINE uint16_t snapshot_iter_from(iter_t iter) {
+  if (iter == ITER_MAX) return SNAPSHOT_ITER_MAX;
+  if (iter == ITER_QUEUED) return SNAPSHOT_ITER_QUEUED;
+  return iter;
+}
 
-  result_t scroll(pos_t delta_x, pos_t delta_y) {
-    if (is_busy()) return result_t::ERROR_BUSY;
+// ITER_WALL for values that do not fit this build
+static FIXBROT_INLINE iter_t snapshot_iter_to(uint16_t value) {
+  if (value == SNAPSHOT_ITER_MAX) return ITER_MAX;
+  if (value == SNAPSHOT_ITER_QUEUED) return ITER_QUEUED;
+  if (value >= ITER_MAX) return ITER_WALL;
+  return value;
+}
 
-    if (vert_flip) {
-      delta_y = -delta_y;
-    }
+// Buffered output to a stream. `prm_TStream` provides:
+//
+//   // false on failure
+//   bool write(const void *data, size_t size);
+template <typename prm_TStream>
+class SnapshotWriter {
+ public:
+  static constexpr int BUFF_SIZE = 64;
 
-    delta_x = clamp((pos_t)(-width + 2), (pos_t)(width - 2), delta_x);
-    delta_y = clamp((pos_t)(-height + 2), (pos_t)(height - 2), delta_y);
+ private:
+  prm_TStream &stream;
+  uint8_t buff[BUFF_SIZE];
+  int buff_len = 0;
+  uint32_t hash = 2166136261u;
+  bool failed = false;
 
-    if (scene.real < -2 && delta_x < 0) delta_x = 0;
-    if (scene.real > 2 && delta_x > 0) delta_x = 0;
-    if (scene.imag < -2 && delta_y < 0) delta_y = 0;
-    if (scene.imag > 2 && delta_y > 0) delta_y = 0;
+ public:
+  SnapshotWriter(prm_TStream &stream) : stream(stream) {}
 
-    if (delta_x == 0 && delta_y == 0) return result_t::SUCCESS;
+  FIXBROT_INLINE void put_u8(uint8_t val) {
+    if (buff_len >= BUFF_SIZE) flush();
+    buff[buff_len++] = val;
+    hash = (hash ^ val) * 16777619u;
+  }
 
-    scene.real += scene.step * delta_x;
-    scene.imag += scene.step * delta_y;
+  void put_u16(uint16_t val) {
+    put_u8(val);
+    put_u8(val >> 8);
+  }
 
-    pos_t dh = height - ((delta_y >= 0) ? delta_y : -delta_y);
-    pos_t dw = width - ((delta_x >= 0) ? delta_x : -delta_x);
+  void put_u32(uint32_t val) {
+    put_u16(val);
+    put_u16(val >> 16);
+  }
 
-    pos_t dx0 = (delta_x >= 0) ? 0 : -delta_x;
-    pos_t dy0 = (delta_y >= 0) ? 0 : -delta_y;
-    pos_t dx1 = dx0 + dw;
-    pos_t dy1 = dy0 + dh;
+  void put_u64(uint64_t val) {
+    put_u32(val);
+    put_u32(val >> 32);
+  }
 
-    pos_t sx0 = dx0 + delta_x;
-    pos_t sy0 = dy0 + delta_y;
-    pos_t sx1 = sx0 + dw;
-    pos_t sy1 = sy0 + dh;
+  void put_varint(uint32_t val) {
+    while (val >= 0x80) {
+      put_u8((val & 0x7F) | 0x80);
+      val >>= 7;
+    }
+    put_u8(val);
+  }
 
-// scroll image data
+  // hash of the bytes since the last reset_hash()
+  FIXBROT_INLINE uint32_t get_hash() const { return hash; }
+  FIXBROT_INLINE void reset_hash() { hash = 2166136261u; }
+
+  // false if any write to the stream has failed
+  bool flush() {
+    if (buff_len > 0 && !failed) {
+      failed = !stream.write(buff, buff_len);
+    }
+    buff_len = 0;
+    return !failed;
+  }
+};
+
+// Buffered input from a stream, which may be read up to BUFF_SIZE bytes
+// past the end of the snapshot. `prm_TStream` provides:
+//
+//   // number of bytes read into `data`, at most `size`; 0 at the end of
+//   // the stream or on failure
+//   size_t read(void *data, size_t size);
+template <typename prm_TStream>
+class SnapshotReader {
+ public:
+  static constexpr int BUFF_SIZE = 64;
+
+ private:
+  prm_TStream &stream;
+  uint8_t buff[BUFF_SIZE];
+  int buff_len = 0;
+  int buff_pos = 0;
+  uint32_t hash = 2166136261u;
+  bool failed = false;
+
+ public:
+  SnapshotReader(prm_TStream &stream) : stream(stream) {}
+
+  // 0 past the end of the stream, see is_failed()
+  FIXBROT_INLINE uint8_t get_u8() {
+    if (buff_pos >= buff_len && !fill()) return 0;
+    uint8_t val = buff[buff_pos++];
+    hash = (hash ^ val) * 16777619u;
+    return val;
+  }
+
+  uint16_t get_u16() {
+    uint16_t val = get_u8();
+    return val | ((uint16_t)get_u8() << 8);
+  }
+
+  uint32_t get_u32() {
+    uint32_t val = get_u16();
+    return val | ((uint32_t)get_u16() << 16);
+  }
+
+  uint64_t get_u64() {
+    uint64_t val = get_u32();
+    return val | ((uint64_t)get_u32() << 32);
+  }
+
+  uint32_t get_varint() {
+    uint32_t val = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b = get_u8();
+      val |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return val;
+    }
+    failed = true;
+    return 0;
+  }
+
+  FIXBROT_INLINE uint32_t get_hash() const { return hash; }
+  FIXBROT_INLINE void reset_hash() { hash = 2166136261u; }
+
+  // true if the stream ended early or a varint was malformed
+  FIXBROT_INLINE bool is_failed() const { return failed; }
+
+ private:
+  bool fill() {
+    buff_pos = 0;
+    buff_len = failed ? 0 : (int)stream.read(buff, BUFF_SIZE);
+    if (buff_len <= 0) {
+      buff_len = 0;
+      failed = true;
+      return false;
+    }
+    return true;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+// #include "fixbrot/tile_cache.hpp"
+
+#ifndef FIXBROT_TILE_CACHE_HPP
+#define FIXBROT_TILE_CACHE_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+// #include "fixbrot/arena.hpp"
+
+// #include "fixbrot/common.hpp"
+
+
+namespace fixbrot {
+
+// Identifies a square of finished pixels. Tile coordinates are in units of
+// TileCache::TILE_SIZE pixels of the scale's pixel grid.
+struct tile_key_t {
+  formula_t formula;
+  int scale_exp;
+  iter_t max_iter;
+  int64_t tx;
+  int64_t ty;
+
+  FIXBROT_INLINE bool operator==(const tile_key_t &other) const {
+    return formula == other.formula && scale_exp == other.scale_exp &&
+           max_iter == other.max_iter && tx == other.tx && ty == other.ty;
+  }
+};
+
+// Least-recently-used cache of finished tiles within a fixed memory budget.
+// Tiles are found through a hash table of chained buckets and kept in a
+// list from the most to the least recently used, so lookups and inserts
+// take constant time however many tiles fit.
+class TileCache {
+ public:
+  static constexpr int TILE_SIZE_BITS = 5;
+  static constexpr int TILE_SIZE = 1 << TILE_SIZE_BITS;
+  static constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+  struct tile_t {
+    tile_key_t key;
+    // next tile of the same bucket, and neighbours in the recency list,
+    // -1 at the ends
+    int32_t bucket_next;
+    int32_t newer;
+    int32_t older;
+    bool valid;
+    iter_t pixels[TILE_PIXELS];
+  };
+
+  const int capacity;
+  const int num_buckets;
+
+ private:
+  // `capacity` cached tiles followed by one scratch tile
+  tile_t *tiles;
+  // first tile of each bucket, -1 if empty
+  int32_t *buckets;
+  bool owns_tiles = false;
+  int32_t newest = -1;
+  int32_t oldest = -1;
+  uint32_t num_hits = 0;
+  uint32_t num_misses = 0;
+
+ public:
+  TileCache(uint32_t budget_bytes, Arena &arena)
+      : capacity(num_tiles(budget_bytes)),
+        num_buckets(bucket_count(capacity)),
+        tiles(arena.alloc<tile_t>(capacity + 1)),
+        buckets(arena.alloc<int32_t>(num_buckets)) {
+    if (tiles && buckets) clear();
+  }
+
+#ifndef FIXBROT_NO_STDLIB
+  TileCache(uint32_t budget_bytes)
+      : capacity(num_tiles(budget_bytes)),
+        num_buckets(bucket_count(capacity)),
+        tiles(new tile_t[capacity + 1]),
+        buckets(new int32_t[num_buckets]),
+        owns_tiles(true) {
+    clear();
+  }
+
+  ~TileCache() {
+    if (owns_tiles) {
+      delete[] tiles;
+      delete[] buckets;
+    }
+  }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(uint32_t budget_bytes) {
+    return Arena::align_up(sizeof(tile_t) * (num_tiles(budget_bytes) + 1)) +
+           Arena::align_up(sizeof(int32_t) *
+                           bucket_count(num_tiles(budget_bytes)));
+  }
+
+  void clear() {
+    for (int i = 0; i < num_buckets; i++) {
+      buckets[i] = -1;
+    }
+    // every tile free, from the newest to the oldest
+    for (int i = 0; i < capacity; i++) {
+      tiles[i].valid = false;
+      tiles[i].bucket_next = -1;
+      tiles[i].newer = i - 1;
+      tiles[i].older = (i + 1 < capacity) ? (i + 1) : -1;
+    }
+    newest = (capacity > 0) ? 0 : -1;
+    oldest = capacity - 1;
+  }
+
+  // pixels of the tile, nullptr if not cached
+  const iter_t *find(const tile_key_t &key) {
+    int32_t i = lookup(key);
+    if (i < 0) {
+      num_misses++;
+      return nullptr;
+    }
+    num_hits++;
+    touch(i);
+    return tiles[i].pixels;
+  }
+
+  FIXBROT_INLINE bool contains(const tile_key_t &key) {
+    int32_t i = lookup(key);
+    if (i >= 0) touch(i);
+    return i >= 0;
+  }
+
+  // buffer to store the pixels of a new tile to, replacing the least
+  // recently used one; nullptr if the cache has no capacity
+  iter_t *insert(const tile_key_t &key) {
+    if (capacity <= 0) return nullptr;
+    int32_t i = lookup(key);
+    if (i < 0) {
+      i = oldest;
+      tile_t &t = tiles[i];
+      if (t.valid) unlink_bucket(i);
+      t.key = key;
+      t.valid = true;
+      int32_t &head = buckets[hash(key)];
+      t.bucket_next = head;
+      head = i;
+    }
+    touch(i);
+    return tiles[i].pixels;
+  }
+
+  // pixels of a tile outside the cache, for collecting one before insert()
+  FIXBROT_INLINE iter_t *get_scratch() { return tiles[capacity].pixels; }
+
+  FIXBROT_INLINE uint32_t get_num_hits() const { return num_hits; }
+  FIXBROT_INLINE uint32_t get_num_misses() const { return num_misses; }
+
+ private:
+  // tiles fitting in the budget besides the scratch tile, counting up to
+  // two bucket entries per tile
+  static constexpr int num_tiles(uint32_t budget_bytes) {
+    return (budget_bytes > sizeof(tile_t) + 2 * sizeof(int32_t))
+               ? (int)(budget_bytes /
+                       (sizeof(tile_t) + 2 * sizeof(int32_t))) -
+                     1
+               : 0;
+  }
+
+  // power of two of at least one bucket per tile
+  static constexpr int bucket_count(int capacity) {
+    int n = 1;
+    while (n < capacity) n *= 2;
+    return n;
+  }
+
+  FIXBROT_INLINE uint32_t hash(const tile_key_t &key) const {
+    uint32_t h = (uint32_t)key.tx * 0x9E3779B1u;
+    h ^= (uint32_t)key.ty * 0x85EBCA77u;
+    h ^= (uint32_t)key.scale_exp * 0xC2B2AE3Du;
+    h ^= ((uint32_t)key.max_iter << 8) | (uint32_t)key.formula;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 13;
+    return h & (num_buckets - 1);
+  }
+
+  int32_t lookup(const tile_key_t &key) const {
+    if (capacity <= 0) return -1;
+    for (int32_t i = buckets[hash(key)]; i >= 0; i = tiles[i].bucket_next) {
+      if (tiles[i].key == key) return i;
+    }
+    return -1;
+  }
+
+  void unlink_bucket(int32_t i) {
+    int32_t *link = &buckets[hash(tiles[i].key)];
+    while (*link != i) link = &tiles[*link].bucket_next;
+    *link = tiles[i].bucket_next;
+  }
+
+  // moves tile `i` to the front of the recency list
+  void touch(int32_t i) {
+    if (i == newest) return;
+    tile_t &t = tiles[i];
+    tiles[t.newer].older = t.older;
+    if (t.older >= 0) {
+      tiles[t.older].newer = t.newer;
+    } else {
+      oldest = t.newer;
+    }
+    t.newer = -1;
+    t.older = newest;
+    tiles[newest].newer = i;
+    newest = i;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+// #include "fixbrot/trace.hpp"
+
+#ifndef FIXBROT_TRACE_HPP
+#define FIXBROT_TRACE_HPP
+
+#ifndef FIXBROT_TRACE
+#define FIXBROT_TRACE (0)
+#endif
+
+#ifndef FIXBROT_TRACE_NUM_CORES
+#define FIXBROT_TRACE_NUM_CORES (2)
+#endif
+
+// number of records per core, must be a power of 2
+#ifndef FIXBROT_TRACE_DEPTH
+#define FIXBROT_TRACE_DEPTH (4096)
+#endif
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <stdio.h>
+#endif
+
+// #include "fixbrot/common.hpp"
+
+
+namespace fixbrot {
+
+enum class trace_event_t : uint8_t {
+  GUI_SERVICE,
+  GUI_PAINT_START,
+  GUI_PAINT_LINE,
+  RENDERER_ITERATE,
+  RENDERER_CORRECT,
+  RENDERER_FILL_BLANK,
+  FEED,
+  WORKER_SERVICE,
+  LAST,
+};
+
+static inline const char *get_trace_event_name(trace_event_t ev) {
+  switch (ev) {
+    case trace_event_t::GUI_SERVICE:
+      return "GUI::service";
+    case trace_event_t::GUI_PAINT_START:
+      return "GUI::paint_start";
+    case trace_event_t::GUI_PAINT_LINE:
+      return "GUI::paint_line";
+    case trace_event_t::RENDERER_ITERATE:
+      return "Renderer::iterate";
+    case trace_event_t::RENDERER_CORRECT:
+      return "Renderer::correct";
+    case trace_event_t::RENDERER_FILL_BLANK:
+      return "Renderer::fill_blank";
+    case trace_event_t::FEED:
+      return "feed";
+    case trace_event_t::WORKER_SERVICE:
+      return "Worker::service";
+    default:
+      return "(Unknown)";
+  }
+}
+
+#if FIXBROT_TRACE
+
+int get_core_id();
+
+struct trace_record_t {
+  uint32_t time_us;
+  trace_event_t event;
+  bool begin;
+};
+
+// Fixed-size ring of trace records. Each core writes only its own ring, so
+// recording needs no lock. Old records are overwritten when the ring is full.
+struct trace_ring_t {
+  static constexpr uint32_t DEPTH = FIXBROT_TRACE_DEPTH;
+  trace_record_t records[DEPTH];
+  volatile uint32_t wr_ptr;
+
+  FIXBROT_INLINE void record(trace_event_t ev, bool begin) {
+    uint32_t wp = wr_ptr;
+    trace_record_t &r = records[wp & (DEPTH - 1)];
+    r.time_us = (uint32_t)get_time_us();
+    r.event = ev;
+    r.begin = begin;
+    wr_ptr = wp + 1;
+  }
+
+  FIXBROT_INLINE uint32_t size() const {
+    return (wr_ptr < DEPTH) ? wr_ptr : DEPTH;
+  }
+
+  // i-th oldest record
+  FIXBROT_INLINE const trace_record_t &at(uint32_t i) const {
+    return records[(wr_ptr - size() + i) & (DEPTH - 1)];
+  }
+};
+
+trace_ring_t trace_rings[FIXBROT_TRACE_NUM_CORES];
+
+static FIXBROT_INLINE void trace_record(trace_event_t ev, bool begin) {
+  int core = get_core_id();
+  if (0 <= core && core < FIXBROT_TRACE_NUM_CORES) {
+    trace_rings[core].record(ev, begin);
+  }
+}
+
+static inline void trace_clear() {
+  for (int i = 0; i < FIXBROT_TRACE_NUM_CORES; i++) {
+    trace_rings[i].wr_ptr = 0;
+  }
+}
+
+class TraceScope {
+ public:
+  const trace_event_t event;
+  FIXBROT_INLINE TraceScope(trace_event_t ev) : event(ev) {
+    trace_record(event, true);
+  }
+  FIXBROT_INLINE ~TraceScope() { trace_record(event, false); }
+};
+
+#define FIXBROT_TRACE_BEGIN(ev) fixbrot::trace_record((ev), true)
+#define FIXBROT_TRACE_END(ev) fixbrot::trace_record((ev), false)
+#define FIXBROT_TRACE_SCOPE(ev) fixbrot::TraceScope fixbrot_trace_scope((ev))
+
+#ifndef FIXBROT_NO_STDLIB
+using trace_write_t = void (*)(void *ctx, const char *str, int len);
+
+// Writes recorded events in Chrome trace (chrome://tracing, Perfetto) JSON
+// format, one thread per core. Recording should be paused while exporting.
+static inline void trace_export_chrome_json(trace_write_t write, void *ctx) {
+  char buf[128];
+  int n;
+  bool first = true;
+
+  // time stamps are 32 bit, so take the oldest record of all cores as zero
+  bool has_base = false;
+  uint32_t base_us = 0;
+  for (int core = 0; core < FIXBROT_TRACE_NUM_CORES; core++) {
+    const trace_ring_t &ring = trace_rings[core];
+    if (ring.size() == 0) continue;
+    uint32_t t = ring.at(0).time_us;
+    if (!has_base || (int32_t)(t - base_us) < 0) {
+      base_us = t;
+      has_base = true;
+    }
+  }
+
+  n = snprintf(buf, sizeof(buf), "{\"traceEvents\":[\n");
+  write(ctx, buf, n);
+
+  for (int core = 0; core < FIXBROT_TRACE_NUM_CORES; core++) {
+    const trace_ring_t &ring = trace_rings[core];
+    uint32_t num_records = ring.size();
+    if (num_records == 0) continue;
+
+    n = snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                 "\"tid\":%d,\"args\":{\"name\":\"Core%d\"}}",
+                 first ? "" : ",\n", core, core);
+    write(ctx, buf, n);
+    first = false;
+
+    // unwrap time stamps while walking the ring
+    uint32_t last_us = ring.at(0).time_us;
+    uint64_t ts_us = (uint32_t)(last_us - base_us);
+    int depth = 0;
+    for (uint32_t i = 0; i < num_records; i++) {
+      const trace_record_t &r = ring.at(i);
+      ts_us += (uint32_t)(r.time_us - last_us);
+      last_us = r.time_us;
+
+      // drop end events whose begin was overwritten
+      if (r.begin) {
+        depth++;
+      } else if (depth > 0) {
+        depth--;
+      } else {
+        continue;
+      }
+
+      n = snprintf(buf, sizeof(buf),
+                   ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,"
+                   "\"pid\":0,\"tid\":%d}",
+                   get_trace_event_name(r.event), r.begin ? 'B' : 'E',
+                   (unsigned long long)ts_us, core);
+      write(ctx, buf, n);
+    }
+  }
+
+  n = snprintf(buf, sizeof(buf), "\n]}\n");
+  write(ctx, buf, n);
+}
+#endif
+
+#else
+
+#define FIXBROT_TRACE_BEGIN(ev) \
+  do {                          \
+  } while (0)
+#define FIXBROT_TRACE_END(ev) \
+  do {                        \
+  } while (0)
+#define FIXBROT_TRACE_SCOPE(ev) \
+  do {                          \
+  } while (0)
+
+#endif
+
+}  // namespace fixbrot
+
+#endif
+// #include "fixbrot/zoom_history.hpp"
+
+#ifndef FIXBROT_ZOOM_HISTORY_HPP
+#define FIXBROT_ZOOM_HISTORY_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <string.h>
+#endif
+
+// #include "fixbrot/arena.hpp"
+
+// #include "fixbrot/common.hpp"
+
+
+namespace fixbrot {
+
+// Stack of finished views saved by zoom_in(), so that zoom_out() can
+// restore them instead of rendering again. Pixels are run-length encoded
+// as pairs of (run length, iteration count) words in a buffer of fixed
+// size; the oldest snapshots are dropped when it is full.
+class ZoomHistory {
+ public:
+  static constexpr int MAX_DEPTH = 16;
+
+ private:
+  struct entry_t {
+    scene_t scene;
+    int scale_exp;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  const uint32_t capacity;
+  uint16_t *data;
+  bool owns_data = false;
+  entry_t entries[MAX_DEPTH];
+  int depth = 0;
+
+  // snapshot being written
+  bool pushing = false;
+  uint32_t wr_ptr = 0;
+  uint16_t run_len = 0;
+  iter_t run_iter = 0;
+
+  // snapshot being read
+  uint32_t rd_ptr = 0;
+  uint16_t rd_len = 0;
+
+ public:
+  ZoomHistory(uint32_t budget_bytes, Arena &arena)
+      : capacity(budget_bytes / sizeof(uint16_t)),
+        data(arena.alloc<uint16_t>(capacity)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  ZoomHistory(uint32_t budget_bytes)
+      : capacity(budget_bytes / sizeof(uint16_t)),
+        data(new uint16_t[capacity > 0 ? capacity : 1]),
+        owns_data(true) {}
+
+  ~ZoomHistory() {
+    if (owns_data) delete[] data;
+  }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(uint32_t budget_bytes) {
+    return Arena::align_up(budget_bytes / sizeof(uint16_t) *
+                           sizeof(uint16_t));
+  }
+
+  void clear() {
+    depth = 0;
+    pushing = false;
+  }
+
+  FIXBROT_INLINE int get_depth() const { return depth; }
+
+  // starts a snapshot of the view `scene`, followed by push_pixel() for
+  // each pixel in row-major order and push_end()
+  void push_begin(const scene_t &scene, int scale_exp) {
+    if (depth >= MAX_DEPTH) drop_oldest();
+    entry_t &e = entries[depth];
+    e.scene = scene;
+    e.scale_exp = scale_exp;
+    e.offset = 0;
+    if (depth > 0) {
+      e.offset = entries[depth - 1].offset + entries[depth - 1].size;
+    }
+    e.size = 0;
+    wr_ptr = e.offset;
+    run_len = 0;
+    pushing = true;
+  }
+
+  // false if the snapshot does not fit and has been discarded
+  bool push_pixel(iter_t iter) {
+    if (!pushing) return false;
+    if (run_len > 0 && iter == run_iter && run_len < 0xFFFF) {
+      run_len++;
+      return true;
+    }
+    if (run_len > 0 && !flush_run()) return false;
+    run_iter = iter;
+    run_len = 1;
+    return true;
+  }
+
+  void push_end() {
+    if (!pushing) return;
+    pushing = false;
+    if (run_len > 0 && !flush_run()) return;
+    entries[depth].size = wr_ptr - entries[depth].offset;
+    depth++;
+  }
+
+  // Pops the newest snapshot. Returns true if it shows `scene` at
+  // `scale_exp`, the pixels are then read by pop_pixel() in row-major
+  // order before the next push.
+  bool pop(const scene_t &scene, int scale_exp) {
+    if (depth == 0) return false;
+    const entry_t &e = entries[--depth];
+    if (e.scale_exp != scale_exp || e.scene.formula != scene.formula ||
+        e.scene.real.raw != scene.real.raw ||
+        e.scene.imag.raw != scene.imag.raw ||
+        e.scene.step.raw != scene.step.raw ||
+        e.scene.max_iter != scene.max_iter) {
+      return false;
+    }
+    rd_ptr = e.offset;
+    rd_len = 0;
+    return true;
+  }
+
+  FIXBROT_INLINE iter_t pop_pixel() {
+    if (rd_len == 0) {
+      rd_len = data[rd_ptr];
+      rd_ptr += 2;
+    }
+    rd_len--;
+    return data[rd_ptr - 1];
+  }
+
+ private:
+  bool flush_run() {
+    if (wr_ptr + 2 > capacity) {
+      // make room by dropping older snapshots, give up if there are none
+      uint32_t used = wr_ptr - entries[depth].offset;
+      if (depth == 0 || !drop_oldest()) {
+        pushing = false;
+        return false;
+      }
+      wr_ptr = entries[depth].offset + used;
+      if (wr_ptr + 2 > capacity) return flush_run();
+    }
+    data[wr_ptr++] = run_len;
+    data[wr_ptr++] = run_iter;
+    return true;
+  }
+
+  // moves everything above the oldest snapshot down over it
+  bool drop_oldest() {
+    if (depth == 0) return false;
+    uint32_t shift = entries[0].size;
+    uint32_t end = pushing ? wr_ptr : (entries[depth - 1].offset +
+                                       entries[depth - 1].size);
+    memmove(data, data + shift, sizeof(uint16_t) * (end - shift));
+    for (int i = 1; i <= depth && i < MAX_DEPTH; i++) {
+      entries[i - 1] = entries[i];
+      entries[i - 1].offset -= shift;
+    }
+    depth--;
+    return true;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+
+// iterations below 2^FIXBROT_COLOR_LUT_BITS are colored by table lookup
+#ifndef FIXBROT_COLOR_LUT_BITS
+#define FIXBROT_COLOR_LUT_BITS (12)
+#endif
+
+// On x86 hosts, paint_line() looks up 8 pixels at a time (AVX2 gather or
+// SSE4.1 inserts) where they read 1:1 from a 16-bit work buffer.
+#ifndef FIXBROT_COLOR_LUT_SIMD
+#if !FIXBROT_ITER_12BIT && !defined(FIXBROT_NO_STDLIB) && \
+    (defined(__AVX2__) || defined(__SSE4_1__))
+#define FIXBROT_COLOR_LUT_SIMD (1)
+#else
+#define FIXBROT_COLOR_LUT_SIMD (0)
+#endif
+#endif
+
+#if FIXBROT_COLOR_LUT_SIMD
+#include <immintrin.h>
+#endif
+
+namespace fixbrot {
+
+void on_render_start(const scene_t &scene);
+void on_render_finished(result_t res);
+void on_prefetch_start(const scene_t &scene);
+bool on_collect(cell_t *resp);
+uint64_t get_time_ms();
+
+// counters of the current (or last) render, reset by each render start
+struct render_stats_t {
+  uint32_t cells_enqueued;
+  uint32_t cells_collected;
+  uint32_t correct_computes;
+  uint32_t queue_peak;
+  uint32_t queue_capacity;
+  // cells deferred to the overflow bitmap because the queue was full
+  uint32_t cells_overflowed;
+  uint32_t fill_blank_pixels;
+  uint64_t total_iters;
+  uint64_t start_ms;
+  uint32_t render_ms;
+  uint32_t tiles_loaded;
+  uint32_t tiles_prefetched;
+  bool finished;
+};
+
+class Renderer {
+ public:
+  const pos_t width;
+  const pos_t height;
+  static constexpr int ZOOM_DURATION_MS = 200;
+  static constexpr uint32_t DEFAULT_PAINT_INTERVAL_MS = 100;
+  // progressive repaints may take at most 1/PAINT_COST_RATIO of the time
+  static constexpr uint32_t PAINT_COST_RATIO = 4;
+  static constexpr int COLOR_LUT_SIZE = 1 << FIXBROT_COLOR_LUT_BITS;
+  // zoom animation scale is fixed point with this many fraction bits
+  static constexpr int PAINT_SCALE_BITS = 16;
+  static constexpr int32_t PAINT_SCALE_ONE = 1 << PAINT_SCALE_BITS;
+
+  // indices written by indexed8_format_t
+  static constexpr uint8_t INDEX8_BLANK = 0;
+  static constexpr uint8_t INDEX8_INSIDE = 1;
+  static constexpr uint8_t INDEX8_QUEUED = 2;
+  static constexpr uint8_t INDEX8_PALETTE = 3;
+  static constexpr int MAX_PALETTE8_SIZE = 128;
+
+ private:
+  uint64_t last_ms = 0;
+
+  int busy_items = 0;
+  // block allocated by the heap constructor, nullptr if the buffers below
+  // were carved from the caller's arena
+  uint8_t *heap_block;
+  ArrayQueue<vec_t> queue;
+#if FIXBROT_ITER_12BIT
+  const pos_t stride;
+  uint8_t *work_buff;
+  uint8_t *copy_buff;
+#else
+  iter_t *work_buff;
+#endif
+
+  scene_t scene;
+  int scale_exp = -2;
+  int screen_size_clog2 = 0;
+  bool vert_flip = false;
+  render_stats_t stats = {};
+
+  pos_t correct_x = 0;
+  pos_t correct_y = height;
+  pos_t fill_y = height;
+
+  col_t palette[MAX_PALETTE_SIZE] = {0};
+  col_t max_iter_color = 0x0000;
+  rgb888_t palette_rgb[MAX_PALETTE_SIZE] = {0};
+  rgb888_t max_iter_rgb = 0;
+  int palette_slope = 0;
+  int palette_phase = 0;
+  int palette_size = MAX_PALETTE_SIZE;
+
+  // display color of each iteration count with palette phase, max_iter and
+  // byte order applied
+  col_t *color_lut;
+  bool color_lut_valid = false;
+  iter_t color_lut_max_iter = 0;
+
+  bool paint_requested = false;
+  bool paint_pending_pixels = false;
+  uint32_t paint_interval_ms = DEFAULT_PAINT_INTERVAL_MS;
+  uint32_t paint_cost_us = 0;
+  uint64_t paint_start_us = 0;
+  uint64_t last_paint_ms = 0;
+  bool paint_zoom_inprog = false;
+  bool paint_zoom_dir_in = false;
+  uint64_t paint_zoom_end_ms = 0;
+  pos_t *paint_x_buff;
+  pos_t *paint_y_buff;
+  int32_t paint_scale = PAINT_SCALE_ONE;
+  // paint_x_buff and paint_y_buff map each position to itself
+  bool paint_unscaled = true;
+
+  // dirty span of each row of tiles (COARSE_POS_STEP pixels square), in
+  // tile units, empty when x1 < x0
+  const pos_t dirty_rows;
+  pos_t *dirty_tx0;
+  pos_t *dirty_tx1;
+  bool dirty_all = true;
+
+  TileCache *tile_cache = nullptr;
+  ZoomHistory *zoom_history = nullptr;
+
+  // tile around the view being computed while idle, see prefetch_service()
+  static constexpr pos_t PREFETCH_MARGIN = TileCache::TILE_SIZE;
+  bool prefetch_active = false;
+  bool prefetch_tile_inprog = false;
+  bool prefetch_zoom = false;
+  int prefetch_index = 0;
+  int prefetch_pending = 0;
+  tile_key_t prefetch_key;
+  pos_t prefetch_x = 0;
+  pos_t prefetch_y = 0;
+  // scratch tile of the cache the tile is collected to
+  iter_t *prefetch_pixels = nullptr;
+  // max_iter the work buffer was rendered with
+  iter_t render_max_iter = 0;
+  // tiles of the view filled from the cache, in row-major order
+  bool *tile_loaded;
+
+  // Pixels marked ITER_QUEUED while the queue was full, one bit each in
+  // row-major order. They count as busy items and are queued again by
+  // requeue_overflowed() as the queue drains.
+  uint32_t *overflow_bits;
+  uint32_t num_overflowed = 0;
+  uint32_t overflow_scan = 0;
+
+ public:
+  // Carves all buffers from `arena`, which needs get_arena_bytes() bytes
+  // left. The trace queue holds `queue_depth` cells, 0 selects
+  // default_queue_depth(); a smaller queue saves memory at the cost of
+  // more rescans of the overflow bitmap.
+  Renderer(pos_t width, pos_t height, Arena &arena, uint32_t queue_depth = 0)
+      : Renderer(width, height,
+                 carve_buffers(arena, width, height, queue_depth)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  // allocates all buffers as one block from the heap
+  Renderer(pos_t width, pos_t height, uint32_t queue_depth = 0)
+      : Renderer(width, height, carve_heap(width, height, queue_depth)) {}
+
+  ~Renderer() { delete[] heap_block; }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height,
+                                          uint32_t queue_depth = 0) {
+    Arena plan;
+    carve_buffers(plan, width, height, queue_depth);
+    return plan.get_used();
+  }
+
+  static constexpr uint32_t default_queue_depth(pos_t width, pos_t height) {
+    return (width + height) * 16;
+  }
+
+  real_t get_center_re() const { return scene.real; }
+  real_t get_center_im() const { return scene.imag; }
+  int get_scale_exp() const { return scale_exp; }
+
+  // scene whose origin is the top-left pixel of the work buffer
+  scene_t get_worker_args() const {
+    scene_t s = scene;
+    s.real -= scene.step * (width / 2);
+    s.imag -= scene.step * (height / 2);
+    return s;
+  }
+
+  FIXBROT_INLINE const render_stats_t &get_stats() const { return stats; }
+
+  // elapsed time of the current render, or duration of the last one
+  uint32_t get_render_ms() const {
+    if (stats.finished) return stats.render_ms;
+    return (uint32_t)(get_time_ms() - stats.start_ms);
+  }
+
+  // Finished tiles are copied to `cache` before the view moves and copied
+  // back instead of being rendered again when the view returns to them.
+  // nullptr disables caching.
+  // While idle, the workers compute tiles in a margin around the view into
+  // the cache. Their pixels are addressed in the scene passed to
+  // on_prefetch_start(), which is that of the view.
+  void set_tile_cache(TileCache *cache) {
+    tile_cache = cache;
+    prefetch_pixels = cache ? cache->get_scratch() : nullptr;
+    prefetch_active = false;
+  }
+
+  // true while idle workers compute tiles around the view
+  FIXBROT_INLINE bool is_prefetching() const { return prefetch_active; }
+
+  // Finished views are saved to `history` by zoom_in() and restored by
+  // zoom_out() when it returns to them. nullptr disables the history.
+  void set_zoom_history(ZoomHistory *history) { zoom_history = history; }
+
+  // Writes the view and its pixels to `stream` in the format described in
+  // snapshot.hpp, see SnapshotWriter for the stream interface. `builtin`
+  // and `slope` are those last passed to load_builtin_palette().
+  // An unfinished render is saved with its queued pixels, so that
+  // load_snapshot() resumes it.
+  template <typename TStream>
+  result_t save_snapshot(TStream &stream, builtin_palette_t builtin,
+                         int slope) const {
+    SnapshotWriter<TStream> wr(stream);
+    wr.put_u32(SNAPSHOT_MAGIC);
+    wr.put_u16(SNAPSHOT_VERSION);
+    wr.put_u16(width);
+    wr.put_u16(height);
+    wr.put_u8((uint8_t)scene.formula);
+    wr.put_u8(vert_flip ? 1 : 0);
+    wr.put_u8((uint8_t)builtin);
+    wr.put_u8(slope);
+    wr.put_u16(palette_phase);
+    wr.put_u32(scale_exp);
+    wr.put_u64(scene.real.raw);
+    wr.put_u64(scene.imag.raw);
+    wr.put_u64(scene.step.raw);
+    wr.put_u16(scene.max_iter);
+
+    wr.reset_hash();
+    for (pos_t y = 0; y < height; y++) {
+      row_reader_t rd(*this, 0, y);
+      uint16_t value = snapshot_iter_from(rd.next());
+      uint32_t run_len = 1;
+      for (pos_t x = 1; x < width; x++) {
+        uint16_t next = snapshot_iter_from(rd.next());
+        if (next == value) {
+          run_len++;
+          continue;
+        }
+        wr.put_u16(value);
+        wr.put_varint(run_len - 1);
+        value = next;
+        run_len = 1;
+      }
+      wr.put_u16(value);
+      wr.put_varint(run_len - 1);
+    }
+    wr.put_u32(wr.get_hash());
+    return wr.flush() ? result_t::SUCCESS : result_t::ERROR_IO;
+  }
+
+  // Restores a view saved by save_snapshot() of a renderer of the same
+  // size, after init(). The builtin palette and slope it was shown with are
+  // loaded and returned to update the caller's settings. A finished view is
+  // shown without rendering, an unfinished one resumes rendering. If the
+  // pixels turn out to be corrupt, the view shown before is rendered again.
+  template <typename TStream>
+  result_t load_snapshot(TStream &stream, builtin_palette_t *out_builtin,
+                         int *out_slope) {
+    if (is_busy()) return result_t::ERROR_BUSY;
+
+    SnapshotReader<TStream> rd(stream);
+    if (rd.get_u32() != SNAPSHOT_MAGIC) return result_t::ERROR_BAD_SNAPSHOT;
+    if (rd.get_u16() != SNAPSHOT_VERSION) return result_t::ERROR_BAD_SNAPSHOT;
+    pos_t w = rd.get_u16();
+    pos_t h = rd.get_u16();
+    scene_t s;
+    s.formula = (formula_t)rd.get_u8();
+    bool vf = rd.get_u8() != 0;
+    builtin_palette_t pal = (builtin_palette_t)rd.get_u8();
+    int slope = rd.get_u8();
+    int phase = rd.get_u16();
+    int exp = (int32_t)rd.get_u32();
+    s.real = real_t::from_raw(rd.get_u64());
+    s.imag = real_t::from_raw(rd.get_u64());
+    s.step = real_t::from_raw(rd.get_u64());
+    s.max_iter = rd.get_u16();
+    if (rd.is_failed() || w != width || h != height ||
+        s.formula >= formula_t::LAST || pal >= builtin_palette_t::LAST ||
+        slope > MAX_PALETTE_SLOPE || phase >= MAX_PALETTE_SIZE ||
+        exp < MIN_SCALE_EXP || s.max_iter > ITER_MAX ||
+        s.step.raw != real_exp2(-exp - screen_size_clog2).raw) {
+      return result_t::ERROR_BAD_SNAPSHOT;
+    }
+
+    cache_store_tiles();
+    rd.reset_hash();
+    bool unfinished = false;
+    for (pos_t y = 0; y < height; y++) {
+      pos_t x = 0;
+      while (x < width) {
+        iter_t iter = snapshot_iter_to(rd.get_u16());
+        uint32_t run_len = rd.get_varint() + 1;
+        if (rd.is_failed() || iter == ITER_WALL ||
+            run_len > (uint32_t)(width - x)) {
+          return rerender_after_bad_snapshot();
+        }
+        if (iter == ITER_BLANK || iter == ITER_QUEUED) unfinished = true;
+        for (; run_len > 0; run_len--) work_buff_write(x++, y, iter);
+      }
+    }
+    uint32_t hash = rd.get_hash();
+    if (rd.get_u32() != hash || rd.is_failed()) {
+      return rerender_after_bad_snapshot();
+    }
+
+    scene = s;
+    scale_exp = exp;
+    vert_flip = vf;
+    load_builtin_palette(pal, slope);
+    set_palette_phase(phase);
+    if (out_builtin) *out_builtin = pal;
+    if (out_slope) *out_slope = slope;
+
+    if (!unfinished) {
+      restore_finished_view();
+      request_full_repaint();
+      return result_t::SUCCESS;
+    }
+
+    // Resume from the pixels that were queued when saved. The coarse grid
+    // and the edges were seeded by the render that was saved, so they are
+    // not seeded again.
+    FIXBROT_TRY(reset_render(true));
+    for (pos_t y = 0; y < height; y++) {
+      for (pos_t x = 0; x < width; x++) {
+        if (work_buff_read(x, y) == ITER_QUEUED) {
+          work_buff_write(x, y, ITER_BLANK);
+          FIXBROT_TRY(enqueue(vec_t{x, y}));
+        }
+      }
+    }
+    request_full_repaint();
+    return result_t::SUCCESS;
+  }
+
+  FIXBROT_INLINE iter_t get_iter(pos_t x, pos_t y) const {
+    return work_buff_read(x, y);
+  }
+
+  // false if the arena given to the constructor was too small; init() and
+  // paint_start() then return ERROR_OUT_OF_MEMORY and nothing else may be
+  // called
+  FIXBROT_INLINE bool has_buffers() const { return overflow_bits != nullptr; }
+
+  result_t init() {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_home_view();
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    FIXBROT_TRY(start_render(true));
+    request_full_repaint();
+    return result_t::SUCCESS;
+  }
+
+  // Same as init(), but starts with the view saved in a snapshot, see
+  // load_snapshot(). If the snapshot cannot be loaded, the home view is
+  // rendered and the error returned.
+  template <typename TStream>
+  result_t init_from_snapshot(TStream &stream, builtin_palette_t *out_builtin,
+                              int *out_slope) {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_home_view();
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    result_t res = load_snapshot(stream, out_builtin, out_slope);
+    if (res != result_t::SUCCESS && !is_busy()) {
+      FIXBROT_TRY(start_render(true));
+      request_full_repaint();
+    }
+    return res;
+  }
+
+  result_t service() {
+    uint64_t now_ms = get_time_ms();
+    last_ms = now_ms;
+
+    if (is_busy()) {
+      bool progress;
+      FIXBROT_TRY(iterate(NO_DEADLINE, &progress));
+    } else {
+      FIXBROT_TRY(prefetch_service());
+    }
+
+    update_paint_request(now_ms);
+    update_zoom_animation(now_ms);
+    return result_t::SUCCESS;
+  }
+
+  // Does as much tracing, correction and fill work as fits before
+  // `deadline_us` (in get_time_us() time). Returns early when waiting for
+  // the workers.
+  result_t service(uint64_t deadline_us) {
+    uint64_t now_ms = get_time_ms();
+    last_ms = now_ms;
+
+    while (is_busy() && get_time_us() < deadline_us) {
+      bool progress;
+      FIXBROT_TRY(iterate(deadline_us, &progress));
+      if (!progress) break;
+      update_paint_request(get_time_ms());
+      if (paint_requested) break;
+    }
+    if (!is_busy()) {
+      FIXBROT_TRY(prefetch_service());
+    }
+
+    update_zoom_animation(now_ms);
+    return result_t::SUCCESS;
+  }
+
+  FIXBROT_INLINE uint32_t get_paint_interval_ms() const {
+    return paint_interval_ms;
+  }
+
+  // target interval of progressive repaints while rendering
+  void set_paint_interval_ms(uint32_t ms) { paint_interval_ms = ms; }
+
+  // moving average of the time from paint_start() to paint_finished()
+  FIXBROT_INLINE uint32_t get_paint_cost_us() const { return paint_cost_us; }
+
+  result_t scroll(pos_t delta_x, pos_t delta_y) {
+    if (is_busy()) return result_t::ERROR_BUSY;
+
+    if (vert_flip) {
+      delta_y = -delta_y;
+    }
+
+    delta_x = clamp((pos_t)(-width + 2), (pos_t)(width - 2), delta_x);
+    delta_y = clamp((pos_t)(-height + 2), (pos_t)(height - 2), delta_y);
+
+    if (scene.real < -2 && delta_x < 0) delta_x = 0;
+    if (scene.real > 2 && delta_x > 0) delta_x = 0;
+    if (scene.imag < -2 && delta_y < 0) delta_y = 0;
+    if (scene.imag > 2 && delta_y > 0) delta_y = 0;
+
+    if (delta_x == 0 && delta_y == 0) return result_t::SUCCESS;
+
+    cache_store_tiles();
+    scene.real += scene.step * delta_x;
+    scene.imag += scene.step * delta_y;
+
+    pos_t dh = height - ((delta_y >= 0) ? delta_y : -delta_y);
+    pos_t dw = width - ((delta_x >= 0) ? delta_x : -delta_x);
+
+    pos_t dx0 = (delta_x >= 0) ? 0 : -delta_x;
+    pos_t dy0 = (delta_y >= 0) ? 0 : -delta_y;
+    pos_t dx1 = dx0 + dw;
+    pos_t dy1 = dy0 + dh;
+
+    pos_t sx0 = dx0 + delta_x;
+    pos_t sy0 = dy0 + delta_y;
+    pos_t sx1 = sx0 + dw;
+    pos_t sy1 = sy0 + dh;
+
+// scroll image data
 #if FIXBROT_ITER_12BIT
     {
       int isx0 = (sx0 * 3) / 2;
@@ -1888,6 +3324,9 @@ class Renderer {
     }
 #endif
 
+    dirty_all = true;
+    paint_pending_pixels = true;
+
     // clear new area
     if (delta_x > 0) {
       FIXBROT_TRY(clear_rect(rect_t{dx1, 0, delta_x, height}));
@@ -1901,7 +3340,7 @@ class Renderer {
     }
 
     // render new area
-    FIXBROT_TRY(start_render(false));
+    FIXBROT_TRY(start_render_cached(false));
     if (delta_x != 0) {
       pos_t x0 = (delta_x > 0) ? (dx1 - 1) : dx0;
       pos_t x1 = (delta_x > 0) ? dx1 : (dx0 - 1);
@@ -1919,6 +3358,8 @@ class Renderer {
   result_t zoom_in() {
     if (is_busy()) return result_t::ERROR_BUSY;
 
+    cache_store_tiles();
+    history_push();
     scale_exp++;
     bool last_is_fixed32 = scene.step.is_fixed32();
     update_pixel_step();
@@ -1928,27 +3369,23 @@ class Renderer {
       // clear all
       FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
     } else {
-      // upscale last image and reuse pixels
+      // upscale last image and reuse pixels, rows in an order that reads
+      // each before it is overwritten
       for (pos_t i = 0; i < height; i++) {
         pos_t dy = (i < height / 2) ? i : (height * 3 / 2 - 1 - i);
-        pos_t sy = height / 4 + (dy / 2);
-        for (pos_t j = 0; j < width; j++) {
-          pos_t dx = (j < width / 2) ? j : (width * 3 / 2 - 1 - j);
-          pos_t sx = width / 4 + (dx / 2);
-          if ((dx & 1) == 0 && (dy & 1) == 0) {
-            work_buff_write(dx, dy, work_buff_read(sx, sy));
-          } else {
-            work_buff_write(dx, dy, ITER_BLANK);
-          }
+        if (dy & 1) {
+          FIXBROT_TRY(clear_rect(rect_t{0, dy, width, 1}));
+        } else {
+          upscale_row(dy, height / 4 + (dy / 2));
         }
       }
     }
-    FIXBROT_TRY(start_render(true));
+    FIXBROT_TRY(start_render_cached(true));
 
     paint_zoom_inprog = true;
     paint_zoom_dir_in = true;
     paint_zoom_end_ms = get_time_ms() + ZOOM_DURATION_MS;
-    paint_requested = true;
+    request_full_repaint();
 
     return result_t::SUCCESS;
   }
@@ -1959,31 +3396,31 @@ class Renderer {
       return result_t::SUCCESS;
     }
 
+    cache_store_tiles();
     scale_exp--;
     bool last_is_fixed32 = scene.step.is_fixed32();
     update_pixel_step();
     bool prec_changed = scene.step.is_fixed32() != last_is_fixed32;
 
-    if (prec_changed) {
+    if (history_pop()) {
+      // restored the view zoom_in() has left
+    } else if (prec_changed) {
       // clear all
       FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
-      FIXBROT_TRY(start_render(true));
+      FIXBROT_TRY(start_render_cached(true));
     } else {
-      // downscale last image and reuse pixels
+      // downscale last image and reuse pixels, rows in an order that reads
+      // each before it is overwritten
       for (pos_t i = 0; i < height; i++) {
         pos_t dy = (i < height / 2) ? (height / 2 - 1 - i) : i;
         pos_t sy = dy * 2 - height / 2;
-        for (pos_t j = 0; j < width; j++) {
-          pos_t dx = (j < width / 2) ? (width / 2 - 1 - j) : j;
-          pos_t sx = dx * 2 - width / 2;
-          if (0 <= sx && sx < width && 0 <= sy && sy < height) {
-            work_buff_write(dx, dy, work_buff_read(sx, sy));
-          } else {
-            work_buff_write(dx, dy, ITER_BLANK);
-          }
+        if (0 <= sy && sy < height) {
+          downscale_row(dy, sy);
+        } else {
+          FIXBROT_TRY(clear_rect(rect_t{0, dy, width, 1}));
         }
       }
-      FIXBROT_TRY(start_render(true));
+      FIXBROT_TRY(start_render_cached(true));
       rect_t rect{(pos_t)(width / 4), (pos_t)(height / 4), (pos_t)(width / 2),
                   (pos_t)(height / 2)};
       FIXBROT_TRY(scan_vert(rect.x, rect.x - 1, rect.y, rect.h));
@@ -1995,8 +3432,47 @@ class Renderer {
     paint_zoom_inprog = true;
     paint_zoom_end_ms = get_time_ms() + ZOOM_DURATION_MS;
     paint_zoom_dir_in = false;
-    paint_requested = true;
+    request_full_repaint();
+
+    return result_t::SUCCESS;
+  }
+
+  result_t set_view(formula_t formula, real_t real, real_t imag, int exp,
+                    iter_t max_iter) {
+    if (is_busy()) return result_t::ERROR_BUSY;
+
+    apply_view(formula, real, imag, exp, max_iter);
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    FIXBROT_TRY(start_render_cached(true));
+    request_full_repaint();
+    return result_t::SUCCESS;
+  }
+
+  // Same as set_view(), but the pixels on the edges of the view for which
+  // `edges(x, y)` returns other than ITER_BLANK are taken from it instead
+  // of being computed, e.g. those shared with adjacent views of a larger
+  // image rendered before. Tracing continues inward from them.
+  template <typename TEdges>
+  result_t set_view_with_edges(formula_t formula, real_t real, real_t imag,
+                               int exp, iter_t max_iter, TEdges &&edges) {
+    if (is_busy()) return result_t::ERROR_BUSY;
 
+    apply_view(formula, real, imag, exp, max_iter);
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    for (pos_t x = 0; x < width; x++) {
+      work_buff_write(x, 0, edges(x, 0));
+      work_buff_write(x, height - 1, edges(x, (pos_t)(height - 1)));
+    }
+    for (pos_t y = 1; y < height - 1; y++) {
+      work_buff_write(0, y, edges(0, y));
+      work_buff_write(width - 1, y, edges((pos_t)(width - 1), y));
+    }
+    FIXBROT_TRY(start_render(true));
+    FIXBROT_TRY(scan_vert(0, 1, 0, height));
+    FIXBROT_TRY(scan_vert(width - 1, width - 2, 0, height));
+    FIXBROT_TRY(scan_hori(0, 0, 1, width));
+    FIXBROT_TRY(scan_hori(0, height - 1, height - 2, width));
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -2004,10 +3480,11 @@ class Renderer {
 
   result_t set_formula(formula_t f) {
     if (is_busy()) return result_t::ERROR_BUSY;
+    cache_store_tiles();
     scene.formula = f;
     FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
-    FIXBROT_TRY(start_render(true));
-    paint_requested = true;
+    FIXBROT_TRY(start_render_cached(true));
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -2052,7 +3529,7 @@ class Renderer {
         }
       }
     }
-    paint_requested = true;
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -2061,7 +3538,7 @@ class Renderer {
   result_t set_vert_flip(bool vf) {
     if (is_busy()) return result_t::ERROR_BUSY;
     vert_flip = vf;
-    paint_requested = true;
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -2081,7 +3558,8 @@ class Renderer {
         palette_load_heatmap(slope);
         break;
     }
-    paint_requested = true;
+    color_lut_valid = false;
+    request_full_repaint();
   }
 
   FIXBROT_INLINE int get_palette_size() const { return palette_size; }
@@ -2090,7 +3568,8 @@ class Renderer {
 
   void set_palette_phase(int phase) {
     palette_phase = phase % MAX_PALETTE_SIZE;
-    paint_requested = true;
+    color_lut_valid = false;
+    request_full_repaint();
   }
 
   int num_queued() const { return queue.size(); }
@@ -2098,100 +3577,617 @@ class Renderer {
   bool dequeue(vec_t *out_loc) { return queue.dequeue(out_loc); }
 
   FIXBROT_INLINE bool is_busy() const {
-    return (busy_items > 0) || (correct_y < height);
+    return (busy_items > 0) || (correct_y < height) || (fill_y < height);
   }
 
   FIXBROT_INLINE bool is_repaint_requested() const { return paint_requested; }
 
+  // true if the next paint has to cover the whole screen
+  FIXBROT_INLINE bool is_full_repaint_requested() const { return dirty_all; }
+
+  // horizontal span of screen row `y` changed since the last paint
+  bool get_dirty_span(pos_t y, pos_t *x, pos_t *w) const {
+    if (dirty_all) {
+      *x = 0;
+      *w = width;
+      return true;
+    }
+    if (vert_flip) {
+      y = height - 1 - y;
+    }
+    pos_t ty = y >> COARSE_POS_BITS;
+    if (dirty_tx1[ty] < dirty_tx0[ty]) {
+      return false;
+    }
+    pos_t x0 = dirty_tx0[ty] << COARSE_POS_BITS;
+    pos_t x1 = (dirty_tx1[ty] + 1) << COARSE_POS_BITS;
+    if (x1 > width) x1 = width;
+    *x = x0;
+    *w = x1 - x0;
+    return true;
+  }
+
   FIXBROT_INLINE bool is_animating() const {
     return (last_ms < paint_zoom_end_ms);
   }
 
   result_t paint_start() {
-    // cache x coordinates
-    for (pos_t x = 0; x < width; x++) {
-      pos_t sx = x;
-      if (paint_scale != 1.0f) {
-        sx = (pos_t)((x - width / 2) * paint_scale + (width / 2));
-      }
-      paint_x_buff[x] = sx;
-    }
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    paint_start_us = get_time_us();
+    if (!color_lut_valid || color_lut_max_iter != scene.max_iter) {
+      update_color_lut();
+    }
+    // cache source coordinates
+    scale_coords(paint_x_buff, width);
+    scale_coords(paint_y_buff, height);
+    paint_unscaled = (paint_scale == PAINT_SCALE_ONE);
     return result_t::SUCCESS;
   }
 
-  result_t paint_line(pos_t x_offset, pos_t y_offset, pos_t w,
-                      col_t *line_buff) {
-    if (vert_flip) {
-      y_offset = height - 1 - y_offset;
+  FIXBROT_INLINE result_t paint_line(pos_t x_offset, pos_t y_offset, pos_t w,
+                                     col_t *line_buff) const {
+    return paint_rect(x_offset, y_offset, w, 1, line_buff, w);
+  }
+
+  // Paints the screen rectangle (x, y, w, h) to `dst`, rows are
+  // `dst_stride` pixels apart. The columns showing the work buffer are
+  // found once per rectangle, and while zooming in, rows and pixels
+  // showing the same source as the previous one are copied from it.
+  result_t paint_rect(pos_t x, pos_t y, pos_t w, pos_t h, col_t *dst,
+                      int dst_stride) const {
+    // columns [ix0, ix1) show the work buffer, the others are black
+    pos_t ix0 = 0, ix1 = w;
+    if (!paint_unscaled) {
+      while (ix0 < w && paint_x_buff[x + ix0] < 0) ix0++;
+      while (ix1 > ix0 && paint_x_buff[x + ix1 - 1] < 0) ix1--;
     }
 
-    pos_t sy = y_offset;
-    if (paint_scale != 1.0f) {
-      sy = (pos_t)((y_offset - height / 2) * paint_scale + (height / 2));
+    const pos_t y_step = vert_flip ? -1 : 1;
+    pos_t y_offset = vert_flip ? (height - 1 - y) : y;
+    pos_t last_sy = -1;
+    const col_t *last_row = nullptr;
+    for (pos_t iy = 0; iy < h; iy++) {
+      pos_t sy = paint_y_buff[y_offset];
+      y_offset += y_step;
+      if (sy < 0 || sy >= height) {
+        for (pos_t ix = 0; ix < w; ix++) dst[ix] = 0x0000;
+      } else if (sy == last_sy) {
+        memcpy(dst, last_row, sizeof(col_t) * w);
+      } else {
+        paint_row(x, sy, w, ix0, ix1, dst);
+        last_sy = sy;
+        last_row = dst;
+      }
+      dst += dst_stride;
     }
+    return result_t::SUCCESS;
+  }
 
-    for (pos_t ix = 0; ix < w; ix++) {
-      pos_t x = x_offset + ix;
-      pos_t sx = paint_x_buff[x];
+  // Same as paint_line() for a rectangle of the screen, in the pixel format
+  // `prm_TFormat` (see pixel_format.hpp). Rows of `dst` are `dst_stride`
+  // pixels apart. Indexed output does not darken unfinished pixels.
+  template <typename prm_TFormat>
+  result_t paint_rect_as(pos_t x, pos_t y, pos_t w, pos_t h,
+                         typename prm_TFormat::pixel_t *dst,
+                         int dst_stride) const {
+    using pixel_t = typename prm_TFormat::pixel_t;
+    const pixel_t black = prm_TFormat::from_color(0, INDEX8_BLANK);
+    const int shift8 = get_palette8_shift();
 
-      if (sx < 0 || sx >= width || sy < 0 || sy >= height) {
-        line_buff[ix] = 0x0000;
-        continue;
+    for (pos_t iy = 0; iy < h; iy++) {
+      pos_t y_offset = y + iy;
+      if (vert_flip) {
+        y_offset = height - 1 - y_offset;
       }
+      pos_t sy = paint_y_buff[y_offset];
+      pixel_t *wr_ptr = dst;
+      dst += dst_stride;
 
-      bool finished = true;
-      iter_t iter = work_buff_read(sx, sy);
-      if (iter == ITER_BLANK) {
-        finished = false;
-        iter = work_buff_read(sx & 0xFFFE, sy & 0xFFFE);
-        if (iter == ITER_BLANK || iter == ITER_QUEUED) {
-          constexpr pos_t MASK = ~(COARSE_POS_STEP - 1);
-          pos_t sx2 = (sx & MASK) + (COARSE_POS_STEP / 2);
-          pos_t sy2 = (sy & MASK) + (COARSE_POS_STEP / 2);
-          iter = work_buff_read(sx2, sy2);
-          if (iter == ITER_QUEUED) {
-            iter = ITER_BLANK;
-          }
+      for (pos_t ix = 0; ix < w; ix++) {
+        pos_t sx = paint_x_buff[x + ix];
+        if (sx < 0 || sx >= width || sy < 0 || sy >= height) {
+          wr_ptr[ix] = black;
+          continue;
         }
-      }
 
-      col_t c;
-      if (ITER_BLANK == iter) {
-        c = 0x0000;
-      } else if (iter <= ITER_MAX) {
-        c = max_iter_color;
-        if (iter < scene.max_iter) {
-          c = palette[(iter + palette_phase) & (palette_size - 1)];
-        }
+        iter_t iter = work_buff_read(sx, sy);
+        bool finished = (iter != ITER_BLANK);
         if (!finished) {
-          c = color_div2(c);
+          iter = read_preview(sx, sy);
         }
-      } else {
-        c = color_pack_from_888(0xFF, 0xFF, 0x00);
+
+        rgb888_t c = iter_to_rgb(iter);
+        if (!finished && ITER_BLANK != iter && iter <= ITER_MAX) {
+          c = rgb888_div2(c);
+        }
+        wr_ptr[ix] = prm_TFormat::from_color(c, iter_to_index8(iter, shift8));
       }
-      line_buff[ix] = c;
     }
 
     return result_t::SUCCESS;
   }
 
+  // Colors of the indices written by indexed8_format_t. Palettes longer
+  // than MAX_PALETTE8_SIZE are subsampled. Returns the number of entries.
+  int export_palette8(rgb888_t *rgb) const {
+    const int shift8 = get_palette8_shift();
+    rgb[INDEX8_BLANK] = 0;
+    rgb[INDEX8_INSIDE] = max_iter_rgb;
+    rgb[INDEX8_QUEUED] = rgb888_pack(0xFF, 0xFF, 0x00);
+    int n = palette_size >> shift8;
+    for (int i = 0; i < n; i++) {
+      rgb[INDEX8_PALETTE + i] = palette_rgb[i << shift8];
+    }
+    return INDEX8_PALETTE + n;
+  }
+
   result_t paint_finished() {
+    uint32_t cost_us = (uint32_t)(get_time_us() - paint_start_us);
+    paint_cost_us = (paint_cost_us * 3 + cost_us) / 4;
+    last_paint_ms = get_time_ms();
     paint_requested = false;
+    paint_pending_pixels = false;
+    clear_dirty();
     return result_t::SUCCESS;
   }
 
  private:
-  FIXBROT_INLINE iter_t work_buff_read(pos_t x, pos_t y) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
+  struct buffers_t {
+    uint8_t *heap_block = nullptr;
+    uint32_t queue_depth = 0;
+    vec_t *queue = nullptr;
+#if FIXBROT_ITER_12BIT
+    uint8_t *work_buff = nullptr;
+    uint8_t *copy_buff = nullptr;
+#else
+    iter_t *work_buff = nullptr;
+#endif
+    col_t *color_lut = nullptr;
+    pos_t *paint_x_buff = nullptr;
+    pos_t *paint_y_buff = nullptr;
+    pos_t *dirty_tx0 = nullptr;
+    pos_t *dirty_tx1 = nullptr;
+    bool *tile_loaded = nullptr;
+    uint32_t *overflow_bits = nullptr;
+  };
+
+  static constexpr pos_t num_dirty_rows(pos_t height) {
+    return (height + COARSE_POS_STEP - 1) / COARSE_POS_STEP;
+  }
+
+  static constexpr uint32_t num_overflow_words(pos_t width, pos_t height) {
+    return ((uint32_t)width * height + 31) / 32;
+  }
+
+  static constexpr buffers_t carve_buffers(Arena &arena, pos_t width,
+                                           pos_t height,
+                                           uint32_t queue_depth) {
+    buffers_t b;
+    b.queue_depth = (queue_depth == 0) ? default_queue_depth(width, height)
+                    : (queue_depth < 2) ? 2
+                                        : queue_depth;
+    b.queue = arena.alloc<vec_t>(b.queue_depth);
+#if FIXBROT_ITER_12BIT
+    b.work_buff = arena.alloc<uint8_t>((size_t)(width * 3 / 2) * height);
+    b.copy_buff = arena.alloc<uint8_t>(width * 3 / 2);
+#else
+    b.work_buff = arena.alloc<iter_t>((size_t)width * height);
+#endif
+    // paint_row_simd() reads one entry past the end
+    b.color_lut = arena.alloc<col_t>(COLOR_LUT_SIZE + FIXBROT_COLOR_LUT_SIMD);
+    b.paint_x_buff = arena.alloc<pos_t>(width);
+    b.paint_y_buff = arena.alloc<pos_t>(height);
+    b.dirty_tx0 = arena.alloc<pos_t>(num_dirty_rows(height));
+    b.dirty_tx1 = arena.alloc<pos_t>(num_dirty_rows(height));
+    b.tile_loaded = arena.alloc<bool>((width / TileCache::TILE_SIZE + 2) *
+                                      (height / TileCache::TILE_SIZE + 2));
+    b.overflow_bits = arena.alloc<uint32_t>(num_overflow_words(width, height));
+    return b;
+  }
+
+#ifndef FIXBROT_NO_STDLIB
+  static buffers_t carve_heap(pos_t width, pos_t height,
+                              uint32_t queue_depth) {
+    size_t bytes = get_arena_bytes(width, height, queue_depth);
+    uint8_t *block = new uint8_t[bytes];
+    Arena arena(block, bytes);
+    buffers_t b = carve_buffers(arena, width, height, queue_depth);
+    b.heap_block = block;
+    return b;
+  }
+#endif
+
+  Renderer(pos_t width, pos_t height, const buffers_t &b)
+      : width(width),
+        height(height),
+        heap_block(b.heap_block),
+        queue(b.queue_depth, b.queue),
+#if FIXBROT_ITER_12BIT
+        stride(width * 3 / 2),
+        work_buff(b.work_buff),
+        copy_buff(b.copy_buff),
+#else
+        work_buff(b.work_buff),
+#endif
+        color_lut(b.color_lut),
+        paint_x_buff(b.paint_x_buff),
+        paint_y_buff(b.paint_y_buff),
+        dirty_rows(num_dirty_rows(height)),
+        dirty_tx0(b.dirty_tx0),
+        dirty_tx1(b.dirty_tx1),
+        tile_loaded(b.tile_loaded),
+        overflow_bits(b.overflow_bits) {
+    pos_t p = width > height ? width : height;
+    while (p > 0) {
+      screen_size_clog2++;
+      p /= 2;
+    }
+    // an exhausted arena hands out nothing after the first failure, so the
+    // last buffer carved tells whether all of them were
+    if (!has_buffers()) return;
+    for (uint32_t i = 0; i < num_overflow_words(width, height); i++) {
+      overflow_bits[i] = 0;
+    }
+    clear_dirty();
+  }
+
+  FIXBROT_INLINE iter_t read_preview(pos_t sx, pos_t sy) const {
+    iter_t iter = work_buff_read(sx & 0xFFFE, sy & 0xFFFE);
+    if (iter == ITER_BLANK || iter == ITER_QUEUED) {
+      constexpr pos_t MASK = ~(COARSE_POS_STEP - 1);
+      pos_t sx2 = (sx & MASK) + (COARSE_POS_STEP / 2);
+      pos_t sy2 = (sy & MASK) + (COARSE_POS_STEP / 2);
+      iter = work_buff_read(sx2, sy2);
+      if (iter == ITER_QUEUED) {
+        iter = ITER_BLANK;
+      }
+    }
+    return iter;
+  }
+
+  // unfinished pixel, previewed with a darkened neighbor
+  FIXBROT_INLINE col_t preview_color(pos_t sx, pos_t sy) const {
+    iter_t iter = read_preview(sx, sy);
+    col_t c = lookup_color(iter);
+    if (ITER_BLANK != iter && iter <= ITER_MAX) {
+      c = color_to_display(color_div2(color_from_display(c)));
+    }
+    return c;
+  }
+
+  FIXBROT_INLINE rgb888_t iter_to_rgb(iter_t iter) const {
+    if (ITER_BLANK == iter) {
       return 0;
+    } else if (iter > ITER_MAX) {
+      return rgb888_pack(0xFF, 0xFF, 0x00);
+    } else if (iter >= scene.max_iter) {
+      return max_iter_rgb;
+    } else {
+      return palette_rgb[(iter + palette_phase) & (palette_size - 1)];
     }
-#if FIXBROT_ITER_12BIT
-    int i = y * stride + x * 3 / 2;
-    if (x % 2 == 0) {
-      return work_buff[i] | ((work_buff[i + 1] & 0x0F) << 8);
+  }
+
+  FIXBROT_INLINE uint8_t iter_to_index8(iter_t iter, int shift8) const {
+    if (ITER_BLANK == iter) {
+      return INDEX8_BLANK;
+    } else if (iter > ITER_MAX) {
+      return INDEX8_QUEUED;
+    } else if (iter >= scene.max_iter) {
+      return INDEX8_INSIDE;
+    } else {
+      int i = (iter + palette_phase) & (palette_size - 1);
+      return INDEX8_PALETTE + (i >> shift8);
+    }
+  }
+
+  int get_palette8_shift() const {
+    int shift = 0;
+    while ((palette_size >> shift) > MAX_PALETTE8_SIZE) shift++;
+    return shift;
+  }
+
+  // display color of a finished pixel
+  FIXBROT_INLINE col_t compute_color(iter_t iter) const {
+    col_t c;
+    if (ITER_BLANK == iter) {
+      c = 0x0000;
+    } else if (iter <= ITER_MAX) {
+      c = max_iter_color;
+      if (iter < scene.max_iter) {
+        c = palette[(iter + palette_phase) & (palette_size - 1)];
+      }
     } else {
-      return ((work_buff[i] & 0xF0) >> 4) | (work_buff[i + 1] << 4);
+      c = color_pack_from_888(0xFF, 0xFF, 0x00);
+    }
+    return color_to_display(c);
+  }
+
+  FIXBROT_INLINE col_t lookup_color(iter_t iter) const {
+    if (iter < COLOR_LUT_SIZE) {
+      return color_lut[iter];
+    }
+    return compute_color(iter);
+  }
+
+#if FIXBROT_COLOR_LUT_SIMD
+  // paint_line() of `w` pixels read 1:1 from (x, y), 8 at a time where all
+  // of them are finished and within the table
+  void paint_row_simd(pos_t x, pos_t y, pos_t w, col_t *dst) const {
+    static_assert(ITER_BLANK == 0, "blank lanes are found by comparing to 0");
+    const iter_t *src = work_buff + y * width + x;
+    const __m128i limit = _mm_set1_epi16(COLOR_LUT_SIZE - 1);
+    const __m128i zero = _mm_setzero_si128();
+    pos_t ix = 0;
+    for (; ix + 8 <= w; ix += 8) {
+      __m128i iters = _mm_loadu_si128((const __m128i *)(src + ix));
+      __m128i in_lut = _mm_cmpeq_epi16(_mm_min_epu16(iters, limit), iters);
+      __m128i blank = _mm_cmpeq_epi16(iters, zero);
+      if (_mm_movemask_epi8(_mm_andnot_si128(blank, in_lut)) != 0xFFFF) {
+        // blank pixels or counts above the table
+        for (int i = 0; i < 8; i++) {
+          iter_t iter = src[ix + i];
+          dst[ix + i] = (iter != ITER_BLANK) ? lookup_color(iter)
+                                             : preview_color(x + ix + i, y);
+        }
+        continue;
+      }
+#ifdef __AVX2__
+      // 32-bit gathers at 2-byte steps, the table has an entry of padding
+      __m256i colors = _mm256_i32gather_epi32(
+          (const int *)color_lut, _mm256_cvtepu16_epi32(iters), 2);
+      colors = _mm256_and_si256(colors, _mm256_set1_epi32(0xFFFF));
+      _mm_storeu_si128((__m128i *)(dst + ix),
+                       _mm_packus_epi32(_mm256_castsi256_si128(colors),
+                                        _mm256_extracti128_si256(colors, 1)));
+#else
+      const col_t *lut = color_lut;
+      __m128i colors = _mm_setr_epi16(
+          lut[_mm_extract_epi16(iters, 0)], lut[_mm_extract_epi16(iters, 1)],
+          lut[_mm_extract_epi16(iters, 2)], lut[_mm_extract_epi16(iters, 3)],
+          lut[_mm_extract_epi16(iters, 4)], lut[_mm_extract_epi16(iters, 5)],
+          lut[_mm_extract_epi16(iters, 6)], lut[_mm_extract_epi16(iters, 7)]);
+      _mm_storeu_si128((__m128i *)(dst + ix), colors);
+#endif
+    }
+    for (; ix < w; ix++) {
+      iter_t iter = src[ix];
+      dst[ix] = (iter != ITER_BLANK) ? lookup_color(iter)
+                                     : preview_color(x + ix, y);
+    }
+  }
+#endif
+
+  // one row of paint_rect() showing work buffer row `sy`
+  void paint_row(pos_t x, pos_t sy, pos_t w, pos_t ix0, pos_t ix1,
+                 col_t *dst) const {
+    if (paint_unscaled) {
+#if FIXBROT_COLOR_LUT_SIMD
+      paint_row_simd(x, sy, w, dst);
+#else
+      // screen and work buffer match, read the row sequentially
+      row_reader_t rd(*this, x, sy);
+      for (pos_t ix = 0; ix < w; ix++) {
+        iter_t iter = rd.next();
+        if (iter != ITER_BLANK) {
+          dst[ix] = lookup_color(iter);
+        } else {
+          dst[ix] = preview_color(x + ix, sy);
+        }
+      }
+#endif
+      return;
+    }
+
+    const pos_t *xs = paint_x_buff + x;
+    for (pos_t ix = 0; ix < ix0; ix++) dst[ix] = 0x0000;
+    pos_t last_sx = -1;
+    for (pos_t ix = ix0; ix < ix1; ix++) {
+      pos_t sx = xs[ix];
+      if (sx == last_sx) {
+        dst[ix] = dst[ix - 1];
+        continue;
+      }
+      last_sx = sx;
+      iter_t iter = work_buff_read(sx, sy);
+      if (iter != ITER_BLANK) {
+        dst[ix] = lookup_color(iter);
+      } else {
+        dst[ix] = preview_color(sx, sy);
+      }
+    }
+    for (pos_t ix = ix1; ix < w; ix++) dst[ix] = 0x0000;
+  }
+
+  void update_color_lut() {
+    for (int i = 0; i < COLOR_LUT_SIZE; i++) {
+      color_lut[i] = compute_color(i);
+    }
+    color_lut_max_iter = scene.max_iter;
+    color_lut_valid = true;
+  }
+
+  FIXBROT_INLINE void request_full_repaint() {
+    paint_requested = true;
+    dirty_all = true;
+  }
+
+  // every pixel affects only the preview of its own tile, see paint_line()
+  FIXBROT_INLINE void mark_dirty(pos_t x, pos_t y) {
+    pos_t tx = x >> COARSE_POS_BITS;
+    pos_t ty = y >> COARSE_POS_BITS;
+    if (tx < dirty_tx0[ty]) dirty_tx0[ty] = tx;
+    if (tx > dirty_tx1[ty]) dirty_tx1[ty] = tx;
+  }
+
+  void clear_dirty() {
+    for (pos_t ty = 0; ty < dirty_rows; ty++) {
+      dirty_tx0[ty] = width;
+      dirty_tx1[ty] = -1;
+    }
+    dirty_all = false;
+  }
+
+  void update_paint_request(uint64_t now_ms) {
+    if (paint_requested || !paint_pending_pixels) return;
+    uint32_t interval_ms = paint_interval_ms;
+    uint32_t cost_ms = paint_cost_us * (PAINT_COST_RATIO - 1) / 1000;
+    if (interval_ms < cost_ms) {
+      interval_ms = cost_ms;
+    }
+    if (now_ms - last_paint_ms >= interval_ms) {
+      paint_requested = true;
+    }
+  }
+
+  // Maps screen coordinates to work buffer coordinates around the center
+  // by stepping a fixed point position, no multiplication per element.
+  // The position takes 64 bits since size times scale may not fit in 32,
+  // and coordinates outside the buffer become -1.
+  void scale_coords(pos_t *buff, pos_t size) {
+    if (paint_scale == PAINT_SCALE_ONE) {
+      for (pos_t i = 0; i < size; i++) {
+        buff[i] = i;
+      }
+      return;
+    }
+    int64_t center = size / 2;
+    int64_t pos = center * (PAINT_SCALE_ONE - paint_scale);
+    for (pos_t i = 0; i < size; i++) {
+      int64_t coord = pos >> PAINT_SCALE_BITS;
+      buff[i] = (coord < 0 || coord >= size) ? -1 : (pos_t)coord;
+      pos += paint_scale;
+    }
+  }
+
+  void update_zoom_animation(uint64_t now_ms) {
+    paint_scale = PAINT_SCALE_ONE;
+    if (paint_zoom_inprog) {
+      int32_t t = (int32_t)(paint_zoom_end_ms - now_ms);
+      if (t < 0) {
+        t = 0;
+        paint_zoom_inprog = false;
+      }
+      request_full_repaint();
+      if (paint_zoom_dir_in) {
+        paint_scale = PAINT_SCALE_ONE + t * PAINT_SCALE_ONE / ZOOM_DURATION_MS;
+      } else {
+        paint_scale =
+            PAINT_SCALE_ONE - t * PAINT_SCALE_ONE / (ZOOM_DURATION_MS * 2);
+      }
+    }
+  }
+
+#if FIXBROT_ITER_12BIT
+  // Pixels 2n and 2n + 1 of a row are packed in 3 bytes and handled as one
+  // little-endian 24 bit word, the even pixel in the lower 12 bits. Words
+  // are assembled from bytes since they are not aligned.
+  static constexpr uint32_t PAIR_MASK = 0xFFF;
+  static constexpr int PAIR_SHIFT = 12;
+
+  FIXBROT_INLINE uint8_t *pair_pointer(pos_t x, pos_t y) const {
+    return work_buff + y * stride + (x >> 1) * 3;
+  }
+
+  static FIXBROT_INLINE uint32_t load_pair(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  }
+
+  static FIXBROT_INLINE void store_pair(uint8_t *p, uint32_t pair) {
+    p[0] = pair & 0xFF;
+    p[1] = (pair >> 8) & 0xFF;
+    p[2] = (pair >> 16) & 0xFF;
+  }
+#endif
+
+  // reads a row of the work buffer from left to right
+  class row_reader_t {
+   public:
+#if FIXBROT_ITER_12BIT
+    row_reader_t(const Renderer &r, pos_t x, pos_t y)
+        : row_reader_t(r.pair_pointer(0, y), x) {}
+
+    // from pixel `x` of a packed row, e.g. one copied to copy_buff
+    row_reader_t(const uint8_t *row, pos_t x)
+        : ptr(row + (x >> 1) * 3), odd(x & 1) {
+      if (odd) {
+        pair = load_pair(ptr);
+        ptr += 3;
+      }
+    }
+
+    FIXBROT_INLINE iter_t next() {
+      odd = !odd;
+      if (odd) {
+        pair = load_pair(ptr);
+        ptr += 3;
+        return pair & PAIR_MASK;
+      }
+      return pair >> PAIR_SHIFT;
+    }
+
+   private:
+    const uint8_t *ptr;
+    uint32_t pair = 0;
+    bool odd;
+#else
+    row_reader_t(const Renderer &r, pos_t x, pos_t y)
+        : ptr(r.work_buff + y * r.width + x) {}
+
+    FIXBROT_INLINE iter_t next() { return *(ptr++); }
+
+   private:
+    const iter_t *ptr;
+#endif
+  };
+
+  // writes a row of the work buffer from left to right, without marking it
+  // dirty; flush() stores a last pixel left without its pair
+  class row_writer_t {
+   public:
+#if FIXBROT_ITER_12BIT
+    row_writer_t(Renderer &r, pos_t x, pos_t y)
+        : ptr(r.pair_pointer(x, y)), odd(x & 1) {
+      if (odd) pair = load_pair(ptr) & PAIR_MASK;
+    }
+
+    FIXBROT_INLINE void put(iter_t iter) {
+      if (odd) {
+        store_pair(ptr, pair | ((uint32_t)iter << PAIR_SHIFT));
+        ptr += 3;
+      } else {
+        pair = iter;
+      }
+      odd = !odd;
     }
+
+    FIXBROT_INLINE void flush() {
+      if (odd) store_pair(ptr, (load_pair(ptr) & ~PAIR_MASK) | pair);
+    }
+
+   private:
+    uint8_t *ptr;
+    uint32_t pair = 0;
+    bool odd;
+#else
+    row_writer_t(Renderer &r, pos_t x, pos_t y)
+        : ptr(r.work_buff + y * r.width + x) {}
+
+    FIXBROT_INLINE void put(iter_t iter) { *(ptr++) = iter; }
+    FIXBROT_INLINE void flush() {}
+
+   private:
+    iter_t *ptr;
+#endif
+  };
+
+  FIXBROT_INLINE iter_t work_buff_read(pos_t x, pos_t y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+      return 0;
+    }
+#if FIXBROT_ITER_12BIT
+    // the two bytes holding the pixel, odd pixels are 4 bits up
+    const uint8_t *p = pair_pointer(x, y) + (x & 1);
+    return ((p[0] | (p[1] << 8)) >> ((x & 1) * 4)) & PAIR_MASK;
 #else
     return work_buff[y * width + x];
 #endif
@@ -2201,20 +4197,45 @@ class Renderer {
     if (x < 0 || x >= width || y < 0 || y >= height) {
       return;
     }
+    mark_dirty(x, y);
 #if FIXBROT_ITER_12BIT
-    int i = y * stride + x * 3 / 2;
-    if (x % 2 == 0) {
-      work_buff[i] = val & 0xFF;
-      work_buff[i + 1] = (work_buff[i + 1] & 0xF0) | ((val >> 8) & 0x0F);
+    // only the two bytes holding the pixel change
+    uint8_t *p = pair_pointer(x, y);
+    if (x & 1) {
+      p[1] = (p[1] & 0x0F) | ((val << 4) & 0xF0);
+      p[2] = (val >> 4) & 0xFF;
     } else {
-      work_buff[i] = (work_buff[i] & 0x0F) | ((val << 4) & 0xF0);
-      work_buff[i + 1] = (val >> 4) & 0xFF;
+      p[0] = val & 0xFF;
+      p[1] = (p[1] & 0xF0) | ((val >> 8) & 0x0F);
     }
 #else
     work_buff[y * width + x] = val;
 #endif
   }
 
+  void init_home_view() {
+    scene.formula = formula_t::MANDELBROT;
+    scene.real = -0.5f;
+    scene.imag = 0;
+    scene.max_iter = 200;
+
+    scale_exp = -2;
+    update_pixel_step();
+
+    load_builtin_palette(builtin_palette_t::HEATMAP, DEFAULT_PALETTE_SLOPE);
+  }
+
+  void apply_view(formula_t formula, real_t real, real_t imag, int exp,
+                  iter_t max_iter) {
+    cache_store_tiles();
+    scene.formula = formula;
+    scene.real = real;
+    scene.imag = imag;
+    scene.max_iter = clamp((iter_t)100, ITER_MAX, max_iter);
+    scale_exp = (exp < MIN_SCALE_EXP) ? MIN_SCALE_EXP : exp;
+    update_pixel_step();
+  }
+
   void update_pixel_step() {
     scene.step = real_exp2(-scale_exp - screen_size_clog2);
   }
@@ -2245,7 +4266,68 @@ class Renderer {
     return result_t::SUCCESS;
   }
 
+  // Row `dy` of the view zoomed in around its center: its even pixels are
+  // those of row `sy` from width / 4 on, the odd ones blank. `sy` may be
+  // `dy`.
+  void upscale_row(pos_t dy, pos_t sy) {
+#if FIXBROT_ITER_12BIT
+    memcpy(copy_buff, pair_pointer(0, sy), stride);
+    row_reader_t rd(copy_buff, width / 4);
+    uint8_t *dst = pair_pointer(0, dy);
+    for (pos_t x = 0; x < width; x += 2, dst += 3) {
+      store_pair(dst, rd.next() | ((uint32_t)ITER_BLANK << PAIR_SHIFT));
+    }
+#else
+    // outwards from the center, so that each pixel is read before the
+    // row overwrites it
+    const iter_t *src = work_buff + sy * width + width / 4;
+    iter_t *dst = work_buff + dy * width;
+    for (pos_t x = 0; x < width / 2; x++) {
+      dst[x] = (x & 1) ? ITER_BLANK : src[x / 2];
+    }
+    for (pos_t x = width - 1; x >= width / 2; x--) {
+      dst[x] = (x & 1) ? ITER_BLANK : src[x / 2];
+    }
+#endif
+    mark_dirty(0, dy);
+    mark_dirty(width - 1, dy);
+  }
+
+  // Row `dy` of the view zoomed out around its center: pixel x is pixel
+  // 2 * x - width / 2 of row `sy`, blank past its edges. `sy` may be `dy`.
+  void downscale_row(pos_t dy, pos_t sy) {
+    // pixels [x0, x1) are in row `sy`
+    const pos_t x0 = (width / 2 + 1) / 2;
+    const pos_t x1 = (width + width / 2 + 1) / 2;
+#if FIXBROT_ITER_12BIT
+    memcpy(copy_buff, pair_pointer(0, sy), stride);
+    row_reader_t rd(copy_buff, 2 * x0 - width / 2);
+    row_writer_t wr(*this, 0, dy);
+    for (pos_t x = 0; x < x0; x++) wr.put(ITER_BLANK);
+    for (pos_t x = x0; x < x1; x++) {
+      if (x > x0) rd.next();
+      wr.put(rd.next());
+    }
+    for (pos_t x = x1; x < width; x++) wr.put(ITER_BLANK);
+    wr.flush();
+#else
+    // inwards to the center, so that each pixel is read before the row
+    // overwrites it
+    const iter_t *src = work_buff + sy * width;
+    iter_t *dst = work_buff + dy * width;
+    for (pos_t x = width / 2 - 1; x >= 0; x--) {
+      dst[x] = (x < x0) ? ITER_BLANK : src[2 * x - width / 2];
+    }
+    for (pos_t x = width / 2; x < width; x++) {
+      dst[x] = (x >= x1) ? ITER_BLANK : src[2 * x - width / 2];
+    }
+#endif
+    mark_dirty(0, dy);
+    mark_dirty(width - 1, dy);
+  }
+
   result_t clear_rect(rect_t view) {
+    dirty_all = true;
 #if FIXBROT_ITER_12BIT
     for (pos_t y = 0; y < view.h; y++) {
       pos_t x0 = view.x;
@@ -2272,93 +4354,638 @@ class Renderer {
 #endif
     return result_t::SUCCESS;
   }
-
-  result_t fill_blank() {
-#if FIXBROT_ITER_12BIT
-    for (pos_t y = 0; y < height; y++) {
-      iter_t last = 1;
-      for (pos_t x = 0; x < width; x++) {
-        iter_t iter = work_buff_read(x, y);
-        if (iter == ITER_BLANK) {
-          work_buff_write(x, y, last);
-        } else {
-          last = iter;
+
+  // fills blank pixels row by row until done or past the deadline
+  result_t fill_blank(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_FILL_BLANK);
+    while (fill_y < height) {
+      pos_t y = fill_y++;
+#if FIXBROT_ITER_12BIT
+      // two pixels per step, rewriting a pair only if it has a blank
+      uint8_t *ptr = pair_pointer(0, y);
+      iter_t last = 1;
+      pos_t x = 0;
+      for (; x + 1 < width; x += 2, ptr += 3) {
+        uint32_t pair = load_pair(ptr);
+        iter_t iter0 = pair & PAIR_MASK;
+        iter_t iter1 = pair >> PAIR_SHIFT;
+        if (iter0 != ITER_BLANK && iter1 != ITER_BLANK) {
+          last = iter1;
+          continue;
         }
+        if (iter0 == ITER_BLANK) {
+          iter0 = last;
+          stats.fill_blank_pixels++;
+        }
+        if (iter1 == ITER_BLANK) {
+          iter1 = iter0;
+          stats.fill_blank_pixels++;
+        }
+        last = iter1;
+        store_pair(ptr, iter0 | ((uint32_t)iter1 << PAIR_SHIFT));
+        mark_dirty(x, y);
+      }
+      if (x < width && work_buff_read(x, y) == ITER_BLANK) {
+        work_buff_write(x, y, last);
+        stats.fill_blank_pixels++;
       }
-    }
 #else
-    iter_t *line_ptr = work_buff;
-    for (pos_t y = 0; y < height; y++) {
-      iter_t *ptr = line_ptr;
+      iter_t *ptr = work_buff + y * width;
       iter_t last = 1;
       for (pos_t x = 0; x < width; x++) {
         iter_t iter = *ptr;
         if (iter == ITER_BLANK) {
           *ptr = last;
+          mark_dirty(x, y);
+          stats.fill_blank_pixels++;
         } else {
           last = iter;
         }
         ptr++;
       }
-      line_ptr += width;
-    }
 #endif
+      if (is_past(deadline_us)) break;
+    }
     return result_t::SUCCESS;
   }
 
-  scene_t get_worker_args() {
-    scene_t s = scene;
-    s.real -= scene.step * (width / 2);
-    s.imag -= scene.step * (height / 2);
-    return s;
+  static FIXBROT_INLINE bool is_past(uint64_t deadline_us) {
+    return (deadline_us != NO_DEADLINE) && (get_time_us() >= deadline_us);
   }
 
   result_t start_render(bool post_correction) {
+    FIXBROT_TRY(reset_render(post_correction));
+
+    for (pos_t y = COARSE_POS_STEP / 2; y < height; y += COARSE_POS_STEP) {
+      for (pos_t x = COARSE_POS_STEP / 2; x < width; x += COARSE_POS_STEP) {
+        enqueue(vec_t{x, y});
+      }
+    }
+
+    for (pos_t x = 0; x < width; x++) {
+      enqueue(vec_t{x, 0});
+      enqueue(vec_t{x, (pos_t)(height - 1)});
+    }
+    for (pos_t y = 1; y < height - 1; y++) {
+      enqueue(vec_t{0, y});
+      enqueue(vec_t{(pos_t)(width - 1), y});
+    }
+
+    return result_t::SUCCESS;
+  }
+
+  // starts a render with nothing queued, the caller seeds it
+  result_t reset_render(bool post_correction) {
     if (is_busy()) {
       return result_t::ERROR_BUSY;
     }
 
     const scene_t s = get_worker_args();
     on_render_start(s);
+    render_max_iter = s.max_iter;
 
     queue.clear();
+    clear_overflowed();
+    prefetch_active = false;
     busy_items = 0;
     correct_x = 0;
     correct_y = post_correction ? 0 : height;
-    iter_accum = 0;
+    fill_y = 0;
 
-    for (pos_t y = COARSE_POS_STEP / 2; y < height; y += COARSE_POS_STEP) {
-      for (pos_t x = COARSE_POS_STEP / 2; x < width; x += COARSE_POS_STEP) {
-        enqueue(vec_t{x, y});
+    stats = render_stats_t{};
+    stats.queue_capacity = queue.depth - 1;
+    stats.start_ms = get_time_ms();
+    return result_t::SUCCESS;
+  }
+
+  // saves the finished view to the zoom history
+  void history_push() {
+    if (!zoom_history || is_busy() || !stats.finished) return;
+    zoom_history->push_begin(scene, scale_exp);
+    for (pos_t y = 0; y < height; y++) {
+      row_reader_t rd(*this, 0, y);
+      for (pos_t x = 0; x < width; x++) {
+        if (!zoom_history->push_pixel(rd.next())) return;
       }
     }
+    zoom_history->push_end();
+  }
 
-    for (pos_t x = 0; x < width; x++) {
-      enqueue(vec_t{x, 0});
-      enqueue(vec_t{x, (pos_t)(height - 1)});
+  // restores the view from the zoom history as a finished render, false if
+  // the newest saved view is a different one
+  bool history_pop() {
+    if (!zoom_history || !zoom_history->pop(scene, scale_exp)) return false;
+    for (pos_t y = 0; y < height; y++) {
+      row_writer_t wr(*this, 0, y);
+      for (pos_t x = 0; x < width; x++) wr.put(zoom_history->pop_pixel());
+      wr.flush();
     }
-    for (pos_t y = 1; y < height - 1; y++) {
-      enqueue(vec_t{0, y});
-      enqueue(vec_t{(pos_t)(width - 1), y});
+    restore_finished_view();
+    return true;
+  }
+
+  // marks the work buffer, filled with a saved view, as a finished render
+  void restore_finished_view() {
+    dirty_all = true;
+    paint_pending_pixels = true;
+
+    queue.clear();
+    clear_overflowed();
+    busy_items = 0;
+    correct_y = height;
+    fill_y = height;
+    render_max_iter = scene.max_iter;
+    stats = render_stats_t{};
+    stats.queue_capacity = queue.depth - 1;
+    stats.start_ms = get_time_ms();
+    stats.finished = true;
+    // the render this replaces may have been in progress
+    on_render_finished(result_t::SUCCESS);
+    prefetch_restart();
+  }
+
+  // the work buffer is partially overwritten, render the current view again
+  result_t rerender_after_bad_snapshot() {
+    clear_rect(rect_t{0, 0, width, height});
+    FIXBROT_TRY(start_render(true));
+    request_full_repaint();
+    return result_t::ERROR_BAD_SNAPSHOT;
+  }
+
+  // start_render() with whole tiles of the view taken from the tile cache
+  result_t start_render_cached(bool post_correction) {
+    int num_loaded = cache_load_tiles();
+    FIXBROT_TRY(start_render(post_correction));
+    stats.tiles_loaded = num_loaded;
+    if (num_loaded > 0) {
+      FIXBROT_TRY(cache_scan_seams());
+    }
+    return result_t::SUCCESS;
+  }
+
+  // buffer position of the first whole tile and its key, false if the view
+  // is not aligned to the pixel grid of its scale (e.g. after set_view())
+  FIXBROT_INLINE bool get_tile_grid(pos_t *x0, pos_t *y0,
+                                    tile_key_t *key) const {
+    return get_tile_grid(scale_exp, x0, y0, key);
+  }
+
+  // same for the view with the same center at scale `exp`
+  bool get_tile_grid(int exp, pos_t *x0, pos_t *y0, tile_key_t *key) const {
+    constexpr int T = TileCache::TILE_SIZE;
+    int shift = fixed64_t::FRAC_BITS - exp - screen_size_clog2;
+    if (shift <= 0 || shift >= 63) return false;
+    const real_t step = real_exp2(-exp - screen_size_clog2);
+    const real_t re = scene.real - step * (width / 2);
+    const real_t im = scene.imag - step * (height / 2);
+    int64_t mask = ((int64_t)1 << shift) - 1;
+    if ((re.raw & mask) || (im.raw & mask)) return false;
+    int64_t gx = re.raw >> shift;
+    int64_t gy = im.raw >> shift;
+    *x0 = (pos_t)(-gx & (T - 1));
+    *y0 = (pos_t)(-gy & (T - 1));
+    key->formula = scene.formula;
+    key->scale_exp = exp;
+    key->max_iter = scene.max_iter;
+    key->tx = (gx + *x0) >> TileCache::TILE_SIZE_BITS;
+    key->ty = (gy + *y0) >> TileCache::TILE_SIZE_BITS;
+    return true;
+  }
+
+  // copies finished whole tiles of the view to the tile cache
+  void cache_store_tiles() {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (!tile_cache || is_busy() || !stats.finished) return;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return;
+    key.max_iter = render_max_iter;
+    int64_t tx0 = key.tx;
+    for (pos_t y = y0; y + T <= height; y += T, key.ty++) {
+      key.tx = tx0;
+      for (pos_t x = x0; x + T <= width; x += T, key.tx++) {
+        if (tile_cache->contains(key)) continue;
+        bool finished = true;
+        for (pos_t i = 0; finished && i < T; i++) {
+          row_reader_t rd(*this, x, y + i);
+          for (pos_t j = 0; j < T; j++) {
+            iter_t iter = rd.next();
+            if (iter == ITER_BLANK || iter > ITER_MAX) {
+              finished = false;
+              break;
+            }
+          }
+        }
+        if (!finished) continue;
+        iter_t *dst = tile_cache->insert(key);
+        if (!dst) return;
+        for (pos_t i = 0; i < T; i++) {
+          row_reader_t rd(*this, x, y + i);
+          for (pos_t j = 0; j < T; j++) *(dst++) = rd.next();
+        }
+      }
+    }
+  }
+
+  // fills tiles of the view, including those cut by its edges, that have
+  // blank pixels from the tile cache; returns the number of tiles filled
+  int cache_load_tiles() {
+    constexpr int T = TileCache::TILE_SIZE;
+    const int tiles_x = width / T + 2;
+    for (int i = 0; i < tiles_x * (height / T + 2); i++) {
+      tile_loaded[i] = false;
+    }
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!tile_cache || !get_tile_grid(&x0, &y0, &key)) return 0;
+    if (x0 > 0) {
+      x0 -= T;
+      key.tx--;
+    }
+    if (y0 > 0) {
+      y0 -= T;
+      key.ty--;
+    }
+    int num_loaded = 0;
+    int64_t tx0 = key.tx;
+    int row = 0;
+    for (pos_t y = y0; y < height; y += T, key.ty++, row++) {
+      key.tx = tx0;
+      int i_tile = row * tiles_x;
+      pos_t i0 = (y < 0) ? -y : 0;
+      pos_t i1 = (y + T > height) ? (height - y) : T;
+      for (pos_t x = x0; x < width; x += T, key.tx++, i_tile++) {
+        pos_t j0 = (x < 0) ? -x : 0;
+        pos_t j1 = (x + T > width) ? (width - x) : T;
+        bool has_blank = false;
+        for (pos_t i = i0; !has_blank && i < i1; i++) {
+          row_reader_t rd(*this, x + j0, y + i);
+          for (pos_t j = j0; j < j1; j++) {
+            if (rd.next() == ITER_BLANK) {
+              has_blank = true;
+              break;
+            }
+          }
+        }
+        if (!has_blank) continue;
+        const iter_t *src = tile_cache->find(key);
+        if (!src) continue;
+        for (pos_t i = i0; i < i1; i++) {
+          row_writer_t wr(*this, x + j0, y + i);
+          for (pos_t j = j0; j < j1; j++) wr.put(src[i * T + j]);
+          wr.flush();
+          mark_dirty(x + j0, y + i);
+          mark_dirty(x + j1 - 1, y + i);
+        }
+        tile_loaded[i_tile] = true;
+        num_loaded++;
+      }
+    }
+    return num_loaded;
+  }
+
+  // seeds tracing from the edges of the tiles filled by cache_load_tiles()
+  result_t cache_scan_seams() {
+    constexpr int T = TileCache::TILE_SIZE;
+    const int tiles_x = width / T + 2;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return result_t::SUCCESS;
+    if (x0 > 0) x0 -= T;
+    if (y0 > 0) y0 -= T;
+    int row = 0;
+    for (pos_t y = y0; y < height; y += T, row++) {
+      int i_tile = row * tiles_x;
+      for (pos_t x = x0; x < width; x += T, i_tile++) {
+        if (!tile_loaded[i_tile]) continue;
+        // edges outside the view are walls and seed nothing
+        FIXBROT_TRY(scan_vert(x, x - 1, y, T));
+        FIXBROT_TRY(scan_vert(x + T - 1, x + T, y, T));
+        FIXBROT_TRY(scan_hori(x, y, y - 1, T));
+        FIXBROT_TRY(scan_hori(x, y + T - 1, y + T, T));
+      }
+    }
+    return result_t::SUCCESS;
+  }
+
+  void prefetch_restart() {
+    prefetch_active = (tile_cache != nullptr);
+    prefetch_tile_inprog = false;
+    prefetch_zoom = false;
+    prefetch_index = 0;
+    prefetch_pending = 0;
+  }
+
+  void prefetch_abort() {
+    queue.clear();
+    prefetch_pending = 0;
+    prefetch_tile_inprog = false;
+    prefetch_active = false;
+  }
+
+  // Collects results of the tile being prefetched and starts the next one
+  // when it is complete: first the tiles within PREFETCH_MARGIN of the
+  // view, then those of the view zoom_in() would show. Does nothing once
+  // all of them are cached.
+  //
+  // A tile is border-traced like the view, within its own square: from
+  // its edges and a coarse grid, then corrected and filled.
+  result_t prefetch_service() {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (!prefetch_active) return result_t::SUCCESS;
+
+    cell_t c;
+    while (prefetch_pending > 0 && on_collect(&c)) {
+      int j = c.loc.x - prefetch_x;
+      int i = c.loc.y - prefetch_y;
+      if (j < 0 || T <= j || i < 0 || T <= i) continue;
+      if (prefetch_pixels[i * T + j] != ITER_QUEUED) continue;
+      prefetch_pixels[i * T + j] = c.iter;
+      prefetch_pending--;
+      if (!prefetch_trace_around(j, i, c.iter)) return result_t::SUCCESS;
+    }
+    if (prefetch_pending > 0) return result_t::SUCCESS;
+
+    if (prefetch_tile_inprog) {
+      if (!prefetch_correct()) return result_t::SUCCESS;
+      if (prefetch_pending > 0) return result_t::SUCCESS;
+      prefetch_fill();
+      iter_t *dst = tile_cache->insert(prefetch_key);
+      if (dst) {
+        memcpy(dst, prefetch_pixels, sizeof(iter_t) * TileCache::TILE_PIXELS);
+        stats.tiles_prefetched++;
+      }
+      prefetch_tile_inprog = false;
     }
 
+    if (render_max_iter != scene.max_iter) {
+      // pixels of the view do not match the current max_iter
+      prefetch_active = false;
+      return result_t::SUCCESS;
+    }
+    if (!prefetch_zoom) {
+      if (prefetch_start_margin_tile()) return result_t::SUCCESS;
+      prefetch_zoom = true;
+      prefetch_index = 0;
+    }
+    if (prefetch_active && prefetch_start_zoom_tile()) {
+      return result_t::SUCCESS;
+    }
+    prefetch_active = false;
     return result_t::SUCCESS;
   }
 
-  result_t iterate() {
+  // starts computing the next uncached tile around the view, false if there
+  // is none
+  bool prefetch_start_margin_tile() {
+    constexpr int T = TileCache::TILE_SIZE;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return false;
+
+    // tiles overlapping the margin, in row-major order
+    int nx0 = (x0 + PREFETCH_MARGIN + T - 1) / T;
+    int ny0 = (y0 + PREFETCH_MARGIN + T - 1) / T;
+    pos_t xa = x0 - nx0 * T;
+    pos_t ya = y0 - ny0 * T;
+    int nx = (width + PREFETCH_MARGIN - xa + T - 1) / T;
+    int ny = (height + PREFETCH_MARGIN - ya + T - 1) / T;
+    int64_t tx0 = key.tx - nx0;
+    int64_t ty0 = key.ty - ny0;
+
+    for (; prefetch_index < nx * ny; prefetch_index++) {
+      int col = prefetch_index % nx;
+      int row = prefetch_index / nx;
+      pos_t x = xa + col * T;
+      pos_t y = ya + row * T;
+      if (0 <= x && x + T <= width && 0 <= y && y + T <= height) continue;
+      key.tx = tx0 + col;
+      key.ty = ty0 + row;
+      if (tile_cache->contains(key)) continue;
+
+      // Pixels in the view are known already, trace the rest. As they lie
+      // outside the work buffer, late results can never be mistaken for
+      // those of a render started meanwhile.
+      prefetch_x = x;
+      prefetch_y = y;
+      for (pos_t i = 0; i < T; i++) {
+        pos_t py = y + i;
+        iter_t *dst = prefetch_pixels + i * T;
+        for (pos_t j = 0; j < T; j++) dst[j] = ITER_BLANK;
+        if (py < 0 || height <= py) continue;
+        // the span of the row within the view
+        pos_t j0 = (x < 0) ? -x : 0;
+        pos_t j1 = (x + T > width) ? (width - x) : T;
+        row_reader_t rd(*this, x + j0, py);
+        for (pos_t j = j0; j < j1; j++) dst[j] = rd.next();
+      }
+      if (!prefetch_seed()) return false;
+      prefetch_begin_tile(get_worker_args(), key);
+      return true;
+    }
+    return false;
+  }
+
+  // Starts computing the next uncached tile of the view at scale_exp + 1,
+  // false if there is none. Pixels on the even grid are those of the view,
+  // unless the precision changes with the scale.
+  bool prefetch_start_zoom_tile() {
+    constexpr int T = TileCache::TILE_SIZE;
+    pos_t cx0, cy0, x0, y0;
+    tile_key_t ckey, key;
+    if (!get_tile_grid(&cx0, &cy0, &ckey)) return false;
+    if (!get_tile_grid(scale_exp + 1, &x0, &y0, &key)) return false;
+
+    // pixel grid positions of both views
+    int64_t gx = ckey.tx * T - cx0;
+    int64_t gy = ckey.ty * T - cy0;
+    int64_t zgx = key.tx * T - x0;
+    int64_t zgy = key.ty * T - y0;
+
+    scene_t s = get_worker_args();
+    s.step = real_exp2(-scale_exp - 1 - screen_size_clog2);
+    s.real = scene.real - s.step * (width / 2);
+    s.imag = scene.imag - s.step * (height / 2);
+    bool reuse = (s.step.is_fixed32() == scene.step.is_fixed32());
+
+    // pixels are addressed right of the work buffer, see above
+    const pos_t loc_offset = width + T;
+    s.real -= s.step * loc_offset;
+
+    // tiles overlapping the view, in row-major order
+    if (x0 > 0) {
+      x0 -= T;
+      key.tx--;
+    }
+    if (y0 > 0) {
+      y0 -= T;
+      key.ty--;
+    }
+    int nx = (width - x0 + T - 1) / T;
+    int ny = (height - y0 + T - 1) / T;
+    int64_t tx0 = key.tx;
+    int64_t ty0 = key.ty;
+
+    for (; prefetch_index < nx * ny; prefetch_index++) {
+      int col = prefetch_index % nx;
+      int row = prefetch_index / nx;
+      pos_t x = x0 + col * T;
+      pos_t y = y0 + row * T;
+      key.tx = tx0 + col;
+      key.ty = ty0 + row;
+      if (tile_cache->contains(key)) continue;
+
+      prefetch_x = x + loc_offset;
+      prefetch_y = y;
+      for (pos_t i = 0; i < T; i++) {
+        int64_t zy = zgy + y + i;
+        pos_t sy = (pos_t)((zy >> 1) - gy);
+        for (pos_t j = 0; j < T; j++) {
+          int64_t zx = zgx + x + j;
+          pos_t sx = (pos_t)((zx >> 1) - gx);
+          bool even = ((zx | zy) & 1) == 0;
+          if (reuse && even && 0 <= sx && sx < width && 0 <= sy &&
+              sy < height) {
+            prefetch_pixels[i * T + j] = work_buff_read(sx, sy);
+          } else {
+            prefetch_pixels[i * T + j] = ITER_BLANK;
+          }
+        }
+      }
+      if (!prefetch_seed()) return false;
+      prefetch_begin_tile(s, key);
+      return true;
+    }
+    return false;
+  }
+
+  // queues a pixel of the tile being prefetched, aborts prefetching and
+  // returns false if the queue is full
+  bool prefetch_enqueue(pos_t x, pos_t y) {
+    if (queue.enqueue(vec_t{x, y}) != result_t::SUCCESS) {
+      prefetch_abort();
+      return false;
+    }
+    prefetch_pending++;
+    return true;
+  }
+
+  // queues pixel (j, i) of the tile being prefetched if it is blank, false
+  // if prefetching was aborted
+  FIXBROT_INLINE bool prefetch_trace(int j, int i) {
+    constexpr int T = TileCache::TILE_SIZE;
+    iter_t &p = prefetch_pixels[i * T + j];
+    if (p != ITER_BLANK) return true;
+    p = ITER_QUEUED;
+    return prefetch_enqueue(prefetch_x + j, prefetch_y + i);
+  }
+
+  // seeds tracing of the tile as start_render() seeds the view
+  bool prefetch_seed() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int k = 0; k < T; k++) {
+      if (!prefetch_trace(k, 0) || !prefetch_trace(k, T - 1) ||
+          !prefetch_trace(0, k) || !prefetch_trace(T - 1, k)) {
+        return false;
+      }
+    }
+    for (int i = COARSE_POS_STEP / 2; i < T; i += COARSE_POS_STEP) {
+      for (int j = COARSE_POS_STEP / 2; j < T; j += COARSE_POS_STEP) {
+        if (!prefetch_trace(j, i)) return false;
+      }
+    }
+    return true;
+  }
+
+  FIXBROT_INLINE iter_t prefetch_get(int j, int i) const {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (j < 0 || T <= j || i < 0 || T <= i) return ITER_WALL;
+    return prefetch_pixels[i * T + j];
+  }
+
+  // see compare(), for the pixel of value `a` with neighbour (bj, bi)
+  FIXBROT_INLINE bool prefetch_compare(iter_t a, int bj, int bi, int cj,
+                                       int ci, int dj, int di) {
+    iter_t b = prefetch_get(bj, bi);
+    if (b == ITER_BLANK || b == ITER_QUEUED || b == ITER_WALL || b == a) {
+      return true;
+    }
+    if (prefetch_get(cj, ci) == ITER_BLANK && !prefetch_trace(cj, ci)) {
+      return false;
+    }
+    if (prefetch_get(dj, di) == ITER_BLANK && !prefetch_trace(dj, di)) {
+      return false;
+    }
+    return true;
+  }
+
+  // traces on from pixel (j, i) of the tile as iterate() does in the view
+  bool prefetch_trace_around(int j, int i, iter_t a) {
+    return prefetch_compare(a, j, i - 1, j - 1, i, j - 1, i - 1) &&
+           prefetch_compare(a, j, i + 1, j - 1, i, j - 1, i + 1) &&
+           prefetch_compare(a, j, i - 1, j + 1, i, j + 1, i - 1) &&
+           prefetch_compare(a, j, i + 1, j + 1, i, j + 1, i + 1) &&
+           prefetch_compare(a, j - 1, i, j, i - 1, j - 1, i - 1) &&
+           prefetch_compare(a, j + 1, i, j, i - 1, j + 1, i - 1) &&
+           prefetch_compare(a, j - 1, i, j, i + 1, j - 1, i + 1) &&
+           prefetch_compare(a, j + 1, i, j, i + 1, j + 1, i + 1);
+  }
+
+  // Queues the middle of each blank run between pixels of different values
+  // in a row, which tracing from its result closes as correct() does in the
+  // view. Nothing is queued once the runs can be filled; false if
+  // prefetching was aborted.
+  bool prefetch_correct() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int i = 0; i < T; i++) {
+      const iter_t *row = prefetch_pixels + i * T;
+      int j0 = 0;
+      for (int j = 1; j < T; j++) {
+        if (row[j] == ITER_BLANK) continue;
+        if (j - j0 > 1 && row[j] != row[j0] &&
+            !prefetch_trace((j0 + j) / 2, i)) {
+          return false;
+        }
+        j0 = j;
+      }
+    }
+    return true;
+  }
+
+  // fills blank pixels of the tile from their left neighbours, the edges
+  // are traced
+  void prefetch_fill() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int i = 0; i < T; i++) {
+      iter_t *row = prefetch_pixels + i * T;
+      for (int j = 1; j < T; j++) {
+        if (row[j] == ITER_BLANK) row[j] = row[j - 1];
+      }
+    }
+  }
+
+  void prefetch_begin_tile(const scene_t &s, const tile_key_t &key) {
+    on_prefetch_start(s);
+    prefetch_key = key;
+    prefetch_tile_inprog = true;
+    prefetch_index++;
+  }
+
+  result_t iterate(uint64_t deadline_us, bool *progress) {
+    *progress = false;
     if (!is_busy()) {
       return result_t::SUCCESS;
     }
 
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_ITERATE);
+
     // border-tracing
     for (int i_batch = 0; i_batch < BATCH_SIZE; i_batch++) {
+      if ((i_batch & 15) == 15 && is_past(deadline_us)) break;
       cell_t c;
       if (!collect(&c)) break;
-      if (c.iter == ITER_MAX) {
-        iter_accum += scene.max_iter;
-      } else {
-        iter_accum += c.iter;
-      }
+      *progress = true;
+      stats.total_iters += (c.iter == ITER_MAX) ? scene.max_iter : c.iter;
       pos_t x = c.loc.x;
       pos_t y = c.loc.y;
       work_buff_write(x, y, c.iter);
@@ -2380,46 +5007,50 @@ class Renderer {
       FIXBROT_TRY(compare(c, r, d, rd));
     }
 
-    uint32_t iter_thresh = (uint32_t)width * height * 4;
-    if (is_animating()) {
-      iter_thresh /= 8;
+    if (*progress) {
+      paint_pending_pixels = true;
     }
-    if (scene.step.is_fixed32()) {
-      iter_thresh *= 2;
+
+    if (num_overflowed > 0) {
+      requeue_overflowed();
     }
-    if (iter_accum >= iter_thresh) {
-      iter_accum = 0;
-      paint_requested = true;
+
+    if (busy_items == 0 && correct_y < height) {
+      correct(deadline_us);
+      *progress = true;
     }
 
-    if (busy_items == 0) {
-      correct();
+    if (busy_items == 0 && correct_y >= height && fill_y < height) {
+      fill_blank(deadline_us);
+      *progress = true;
     }
 
     if (!is_busy()) {
-      // fill blanks
-      fill_blank();
+      stats.render_ms = (uint32_t)(get_time_ms() - stats.start_ms);
+      stats.finished = true;
       on_render_finished(result_t::SUCCESS);
       paint_requested = true;
+      prefetch_restart();
     }
 
     return result_t::SUCCESS;
   }
 
-  void correct() {
+  void correct(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_CORRECT);
     scene_t s = get_worker_args();
 
     while (correct_y < height) {
+      if (correct_x == 0 && is_past(deadline_us)) return;
       pos_t x0 = -1;
       iter_t iter0 = ITER_BLANK;
       int blank_count = 0;
+#if !FIXBROT_ITER_12BIT
       int line_ptr = correct_y * width;
-      while (correct_x < width) {
-#if FIXBROT_ITER_12BIT
-        iter_t iter1 = work_buff_read(correct_x, correct_y);
-#else
-        iter_t iter1 = work_buff[line_ptr + correct_x];
 #endif
+      row_reader_t rd(*this, correct_x, correct_y);
+      while (correct_x < width) {
+        iter_t iter1 = rd.next();
         if (iter1 == ITER_BLANK || ITER_MAX < iter1) {
           // count blank pixel
           blank_count++;
@@ -2441,10 +5072,13 @@ class Renderer {
         while (x0 + 1 < x1) {
           pos_t xm = (x1 + x0) / 2;
           iter_t iter_m = Mandelbrot::compute(s, vec_t{xm, correct_y});
+          stats.correct_computes++;
+          stats.total_iters += iter_m;
 #if FIXBROT_ITER_12BIT
           work_buff_write(xm, correct_y, iter_m);
 #else
           work_buff[line_ptr + xm] = iter_m;
+          mark_dirty(xm, correct_y);
 #endif
           if (iter_m == iter0) {
             x0 = xm;
@@ -2531,46 +5165,95 @@ class Renderer {
     work_buff_write(loc.x, loc.y, ITER_QUEUED);
 #else
     work_buff[i] = ITER_QUEUED;
+    mark_dirty(loc.x, loc.y);
 #endif
-    FIXBROT_TRY(queue.enqueue(loc));
     busy_items++;
+    stats.cells_enqueued++;
+    if (queue.enqueue(loc) != result_t::SUCCESS) {
+      // trace it later instead of aborting the render
+      uint32_t bit = (uint32_t)loc.y * width + loc.x;
+      overflow_bits[bit / 32] |= 1u << (bit % 32);
+      num_overflowed++;
+      stats.cells_overflowed++;
+      return result_t::SUCCESS;
+    }
+    uint32_t depth = queue.size();
+    if (depth > stats.queue_peak) {
+      stats.queue_peak = depth;
+    }
     return result_t::SUCCESS;
   }
 
+  // moves pixels of the overflow bitmap to the queue while it has room,
+  // resuming the scan where the last call stopped
+  void requeue_overflowed() {
+    const uint32_t num_words = num_overflow_words(width, height);
+    for (uint32_t n = 0; n < num_words && num_overflowed > 0; n++) {
+      uint32_t &word = overflow_bits[overflow_scan];
+      while (word != 0) {
+        if (queue.full()) return;
+        int bit = count_trailing_zeros(word);
+        uint32_t i = overflow_scan * 32 + bit;
+        queue.enqueue(vec_t{(pos_t)(i % width), (pos_t)(i / width)});
+        word &= word - 1;
+        num_overflowed--;
+      }
+      if (++overflow_scan >= num_words) overflow_scan = 0;
+    }
+  }
+
+  void clear_overflowed() {
+    if (num_overflowed > 0) {
+      for (uint32_t i = 0; i < num_overflow_words(width, height); i++) {
+        overflow_bits[i] = 0;
+      }
+      num_overflowed = 0;
+    }
+    overflow_scan = 0;
+  }
+
   bool collect(cell_t *cell) {
-    if (on_collect(cell)) {
+    while (on_collect(cell)) {
+      // drop late results of an aborted prefetch, which are outside the view
+      if (work_buff_read(cell->loc.x, cell->loc.y) != ITER_QUEUED) continue;
       busy_items--;
+      stats.cells_collected++;
       return true;
-    } else {
-      return false;
     }
+    return false;
+  }
+
+  void set_palette_color(int i, uint8_t r, uint8_t g, uint8_t b) {
+    palette[i] = color_pack_from_888(r, g, b);
+    palette_rgb[i] = rgb888_pack(r, g, b);
   }
 
   void palette_load_heatmap(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       int p = i * (256 * 6) / palette_size;
       int c = p / 256;
       int f = p % 256;
       switch (c) {
         case 0:
-          palette[i] = color_pack_from_888(0, f / 4, f);
+          set_palette_color(i, 0, f / 4, f);
           break;
         case 1:
-          palette[i] = color_pack_from_888(0, 64 + f / 2, 255);
+          set_palette_color(i, 0, 64 + f / 2, 255);
           break;
         case 2:
-          palette[i] = color_pack_from_888(f, 192 + f / 4, 255);
+          set_palette_color(i, f, 192 + f / 4, 255);
           break;
         case 3:
-          palette[i] = color_pack_from_888(255, 255 - f / 4, 255 - f);
+          set_palette_color(i, 255, 255 - f / 4, 255 - f);
           break;
         case 4:
-          palette[i] = color_pack_from_888(255, 191 - f / 2, 0);
+          set_palette_color(i, 255, 191 - f / 2, 0);
           break;
         default:
-          palette[i] = color_pack_from_888(255 - f, 63 - f / 4, 0);
+          set_palette_color(i, 255 - f, 63 - f / 4, 0);
           break;
       }
     }
@@ -2579,28 +5262,29 @@ class Renderer {
   void palette_load_rainbow(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       int p = i * (256 * 6) / palette_size;
       int c = p / 256;
       int f = p % 256;
       switch (c) {
         case 0:
-          palette[i] = color_pack(255, f, 0);
+          set_palette_color(i, 255, f, 0);
           break;
         case 1:
-          palette[i] = color_pack(255 - f, 255, 0);
+          set_palette_color(i, 255 - f, 255, 0);
           break;
         case 2:
-          palette[i] = color_pack(0, 255, f);
+          set_palette_color(i, 0, 255, f);
           break;
         case 3:
-          palette[i] = color_pack(0, 255 - f, 255);
+          set_palette_color(i, 0, 255 - f, 255);
           break;
         case 4:
-          palette[i] = color_pack(f, 0, 255);
+          set_palette_color(i, f, 0, 255);
           break;
         default:
-          palette[i] = color_pack(255, 0, 255 - f);
+          set_palette_color(i, 255, 0, 255 - f);
           break;
       }
     }
@@ -2609,23 +5293,25 @@ class Renderer {
   void palette_load_gray(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       uint16_t gray = i * 512 / palette_size;
       if (gray >= 256) {
         gray = 511 - gray;
       }
-      palette[i] = color_pack(gray, gray, gray);
+      set_palette_color(i, gray, gray, gray);
     }
   }
 
   void palette_load_stripe(int slope) {
     palette_size = 64 >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       if (i < palette_size / 2) {
-        palette[i] = color_pack_from_888(224, 224, 224);
+        set_palette_color(i, 224, 224, 224);
       } else {
-        palette[i] = color_pack_from_888(32, 32, 32);
+        set_palette_color(i, 32, 32, 32);
       }
     }
   }
@@ -2634,6 +5320,8 @@ class Renderer {
 }  // namespace fixbrot
 
 #endif
+// #include "fixbrot/trace.hpp"
+
 // #include "fixbrot/worker.hpp"
 
 #ifndef FIXBROT_WORKER_HPP
@@ -2648,6 +5336,8 @@ class Renderer {
 
 // #include "fixbrot/mandelbrot.hpp"
 
+// #include "fixbrot/trace.hpp"
+
 
 namespace fixbrot {
 
@@ -2661,19 +5351,38 @@ class Worker {
   volatile index_t wr_ptr = 0;
   volatile index_t proc_ptr = 0;
   volatile index_t rd_ptr = 0;
+  volatile uint32_t num_computed = 0;
   scene_t scene;
 
+  // scenes passed to init(), alternately, and the number of init() calls
+  // requested and applied by service()
+  scene_t next_scenes[2];
+  volatile uint32_t init_seq = 0;
+  volatile uint32_t applied_seq = 0;
+
  public:
+  // Discards the queued cells and switches to `scene`. Called from the
+  // core that feeds the worker while another core may be inside service(),
+  // so it only posts the request: service() applies it before it computes
+  // the next cell, and until then full() is true and collect() returns
+  // nothing.
   result_t init(const scene_t &scene) {
-    this->scene = scene;
-    wr_ptr = 0;
-    proc_ptr = 0;
-    rd_ptr = 0;
+    uint32_t seq = init_seq + 1;
+    next_scenes[seq & 1] = scene;
+    __sync_synchronize();
+    init_seq = seq;
     return result_t::SUCCESS;
   }
 
+  FIXBROT_INLINE bool is_init_pending() const {
+    return init_seq != applied_seq;
+  }
+
+  // number of cells computed by this worker since the last init()
+  FIXBROT_INLINE uint32_t get_num_computed() const { return num_computed; }
+
   FIXBROT_INLINE bool full() const {
-    return ((wr_ptr + 1) & (DEPTH - 1)) == rd_ptr;
+    return is_init_pending() || ((wr_ptr + 1) & (DEPTH - 1)) == rd_ptr;
   }
 
   FIXBROT_INLINE bool empty() const { return rd_ptr == wr_ptr; }
@@ -2683,13 +5392,14 @@ class Worker {
   }
 
   FIXBROT_INLINE index_t num_processed() const {
+    if (is_init_pending()) return 0;
     return (proc_ptr - rd_ptr) & (DEPTH - 1);
   }
 
   FIXBROT_INLINE result_t dispatch(vec_t loc) {
     index_t wp = wr_ptr;
     index_t next_wp = (wp + 1) & (DEPTH - 1);
-    if (next_wp == rd_ptr) {
+    if (next_wp == rd_ptr || is_init_pending()) {
       return result_t::ERROR_QUEUE_OVERFLOW;
     }
     queue[wp].loc = loc;
@@ -2698,6 +5408,7 @@ class Worker {
   }
 
   FIXBROT_INLINE bool collect(cell_t *resp) {
+    if (is_init_pending()) return false;
     index_t rp = rd_ptr;
     if (rp == proc_ptr) return false;
     *resp = queue[rp];
@@ -2705,10 +5416,18 @@ class Worker {
     return true;
   }
 
-  result_t service() {
+  // computes queued cells, stops early when past `deadline_us`
+  result_t service(uint64_t deadline_us = NO_DEADLINE) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::WORKER_SERVICE);
+    if (is_init_pending()) apply_init();
     int n = num_queued();
     vec_t loc;
     while (n-- > 0 && fetch(&loc)) {
+      if (deadline_us != NO_DEADLINE && get_time_us() >= deadline_us) break;
+      if (is_init_pending()) {
+        apply_init();
+        return result_t::SUCCESS;
+      }
       cell_t resp;
       resp.loc = loc;
       resp.iter = Mandelbrot::compute(scene, loc);
@@ -2716,11 +5435,32 @@ class Worker {
         resp.iter = ITER_MAX;
       }
       advance(resp.iter);
+      num_computed++;
     }
     return result_t::SUCCESS;
   }
 
  private:
+  // runs on the core of service(), the feeding core leaves the pointers
+  // alone while the request is pending
+  void apply_init() {
+    uint32_t seq;
+    do {
+      // init() only writes the other slot unless it is called again
+      // during the copy, which changes init_seq
+      seq = init_seq;
+      __sync_synchronize();
+      scene = next_scenes[seq & 1];
+      __sync_synchronize();
+    } while (seq != init_seq);
+    wr_ptr = 0;
+    proc_ptr = 0;
+    rd_ptr = 0;
+    num_computed = 0;
+    __sync_synchronize();
+    applied_seq = seq;
+  }
+
   FIXBROT_INLINE bool fetch(vec_t *loc) {
     index_t pp = proc_ptr;
     if (pp == wr_ptr) return false;
@@ -3014,6 +5754,7 @@ enum class menu_key_t {
   LAST,
   CAPTION,
   BLANK,
+  STATS,
 };
 
 struct menu_item_t {
@@ -3025,11 +5766,19 @@ struct menu_item_t {
   pos_t y_center;
 };
 
+// state of a menu item last drawn to the menu bitmap of a GUI
+struct menu_item_drawn_t {
+  bool valid;
+  bool active;
+  char text[32];
+};
+
+// in display byte order
 static const col_t MENU_PALETTE[4] = {
-    color_pack_from_888(0x16, 0x16, 0x16),
-    color_pack_from_888(0x00, 0x80, 0xFF),
-    color_pack_from_888(0xC0, 0xC0, 0xC0),
-    color_pack_from_888(0xFF, 0xFF, 0xFF),
+    color_to_display(color_pack_from_888(0x16, 0x16, 0x16)),
+    color_to_display(color_pack_from_888(0x00, 0x80, 0xFF)),
+    color_to_display(color_pack_from_888(0xC0, 0xC0, 0xC0)),
+    color_to_display(color_pack_from_888(0xFF, 0xFF, 0xFF)),
 };
 static constexpr uint8_t MENU_BACK = 0;
 static constexpr uint8_t MENU_ACTIVE = 1;
@@ -3048,7 +5797,7 @@ menu_item_t menu_items[] = {
     {menu_key_t::SCENE_ZOOM, 40, 1, "Zoom"},
     {menu_key_t::SCENE_ITER, 40, 1, "Iter"},
     {menu_key_t::SCENE_VFLIP, 40, 1, "VFlip"},
-    {menu_key_t::BLANK, 0, 1, ""},
+    {menu_key_t::STATS, 40, 1, "Stat"},
     {menu_key_t::CAPTION, 0, 1, "PALETTE"},
     {menu_key_t::PALETTE_TYPE, 50, 1, "Type"},
     {menu_key_t::PALETTE_SLOPE, 50, 1, "Slope"},
@@ -3056,6 +5805,13 @@ menu_item_t menu_items[] = {
 };
 const int NUM_MENU_ITEMS = sizeof(menu_items) / sizeof(menu_items[0]);
 
+struct paint_stats_t {
+  uint32_t frames;
+  uint32_t full_frames;
+  uint64_t pixels_sent;
+  uint64_t pixels_skipped;
+};
+
 static constexpr int MENU_WIDTH = 160;
 static constexpr int KEYPAD_HEIGHT = 64;
 
@@ -3067,6 +5823,7 @@ class GUI {
   Renderer renderer;
 
   Gray2Bitmap menu_bmp;
+  Gray2Bitmap::expansion_t menu_expansion;
 
   builtin_palette_t palette = builtin_palette_t::HEATMAP;
   int palette_slope = DEFAULT_PALETTE_SLOPE;
@@ -3092,30 +5849,93 @@ class GUI {
   vec_t touch_drag_last_pos = {0, 0};
 
   bool paint_requested = false;
+  bool paint_full = true;
+  paint_stats_t paint_stats = {};
   bool menu_open = false;
   menu_key_t menu_cursor = (menu_key_t)0;
   int menu_pos = 0;
+  int painted_menu_pos = 0;
+  bool menu_bmp_valid = false;
+  // rows of the menu bitmap redrawn since the last paint, empty if y1 <= y0
+  pos_t menu_damage_y0 = 0;
+  pos_t menu_damage_y1 = 0;
+  menu_item_drawn_t menu_drawn[NUM_MENU_ITEMS] = {};
 
   static constexpr int SHADOW_SIZE = 16;
-  int shadow_alpha[SHADOW_SIZE];
+  // darkened value of each color channel value, per shadow column
+  uint8_t shadow_lut[SHADOW_SIZE][64];
+
+  // Carves all buffers from `arena`, which needs get_arena_bytes() bytes
+  // left. `queue_depth` is that of the renderer's trace queue, 0 selects
+  // the default.
+  GUI(pos_t width, pos_t height, Arena &arena, uint32_t queue_depth = 0)
+      : width(width),
+        height(height),
+        renderer(width, height, arena, queue_depth),
+        menu_bmp(MENU_WIDTH, height, arena) {}
 
-  GUI(pos_t width, pos_t height)
+#ifndef FIXBROT_NO_STDLIB
+  GUI(pos_t width, pos_t height, uint32_t queue_depth = 0)
       : width(width),
         height(height),
-        renderer(width, height),
+        renderer(width, height, queue_depth),
         menu_bmp(MENU_WIDTH, height) {}
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height,
+                                          uint32_t queue_depth = 0) {
+    return Renderer::get_arena_bytes(width, height, queue_depth) +
+           Gray2Bitmap::get_arena_bytes(MENU_WIDTH, height);
+  }
+
+  // false if the arena given to the constructor was too small, see
+  // Renderer::has_buffers()
+  FIXBROT_INLINE bool has_buffers() const {
+    return renderer.has_buffers() && menu_bmp.has_buffer();
+  }
 
   result_t init() {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
     FIXBROT_TRY(renderer.init());
+    init_ui();
+    return result_t::SUCCESS;
+  }
+
+  // same as init(), but starts with the view of a snapshot, see
+  // Renderer::init_from_snapshot()
+  template <typename TStream>
+  result_t init_from_snapshot(TStream &stream) {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_ui();
+    return renderer.init_from_snapshot(stream, &palette, &palette_slope);
+  }
+
+  // see Renderer::save_snapshot()
+  template <typename TStream>
+  result_t save_snapshot(TStream &stream) const {
+    return renderer.save_snapshot(stream, palette, palette_slope);
+  }
+
+  // see Renderer::load_snapshot()
+  template <typename TStream>
+  result_t load_snapshot(TStream &stream) {
+    return renderer.load_snapshot(stream, &palette, &palette_slope);
+  }
+
+  void init_ui() {
+    Gray2Bitmap::build_expansion(MENU_PALETTE, &menu_expansion);
     for (int i = 0; i < SHADOW_SIZE; i++) {
-      shadow_alpha[i] = 256 - (SHADOW_SIZE - i) * (SHADOW_SIZE - i) * 256 /
-                                  (SHADOW_SIZE * SHADOW_SIZE);
+      int alpha = 256 - (SHADOW_SIZE - i) * (SHADOW_SIZE - i) * 256 /
+                            (SHADOW_SIZE * SHADOW_SIZE);
+      for (int v = 0; v < 64; v++) {
+        shadow_lut[i][v] = (v * alpha) >> 8;
+      }
     }
     for (int i = 0; i < NUM_MAX_TOUCHES; i++) {
       touches[i].pressed = false;
     }
     touch_drag_thresh = (width * height) / 256;
-    return result_t::SUCCESS;
   }
 
   bool is_busy() const { return renderer.is_busy() || paint_requested; }
@@ -3437,6 +6257,21 @@ class GUI {
   }
 
   result_t service() {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_SERVICE);
+    FIXBROT_TRY(service_input());
+    FIXBROT_TRY(renderer.service());
+    return result_t::SUCCESS;
+  }
+
+  // renders until `deadline_us` (in get_time_us() time)
+  result_t service(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_SERVICE);
+    FIXBROT_TRY(service_input());
+    FIXBROT_TRY(renderer.service(deadline_us));
+    return result_t::SUCCESS;
+  }
+
+  result_t service_input() {
     uint64_t now_ms = get_time_ms();
     if (touch_state == touch_state_t::TAP_RELEASE) {
       uint64_t elapsed_ms = now_ms - touch_last_event_time_ms;
@@ -3449,12 +6284,12 @@ class GUI {
         touch_state = touch_state_t::IDLE;
       }
     }
-
-    FIXBROT_TRY(renderer.service());
     return result_t::SUCCESS;
   }
 
   result_t paint_start() {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_PAINT_START);
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
     paint_requested = false;
 
     if (menu_open) {
@@ -3474,42 +6309,142 @@ class GUI {
       }
     }
 
+    // the whole screen moves while the menu slides
+    paint_full =
+        (menu_pos != painted_menu_pos) || renderer.is_full_repaint_requested();
+    painted_menu_pos = menu_pos;
+
     renderer.paint_start();
 
     return result_t::SUCCESS;
   }
 
-  result_t paint_line(pos_t y, uint16_t *line_buff) {
-    pos_t canvas_w = width - menu_pos;
-    pos_t canvas_sx = menu_pos / 2;
-    renderer.paint_line(canvas_sx, y, canvas_w, line_buff + menu_pos);
+  // The paint functions only read the GUI state, so disjoint areas may be
+  // painted concurrently between paint_start() and paint_end().
 
-    if (menu_pos > 0) {
-      menu_bmp.render_to(MENU_WIDTH - menu_pos, y, menu_pos, 1, line_buff,
-                         width, MENU_PALETTE);
+  // Paints the screen rectangle (x, y, w, h) straight to `dst`, rows are
+  // `dst_stride` pixels apart. The menu overlay and its shadow are
+  // composited in the same pass.
+  result_t paint_rect(pos_t x, pos_t y, pos_t w, pos_t h, col_t *dst,
+                      int dst_stride) const {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_PAINT_LINE);
+    pos_t x1 = x + w;
+
+    // menu overlay
+    pos_t menu_x1 = (x1 < menu_pos) ? x1 : menu_pos;
+    if (x < menu_x1) {
+      menu_bmp.render_to(MENU_WIDTH - menu_pos + x, y, menu_x1 - x, h, dst,
+                         dst_stride, menu_expansion);
+    }
+
+    pos_t canvas_x = (x > menu_pos) ? x : menu_pos;
+    if (canvas_x >= x1) {
+      return result_t::SUCCESS;
+    }
+    dst += canvas_x - x;
+
+    // screen column `menu_pos` shows renderer column `menu_pos / 2`
+    pos_t offset = menu_pos - menu_pos / 2;
+    FIXBROT_TRY(renderer.paint_rect(canvas_x - offset, y, x1 - canvas_x, h,
+                                    dst, dst_stride));
 
-      // menu shadow effect
-      for (int i = 0; i < SHADOW_SIZE; i++) {
-        uint8_t r, g, b;
-        color_unpack(line_buff[menu_pos + i], &r, &g, &b);
-        r = (int)(r * shadow_alpha[i]) >> 8;
-        g = (int)(g * shadow_alpha[i]) >> 8;
-        b = (int)(b * shadow_alpha[i]) >> 8;
-        line_buff[menu_pos + i] = color_pack(r, g, b);
+    // menu shadow effect, the shadowed canvas columns are darkened in place
+    if (menu_pos > 0) {
+      pos_t shadow_x1 = menu_pos + SHADOW_SIZE;
+      if (shadow_x1 > x1) shadow_x1 = x1;
+      pos_t n = shadow_x1 - canvas_x;
+      for (pos_t iy = 0; iy < h; iy++) {
+        col_t *wr_ptr = dst + iy * dst_stride;
+        for (pos_t i = 0; i < n; i++) {
+          const uint8_t *lut = shadow_lut[canvas_x - menu_pos + i];
+          uint8_t r, g, b;
+          color_unpack(color_from_display(wr_ptr[i]), &r, &g, &b);
+          wr_ptr[i] = color_to_display(color_pack(lut[r], lut[g], lut[b]));
+        }
       }
     }
 
-#if FIXBROT_BYTE_SWAP
-    for (int x = 0; x < width; x++) {
-      uint16_t c = line_buff[x];
-      line_buff[x] = ((c >> 8) & 0x00FF) | ((c << 8) & 0xFF00);
+    return result_t::SUCCESS;
+  }
+
+  FIXBROT_INLINE result_t paint_line(pos_t y, col_t *line_buff) const {
+    return paint_rect(0, y, width, 1, line_buff, width);
+  }
+
+  // paints rows [y0, y0 + h) to `buff`, rows are `stride` pixels apart
+  FIXBROT_INLINE result_t paint_band(pos_t y0, pos_t h, col_t *buff,
+                                     int stride) const {
+    return paint_rect(0, y0, width, h, buff, stride);
+  }
+
+  // Horizontal span of screen row `y` that needs to be sent to the display
+  // in this frame. Rows without a span can be skipped entirely.
+  bool get_dirty_span(pos_t y, pos_t *x, pos_t *w) {
+    if (paint_full) {
+      *x = 0;
+      *w = width;
+      return true;
     }
-#endif
 
+    pos_t x0 = width, x1 = 0;
+
+    // renderer span shifted to where the canvas is shown
+    pos_t rx, rw;
+    if (renderer.get_dirty_span(y, &rx, &rw)) {
+      pos_t offset = menu_pos - menu_pos / 2;
+      x0 = rx + offset;
+      x1 = rx + rw + offset;
+      if (x0 < menu_pos) x0 = menu_pos;
+      if (x1 > width) x1 = width;
+    }
+
+    if (menu_pos > 0 && menu_damage_y0 <= y && y < menu_damage_y1) {
+      x0 = 0;
+      if (x1 < menu_pos) x1 = menu_pos;
+    }
+
+    bool dirty = x0 < x1;
+    *x = dirty ? x0 : 0;
+    *w = dirty ? (x1 - x0) : 0;
+    paint_stats.pixels_sent += *w;
+    paint_stats.pixels_skipped += width - *w;
+    return dirty;
+  }
+
+  // Paints the dirty spans of this frame to the frame buffer `frame`, rows
+  // are `stride` pixels apart. Runs of rows with the same span, as within a
+  // row of renderer tiles, are painted as one rectangle.
+  result_t paint_dirty(col_t *frame, int stride) {
+    pos_t run_y = 0, run_x = 0, run_w = 0;
+    for (pos_t y = 0; y <= height; y++) {
+      pos_t x = 0, w = 0;
+      if (y < height) get_dirty_span(y, &x, &w);
+      if (y < height && x == run_x && w == run_w) continue;
+      if (run_w > 0) {
+        FIXBROT_TRY(paint_rect(run_x, run_y, run_w, y - run_y,
+                               frame + run_y * stride + run_x, stride));
+      }
+      run_y = y;
+      run_x = x;
+      run_w = w;
+    }
     return result_t::SUCCESS;
   }
 
+  FIXBROT_INLINE bool is_full_paint() const { return paint_full; }
+
+  FIXBROT_INLINE const paint_stats_t &get_paint_stats() const {
+    return paint_stats;
+  }
+
   result_t paint_end() {
+    paint_stats.frames++;
+    if (paint_full) {
+      paint_stats.full_frames++;
+      paint_stats.pixels_sent += (uint32_t)width * height;
+    }
+    menu_damage_y0 = 0;
+    menu_damage_y1 = 0;
     renderer.paint_finished();
     return result_t::SUCCESS;
   }
@@ -3664,13 +6599,25 @@ class GUI {
         int delta = inc_dec * renderer.get_palette_size() / 8;
         renderer.set_palette_phase(renderer.get_palette_phase() + delta);
       } break;
+
+      case menu_key_t::BLANK:
+      case menu_key_t::CAPTION:
+      case menu_key_t::STATS:
+      case menu_key_t::LAST:
+        break;
     }
   }
 
   void update_menu() {
     const GFXfont &font = ShapoSansP_s12c09a01w02;
 
-    menu_bmp.clear(MENU_BACK);
+    if (!menu_bmp_valid) {
+      menu_bmp.clear(MENU_BACK);
+      for (int i_menu = 0; i_menu < NUM_MENU_ITEMS; i_menu++) {
+        menu_drawn[i_menu].valid = false;
+      }
+      menu_bmp_valid = true;
+    }
 
     int scale_exp = renderer.get_scale_exp();
     int frac_digits = clamp(1, 20, scale_exp * 77 / 256 + 4);
@@ -3715,6 +6662,16 @@ class GUI {
                    renderer.get_vert_flip() ? "On" : "Off");
           break;
 
+        case menu_key_t::STATS: {
+          // render time and ratio of pixels actually computed
+          const render_stats_t &st = renderer.get_stats();
+          uint32_t pixels = (uint32_t)width * height;
+          uint32_t computed = st.cells_collected + st.correct_computes;
+          snprintf(item.value_text, sizeof(item.value_text), "%lu ms, %lu %%",
+                   (unsigned long)renderer.get_render_ms(),
+                   (unsigned long)(100 * computed / pixels));
+        } break;
+
         case menu_key_t::PALETTE_TYPE:
           snprintf(item.value_text, sizeof(item.value_text), "%d",
                    (int)palette);
@@ -3733,6 +6690,30 @@ class GUI {
         } break;
       }
 
+      int h = line_height * item.value_lines;
+      item.y_center = y + h / 2;
+
+      // redraw only items whose appearance changed
+      bool active = (menu_cursor == item.key);
+      menu_item_drawn_t &drawn = menu_drawn[i_menu];
+      if (drawn.valid && drawn.active == active &&
+          strcmp(drawn.text, item.value_text) == 0) {
+        y += h;
+        continue;
+      }
+      drawn.valid = true;
+      drawn.active = active;
+      strncpy(drawn.text, item.value_text, sizeof(drawn.text));
+      // grow the pending span, an item above it may be redrawn as well
+      if (menu_damage_y1 <= menu_damage_y0) {
+        menu_damage_y0 = y;
+        menu_damage_y1 = y + h;
+      } else {
+        if (y < menu_damage_y0) menu_damage_y0 = y;
+        if (y + h > menu_damage_y1) menu_damage_y1 = y + h;
+      }
+      menu_bmp.fill_rect(0, y, MENU_WIDTH, h, MENU_BACK);
+
       // render menu item
       if (item.key == menu_key_t::CAPTION) {
         menu_bmp.fill_rect(0, y, MENU_WIDTH, line_height * item.value_lines - 1,
@@ -3744,7 +6725,7 @@ class GUI {
       } else {
         uint8_t label_color = MENU_LABEL;
         uint8_t value_color = MENU_VALUE;
-        if (menu_cursor == item.key) {
+        if (active) {
           menu_bmp.fill_rect(0, y, MENU_WIDTH,
                              line_height * item.value_lines - 1, MENU_ACTIVE);
           label_color = MENU_BACK;
@@ -3759,8 +6740,6 @@ class GUI {
                            value_color);
       }
 
-      int h = line_height * item.value_lines;
-      item.y_center = y + h / 2;
       y += h;
     }
   }
@@ -3769,14 +6748,847 @@ class GUI {
 }  // namespace fixbrot
 
 #endif
+
+namespace fixbrot {
+
+// Double-buffered band output to a display. While the driver is still
+// sending one band (e.g. by DMA), the GUI paints the next one into the
+// other buffer. `prm_TDriver` provides:
+//
+//   // starts sending a rectangle, rows of `pixels` are `stride` apart
+//   void start(pos_t x, pos_t y, pos_t w, pos_t h, const col_t *pixels,
+//              int stride);
+//   // blocks until the transfer started last has completed
+//   void wait();
+template <typename prm_TDriver>
+class DisplaySink {
+ public:
+  prm_TDriver &driver;
+  const pos_t width;
+  const pos_t band_height;
+
+ private:
+  col_t *buffs[2];
+  bool owns_buffs = false;
+  int back = 0;
+  bool in_flight = false;
+
+ public:
+  DisplaySink(prm_TDriver &driver, pos_t width, pos_t band_height,
+              Arena &arena)
+      : driver(driver), width(width), band_height(band_height) {
+    buffs[0] = arena.alloc<col_t>(width * band_height);
+    buffs[1] = arena.alloc<col_t>(width * band_height);
+  }
+
+#ifndef FIXBROT_NO_STDLIB
+  DisplaySink(prm_TDriver &driver, pos_t width, pos_t band_height)
+      : driver(driver),
+        width(width),
+        band_height(band_height),
+        owns_buffs(true) {
+    buffs[0] = new col_t[width * band_height];
+    buffs[1] = new col_t[width * band_height];
+  }
+#endif
+
+  ~DisplaySink() {
+    flush();
+#ifndef FIXBROT_NO_STDLIB
+    if (owns_buffs) {
+      delete[] buffs[0];
+      delete[] buffs[1];
+    }
+#endif
+  }
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t band_height) {
+    return Arena::align_up(sizeof(col_t) * width * band_height) * 2;
+  }
+
+  // buffer to be filled next, `band_height` rows of `width` pixels
+  FIXBROT_INLINE col_t *get_band() const { return buffs[back]; }
+
+  // sends rows [0, h) of the band to the rectangle at (x, y), then swaps
+  // buffers
+  void submit(pos_t x, pos_t y, pos_t w, pos_t h) {
+    flush();
+    driver.start(x, y, w, h, buffs[back] + x, width);
+    in_flight = true;
+    back ^= 1;
+  }
+
+  // waits until everything submitted has reached the display
+  void flush() {
+    if (in_flight) {
+      driver.wait();
+      in_flight = false;
+    }
+  }
+
+  // Paints a frame of `gui`. Consecutive dirty rows are merged into bands
+  // covering the union of their spans, a full repaint is sent in bands of
+  // the whole width. The last band may still be in flight on return.
+  // `prm_TGui` is GUI, or a type with the same paint interface (e.g. a
+  // wrapper used by the host benchmarks).
+  template <typename prm_TGui>
+  result_t paint(prm_TGui &gui) {
+    FIXBROT_TRY(gui.paint_start());
+    pos_t band_y = 0, band_h = 0;
+    pos_t band_x0 = width, band_x1 = 0;
+    for (pos_t y = 0; y < gui.height; y++) {
+      pos_t x, w;
+      bool dirty = gui.get_dirty_span(y, &x, &w);
+      if (dirty) {
+        if (band_h == 0) band_y = y;
+        FIXBROT_TRY(gui.paint_line(y, get_band() + band_h * width));
+        band_h++;
+        if (x < band_x0) band_x0 = x;
+        if (x + w > band_x1) band_x1 = x + w;
+      }
+
+      bool last = (y == gui.height - 1);
+      if (band_h > 0 && (!dirty || band_h >= band_height || last)) {
+        submit(band_x0, band_y, band_x1 - band_x0, band_h);
+        band_h = 0;
+        band_x0 = width;
+        band_x1 = 0;
+      }
+    }
+    return gui.paint_end();
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+// #include "fixbrot/gui.hpp"
+
 // #include "fixbrot/mandelbrot.hpp"
 
 // #include "fixbrot/packed_bitmap.hpp"
 
+// #include "fixbrot/pixel_format.hpp"
+
+// #include "fixbrot/poster.hpp"
+
+#ifndef FIXBROT_POSTER_HPP
+#define FIXBROT_POSTER_HPP
+
+// #include "fixbrot/common.hpp"
+
+// #include "fixbrot/renderer.hpp"
+
+
+// maps its file with POSIX mmap(), so only on hosts
+#if !defined(FIXBROT_NO_STDLIB) && (defined(__unix__) || defined(__APPLE__))
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fixbrot {
+
+// Renders an image far larger than the screen, e.g. a gigapixel poster, to
+// a file of tiles mapped into memory, so that only the tiles being traced
+// and their neighbours need to be resident.
+//
+// Tiles are traced one at a time in row-major order by a Renderer of
+// TILE_SIZE + 2 pixels square, whose view covers the tile and a ring of one
+// pixel around it. The ring pixels of tiles finished before are taken from
+// the file instead of being computed, so the boundaries shared by tiles are
+// computed once and tracing crosses them as if the image were one view.
+//
+// Finished tiles are marked in the file. Opening it again for the same
+// view skips them, which resumes an interrupted render.
+//
+// The application drives get_tile_renderer() like a screen-sized one:
+// workers are initialized by on_render_start() with the scene of each tile
+// and dequeue its pixels, and service() takes the place of
+// Renderer::service().
+class PosterRenderer {
+ public:
+  static constexpr int32_t TILE_SIZE = 256;
+  static constexpr uint32_t TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+  static constexpr pos_t VIEW_SIZE = TILE_SIZE + 2;
+
+  static constexpr uint32_t FILE_MAGIC = 0x50425846;  // "FXBP"
+  static constexpr uint16_t FILE_VERSION = 1;
+  static constexpr size_t FILE_ALIGN = 4096;
+
+  const int32_t width;
+  const int32_t height;
+  const int32_t tiles_x;
+  const int32_t tiles_y;
+  const uint32_t num_tiles;
+
+ private:
+  // Start of the file in host byte order, followed by one state byte per
+  // tile, then TILE_PIXELS iteration counts per tile from FILE_ALIGN on.
+  // The pixels of a tile are in row-major order, including those past the
+  // right and bottom edges of the image.
+  struct header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t iter_max;
+    int32_t width;
+    int32_t height;
+    int32_t tile_size;
+    int32_t scale_exp;
+    int64_t real;
+    int64_t imag;
+    int64_t step;
+    uint16_t max_iter;
+    uint8_t formula;
+    uint8_t reserved;
+  };
+
+  Renderer view;
+
+  int fd = -1;
+  uint8_t *map = nullptr;
+  size_t map_bytes = 0;
+  uint8_t *tile_done = nullptr;
+  iter_t *tile_pixels = nullptr;
+
+  scene_t scene;
+  int scale_exp = 0;
+  int view_exp = 0;
+
+  uint32_t num_done = 0;
+  uint32_t next_tile = 0;
+  int64_t current_tile = -1;
+
+ public:
+  PosterRenderer(int32_t width, int32_t height)
+      : width(width),
+        height(height),
+        tiles_x((width + TILE_SIZE - 1) / TILE_SIZE),
+        tiles_y((height + TILE_SIZE - 1) / TILE_SIZE),
+        num_tiles((uint32_t)tiles_x * tiles_y),
+        view(VIEW_SIZE, VIEW_SIZE) {}
+
+  ~PosterRenderer() { close(); }
+
+  // bytes of the file for the image
+  FIXBROT_INLINE size_t get_file_bytes() const {
+    return get_pixels_offset() +
+           (size_t)num_tiles * TILE_PIXELS * sizeof(iter_t);
+  }
+
+  // Opens `path` to render the view centered at `real`, `imag`, where
+  // `exp` scales the image like Renderer::set_view() scales the screen.
+  // A file left by an unfinished render of the same view is resumed, any
+  // other file is overwritten.
+  result_t open(const char *path, formula_t formula, real_t real,
+                real_t imag, int exp, iter_t max_iter) {
+    close();
+
+    // the tile views cannot zoom out further than a screen
+    int image_clog2 = size_clog2(width > height ? width : height);
+    int view_clog2 = size_clog2(VIEW_SIZE);
+    if (exp + image_clog2 - view_clog2 < MIN_SCALE_EXP) {
+      exp = MIN_SCALE_EXP + view_clog2 - image_clog2;
+    }
+    scale_exp = exp;
+    view_exp = exp + image_clog2 - view_clog2;
+    scene.formula = formula;
+    scene.real = real;
+    scene.imag = imag;
+    scene.step = real_exp2(-exp - image_clog2);
+    scene.max_iter = clamp((iter_t)100, ITER_MAX, max_iter);
+
+    header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FILE_MAGIC;
+    hdr.version = FILE_VERSION;
+    hdr.iter_max = ITER_MAX;
+    hdr.width = width;
+    hdr.height = height;
+    hdr.tile_size = TILE_SIZE;
+    hdr.scale_exp = scale_exp;
+    hdr.real = scene.real.raw;
+    hdr.imag = scene.imag.raw;
+    hdr.step = scene.step.raw;
+    hdr.max_iter = scene.max_iter;
+    hdr.formula = (uint8_t)scene.formula;
+
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return result_t::ERROR_IO;
+
+    const size_t bytes = get_file_bytes();
+    struct stat st;
+    header_t old;
+    bool resume = fstat(fd, &st) == 0 && (size_t)st.st_size == bytes &&
+                  pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+                  memcmp(&old, &hdr, sizeof(hdr)) == 0;
+    if (!resume) {
+      // truncating first leaves every tile state zero, i.e. not done
+      if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)bytes) != 0 ||
+          pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        close();
+        return result_t::ERROR_IO;
+      }
+    }
+
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      close();
+      return result_t::ERROR_IO;
+    }
+    map = (uint8_t *)p;
+    map_bytes = bytes;
+    tile_done = map + sizeof(header_t);
+    tile_pixels = (iter_t *)(map + get_pixels_offset());
+
+    num_done = 0;
+    for (uint32_t i = 0; i < num_tiles; i++) {
+      if (tile_done[i]) num_done++;
+    }
+    next_tile = 0;
+    current_tile = -1;
+    return result_t::SUCCESS;
+  }
+
+  // Writes the finished tiles back and unmaps the file. The tile being
+  // traced is discarded and traced again when the render is resumed.
+  void close() {
+    if (map) {
+      msync(map, map_bytes, MS_SYNC);
+      munmap(map, map_bytes);
+    }
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    map = nullptr;
+    map_bytes = 0;
+    tile_done = nullptr;
+    tile_pixels = nullptr;
+    current_tile = -1;
+  }
+
+  FIXBROT_INLINE bool is_open() const { return map != nullptr; }
+
+  // true until every tile is finished and stored
+  FIXBROT_INLINE bool is_busy() const {
+    return map && (current_tile >= 0 || num_done < num_tiles);
+  }
+
+  FIXBROT_INLINE uint32_t get_num_done() const { return num_done; }
+  FIXBROT_INLINE int get_scale_exp() const { return scale_exp; }
+
+  // the renderer tracing the current tile, for the workers
+  FIXBROT_INLINE Renderer &get_tile_renderer() { return view; }
+
+  // image pixel of the tile being traced at (0, 0) of its renderer's view,
+  // i.e. one up and left of the tile itself
+  FIXBROT_INLINE int32_t get_tile_x() const {
+    return (int32_t)(current_tile % tiles_x) * TILE_SIZE - 1;
+  }
+  FIXBROT_INLINE int32_t get_tile_y() const {
+    return (int32_t)(current_tile / tiles_x) * TILE_SIZE - 1;
+  }
+
+  // Stores the tile once its view is finished and starts the next one,
+  // then services the tile renderer.
+  result_t service() {
+    if (!map) return result_t::SUCCESS;
+    if (!view.is_busy()) {
+      if (current_tile >= 0) store_tile();
+      if (num_done >= num_tiles) return result_t::SUCCESS;
+      FIXBROT_TRY(start_tile());
+    }
+    return view.service();
+  }
+
+  // ITER_BLANK outside the image or in a tile not finished yet
+  FIXBROT_INLINE iter_t get_iter(int32_t x, int32_t y) const {
+    if (!map || x < 0 || x >= width || y < 0 || y >= height) {
+      return ITER_BLANK;
+    }
+    uint32_t tile = (uint32_t)(y / TILE_SIZE) * tiles_x + x / TILE_SIZE;
+    if (!tile_done[tile]) return ITER_BLANK;
+    return tile_pixels[(size_t)tile * TILE_PIXELS +
+                       (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+  }
+
+  // copies pixels [x0, x0 + w) of row `y` to `dst`, see get_iter()
+  void read_row(int32_t y, int32_t x0, int32_t w, iter_t *dst) const {
+    for (int32_t x = x0; x < x0 + w; x++) {
+      *(dst++) = get_iter(x, y);
+    }
+  }
+
+ private:
+  static int size_clog2(int32_t size) {
+    int n = 0;
+    while (size > 0) {
+      n++;
+      size /= 2;
+    }
+    return n;
+  }
+
+  FIXBROT_INLINE size_t get_pixels_offset() const {
+    return (sizeof(header_t) + num_tiles + FILE_ALIGN - 1) &
+           ~(FILE_ALIGN - 1);
+  }
+
+  result_t start_tile() {
+    while (tile_done[next_tile]) next_tile++;
+    current_tile = next_tile++;
+
+    // center of the view relative to that of the image
+    const int32_t x0 = get_tile_x();
+    const int32_t y0 = get_tile_y();
+    real_t real =
+        scene.real + scene.step * (int)(x0 + VIEW_SIZE / 2 - width / 2);
+    real_t imag =
+        scene.imag + scene.step * (int)(y0 + VIEW_SIZE / 2 - height / 2);
+
+    return view.set_view_with_edges(
+        scene.formula, real, imag, view_exp, scene.max_iter,
+        [&](pos_t x, pos_t y) { return get_iter(x0 + x, y0 + y); });
+  }
+
+  void store_tile() {
+    iter_t *dst = tile_pixels + (size_t)current_tile * TILE_PIXELS;
+    for (pos_t y = 0; y < TILE_SIZE; y++) {
+      for (pos_t x = 0; x < TILE_SIZE; x++) {
+        *(dst++) = view.get_iter(x + 1, y + 1);
+      }
+    }
+    tile_done[current_tile] = 1;
+    num_done++;
+    current_tile = -1;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+
+#endif
+// #include "fixbrot/renderer.hpp"
+
+// #include "fixbrot/row_rle_buffer.hpp"
+
+#ifndef FIXBROT_ROW_RLE_BUFFER_HPP
+#define FIXBROT_ROW_RLE_BUFFER_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+// #include "fixbrot/common.hpp"
+
+
+// grows its rows on the heap
+#ifndef FIXBROT_NO_STDLIB
+
+namespace fixbrot {
+
+// Iteration counts stored as runs of equal values per row, for canvases too
+// large for a dense buffer. Border tracing leaves large areas of a single
+// count, so a finished row usually holds a few dozen runs instead of
+// `width` pixels.
+//
+// Each row remembers the run accessed last and searches from there, so
+// reading along a row or around a pixel (as painting and tracing do) costs
+// O(1) amortized. Writes split or merge runs in place.
+//
+// The renderer does not use it: a read costs several times a dense one,
+// and rows of fine detail, with runs of two or three pixels, take more
+// memory than dense. row_rle_bench in test/ measures both against the
+// dense layout.
+class RowRleBuffer {
+  // run counts and capacities of a row are at most `width`
+  static_assert(sizeof(pos_t) <= sizeof(uint16_t),
+                "row run counts must hold any width");
+
+ public:
+  // run of `iter` from `x` up to the start of the next run
+  struct run_t {
+    pos_t x;
+    iter_t iter;
+  };
+
+  const pos_t width;
+  const pos_t height;
+
+ private:
+  struct row_t {
+    run_t *runs;
+    uint16_t num_runs;
+    uint16_t capacity;
+    uint16_t cursor;
+  };
+
+  row_t *rows;
+
+ public:
+  RowRleBuffer(pos_t width, pos_t height)
+      : width(width), height(height), rows(new row_t[height]) {
+    for (pos_t y = 0; y < height; y++) {
+      rows[y].runs = nullptr;
+      rows[y].capacity = 0;
+    }
+    clear();
+  }
+
+  ~RowRleBuffer() {
+    for (pos_t y = 0; y < height; y++) {
+      delete[] rows[y].runs;
+    }
+    delete[] rows;
+  }
+
+  // makes every pixel ITER_BLANK
+  void clear() {
+    for (pos_t y = 0; y < height; y++) {
+      row_t &row = rows[y];
+      reserve(row, 1);
+      row.runs[0] = run_t{0, ITER_BLANK};
+      row.num_runs = 1;
+      row.cursor = 0;
+    }
+  }
+
+  // replaces row `y` with `width` pixels from `pixels`
+  void store_row(pos_t y, const iter_t *pixels) {
+    row_t &row = rows[y];
+    uint16_t n = 1;
+    for (pos_t x = 1; x < width; x++) {
+      if (pixels[x] != pixels[x - 1]) n++;
+    }
+    reserve(row, n);
+    row.runs[0] = run_t{0, pixels[0]};
+    n = 1;
+    for (pos_t x = 1; x < width; x++) {
+      if (pixels[x] != pixels[x - 1]) {
+        row.runs[n++] = run_t{x, pixels[x]};
+      }
+    }
+    row.num_runs = n;
+    row.cursor = 0;
+  }
+
+  // copies pixels [x0, x0 + w) of row `y` to `dst`
+  void read_row(pos_t y, pos_t x0, pos_t w, iter_t *dst) {
+    row_t &row = rows[y];
+    int i = find(row, x0);
+    pos_t x = x0;
+    const pos_t x1 = x0 + w;
+    while (x < x1) {
+      pos_t end = run_end(row, i);
+      if (end > x1) end = x1;
+      iter_t iter = row.runs[i].iter;
+      for (; x < end; x++) *(dst++) = iter;
+      i++;
+    }
+    row.cursor = (i > 0) ? (i - 1) : 0;
+  }
+
+  FIXBROT_INLINE iter_t read(pos_t x, pos_t y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return ITER_BLANK;
+    row_t &row = rows[y];
+    return row.runs[find(row, x)].iter;
+  }
+
+  void write(pos_t x, pos_t y, iter_t val) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    row_t &row = rows[y];
+    int i = find(row, x);
+    run_t *r = row.runs;
+    if (r[i].iter == val) return;
+
+    pos_t start = r[i].x;
+    pos_t end = run_end(row, i);
+    bool join_prev = (x == start) && (i > 0) && (r[i - 1].iter == val);
+    bool join_next =
+        (x == end - 1) && (i + 1 < row.num_runs) && (r[i + 1].iter == val);
+
+    if (start == end - 1) {
+      // the run is the pixel itself
+      if (join_prev && join_next) {
+        remove_runs(row, i, 2);
+        row.cursor = i - 1;
+      } else if (join_prev) {
+        remove_runs(row, i, 1);
+        row.cursor = i - 1;
+      } else if (join_next) {
+        remove_runs(row, i, 1);
+        row.runs[i].x = x;
+      } else {
+        r[i].iter = val;
+      }
+    } else if (x == start) {
+      if (join_prev) {
+        r[i].x = x + 1;
+        row.cursor = i - 1;
+      } else {
+        insert_runs(row, i, 1);
+        row.runs[i] = run_t{x, val};
+        row.runs[i + 1].x = x + 1;
+      }
+    } else if (x == end - 1) {
+      if (join_next) {
+        r[i + 1].x = x;
+        row.cursor = i + 1;
+      } else {
+        insert_runs(row, i + 1, 1);
+        row.runs[i + 1] = run_t{x, val};
+      }
+    } else {
+      // split the run around the pixel
+      insert_runs(row, i + 1, 2);
+      row.runs[i + 1] = run_t{x, val};
+      row.runs[i + 2] = run_t{(pos_t)(x + 1), row.runs[i].iter};
+      row.cursor = i + 1;
+    }
+  }
+
+  // total number of runs of all rows
+  uint32_t get_num_runs() const {
+    uint32_t n = 0;
+    for (pos_t y = 0; y < height; y++) n += rows[y].num_runs;
+    return n;
+  }
+
+  // bytes allocated for the rows and their runs
+  size_t get_memory_bytes() const {
+    size_t bytes = sizeof(row_t) * height;
+    for (pos_t y = 0; y < height; y++) {
+      bytes += sizeof(run_t) * rows[y].capacity;
+    }
+    return bytes;
+  }
+
+ private:
+  FIXBROT_INLINE pos_t run_end(const row_t &row, int i) const {
+    return (i + 1 < row.num_runs) ? row.runs[i + 1].x : width;
+  }
+
+  // index of the run containing `x`, searching outward from the cursor and
+  // falling back to bisection for distant pixels
+  FIXBROT_INLINE int find(row_t &row, pos_t x) {
+    int i = row.cursor;
+    const run_t *r = row.runs;
+    if (r[i].x <= x && x < run_end(row, i)) return i;
+    if (i + 1 < row.num_runs && r[i + 1].x <= x && x < run_end(row, i + 1)) {
+      row.cursor = i + 1;
+      return i + 1;
+    }
+    if (i > 0 && r[i - 1].x <= x && x < r[i].x) {
+      row.cursor = i - 1;
+      return i - 1;
+    }
+    int lo = 0, hi = row.num_runs - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (r[mid].x <= x) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    row.cursor = lo;
+    return lo;
+  }
+
+  void reserve(row_t &row, int n) {
+    if (n <= row.capacity) return;
+    int cap = row.capacity ? row.capacity : 4;
+    while (cap < n) cap *= 2;
+    if (cap > width) cap = width;
+    run_t *runs = new run_t[cap];
+    if (row.runs) {
+      memcpy(runs, row.runs, sizeof(run_t) * row.num_runs);
+      delete[] row.runs;
+    }
+    row.runs = runs;
+    row.capacity = cap;
+  }
+
+  void insert_runs(row_t &row, int i, int n) {
+    reserve(row, row.num_runs + n);
+    memmove(row.runs + i + n, row.runs + i,
+            sizeof(run_t) * (row.num_runs - i));
+    row.num_runs += n;
+  }
+
+  void remove_runs(row_t &row, int i, int n) {
+    memmove(row.runs + i, row.runs + i + n,
+            sizeof(run_t) * (row.num_runs - i - n));
+    row.num_runs -= n;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+
+#endif
+// #include "fixbrot/snapshot.hpp"
+
+// #include "fixbrot/tile_cache.hpp"
+
+// #include "fixbrot/trace.hpp"
+
+// #include "fixbrot/verifier.hpp"
+
+#ifndef FIXBROT_VERIFIER_HPP
+#define FIXBROT_VERIFIER_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
+
+// #include "fixbrot/common.hpp"
+
+// #include "fixbrot/mandelbrot.hpp"
+
 // #include "fixbrot/renderer.hpp"
 
+
+namespace fixbrot {
+
+struct verify_scene_t {
+  formula_t formula;
+  real_t real;
+  real_t imag;
+  int scale_exp;
+  iter_t max_iter;
+};
+
+// scenes known to stress the border tracer
+static const verify_scene_t VERIFY_SCENES[] = {
+    {formula_t::MANDELBROT, -0.5f, 0, -2, 200},
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 8, 1000},
+    // fixed32 / fixed64 boundary
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 16, 1000},
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 17, 1000},
+    {formula_t::BURNING_SHIP, -0.5f, 0, -2, 200},
+    {formula_t::BURNING_SHIP, -1.762f, -0.028f, 6, 500},
+    {formula_t::CELTIC, -0.5f, 0, -2, 200},
+    {formula_t::BUFFALO, -0.5f, 0, -2, 200},
+    {formula_t::PERP_BURNING_SHIP, -0.5f, 0, -2, 200},
+    {formula_t::AIRSHIP, -0.5f, 0, -2, 200},
+    {formula_t::SHARK_FIN, -0.5f, 0, -2, 200},
+    {formula_t::POWER_DRILL, -0.5f, 0, -2, 200},
+    {formula_t::CROWN, -0.5f, 0, -2, 200},
+    {formula_t::SUPER, -0.5f, 0, -2, 200},
+    {formula_t::CUBIC_MANDELBROT, 0, 0, -2, 200},
+    {formula_t::CUBIC_01344, 0, 0, -2, 200},
+    {formula_t::CUBIC_01417, 0, 0, -2, 200},
+    {formula_t::CUBIC_01479, 0, 0, -2, 200},
+    {formula_t::CUBIC_01856, 0, 0, -2, 200},
+    {formula_t::CUBIC_09601, 0, 0, -2, 200},
+    {formula_t::CUBIC_09743, 0, 0, -2, 200},
+    {formula_t::FEATHER, 0, 0, -2, 200},
+};
+static constexpr int NUM_VERIFY_SCENES =
+    sizeof(VERIFY_SCENES) / sizeof(VERIFY_SCENES[0]);
+
+struct mismatch_t {
+  vec_t loc;
+  iter_t expected;
+  iter_t actual;
+};
+
+struct verify_report_t {
+  static constexpr int MAX_LOCATIONS = 16;
+
+  uint32_t num_pixels;
+  uint32_t num_mismatches;
+  uint32_t num_unfinished;
+  rect_t bounds;
+  int num_locations;
+  mismatch_t locations[MAX_LOCATIONS];
+
+  // pass if mismatches are within `max_mismatches` and `max_ppm` of pixels
+  FIXBROT_INLINE bool passed(uint32_t max_mismatches = 0,
+                             uint32_t max_ppm = 0) const {
+    if (num_unfinished > 0) return false;
+    if (num_mismatches <= max_mismatches) return true;
+    return (uint64_t)num_mismatches * 1000000 <=
+           (uint64_t)num_pixels * max_ppm;
+  }
+};
+
+// Compares the iteration buffer of a finished render against an exhaustive
+// per-pixel Mandelbrot::compute sweep of the same scene.
+class Verifier {
+ public:
+  static result_t load_scene(Renderer &renderer, const verify_scene_t &vs) {
+    return renderer.set_view(vs.formula, vs.real, vs.imag, vs.scale_exp,
+                             vs.max_iter);
+  }
+
+  static result_t compare(const Renderer &renderer, verify_report_t *report) {
+    if (renderer.is_busy()) return result_t::ERROR_BUSY;
+
+    const scene_t s = renderer.get_worker_args();
+    pos_t x0 = renderer.width, y0 = renderer.height, x1 = -1, y1 = -1;
+
+    report->num_pixels = (uint32_t)renderer.width * renderer.height;
+    report->num_mismatches = 0;
+    report->num_unfinished = 0;
+    report->num_locations = 0;
+
+    for (pos_t y = 0; y < renderer.height; y++) {
+      for (pos_t x = 0; x < renderer.width; x++) {
+        iter_t expected = normalize(s, Mandelbrot::compute(s, vec_t{x, y}));
+        iter_t actual = renderer.get_iter(x, y);
+        if (actual == ITER_BLANK || actual > ITER_MAX) {
+          report->num_unfinished++;
+        } else {
+          actual = normalize(s, actual);
+        }
+        if (actual == expected) continue;
+
+        report->num_mismatches++;
+        if (report->num_locations < verify_report_t::MAX_LOCATIONS) {
+          report->locations[report->num_locations++] =
+              mismatch_t{vec_t{x, y}, expected, actual};
+        }
+        if (x < x0) x0 = x;
+        if (y < y0) y0 = y;
+        if (x > x1) x1 = x;
+        if (y > y1) y1 = y;
+      }
+    }
+
+    if (report->num_mismatches > 0) {
+      report->bounds = rect_t{x0, y0, (pos_t)(x1 - x0 + 1),
+                              (pos_t)(y1 - y0 + 1)};
+    } else {
+      report->bounds = rect_t{0, 0, 0, 0};
+    }
+    return result_t::SUCCESS;
+  }
+
+ private:
+  // the tracer stores ITER_MAX for points inside the set while post
+  // correction stores max_iter itself, both mean the same thing
+  static FIXBROT_INLINE iter_t normalize(const scene_t &s, iter_t iter) {
+    return (iter >= s.max_iter) ? ITER_MAX : iter;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
 // #include "fixbrot/worker.hpp"
 
+// #include "fixbrot/zoom_history.hpp"
+
 
 #endif
 
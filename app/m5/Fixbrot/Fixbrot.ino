@@ -1,22 +1,58 @@
 #include <M5Unified.h>
+
+#define FIXBROT_USE_CANVAS (0)
+
+// sprites and DMA transfers take pixels in the display byte order
+#define FIXBROT_BYTE_SWAP (1)
 #include "Fixbrot.h"
 
 static constexpr uint16_t NUM_WORKERS = 2;
+static constexpr uint64_t UPDATE_BUDGET_US = 16000;
+// cache sizes when PSRAM is available, large allocations go to PSRAM
+static constexpr uint32_t TILE_CACHE_BYTES = 2 * 1024 * 1024;
+static constexpr uint32_t ZOOM_HISTORY_BYTES = 1024 * 1024;
 
-#define FIXBROT_USE_CANVAS (0)
+namespace fb = fixbrot;
 
 #if FIXBROT_USE_CANVAS
 M5Canvas *canvas;
+#else
+static constexpr fb::pos_t BAND_HEIGHT = 16;
+
+// sends bands by DMA while the next band is painted
+struct DMADriver {
+  void start(fb::pos_t x, fb::pos_t y, fb::pos_t w, fb::pos_t h,
+             const uint16_t *pixels, int stride) {
+    M5.Display.startWrite();
+    if (w == stride) {
+      M5.Display.pushImageDMA(x, y, w, h, (const lgfx::swap565_t *)pixels);
+    } else {
+      for (fb::pos_t iy = 0; iy < h; iy++) {
+        M5.Display.pushImageDMA(x, y + iy, w, 1,
+                                (const lgfx::swap565_t *)pixels);
+        pixels += stride;
+      }
+    }
+  }
+  void wait() {
+    M5.Display.waitDMA();
+    M5.Display.endWrite();
+  }
+};
+
+DMADriver dma_driver;
+fb::DisplaySink<DMADriver> *sink;
 #endif
 
 int screen_w, screen_h;
 
-namespace fb = fixbrot;
+fb::Arena gui_arena;
 fb::GUI *gui;
+fb::TileCache *tile_cache;
+fb::ZoomHistory *zoom_history;
 fb::Worker workers[NUM_WORKERS];
 
 static int feed_index = 0;
-static uint16_t *line_buff;
 static uint64_t last_busy_time_ms = 0;
 static volatile bool busy = false;
 
@@ -24,6 +60,16 @@ static void worker1(void *arg);
 static void paint();
 static fb::result_t feed();
 
+// shows `msg` and stops
+static void halt(const char *msg) {
+  M5.Display.setTextColor(TFT_RED, TFT_BLACK);
+  M5.Display.setCursor(0, 0);
+  M5.Display.printf("Fixbrot: %s\n", msg);
+  while (true) {
+    delay(1000);
+  }
+}
+
 void setup() {
   auto cfg = M5.config();
   M5.begin(cfg);
@@ -34,12 +80,27 @@ void setup() {
 #if FIXBROT_USE_CANVAS
   canvas = new M5Canvas(&M5.Display);
   canvas->createSprite(screen_w, screen_h);
+#else
+  sink = new fb::DisplaySink<DMADriver>(dma_driver, screen_w, BAND_HEIGHT);
 #endif
 
-  line_buff = new uint16_t[screen_w];
-
-  gui = new fb::GUI(screen_w, screen_h);
-  gui->init();
+  // the screen size is known at run time only, so the buffers of the GUI
+  // are carved from a single block of the planned size
+  size_t arena_bytes = fb::GUI::get_arena_bytes(screen_w, screen_h);
+  gui_arena = fb::Arena(new uint8_t[arena_bytes], arena_bytes);
+  gui = new fb::GUI(screen_w, screen_h, gui_arena);
+  if (psramFound()) {
+    tile_cache = new fb::TileCache(TILE_CACHE_BYTES);
+    gui->renderer.set_tile_cache(tile_cache);
+    zoom_history = new fb::ZoomHistory(ZOOM_HISTORY_BYTES);
+    gui->renderer.set_zoom_history(zoom_history);
+  }
+  if (gui_arena.has_overflowed()) {
+    halt("arena too small");
+  }
+  if (gui->init() != fb::result_t::SUCCESS) {
+    halt("init failed");
+  }
 
   xTaskCreatePinnedToCore(worker1, "Worker1", 8192, NULL, 3, NULL, PRO_CPU_NUM);
 }
@@ -57,12 +118,18 @@ void loop() {
     touches[it].y = tp[it].y;
   }
   gui->touch_update_raw(num_touches, touches);
-  gui->service();
-  feed();
 
-  workers[0].service();
+  uint64_t deadline_us = fb::get_time_us() + UPDATE_BUDGET_US;
+  do {
+    gui->service(deadline_us);
+    feed();
+    workers[0].service(deadline_us);
+  } while (gui->renderer.is_busy() && !gui->renderer.is_repaint_requested() &&
+           fb::get_time_us() < deadline_us);
+
   paint();
-  if (gui->is_busy() || num_touches > 0) {
+  // keep both cores running while tiles around the view are prefetched
+  if (gui->is_busy() || gui->renderer.is_prefetching() || num_touches > 0) {
     last_busy_time_ms = now_ms;
     busy = true;
   } else {
@@ -94,31 +161,18 @@ static void paint() {
     return;
   }
 
-  gui->paint_start();
-#if FIXBROT_USE_CANVAS
-  uint16_t *wptr = (uint16_t *)(canvas->getBuffer());
-#endif
-  for (fb::pos_t y = 0; y < screen_h; y++) {
-    gui->paint_line(y, line_buff);
 #if FIXBROT_USE_CANVAS
-    for (fb::pos_t x = 0; x < screen_w; x++) {
-      uint16_t tmp = line_buff[x];
-      tmp = ((tmp << 8) & 0xFF00) | ((tmp >> 8) & 0xFF);
-      line_buff[x] = tmp;
-    }
-    memcpy(wptr, line_buff, sizeof(uint16_t) * screen_w);
-    wptr += screen_w;
-#else
-    M5.Display.drawBitmap(0, y, screen_w, 1, line_buff);
-#endif
-  }
+  gui->paint_start();
+  gui->paint_dirty((uint16_t *)(canvas->getBuffer()), screen_w);
   gui->paint_end();
-#if FIXBROT_USE_CANVAS
   canvas->pushSprite(0, 0);
+#else
+  sink->paint(*gui);
 #endif
 }
 
 static fb::result_t feed() {
+  FIXBROT_TRACE_SCOPE(fb::trace_event_t::FEED);
   bool stall = false;
   int n = gui->renderer.num_queued();
   while (n-- > 0 && !stall) {
@@ -141,6 +195,16 @@ uint64_t fb::get_time_ms() {
   return millis();
 }
 
+uint64_t fb::get_time_us() {
+  return esp_timer_get_time();
+}
+
+#if FIXBROT_TRACE
+int fb::get_core_id() {
+  return xPortGetCoreID();
+}
+#endif
+
 void fb::on_render_start(const fb::scene_t &scene) {
   for (int i = 0; i < NUM_WORKERS; i++) {
     workers[i].init(scene);
@@ -149,6 +213,12 @@ void fb::on_render_start(const fb::scene_t &scene) {
 
 void fb::on_render_finished(fb::result_t res) {}
 
+void fb::on_prefetch_start(const fb::scene_t &scene) {
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    workers[i].init(scene);
+  }
+}
+
 bool fb::on_collect(fb::cell_t *resp) {
   if (workers[0].num_processed() > workers[1].num_processed()) {
     return workers[0].collect(resp);
@@ -5,19 +5,48 @@
 namespace fb = fixbrot;
 
 static constexpr uint16_t NUM_WORKERS = 2;
+static constexpr uint64_t UPDATE_BUDGET_US = 16000;
 
 static int feed_index = 0;
-static uint16_t line_buff[WIDTH];
+static constexpr fb::pos_t BAND_HEIGHT = 8;
 
 static uint64_t last_busy_time_ms = 0;
 static volatile bool busy = false;
 
 static void core1_main();
+static void halt();
 static void paint();
 static fb::result_t feed();
 
+// DispSendImg2() is blocking, so each band is sent as soon as it is
+// submitted
+struct DispDriver {
+  void start(fb::pos_t x, fb::pos_t y, fb::pos_t w, fb::pos_t h,
+             const uint16_t *pixels, int stride) {
+    DispStartImg(x, x + w, y, y + h);
+    for (fb::pos_t iy = 0; iy < h; iy++) {
+      for (fb::pos_t ix = 0; ix < w; ix++) {
+        DispSendImg2(pixels[ix]);
+      }
+      pixels += stride;
+    }
+    DispStopImg();
+  }
+  void wait() {}
+};
+
+// every buffer of the GUI and the display sink, sized at compile time since
+// FIXBROT_NO_STDLIB leaves the library without heap allocation
+alignas(fb::Arena::ALIGN) static uint8_t
+    arena_buff[fb::GUI::get_arena_bytes(WIDTH, HEIGHT) +
+               fb::DisplaySink<DispDriver>::get_arena_bytes(WIDTH,
+                                                            BAND_HEIGHT)];
+static fb::Arena arena(arena_buff, sizeof(arena_buff));
+
 fb::Worker workers[NUM_WORKERS];
-fb::GUI gui(WIDTH, HEIGHT);
+fb::GUI gui(WIDTH, HEIGHT, arena);
+DispDriver disp_driver;
+fb::DisplaySink<DispDriver> sink(disp_driver, WIDTH, BAND_HEIGHT, arena);
 
 int main() {
 #if USE_PICOPAD10 || USE_PICOPAD20
@@ -26,7 +55,10 @@ int main() {
   set_sys_clock_khz(250000, true);
 #endif
 
-  gui.init();
+  // the arena is sized by the same plan, so this only fails if it is wrong
+  if (arena.has_overflowed() || gui.init() != fb::result_t::SUCCESS) {
+    halt();
+  }
 
   Core1Exec(core1_main);
 
@@ -48,9 +80,14 @@ int main() {
     }
 
     gui.button_update(key_pressed);
-    gui.service();
-    feed();
-    workers[0].service();
+
+    uint64_t deadline_us = fb::get_time_us() + UPDATE_BUDGET_US;
+    do {
+      gui.service(deadline_us);
+      feed();
+      workers[0].service(deadline_us);
+    } while (gui.renderer.is_busy() && !gui.renderer.is_repaint_requested() &&
+             fb::get_time_us() < deadline_us);
 
     paint();
 
@@ -76,24 +113,31 @@ static void core1_main() {
   }
 }
 
+// fills the screen red and waits for Y to return to the boot loader
+static void halt() {
+  DispStartImg(0, WIDTH, 0, HEIGHT);
+  for (int i = 0; i < WIDTH * HEIGHT; i++) {
+    DispSendImg2(0xF800);
+  }
+  DispStopImg();
+  while (True) {
+    if (KeyPressedFast(KEY_Y)) {
+      ResetToBootLoader();
+    }
+    WaitMs(20);
+  }
+}
+
 static void paint() {
   if (!gui.is_paint_requested()) {
     return;
   }
 
-  gui.paint_start();
-  DispStartImg(0, WIDTH, 0, HEIGHT);
-  for (fb::pos_t y = 0; y < HEIGHT; y++) {
-    gui.paint_line(y, line_buff);
-    for (fb::pos_t x = 0; x < WIDTH; x++) {
-      DispSendImg2(line_buff[x]);
-    }
-  }
-  DispStopImg();
-  gui.paint_end();
+  sink.paint(gui);
 }
 
 static fb::result_t feed() {
+  FIXBROT_TRACE_SCOPE(fb::trace_event_t::FEED);
   bool stall = false;
   int n = gui.renderer.num_queued();
   while (n-- > 0 && !stall) {
@@ -113,6 +157,11 @@ static fb::result_t feed() {
 }
 
 uint64_t fb::get_time_ms() { return Time64() / 1000; }
+uint64_t fb::get_time_us() { return Time64(); }
+
+#if FIXBROT_TRACE
+int fb::get_core_id() { return CpuID(); }
+#endif
 
 void fb::on_render_start(const fb::scene_t &scene) {
   LedOn(LED1);
@@ -123,6 +172,12 @@ void fb::on_render_start(const fb::scene_t &scene) {
 
 void fb::on_render_finished(fb::result_t res) { LedOff(LED1); }
 
+void fb::on_prefetch_start(const fb::scene_t &scene) {
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    workers[i].init(scene);
+  }
+}
+
 bool fb::on_collect(fb::cell_t *resp) {
   if (workers[0].num_processed() > workers[1].num_processed()) {
     return workers[0].collect(resp);
@@ -9,6 +9,11 @@ namespace fb = fixbrot;
 static constexpr uint16_t NUM_WORKERS = 2;
 static constexpr fb::pos_t WIDTH = 240;
 static constexpr fb::pos_t HEIGHT = 240;
+static constexpr uint64_t UPDATE_BUDGET_US = 12000;
+// core1 checks for paint requests between worker slices
+static constexpr uint64_t CORE1_SLICE_US = 2000;
+// core1 paints the rows below this during full repaints
+static constexpr fb::pos_t PAINT_SPLIT_Y = HEIGHT / 2;
 
 static int feed_index = 0;
 
@@ -18,11 +23,23 @@ static volatile bool busy = false;
 static void core1_main();
 static fb::result_t feed();
 
+// every buffer of the GUI, sized at compile time
+alignas(fb::Arena::ALIGN) static uint8_t
+    arena_buff[fb::GUI::get_arena_bytes(WIDTH, HEIGHT)];
+static fb::Arena arena(arena_buff, sizeof(arena_buff));
+
 fb::Worker workers[NUM_WORKERS];
-fb::GUI gui(WIDTH, HEIGHT);
+fb::GUI gui(WIDTH, HEIGHT, arena);
 
 void init() {
-  gui.init();
+  // the arena is sized by the same plan, so these only fail if it is wrong
+  if (arena.has_overflowed()) {
+    panic("fixbrot: arena of %u bytes too small", (unsigned)sizeof(arena_buff));
+  }
+  fb::result_t res = gui.init();
+  if (res != fb::result_t::SUCCESS) {
+    panic("fixbrot: init failed (%d)", (int)res);
+  }
   multicore_launch_core1(core1_main);
 }
 
@@ -41,13 +58,13 @@ void update(uint32_t tick) {
 
   gui.button_update(key_pressed);
 
-  for (int i = 0; i < 256; i++) {
-    gui.service();
+  uint64_t deadline_us = fb::get_time_us() + UPDATE_BUDGET_US;
+  do {
+    gui.service(deadline_us);
     feed();
-    if (workers[0].num_queued() == 0) break;
-    workers[0].service();
-    if (gui.renderer.is_repaint_requested()) break;
-  }
+    workers[0].service(deadline_us);
+  } while (gui.renderer.is_busy() && !gui.renderer.is_repaint_requested() &&
+           fb::get_time_us() < deadline_us);
 
   if (gui.is_busy() || key_pressed != fb::button_t::NONE) {
     last_busy_time_ms = now_ms;
@@ -69,23 +86,41 @@ void draw(uint32_t tick) {
   uint16_t *wr_ptr = ps::SCREEN->data;
 
   gui.paint_start();
-  for (fb::pos_t y = 0; y < HEIGHT; y++) {
-    gui.paint_line(y, wr_ptr);
-    wr_ptr += WIDTH;
+  if (gui.is_full_paint()) {
+    // split the frame with core1 and join before the screen is flipped
+    multicore_fifo_push_blocking(PAINT_SPLIT_Y);
+    gui.paint_band(0, PAINT_SPLIT_Y, wr_ptr, WIDTH);
+    multicore_fifo_pop_blocking();
+  } else {
+    gui.paint_dirty(wr_ptr, WIDTH);
   }
   gui.paint_end();
 }
 
 static void core1_main() {
   while (true) {
-    workers[1].service();
-    if (!busy) {
-      sleep_ms(20);
+    workers[1].service(fb::get_time_us() + CORE1_SLICE_US);
+
+    // paint request from core0 carries the first row of the band
+    uint32_t y0;
+    bool paint_req;
+    if (busy) {
+      paint_req = multicore_fifo_rvalid();
+      if (paint_req) {
+        y0 = multicore_fifo_pop_blocking();
+      }
+    } else {
+      paint_req = multicore_fifo_pop_timeout_us(20000, &y0);
+    }
+    if (paint_req) {
+      gui.paint_band(y0, HEIGHT - y0, ps::SCREEN->data + y0 * WIDTH, WIDTH);
+      multicore_fifo_push_blocking(y0);
     }
   }
 }
 
 static fb::result_t feed() {
+  FIXBROT_TRACE_SCOPE(fb::trace_event_t::FEED);
   bool stall = false;
   int n = gui.renderer.num_queued();
   while (n-- > 0 && !stall) {
@@ -105,6 +140,11 @@ static fb::result_t feed() {
 }
 
 uint64_t fb::get_time_ms() { return ps::time(); }
+uint64_t fb::get_time_us() { return time_us_64(); }
+
+#if FIXBROT_TRACE
+int fb::get_core_id() { return get_core_num(); }
+#endif
 
 void fb::on_render_start(const fb::scene_t &scene) {
   for (int i = 0; i < NUM_WORKERS; i++) {
@@ -114,6 +154,12 @@ void fb::on_render_start(const fb::scene_t &scene) {
 
 void fb::on_render_finished(fb::result_t res) {}
 
+void fb::on_prefetch_start(const fb::scene_t &scene) {
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    workers[i].init(scene);
+  }
+}
+
 bool fb::on_collect(fb::cell_t *resp) {
   if (workers[0].num_processed() > workers[1].num_processed()) {
     return workers[0].collect(resp);
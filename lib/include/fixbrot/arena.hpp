@@ -0,0 +1,64 @@
+#ifndef FIXBROT_ARENA_HPP
+#define FIXBROT_ARENA_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+// Bump allocator that carves buffers out of one block supplied by the
+// application, e.g. static storage sized by the get_arena_bytes() of the
+// objects constructed from it. Nothing is ever freed; the block must
+// outlive those objects and be aligned to ALIGN.
+//
+// A default-constructed arena has no block and only adds up the bytes
+// requested, which is how the get_arena_bytes() plans are computed from the
+// same sequence of alloc() calls that constructs the object.
+class Arena {
+ public:
+  static constexpr size_t ALIGN = 8;
+
+  static FIXBROT_INLINE constexpr size_t align_up(size_t bytes) {
+    return (bytes + ALIGN - 1) & ~(ALIGN - 1);
+  }
+
+ private:
+  uint8_t *base = nullptr;
+  size_t capacity = 0;
+  size_t used = 0;
+  bool overflowed = false;
+
+ public:
+  constexpr Arena() {}
+  Arena(void *base, size_t capacity)
+      : base((uint8_t *)base), capacity(capacity) {}
+
+  // Buffer of `n` elements, aligned to ALIGN. nullptr when counting, or if
+  // the block is exhausted, after which every later alloc() fails as well.
+  template <typename T>
+  constexpr T *alloc(size_t n) {
+    size_t offset = align_up(used);
+    used = offset + sizeof(T) * n;
+    if (!base) return nullptr;
+    if (used > capacity) {
+      overflowed = true;
+      return nullptr;
+    }
+    return reinterpret_cast<T *>(base + offset);
+  }
+
+  // bytes taken so far, including padding up to the next buffer
+  FIXBROT_INLINE constexpr size_t get_used() const { return align_up(used); }
+  FIXBROT_INLINE size_t get_capacity() const { return capacity; }
+
+  // true if an alloc() did not fit, meaning the block is smaller than planned
+  FIXBROT_INLINE bool has_overflowed() const { return overflowed; }
+};
+
+}  // namespace fixbrot
+
+#endif
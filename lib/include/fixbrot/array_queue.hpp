@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #endif
 
+#include "fixbrot/arena.hpp"
 #include "fixbrot/common.hpp"
 
 namespace fixbrot {
@@ -22,9 +23,28 @@ class ArrayQueue {
 
   TData *array;
 
-  ArrayQueue(index_t depth) : depth(depth) { array = new TData[depth]; }
+ private:
+  bool owns_array = false;
 
-  ~ArrayQueue() { delete[] array; }
+ public:
+  // `array` of `depth` entries is supplied by the caller
+  ArrayQueue(index_t depth, TData *array) : depth(depth), array(array) {}
+
+  ArrayQueue(index_t depth, Arena &arena)
+      : depth(depth), array(arena.alloc<TData>(depth)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  ArrayQueue(index_t depth)
+      : depth(depth), array(new TData[depth]), owns_array(true) {}
+
+  ~ArrayQueue() {
+    if (owns_array) delete[] array;
+  }
+#endif
+
+  static constexpr size_t get_arena_bytes(index_t depth) {
+    return Arena::align_up(sizeof(TData) * depth);
+  }
 
   FIXBROT_INLINE index_t size() const {
     index_t rp = rd_ptr;
@@ -9,6 +9,11 @@
 #define FIXBROT_ARGB4444_BSWAP (0)
 #endif
 
+// byte order of pixels handed to the application differs from col_t
+#ifndef FIXBROT_BYTE_SWAP
+#define FIXBROT_BYTE_SWAP (0)
+#endif
+
 #ifndef FIXBROT_NO_STDLIB
 #include <stdint.h>
 #endif
@@ -23,6 +28,9 @@ enum class result_t : uint16_t {
   ERROR_QUEUE_OVERFLOW,
   ERROR_BUSY,
   ERROR_TOO_MANY_TOUCHES,
+  ERROR_IO,
+  ERROR_BAD_SNAPSHOT,
+  ERROR_OUT_OF_MEMORY,
 };
 
 #define FIXBROT_TRY(expr)                    \
@@ -43,6 +51,20 @@ static FIXBROT_INLINE real_t real_exp2(int exp) {
   return fixed64_t::from_raw((int64_t)1 << (fixed64_t::FRAC_BITS + exp));
 }
 
+// index of the lowest set bit of `x`, which must not be zero
+static FIXBROT_INLINE int count_trailing_zeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(x);
+#else
+  int n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
 struct vec_t {
   pos_t x;
   pos_t y;
@@ -181,6 +203,23 @@ static FIXBROT_INLINE constexpr col_t color_div2(col_t c) {
 #endif
 }
 
+static FIXBROT_INLINE constexpr col_t color_bswap(col_t c) {
+  return ((c >> 8) & 0x00FF) | ((c << 8) & 0xFF00);
+}
+
+// converts a color to the byte order of the display, see FIXBROT_BYTE_SWAP
+static FIXBROT_INLINE constexpr col_t color_to_display(col_t c) {
+#if FIXBROT_BYTE_SWAP
+  return color_bswap(c);
+#else
+  return c;
+#endif
+}
+
+static FIXBROT_INLINE constexpr col_t color_from_display(col_t c) {
+  return color_to_display(c);
+}
+
 template <typename T>
 static FIXBROT_INLINE T clamp(T min, T max, T val) {
   if (val < min) return min;
@@ -197,6 +236,10 @@ static constexpr int DEFAULT_PALETTE_SLOPE = 2;
 
 static constexpr int MIN_SCALE_EXP = -3;
 
+// supplied by the application, used for time budgets
+uint64_t get_time_us();
+static constexpr uint64_t NO_DEADLINE = ~(uint64_t)0;
+
 }  // namespace fixbrot
 
 #endif
@@ -0,0 +1,125 @@
+#ifndef FIXBROT_DISPLAY_SINK_HPP
+#define FIXBROT_DISPLAY_SINK_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
+
+#include "fixbrot/arena.hpp"
+#include "fixbrot/common.hpp"
+#include "fixbrot/gui.hpp"
+
+namespace fixbrot {
+
+// Double-buffered band output to a display. While the driver is still
+// sending one band (e.g. by DMA), the GUI paints the next one into the
+// other buffer. `prm_TDriver` provides:
+//
+//   // starts sending a rectangle, rows of `pixels` are `stride` apart
+//   void start(pos_t x, pos_t y, pos_t w, pos_t h, const col_t *pixels,
+//              int stride);
+//   // blocks until the transfer started last has completed
+//   void wait();
+template <typename prm_TDriver>
+class DisplaySink {
+ public:
+  prm_TDriver &driver;
+  const pos_t width;
+  const pos_t band_height;
+
+ private:
+  col_t *buffs[2];
+  bool owns_buffs = false;
+  int back = 0;
+  bool in_flight = false;
+
+ public:
+  DisplaySink(prm_TDriver &driver, pos_t width, pos_t band_height,
+              Arena &arena)
+      : driver(driver), width(width), band_height(band_height) {
+    buffs[0] = arena.alloc<col_t>(width * band_height);
+    buffs[1] = arena.alloc<col_t>(width * band_height);
+  }
+
+#ifndef FIXBROT_NO_STDLIB
+  DisplaySink(prm_TDriver &driver, pos_t width, pos_t band_height)
+      : driver(driver),
+        width(width),
+        band_height(band_height),
+        owns_buffs(true) {
+    buffs[0] = new col_t[width * band_height];
+    buffs[1] = new col_t[width * band_height];
+  }
+#endif
+
+  ~DisplaySink() {
+    flush();
+#ifndef FIXBROT_NO_STDLIB
+    if (owns_buffs) {
+      delete[] buffs[0];
+      delete[] buffs[1];
+    }
+#endif
+  }
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t band_height) {
+    return Arena::align_up(sizeof(col_t) * width * band_height) * 2;
+  }
+
+  // buffer to be filled next, `band_height` rows of `width` pixels
+  FIXBROT_INLINE col_t *get_band() const { return buffs[back]; }
+
+  // sends rows [0, h) of the band to the rectangle at (x, y), then swaps
+  // buffers
+  void submit(pos_t x, pos_t y, pos_t w, pos_t h) {
+    flush();
+    driver.start(x, y, w, h, buffs[back] + x, width);
+    in_flight = true;
+    back ^= 1;
+  }
+
+  // waits until everything submitted has reached the display
+  void flush() {
+    if (in_flight) {
+      driver.wait();
+      in_flight = false;
+    }
+  }
+
+  // Paints a frame of `gui`. Consecutive dirty rows are merged into bands
+  // covering the union of their spans, a full repaint is sent in bands of
+  // the whole width. The last band may still be in flight on return.
+  // `prm_TGui` is GUI, or a type with the same paint interface (e.g. a
+  // wrapper used by the host benchmarks).
+  template <typename prm_TGui>
+  result_t paint(prm_TGui &gui) {
+    FIXBROT_TRY(gui.paint_start());
+    pos_t band_y = 0, band_h = 0;
+    pos_t band_x0 = width, band_x1 = 0;
+    for (pos_t y = 0; y < gui.height; y++) {
+      pos_t x, w;
+      bool dirty = gui.get_dirty_span(y, &x, &w);
+      if (dirty) {
+        if (band_h == 0) band_y = y;
+        FIXBROT_TRY(gui.paint_line(y, get_band() + band_h * width));
+        band_h++;
+        if (x < band_x0) band_x0 = x;
+        if (x + w > band_x1) band_x1 = x + w;
+      }
+
+      bool last = (y == gui.height - 1);
+      if (band_h > 0 && (!dirty || band_h >= band_height || last)) {
+        submit(band_x0, band_y, band_x1 - band_x0, band_h);
+        band_h = 0;
+        band_x0 = width;
+        band_x1 = 0;
+      }
+    }
+    return gui.paint_end();
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
@@ -1,12 +1,22 @@
 #ifndef FIXBROT_HPP
 #define FIXBROT_HPP
 
+#include "fixbrot/arena.hpp"
 #include "fixbrot/array_queue.hpp"
 #include "fixbrot/common.hpp"
+#include "fixbrot/display_sink.hpp"
 #include "fixbrot/gui.hpp"
 #include "fixbrot/mandelbrot.hpp"
 #include "fixbrot/packed_bitmap.hpp"
+#include "fixbrot/pixel_format.hpp"
+#include "fixbrot/poster.hpp"
 #include "fixbrot/renderer.hpp"
+#include "fixbrot/row_rle_buffer.hpp"
+#include "fixbrot/snapshot.hpp"
+#include "fixbrot/tile_cache.hpp"
+#include "fixbrot/trace.hpp"
+#include "fixbrot/verifier.hpp"
 #include "fixbrot/worker.hpp"
+#include "fixbrot/zoom_history.hpp"
 
 #endif
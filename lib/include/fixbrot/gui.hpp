@@ -7,9 +7,11 @@
 #include <string.h>
 #endif
 
+#include "fixbrot/arena.hpp"
 #include "fixbrot/common.hpp"
 #include "fixbrot/packed_bitmap.hpp"
 #include "fixbrot/renderer.hpp"
+#include "fixbrot/trace.hpp"
 #include "fixbrot/worker.hpp"
 
 #define SHAPOFONT_INCLUDE_GFXFONT
@@ -94,6 +96,7 @@ enum class menu_key_t {
   LAST,
   CAPTION,
   BLANK,
+  STATS,
 };
 
 struct menu_item_t {
@@ -105,11 +108,19 @@ struct menu_item_t {
   pos_t y_center;
 };
 
+// state of a menu item last drawn to the menu bitmap of a GUI
+struct menu_item_drawn_t {
+  bool valid;
+  bool active;
+  char text[32];
+};
+
+// in display byte order
 static const col_t MENU_PALETTE[4] = {
-    color_pack_from_888(0x16, 0x16, 0x16),
-    color_pack_from_888(0x00, 0x80, 0xFF),
-    color_pack_from_888(0xC0, 0xC0, 0xC0),
-    color_pack_from_888(0xFF, 0xFF, 0xFF),
+    color_to_display(color_pack_from_888(0x16, 0x16, 0x16)),
+    color_to_display(color_pack_from_888(0x00, 0x80, 0xFF)),
+    color_to_display(color_pack_from_888(0xC0, 0xC0, 0xC0)),
+    color_to_display(color_pack_from_888(0xFF, 0xFF, 0xFF)),
 };
 static constexpr uint8_t MENU_BACK = 0;
 static constexpr uint8_t MENU_ACTIVE = 1;
@@ -128,7 +139,7 @@ menu_item_t menu_items[] = {
     {menu_key_t::SCENE_ZOOM, 40, 1, "Zoom"},
     {menu_key_t::SCENE_ITER, 40, 1, "Iter"},
     {menu_key_t::SCENE_VFLIP, 40, 1, "VFlip"},
-    {menu_key_t::BLANK, 0, 1, ""},
+    {menu_key_t::STATS, 40, 1, "Stat"},
     {menu_key_t::CAPTION, 0, 1, "PALETTE"},
     {menu_key_t::PALETTE_TYPE, 50, 1, "Type"},
     {menu_key_t::PALETTE_SLOPE, 50, 1, "Slope"},
@@ -136,6 +147,13 @@ menu_item_t menu_items[] = {
 };
 const int NUM_MENU_ITEMS = sizeof(menu_items) / sizeof(menu_items[0]);
 
+struct paint_stats_t {
+  uint32_t frames;
+  uint32_t full_frames;
+  uint64_t pixels_sent;
+  uint64_t pixels_skipped;
+};
+
 static constexpr int MENU_WIDTH = 160;
 static constexpr int KEYPAD_HEIGHT = 64;
 
@@ -147,6 +165,7 @@ class GUI {
   Renderer renderer;
 
   Gray2Bitmap menu_bmp;
+  Gray2Bitmap::expansion_t menu_expansion;
 
   builtin_palette_t palette = builtin_palette_t::HEATMAP;
   int palette_slope = DEFAULT_PALETTE_SLOPE;
@@ -172,30 +191,93 @@ class GUI {
   vec_t touch_drag_last_pos = {0, 0};
 
   bool paint_requested = false;
+  bool paint_full = true;
+  paint_stats_t paint_stats = {};
   bool menu_open = false;
   menu_key_t menu_cursor = (menu_key_t)0;
   int menu_pos = 0;
+  int painted_menu_pos = 0;
+  bool menu_bmp_valid = false;
+  // rows of the menu bitmap redrawn since the last paint, empty if y1 <= y0
+  pos_t menu_damage_y0 = 0;
+  pos_t menu_damage_y1 = 0;
+  menu_item_drawn_t menu_drawn[NUM_MENU_ITEMS] = {};
 
   static constexpr int SHADOW_SIZE = 16;
-  int shadow_alpha[SHADOW_SIZE];
+  // darkened value of each color channel value, per shadow column
+  uint8_t shadow_lut[SHADOW_SIZE][64];
 
-  GUI(pos_t width, pos_t height)
+  // Carves all buffers from `arena`, which needs get_arena_bytes() bytes
+  // left. `queue_depth` is that of the renderer's trace queue, 0 selects
+  // the default.
+  GUI(pos_t width, pos_t height, Arena &arena, uint32_t queue_depth = 0)
       : width(width),
         height(height),
-        renderer(width, height),
+        renderer(width, height, arena, queue_depth),
+        menu_bmp(MENU_WIDTH, height, arena) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  GUI(pos_t width, pos_t height, uint32_t queue_depth = 0)
+      : width(width),
+        height(height),
+        renderer(width, height, queue_depth),
         menu_bmp(MENU_WIDTH, height) {}
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height,
+                                          uint32_t queue_depth = 0) {
+    return Renderer::get_arena_bytes(width, height, queue_depth) +
+           Gray2Bitmap::get_arena_bytes(MENU_WIDTH, height);
+  }
+
+  // false if the arena given to the constructor was too small, see
+  // Renderer::has_buffers()
+  FIXBROT_INLINE bool has_buffers() const {
+    return renderer.has_buffers() && menu_bmp.has_buffer();
+  }
 
   result_t init() {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
     FIXBROT_TRY(renderer.init());
+    init_ui();
+    return result_t::SUCCESS;
+  }
+
+  // same as init(), but starts with the view of a snapshot, see
+  // Renderer::init_from_snapshot()
+  template <typename TStream>
+  result_t init_from_snapshot(TStream &stream) {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_ui();
+    return renderer.init_from_snapshot(stream, &palette, &palette_slope);
+  }
+
+  // see Renderer::save_snapshot()
+  template <typename TStream>
+  result_t save_snapshot(TStream &stream) const {
+    return renderer.save_snapshot(stream, palette, palette_slope);
+  }
+
+  // see Renderer::load_snapshot()
+  template <typename TStream>
+  result_t load_snapshot(TStream &stream) {
+    return renderer.load_snapshot(stream, &palette, &palette_slope);
+  }
+
+  void init_ui() {
+    Gray2Bitmap::build_expansion(MENU_PALETTE, &menu_expansion);
     for (int i = 0; i < SHADOW_SIZE; i++) {
-      shadow_alpha[i] = 256 - (SHADOW_SIZE - i) * (SHADOW_SIZE - i) * 256 /
-                                  (SHADOW_SIZE * SHADOW_SIZE);
+      int alpha = 256 - (SHADOW_SIZE - i) * (SHADOW_SIZE - i) * 256 /
+                            (SHADOW_SIZE * SHADOW_SIZE);
+      for (int v = 0; v < 64; v++) {
+        shadow_lut[i][v] = (v * alpha) >> 8;
+      }
     }
     for (int i = 0; i < NUM_MAX_TOUCHES; i++) {
       touches[i].pressed = false;
     }
     touch_drag_thresh = (width * height) / 256;
-    return result_t::SUCCESS;
   }
 
   bool is_busy() const { return renderer.is_busy() || paint_requested; }
@@ -517,6 +599,21 @@ class GUI {
   }
 
   result_t service() {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_SERVICE);
+    FIXBROT_TRY(service_input());
+    FIXBROT_TRY(renderer.service());
+    return result_t::SUCCESS;
+  }
+
+  // renders until `deadline_us` (in get_time_us() time)
+  result_t service(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_SERVICE);
+    FIXBROT_TRY(service_input());
+    FIXBROT_TRY(renderer.service(deadline_us));
+    return result_t::SUCCESS;
+  }
+
+  result_t service_input() {
     uint64_t now_ms = get_time_ms();
     if (touch_state == touch_state_t::TAP_RELEASE) {
       uint64_t elapsed_ms = now_ms - touch_last_event_time_ms;
@@ -529,12 +626,12 @@ class GUI {
         touch_state = touch_state_t::IDLE;
       }
     }
-
-    FIXBROT_TRY(renderer.service());
     return result_t::SUCCESS;
   }
 
   result_t paint_start() {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_PAINT_START);
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
     paint_requested = false;
 
     if (menu_open) {
@@ -554,42 +651,142 @@ class GUI {
       }
     }
 
+    // the whole screen moves while the menu slides
+    paint_full =
+        (menu_pos != painted_menu_pos) || renderer.is_full_repaint_requested();
+    painted_menu_pos = menu_pos;
+
     renderer.paint_start();
 
     return result_t::SUCCESS;
   }
 
-  result_t paint_line(pos_t y, uint16_t *line_buff) {
-    pos_t canvas_w = width - menu_pos;
-    pos_t canvas_sx = menu_pos / 2;
-    renderer.paint_line(canvas_sx, y, canvas_w, line_buff + menu_pos);
+  // The paint functions only read the GUI state, so disjoint areas may be
+  // painted concurrently between paint_start() and paint_end().
+
+  // Paints the screen rectangle (x, y, w, h) straight to `dst`, rows are
+  // `dst_stride` pixels apart. The menu overlay and its shadow are
+  // composited in the same pass.
+  result_t paint_rect(pos_t x, pos_t y, pos_t w, pos_t h, col_t *dst,
+                      int dst_stride) const {
+    FIXBROT_TRACE_SCOPE(trace_event_t::GUI_PAINT_LINE);
+    pos_t x1 = x + w;
+
+    // menu overlay
+    pos_t menu_x1 = (x1 < menu_pos) ? x1 : menu_pos;
+    if (x < menu_x1) {
+      menu_bmp.render_to(MENU_WIDTH - menu_pos + x, y, menu_x1 - x, h, dst,
+                         dst_stride, menu_expansion);
+    }
+
+    pos_t canvas_x = (x > menu_pos) ? x : menu_pos;
+    if (canvas_x >= x1) {
+      return result_t::SUCCESS;
+    }
+    dst += canvas_x - x;
+
+    // screen column `menu_pos` shows renderer column `menu_pos / 2`
+    pos_t offset = menu_pos - menu_pos / 2;
+    FIXBROT_TRY(renderer.paint_rect(canvas_x - offset, y, x1 - canvas_x, h,
+                                    dst, dst_stride));
 
+    // menu shadow effect, the shadowed canvas columns are darkened in place
     if (menu_pos > 0) {
-      menu_bmp.render_to(MENU_WIDTH - menu_pos, y, menu_pos, 1, line_buff,
-                         width, MENU_PALETTE);
-
-      // menu shadow effect
-      for (int i = 0; i < SHADOW_SIZE; i++) {
-        uint8_t r, g, b;
-        color_unpack(line_buff[menu_pos + i], &r, &g, &b);
-        r = (int)(r * shadow_alpha[i]) >> 8;
-        g = (int)(g * shadow_alpha[i]) >> 8;
-        b = (int)(b * shadow_alpha[i]) >> 8;
-        line_buff[menu_pos + i] = color_pack(r, g, b);
+      pos_t shadow_x1 = menu_pos + SHADOW_SIZE;
+      if (shadow_x1 > x1) shadow_x1 = x1;
+      pos_t n = shadow_x1 - canvas_x;
+      for (pos_t iy = 0; iy < h; iy++) {
+        col_t *wr_ptr = dst + iy * dst_stride;
+        for (pos_t i = 0; i < n; i++) {
+          const uint8_t *lut = shadow_lut[canvas_x - menu_pos + i];
+          uint8_t r, g, b;
+          color_unpack(color_from_display(wr_ptr[i]), &r, &g, &b);
+          wr_ptr[i] = color_to_display(color_pack(lut[r], lut[g], lut[b]));
+        }
       }
     }
 
-#if FIXBROT_BYTE_SWAP
-    for (int x = 0; x < width; x++) {
-      uint16_t c = line_buff[x];
-      line_buff[x] = ((c >> 8) & 0x00FF) | ((c << 8) & 0xFF00);
+    return result_t::SUCCESS;
+  }
+
+  FIXBROT_INLINE result_t paint_line(pos_t y, col_t *line_buff) const {
+    return paint_rect(0, y, width, 1, line_buff, width);
+  }
+
+  // paints rows [y0, y0 + h) to `buff`, rows are `stride` pixels apart
+  FIXBROT_INLINE result_t paint_band(pos_t y0, pos_t h, col_t *buff,
+                                     int stride) const {
+    return paint_rect(0, y0, width, h, buff, stride);
+  }
+
+  // Horizontal span of screen row `y` that needs to be sent to the display
+  // in this frame. Rows without a span can be skipped entirely.
+  bool get_dirty_span(pos_t y, pos_t *x, pos_t *w) {
+    if (paint_full) {
+      *x = 0;
+      *w = width;
+      return true;
     }
-#endif
 
+    pos_t x0 = width, x1 = 0;
+
+    // renderer span shifted to where the canvas is shown
+    pos_t rx, rw;
+    if (renderer.get_dirty_span(y, &rx, &rw)) {
+      pos_t offset = menu_pos - menu_pos / 2;
+      x0 = rx + offset;
+      x1 = rx + rw + offset;
+      if (x0 < menu_pos) x0 = menu_pos;
+      if (x1 > width) x1 = width;
+    }
+
+    if (menu_pos > 0 && menu_damage_y0 <= y && y < menu_damage_y1) {
+      x0 = 0;
+      if (x1 < menu_pos) x1 = menu_pos;
+    }
+
+    bool dirty = x0 < x1;
+    *x = dirty ? x0 : 0;
+    *w = dirty ? (x1 - x0) : 0;
+    paint_stats.pixels_sent += *w;
+    paint_stats.pixels_skipped += width - *w;
+    return dirty;
+  }
+
+  // Paints the dirty spans of this frame to the frame buffer `frame`, rows
+  // are `stride` pixels apart. Runs of rows with the same span, as within a
+  // row of renderer tiles, are painted as one rectangle.
+  result_t paint_dirty(col_t *frame, int stride) {
+    pos_t run_y = 0, run_x = 0, run_w = 0;
+    for (pos_t y = 0; y <= height; y++) {
+      pos_t x = 0, w = 0;
+      if (y < height) get_dirty_span(y, &x, &w);
+      if (y < height && x == run_x && w == run_w) continue;
+      if (run_w > 0) {
+        FIXBROT_TRY(paint_rect(run_x, run_y, run_w, y - run_y,
+                               frame + run_y * stride + run_x, stride));
+      }
+      run_y = y;
+      run_x = x;
+      run_w = w;
+    }
     return result_t::SUCCESS;
   }
 
+  FIXBROT_INLINE bool is_full_paint() const { return paint_full; }
+
+  FIXBROT_INLINE const paint_stats_t &get_paint_stats() const {
+    return paint_stats;
+  }
+
   result_t paint_end() {
+    paint_stats.frames++;
+    if (paint_full) {
+      paint_stats.full_frames++;
+      paint_stats.pixels_sent += (uint32_t)width * height;
+    }
+    menu_damage_y0 = 0;
+    menu_damage_y1 = 0;
     renderer.paint_finished();
     return result_t::SUCCESS;
   }
@@ -744,13 +941,25 @@ class GUI {
         int delta = inc_dec * renderer.get_palette_size() / 8;
         renderer.set_palette_phase(renderer.get_palette_phase() + delta);
       } break;
+
+      case menu_key_t::BLANK:
+      case menu_key_t::CAPTION:
+      case menu_key_t::STATS:
+      case menu_key_t::LAST:
+        break;
     }
   }
 
   void update_menu() {
     const GFXfont &font = ShapoSansP_s12c09a01w02;
 
-    menu_bmp.clear(MENU_BACK);
+    if (!menu_bmp_valid) {
+      menu_bmp.clear(MENU_BACK);
+      for (int i_menu = 0; i_menu < NUM_MENU_ITEMS; i_menu++) {
+        menu_drawn[i_menu].valid = false;
+      }
+      menu_bmp_valid = true;
+    }
 
     int scale_exp = renderer.get_scale_exp();
     int frac_digits = clamp(1, 20, scale_exp * 77 / 256 + 4);
@@ -795,6 +1004,16 @@ class GUI {
                    renderer.get_vert_flip() ? "On" : "Off");
           break;
 
+        case menu_key_t::STATS: {
+          // render time and ratio of pixels actually computed
+          const render_stats_t &st = renderer.get_stats();
+          uint32_t pixels = (uint32_t)width * height;
+          uint32_t computed = st.cells_collected + st.correct_computes;
+          snprintf(item.value_text, sizeof(item.value_text), "%lu ms, %lu %%",
+                   (unsigned long)renderer.get_render_ms(),
+                   (unsigned long)(100 * computed / pixels));
+        } break;
+
         case menu_key_t::PALETTE_TYPE:
           snprintf(item.value_text, sizeof(item.value_text), "%d",
                    (int)palette);
@@ -813,6 +1032,30 @@ class GUI {
         } break;
       }
 
+      int h = line_height * item.value_lines;
+      item.y_center = y + h / 2;
+
+      // redraw only items whose appearance changed
+      bool active = (menu_cursor == item.key);
+      menu_item_drawn_t &drawn = menu_drawn[i_menu];
+      if (drawn.valid && drawn.active == active &&
+          strcmp(drawn.text, item.value_text) == 0) {
+        y += h;
+        continue;
+      }
+      drawn.valid = true;
+      drawn.active = active;
+      strncpy(drawn.text, item.value_text, sizeof(drawn.text));
+      // grow the pending span, an item above it may be redrawn as well
+      if (menu_damage_y1 <= menu_damage_y0) {
+        menu_damage_y0 = y;
+        menu_damage_y1 = y + h;
+      } else {
+        if (y < menu_damage_y0) menu_damage_y0 = y;
+        if (y + h > menu_damage_y1) menu_damage_y1 = y + h;
+      }
+      menu_bmp.fill_rect(0, y, MENU_WIDTH, h, MENU_BACK);
+
       // render menu item
       if (item.key == menu_key_t::CAPTION) {
         menu_bmp.fill_rect(0, y, MENU_WIDTH, line_height * item.value_lines - 1,
@@ -824,7 +1067,7 @@ class GUI {
       } else {
         uint8_t label_color = MENU_LABEL;
         uint8_t value_color = MENU_VALUE;
-        if (menu_cursor == item.key) {
+        if (active) {
           menu_bmp.fill_rect(0, y, MENU_WIDTH,
                              line_height * item.value_lines - 1, MENU_ACTIVE);
           label_color = MENU_BACK;
@@ -839,8 +1082,6 @@ class GUI {
                            value_color);
       }
 
-      int h = line_height * item.value_lines;
-      item.y_center = y + h / 2;
       y += h;
     }
   }
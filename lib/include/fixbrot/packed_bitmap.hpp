@@ -3,6 +3,7 @@
 
 #include <gfxfont.h>
 
+#include "fixbrot/arena.hpp"
 #include "fixbrot/common.hpp"
 
 #define FIXBROT_INLINE __attribute__((always_inline)) inline
@@ -14,36 +15,75 @@ class PackedBitmap {
  public:
   static constexpr int BPP = prm_BPP;
   static constexpr int PIXS_PER_BYTE = 8 / BPP;
+
+  // colors of the pixels packed in each possible byte value
+  struct expansion_t {
+    col_t pixels[256][PIXS_PER_BYTE];
+  };
+
   const pos_t width;
   const pos_t height;
   const pos_t stride;
 
  private:
   uint8_t *buff;
+  bool owns_buff = false;
 
  public:
+  PackedBitmap(pos_t width, pos_t height, Arena &arena)
+      : width(width),
+        height(height),
+        stride((width * BPP + 7) / 8),
+        buff(arena.alloc<uint8_t>(stride * height)) {}
+
+#ifndef FIXBROT_NO_STDLIB
   PackedBitmap(pos_t width, pos_t height)
       : width(width),
         height(height),
         stride((width * BPP + 7) / 8),
-        buff(new uint8_t[stride * height]) {}
+        buff(new uint8_t[stride * height]),
+        owns_buff(true) {}
+
+  ~PackedBitmap() {
+    if (owns_buff) delete[] buff;
+  }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height) {
+    return Arena::align_up((size_t)((width * BPP + 7) / 8) * height);
+  }
 
-  ~PackedBitmap() { delete[] buff; }
+  // false if the arena given to the constructor was too small
+  FIXBROT_INLINE bool has_buffer() const { return buff != nullptr; }
 
   FIXBROT_INLINE uint8_t *pixel_pointer(pos_t x, pos_t y) {
     return buff + (y * stride) + (x / PIXS_PER_BYTE);
   }
 
+  FIXBROT_INLINE const uint8_t *pixel_pointer(pos_t x, pos_t y) const {
+    return buff + (y * stride) + (x / PIXS_PER_BYTE);
+  }
+
+  static void build_expansion(const col_t *palette, expansion_t *exp) {
+    for (int byte = 0; byte < 256; byte++) {
+      for (int i = 0; i < PIXS_PER_BYTE; i++) {
+        int shift = (PIXS_PER_BYTE - 1 - i) * BPP;
+        exp->pixels[byte][i] = palette[(byte >> shift) & ((1 << BPP) - 1)];
+      }
+    }
+  }
+
   void render_to(pos_t sx, pos_t sy, pos_t w, pos_t h, col_t *dest_buff,
-                 int dest_stride, const col_t *palette) {
-    uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
+                 int dest_stride, const col_t *palette) const {
+    const uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
     for (pos_t iy = 0; iy < h; iy++) {
-      uint8_t *rd_ptr = rd_line_ptr;
+      const uint8_t *rd_ptr = rd_line_ptr;
       uint8_t rd_byte = *(rd_ptr++);
       rd_byte <<= (sx % PIXS_PER_BYTE) * BPP;
       col_t *wr_ptr = dest_buff;
       for (pos_t ix = 0; ix < w; ix++) {
-        uint8_t color = (rd_byte >> 6) & ((1 << BPP) - 1);
+        uint8_t color = (rd_byte >> (8 - BPP)) & ((1 << BPP) - 1);
         *(wr_ptr++) = palette[color];
         rd_byte <<= BPP;
         if (((sx + ix + 1) % PIXS_PER_BYTE) == 0) {
@@ -55,6 +95,48 @@ class PackedBitmap {
     }
   }
 
+  // same as above, expands whole source bytes through a table made by
+  // build_expansion()
+  void render_to(pos_t sx, pos_t sy, pos_t w, pos_t h, col_t *dest_buff,
+                 int dest_stride, const expansion_t &exp) const {
+    const uint8_t *rd_line_ptr = pixel_pointer(sx, sy);
+    pos_t head = (PIXS_PER_BYTE - sx % PIXS_PER_BYTE) % PIXS_PER_BYTE;
+    if (head > w) head = w;
+    pos_t num_bytes = (w - head) / PIXS_PER_BYTE;
+    pos_t tail = w - head - num_bytes * PIXS_PER_BYTE;
+    for (pos_t iy = 0; iy < h; iy++) {
+      const uint8_t *rd_ptr = rd_line_ptr;
+      col_t *wr_ptr = dest_buff;
+
+      // unaligned pixels of the first byte
+      if (head > 0) {
+        const col_t *e = exp.pixels[*(rd_ptr++)] + (sx % PIXS_PER_BYTE);
+        for (pos_t i = 0; i < head; i++) {
+          *(wr_ptr++) = e[i];
+        }
+      }
+
+      // whole bytes, the compiler merges the copy into wide stores
+      for (pos_t ib = 0; ib < num_bytes; ib++) {
+        const col_t *e = exp.pixels[*(rd_ptr++)];
+        for (int i = 0; i < PIXS_PER_BYTE; i++) {
+          wr_ptr[i] = e[i];
+        }
+        wr_ptr += PIXS_PER_BYTE;
+      }
+
+      if (tail > 0) {
+        const col_t *e = exp.pixels[*rd_ptr];
+        for (pos_t i = 0; i < tail; i++) {
+          *(wr_ptr++) = e[i];
+        }
+      }
+
+      rd_line_ptr += stride;
+      dest_buff += dest_stride;
+    }
+  }
+
   void clear(uint8_t color = 0) {
     color = extend_pixel(color);
     uint8_t *line_ptr = buff;
@@ -195,17 +277,29 @@ class PackedBitmap {
 
 class MonoBitmap : public PackedBitmap<1> {
  public:
+  MonoBitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<1>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   MonoBitmap(pos_t width, pos_t height) : PackedBitmap<1>(width, height) {}
+#endif
 };
 
 class Gray2Bitmap : public PackedBitmap<2> {
  public:
+  Gray2Bitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<2>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   Gray2Bitmap(pos_t width, pos_t height) : PackedBitmap<2>(width, height) {}
+#endif
 };
 
 class Gray4Bitmap : public PackedBitmap<4> {
  public:
+  Gray4Bitmap(pos_t width, pos_t height, Arena &arena)
+      : PackedBitmap<4>(width, height, arena) {}
+#ifndef FIXBROT_NO_STDLIB
   Gray4Bitmap(pos_t width, pos_t height) : PackedBitmap<4>(width, height) {}
+#endif
 };
 
 }  // namespace fixbrot
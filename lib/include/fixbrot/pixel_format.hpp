@@ -0,0 +1,71 @@
+#ifndef FIXBROT_PIXEL_FORMAT_HPP
+#define FIXBROT_PIXEL_FORMAT_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
+
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+// 8 bits per channel color, 0x00RRGGBB
+using rgb888_t = uint32_t;
+
+static FIXBROT_INLINE constexpr rgb888_t rgb888_pack(uint8_t r, uint8_t g,
+                                                     uint8_t b) {
+  return ((rgb888_t)r << 16) | ((rgb888_t)g << 8) | b;
+}
+
+static FIXBROT_INLINE constexpr uint8_t rgb888_r(rgb888_t c) {
+  return (c >> 16) & 0xFF;
+}
+static FIXBROT_INLINE constexpr uint8_t rgb888_g(rgb888_t c) {
+  return (c >> 8) & 0xFF;
+}
+static FIXBROT_INLINE constexpr uint8_t rgb888_b(rgb888_t c) {
+  return c & 0xFF;
+}
+
+static FIXBROT_INLINE constexpr rgb888_t rgb888_div2(rgb888_t c) {
+  return (c >> 1) & 0x7F7F7F;
+}
+
+// Output pixel formats of Renderer::paint_rect_as(). Each format receives
+// both the color and the palette index of a pixel and uses one of them,
+// see Renderer::export_palette8() for the meaning of indices.
+
+struct indexed8_format_t {
+  using pixel_t = uint8_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t, uint8_t index) {
+    return index;
+  }
+};
+
+struct rgb565_format_t {
+  using pixel_t = uint16_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return ((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F);
+  }
+};
+
+struct argb4444_format_t {
+  using pixel_t = uint16_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return 0xF000 | ((c >> 12) & 0x0F00) | ((c >> 8) & 0x00F0) |
+           ((c >> 4) & 0x000F);
+  }
+};
+
+// bytes R, G, B, A in memory on little-endian hosts
+struct rgba8888_format_t {
+  using pixel_t = uint32_t;
+  static FIXBROT_INLINE pixel_t from_color(rgb888_t c, uint8_t) {
+    return 0xFF000000 | ((c >> 16) & 0xFF) | (c & 0xFF00) |
+           ((c & 0xFF) << 16);
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
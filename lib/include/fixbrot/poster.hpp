@@ -0,0 +1,298 @@
+#ifndef FIXBROT_POSTER_HPP
+#define FIXBROT_POSTER_HPP
+
+#include "fixbrot/common.hpp"
+#include "fixbrot/renderer.hpp"
+
+// maps its file with POSIX mmap(), so only on hosts
+#if !defined(FIXBROT_NO_STDLIB) && (defined(__unix__) || defined(__APPLE__))
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fixbrot {
+
+// Renders an image far larger than the screen, e.g. a gigapixel poster, to
+// a file of tiles mapped into memory, so that only the tiles being traced
+// and their neighbours need to be resident.
+//
+// Tiles are traced one at a time in row-major order by a Renderer of
+// TILE_SIZE + 2 pixels square, whose view covers the tile and a ring of one
+// pixel around it. The ring pixels of tiles finished before are taken from
+// the file instead of being computed, so the boundaries shared by tiles are
+// computed once and tracing crosses them as if the image were one view.
+//
+// Finished tiles are marked in the file. Opening it again for the same
+// view skips them, which resumes an interrupted render.
+//
+// The application drives get_tile_renderer() like a screen-sized one:
+// workers are initialized by on_render_start() with the scene of each tile
+// and dequeue its pixels, and service() takes the place of
+// Renderer::service().
+class PosterRenderer {
+ public:
+  static constexpr int32_t TILE_SIZE = 256;
+  static constexpr uint32_t TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+  static constexpr pos_t VIEW_SIZE = TILE_SIZE + 2;
+
+  static constexpr uint32_t FILE_MAGIC = 0x50425846;  // "FXBP"
+  static constexpr uint16_t FILE_VERSION = 1;
+  static constexpr size_t FILE_ALIGN = 4096;
+
+  const int32_t width;
+  const int32_t height;
+  const int32_t tiles_x;
+  const int32_t tiles_y;
+  const uint32_t num_tiles;
+
+ private:
+  // Start of the file in host byte order, followed by one state byte per
+  // tile, then TILE_PIXELS iteration counts per tile from FILE_ALIGN on.
+  // The pixels of a tile are in row-major order, including those past the
+  // right and bottom edges of the image.
+  struct header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t iter_max;
+    int32_t width;
+    int32_t height;
+    int32_t tile_size;
+    int32_t scale_exp;
+    int64_t real;
+    int64_t imag;
+    int64_t step;
+    uint16_t max_iter;
+    uint8_t formula;
+    uint8_t reserved;
+  };
+
+  Renderer view;
+
+  int fd = -1;
+  uint8_t *map = nullptr;
+  size_t map_bytes = 0;
+  uint8_t *tile_done = nullptr;
+  iter_t *tile_pixels = nullptr;
+
+  scene_t scene;
+  int scale_exp = 0;
+  int view_exp = 0;
+
+  uint32_t num_done = 0;
+  uint32_t next_tile = 0;
+  int64_t current_tile = -1;
+
+ public:
+  PosterRenderer(int32_t width, int32_t height)
+      : width(width),
+        height(height),
+        tiles_x((width + TILE_SIZE - 1) / TILE_SIZE),
+        tiles_y((height + TILE_SIZE - 1) / TILE_SIZE),
+        num_tiles((uint32_t)tiles_x * tiles_y),
+        view(VIEW_SIZE, VIEW_SIZE) {}
+
+  ~PosterRenderer() { close(); }
+
+  // bytes of the file for the image
+  FIXBROT_INLINE size_t get_file_bytes() const {
+    return get_pixels_offset() +
+           (size_t)num_tiles * TILE_PIXELS * sizeof(iter_t);
+  }
+
+  // Opens `path` to render the view centered at `real`, `imag`, where
+  // `exp` scales the image like Renderer::set_view() scales the screen.
+  // A file left by an unfinished render of the same view is resumed, any
+  // other file is overwritten.
+  result_t open(const char *path, formula_t formula, real_t real,
+                real_t imag, int exp, iter_t max_iter) {
+    close();
+
+    // the tile views cannot zoom out further than a screen
+    int image_clog2 = size_clog2(width > height ? width : height);
+    int view_clog2 = size_clog2(VIEW_SIZE);
+    if (exp + image_clog2 - view_clog2 < MIN_SCALE_EXP) {
+      exp = MIN_SCALE_EXP + view_clog2 - image_clog2;
+    }
+    scale_exp = exp;
+    view_exp = exp + image_clog2 - view_clog2;
+    scene.formula = formula;
+    scene.real = real;
+    scene.imag = imag;
+    scene.step = real_exp2(-exp - image_clog2);
+    scene.max_iter = clamp((iter_t)100, ITER_MAX, max_iter);
+
+    header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FILE_MAGIC;
+    hdr.version = FILE_VERSION;
+    hdr.iter_max = ITER_MAX;
+    hdr.width = width;
+    hdr.height = height;
+    hdr.tile_size = TILE_SIZE;
+    hdr.scale_exp = scale_exp;
+    hdr.real = scene.real.raw;
+    hdr.imag = scene.imag.raw;
+    hdr.step = scene.step.raw;
+    hdr.max_iter = scene.max_iter;
+    hdr.formula = (uint8_t)scene.formula;
+
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return result_t::ERROR_IO;
+
+    const size_t bytes = get_file_bytes();
+    struct stat st;
+    header_t old;
+    bool resume = fstat(fd, &st) == 0 && (size_t)st.st_size == bytes &&
+                  pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+                  memcmp(&old, &hdr, sizeof(hdr)) == 0;
+    if (!resume) {
+      // truncating first leaves every tile state zero, i.e. not done
+      if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)bytes) != 0 ||
+          pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        close();
+        return result_t::ERROR_IO;
+      }
+    }
+
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      close();
+      return result_t::ERROR_IO;
+    }
+    map = (uint8_t *)p;
+    map_bytes = bytes;
+    tile_done = map + sizeof(header_t);
+    tile_pixels = (iter_t *)(map + get_pixels_offset());
+
+    num_done = 0;
+    for (uint32_t i = 0; i < num_tiles; i++) {
+      if (tile_done[i]) num_done++;
+    }
+    next_tile = 0;
+    current_tile = -1;
+    return result_t::SUCCESS;
+  }
+
+  // Writes the finished tiles back and unmaps the file. The tile being
+  // traced is discarded and traced again when the render is resumed.
+  void close() {
+    if (map) {
+      msync(map, map_bytes, MS_SYNC);
+      munmap(map, map_bytes);
+    }
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    map = nullptr;
+    map_bytes = 0;
+    tile_done = nullptr;
+    tile_pixels = nullptr;
+    current_tile = -1;
+  }
+
+  FIXBROT_INLINE bool is_open() const { return map != nullptr; }
+
+  // true until every tile is finished and stored
+  FIXBROT_INLINE bool is_busy() const {
+    return map && (current_tile >= 0 || num_done < num_tiles);
+  }
+
+  FIXBROT_INLINE uint32_t get_num_done() const { return num_done; }
+  FIXBROT_INLINE int get_scale_exp() const { return scale_exp; }
+
+  // the renderer tracing the current tile, for the workers
+  FIXBROT_INLINE Renderer &get_tile_renderer() { return view; }
+
+  // image pixel of the tile being traced at (0, 0) of its renderer's view,
+  // i.e. one up and left of the tile itself
+  FIXBROT_INLINE int32_t get_tile_x() const {
+    return (int32_t)(current_tile % tiles_x) * TILE_SIZE - 1;
+  }
+  FIXBROT_INLINE int32_t get_tile_y() const {
+    return (int32_t)(current_tile / tiles_x) * TILE_SIZE - 1;
+  }
+
+  // Stores the tile once its view is finished and starts the next one,
+  // then services the tile renderer.
+  result_t service() {
+    if (!map) return result_t::SUCCESS;
+    if (!view.is_busy()) {
+      if (current_tile >= 0) store_tile();
+      if (num_done >= num_tiles) return result_t::SUCCESS;
+      FIXBROT_TRY(start_tile());
+    }
+    return view.service();
+  }
+
+  // ITER_BLANK outside the image or in a tile not finished yet
+  FIXBROT_INLINE iter_t get_iter(int32_t x, int32_t y) const {
+    if (!map || x < 0 || x >= width || y < 0 || y >= height) {
+      return ITER_BLANK;
+    }
+    uint32_t tile = (uint32_t)(y / TILE_SIZE) * tiles_x + x / TILE_SIZE;
+    if (!tile_done[tile]) return ITER_BLANK;
+    return tile_pixels[(size_t)tile * TILE_PIXELS +
+                       (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+  }
+
+  // copies pixels [x0, x0 + w) of row `y` to `dst`, see get_iter()
+  void read_row(int32_t y, int32_t x0, int32_t w, iter_t *dst) const {
+    for (int32_t x = x0; x < x0 + w; x++) {
+      *(dst++) = get_iter(x, y);
+    }
+  }
+
+ private:
+  static int size_clog2(int32_t size) {
+    int n = 0;
+    while (size > 0) {
+      n++;
+      size /= 2;
+    }
+    return n;
+  }
+
+  FIXBROT_INLINE size_t get_pixels_offset() const {
+    return (sizeof(header_t) + num_tiles + FILE_ALIGN - 1) &
+           ~(FILE_ALIGN - 1);
+  }
+
+  result_t start_tile() {
+    while (tile_done[next_tile]) next_tile++;
+    current_tile = next_tile++;
+
+    // center of the view relative to that of the image
+    const int32_t x0 = get_tile_x();
+    const int32_t y0 = get_tile_y();
+    real_t real =
+        scene.real + scene.step * (int)(x0 + VIEW_SIZE / 2 - width / 2);
+    real_t imag =
+        scene.imag + scene.step * (int)(y0 + VIEW_SIZE / 2 - height / 2);
+
+    return view.set_view_with_edges(
+        scene.formula, real, imag, view_exp, scene.max_iter,
+        [&](pos_t x, pos_t y) { return get_iter(x0 + x, y0 + y); });
+  }
+
+  void store_tile() {
+    iter_t *dst = tile_pixels + (size_t)current_tile * TILE_PIXELS;
+    for (pos_t y = 0; y < TILE_SIZE; y++) {
+      for (pos_t x = 0; x < TILE_SIZE; x++) {
+        *(dst++) = view.get_iter(x + 1, y + 1);
+      }
+    }
+    tile_done[current_tile] = 1;
+    num_done++;
+    current_tile = -1;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+
+#endif
@@ -7,27 +7,89 @@
 #include <string.h>
 #endif
 
+#include "fixbrot/arena.hpp"
 #include "fixbrot/array_queue.hpp"
 #include "fixbrot/common.hpp"
 #include "fixbrot/mandelbrot.hpp"
+#include "fixbrot/pixel_format.hpp"
+#include "fixbrot/snapshot.hpp"
+#include "fixbrot/tile_cache.hpp"
+#include "fixbrot/trace.hpp"
+#include "fixbrot/zoom_history.hpp"
+
+// iterations below 2^FIXBROT_COLOR_LUT_BITS are colored by table lookup
+#ifndef FIXBROT_COLOR_LUT_BITS
+#define FIXBROT_COLOR_LUT_BITS (12)
+#endif
+
+// On x86 hosts, paint_line() looks up 8 pixels at a time (AVX2 gather or
+// SSE4.1 inserts) where they read 1:1 from a 16-bit work buffer.
+#ifndef FIXBROT_COLOR_LUT_SIMD
+#if !FIXBROT_ITER_12BIT && !defined(FIXBROT_NO_STDLIB) && \
+    (defined(__AVX2__) || defined(__SSE4_1__))
+#define FIXBROT_COLOR_LUT_SIMD (1)
+#else
+#define FIXBROT_COLOR_LUT_SIMD (0)
+#endif
+#endif
+
+#if FIXBROT_COLOR_LUT_SIMD
+#include <immintrin.h>
+#endif
 
 namespace fixbrot {
 
 void on_render_start(const scene_t &scene);
 void on_render_finished(result_t res);
+void on_prefetch_start(const scene_t &scene);
 bool on_collect(cell_t *resp);
 uint64_t get_time_ms();
 
+// counters of the current (or last) render, reset by each render start
+struct render_stats_t {
+  uint32_t cells_enqueued;
+  uint32_t cells_collected;
+  uint32_t correct_computes;
+  uint32_t queue_peak;
+  uint32_t queue_capacity;
+  // cells deferred to the overflow bitmap because the queue was full
+  uint32_t cells_overflowed;
+  uint32_t fill_blank_pixels;
+  uint64_t total_iters;
+  uint64_t start_ms;
+  uint32_t render_ms;
+  uint32_t tiles_loaded;
+  uint32_t tiles_prefetched;
+  bool finished;
+};
+
 class Renderer {
  public:
   const pos_t width;
   const pos_t height;
   static constexpr int ZOOM_DURATION_MS = 200;
+  static constexpr uint32_t DEFAULT_PAINT_INTERVAL_MS = 100;
+  // progressive repaints may take at most 1/PAINT_COST_RATIO of the time
+  static constexpr uint32_t PAINT_COST_RATIO = 4;
+  static constexpr int COLOR_LUT_SIZE = 1 << FIXBROT_COLOR_LUT_BITS;
+  // zoom animation scale is fixed point with this many fraction bits
+  static constexpr int PAINT_SCALE_BITS = 16;
+  static constexpr int32_t PAINT_SCALE_ONE = 1 << PAINT_SCALE_BITS;
+
+  // indices written by indexed8_format_t
+  static constexpr uint8_t INDEX8_BLANK = 0;
+  static constexpr uint8_t INDEX8_INSIDE = 1;
+  static constexpr uint8_t INDEX8_QUEUED = 2;
+  static constexpr uint8_t INDEX8_PALETTE = 3;
+  static constexpr int MAX_PALETTE8_SIZE = 128;
 
  private:
   uint64_t last_ms = 0;
 
   int busy_items = 0;
+  // block allocated by the heap constructor, nullptr if the buffers below
+  // were carved from the caller's arena
+  uint8_t *heap_block;
   ArrayQueue<vec_t> queue;
 #if FIXBROT_ITER_12BIT
   const pos_t stride;
@@ -41,99 +103,358 @@ class Renderer {
   int scale_exp = -2;
   int screen_size_clog2 = 0;
   bool vert_flip = false;
-  uint32_t iter_accum = 0;
+  render_stats_t stats = {};
 
   pos_t correct_x = 0;
   pos_t correct_y = height;
+  pos_t fill_y = height;
 
   col_t palette[MAX_PALETTE_SIZE] = {0};
   col_t max_iter_color = 0x0000;
+  rgb888_t palette_rgb[MAX_PALETTE_SIZE] = {0};
+  rgb888_t max_iter_rgb = 0;
   int palette_slope = 0;
   int palette_phase = 0;
   int palette_size = MAX_PALETTE_SIZE;
 
+  // display color of each iteration count with palette phase, max_iter and
+  // byte order applied
+  col_t *color_lut;
+  bool color_lut_valid = false;
+  iter_t color_lut_max_iter = 0;
+
   bool paint_requested = false;
+  bool paint_pending_pixels = false;
+  uint32_t paint_interval_ms = DEFAULT_PAINT_INTERVAL_MS;
+  uint32_t paint_cost_us = 0;
+  uint64_t paint_start_us = 0;
+  uint64_t last_paint_ms = 0;
   bool paint_zoom_inprog = false;
   bool paint_zoom_dir_in = false;
   uint64_t paint_zoom_end_ms = 0;
   pos_t *paint_x_buff;
-  float paint_scale = 1.0f;
+  pos_t *paint_y_buff;
+  int32_t paint_scale = PAINT_SCALE_ONE;
+  // paint_x_buff and paint_y_buff map each position to itself
+  bool paint_unscaled = true;
+
+  // dirty span of each row of tiles (COARSE_POS_STEP pixels square), in
+  // tile units, empty when x1 < x0
+  const pos_t dirty_rows;
+  pos_t *dirty_tx0;
+  pos_t *dirty_tx1;
+  bool dirty_all = true;
+
+  TileCache *tile_cache = nullptr;
+  ZoomHistory *zoom_history = nullptr;
+
+  // tile around the view being computed while idle, see prefetch_service()
+  static constexpr pos_t PREFETCH_MARGIN = TileCache::TILE_SIZE;
+  bool prefetch_active = false;
+  bool prefetch_tile_inprog = false;
+  bool prefetch_zoom = false;
+  int prefetch_index = 0;
+  int prefetch_pending = 0;
+  tile_key_t prefetch_key;
+  pos_t prefetch_x = 0;
+  pos_t prefetch_y = 0;
+  // scratch tile of the cache the tile is collected to
+  iter_t *prefetch_pixels = nullptr;
+  // max_iter the work buffer was rendered with
+  iter_t render_max_iter = 0;
+  // tiles of the view filled from the cache, in row-major order
+  bool *tile_loaded;
+
+  // Pixels marked ITER_QUEUED while the queue was full, one bit each in
+  // row-major order. They count as busy items and are queued again by
+  // requeue_overflowed() as the queue drains.
+  uint32_t *overflow_bits;
+  uint32_t num_overflowed = 0;
+  uint32_t overflow_scan = 0;
 
  public:
-  Renderer(pos_t width, pos_t height)
-      : width(width),
-        height(height),
-        queue((width + height) * 16),
-#if FIXBROT_ITER_12BIT
-        stride(width * 3 / 2),
-        work_buff(new uint8_t[stride * height]),
-        copy_buff(new uint8_t[stride]),
-#else
-        work_buff(new iter_t[width * height]),
+  // Carves all buffers from `arena`, which needs get_arena_bytes() bytes
+  // left. The trace queue holds `queue_depth` cells, 0 selects
+  // default_queue_depth(); a smaller queue saves memory at the cost of
+  // more rescans of the overflow bitmap.
+  Renderer(pos_t width, pos_t height, Arena &arena, uint32_t queue_depth = 0)
+      : Renderer(width, height,
+                 carve_buffers(arena, width, height, queue_depth)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  // allocates all buffers as one block from the heap
+  Renderer(pos_t width, pos_t height, uint32_t queue_depth = 0)
+      : Renderer(width, height, carve_heap(width, height, queue_depth)) {}
+
+  ~Renderer() { delete[] heap_block; }
 #endif
-        paint_x_buff(new pos_t[width]) {
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(pos_t width, pos_t height,
+                                          uint32_t queue_depth = 0) {
+    Arena plan;
+    carve_buffers(plan, width, height, queue_depth);
+    return plan.get_used();
   }
 
-  ~Renderer() {
-    delete[] work_buff;
-    delete[] paint_x_buff;
+  static constexpr uint32_t default_queue_depth(pos_t width, pos_t height) {
+    return (width + height) * 16;
   }
 
   real_t get_center_re() const { return scene.real; }
   real_t get_center_im() const { return scene.imag; }
   int get_scale_exp() const { return scale_exp; }
 
-  result_t init() {
-    scene.formula = formula_t::MANDELBROT;
-    scene.real = -0.5f;
-    scene.imag = 0;
-    scene.max_iter = 200;
+  // scene whose origin is the top-left pixel of the work buffer
+  scene_t get_worker_args() const {
+    scene_t s = scene;
+    s.real -= scene.step * (width / 2);
+    s.imag -= scene.step * (height / 2);
+    return s;
+  }
 
-    scale_exp = -2;
-    screen_size_clog2 = 0;
-    pos_t p = width > height ? width : height;
-    while (p > 0) {
-      screen_size_clog2++;
-      p /= 2;
+  FIXBROT_INLINE const render_stats_t &get_stats() const { return stats; }
+
+  // elapsed time of the current render, or duration of the last one
+  uint32_t get_render_ms() const {
+    if (stats.finished) return stats.render_ms;
+    return (uint32_t)(get_time_ms() - stats.start_ms);
+  }
+
+  // Finished tiles are copied to `cache` before the view moves and copied
+  // back instead of being rendered again when the view returns to them.
+  // nullptr disables caching.
+  // While idle, the workers compute tiles in a margin around the view into
+  // the cache. Their pixels are addressed in the scene passed to
+  // on_prefetch_start(), which is that of the view.
+  void set_tile_cache(TileCache *cache) {
+    tile_cache = cache;
+    prefetch_pixels = cache ? cache->get_scratch() : nullptr;
+    prefetch_active = false;
+  }
+
+  // true while idle workers compute tiles around the view
+  FIXBROT_INLINE bool is_prefetching() const { return prefetch_active; }
+
+  // Finished views are saved to `history` by zoom_in() and restored by
+  // zoom_out() when it returns to them. nullptr disables the history.
+  void set_zoom_history(ZoomHistory *history) { zoom_history = history; }
+
+  // Writes the view and its pixels to `stream` in the format described in
+  // snapshot.hpp, see SnapshotWriter for the stream interface. `builtin`
+  // and `slope` are those last passed to load_builtin_palette().
+  // An unfinished render is saved with its queued pixels, so that
+  // load_snapshot() resumes it.
+  template <typename TStream>
+  result_t save_snapshot(TStream &stream, builtin_palette_t builtin,
+                         int slope) const {
+    SnapshotWriter<TStream> wr(stream);
+    wr.put_u32(SNAPSHOT_MAGIC);
+    wr.put_u16(SNAPSHOT_VERSION);
+    wr.put_u16(width);
+    wr.put_u16(height);
+    wr.put_u8((uint8_t)scene.formula);
+    wr.put_u8(vert_flip ? 1 : 0);
+    wr.put_u8((uint8_t)builtin);
+    wr.put_u8(slope);
+    wr.put_u16(palette_phase);
+    wr.put_u32(scale_exp);
+    wr.put_u64(scene.real.raw);
+    wr.put_u64(scene.imag.raw);
+    wr.put_u64(scene.step.raw);
+    wr.put_u16(scene.max_iter);
+
+    wr.reset_hash();
+    for (pos_t y = 0; y < height; y++) {
+      row_reader_t rd(*this, 0, y);
+      uint16_t value = snapshot_iter_from(rd.next());
+      uint32_t run_len = 1;
+      for (pos_t x = 1; x < width; x++) {
+        uint16_t next = snapshot_iter_from(rd.next());
+        if (next == value) {
+          run_len++;
+          continue;
+        }
+        wr.put_u16(value);
+        wr.put_varint(run_len - 1);
+        value = next;
+        run_len = 1;
+      }
+      wr.put_u16(value);
+      wr.put_varint(run_len - 1);
     }
-    update_pixel_step();
+    wr.put_u32(wr.get_hash());
+    return wr.flush() ? result_t::SUCCESS : result_t::ERROR_IO;
+  }
+
+  // Restores a view saved by save_snapshot() of a renderer of the same
+  // size, after init(). The builtin palette and slope it was shown with are
+  // loaded and returned to update the caller's settings. A finished view is
+  // shown without rendering, an unfinished one resumes rendering. If the
+  // pixels turn out to be corrupt, the view shown before is rendered again.
+  template <typename TStream>
+  result_t load_snapshot(TStream &stream, builtin_palette_t *out_builtin,
+                         int *out_slope) {
+    if (is_busy()) return result_t::ERROR_BUSY;
+
+    SnapshotReader<TStream> rd(stream);
+    if (rd.get_u32() != SNAPSHOT_MAGIC) return result_t::ERROR_BAD_SNAPSHOT;
+    if (rd.get_u16() != SNAPSHOT_VERSION) return result_t::ERROR_BAD_SNAPSHOT;
+    pos_t w = rd.get_u16();
+    pos_t h = rd.get_u16();
+    scene_t s;
+    s.formula = (formula_t)rd.get_u8();
+    bool vf = rd.get_u8() != 0;
+    builtin_palette_t pal = (builtin_palette_t)rd.get_u8();
+    int slope = rd.get_u8();
+    int phase = rd.get_u16();
+    int exp = (int32_t)rd.get_u32();
+    s.real = real_t::from_raw(rd.get_u64());
+    s.imag = real_t::from_raw(rd.get_u64());
+    s.step = real_t::from_raw(rd.get_u64());
+    s.max_iter = rd.get_u16();
+    if (rd.is_failed() || w != width || h != height ||
+        s.formula >= formula_t::LAST || pal >= builtin_palette_t::LAST ||
+        slope > MAX_PALETTE_SLOPE || phase >= MAX_PALETTE_SIZE ||
+        exp < MIN_SCALE_EXP || s.max_iter > ITER_MAX ||
+        s.step.raw != real_exp2(-exp - screen_size_clog2).raw) {
+      return result_t::ERROR_BAD_SNAPSHOT;
+    }
+
+    cache_store_tiles();
+    rd.reset_hash();
+    bool unfinished = false;
+    for (pos_t y = 0; y < height; y++) {
+      pos_t x = 0;
+      while (x < width) {
+        iter_t iter = snapshot_iter_to(rd.get_u16());
+        uint32_t run_len = rd.get_varint() + 1;
+        if (rd.is_failed() || iter == ITER_WALL ||
+            run_len > (uint32_t)(width - x)) {
+          return rerender_after_bad_snapshot();
+        }
+        if (iter == ITER_BLANK || iter == ITER_QUEUED) unfinished = true;
+        for (; run_len > 0; run_len--) work_buff_write(x++, y, iter);
+      }
+    }
+    uint32_t hash = rd.get_hash();
+    if (rd.get_u32() != hash || rd.is_failed()) {
+      return rerender_after_bad_snapshot();
+    }
+
+    scene = s;
+    scale_exp = exp;
+    vert_flip = vf;
+    load_builtin_palette(pal, slope);
+    set_palette_phase(phase);
+    if (out_builtin) *out_builtin = pal;
+    if (out_slope) *out_slope = slope;
+
+    if (!unfinished) {
+      restore_finished_view();
+      request_full_repaint();
+      return result_t::SUCCESS;
+    }
+
+    // Resume from the pixels that were queued when saved. The coarse grid
+    // and the edges were seeded by the render that was saved, so they are
+    // not seeded again.
+    FIXBROT_TRY(reset_render(true));
+    for (pos_t y = 0; y < height; y++) {
+      for (pos_t x = 0; x < width; x++) {
+        if (work_buff_read(x, y) == ITER_QUEUED) {
+          work_buff_write(x, y, ITER_BLANK);
+          FIXBROT_TRY(enqueue(vec_t{x, y}));
+        }
+      }
+    }
+    request_full_repaint();
+    return result_t::SUCCESS;
+  }
+
+  FIXBROT_INLINE iter_t get_iter(pos_t x, pos_t y) const {
+    return work_buff_read(x, y);
+  }
 
-    palette_load_heatmap(DEFAULT_PALETTE_SLOPE);
+  // false if the arena given to the constructor was too small; init() and
+  // paint_start() then return ERROR_OUT_OF_MEMORY and nothing else may be
+  // called
+  FIXBROT_INLINE bool has_buffers() const { return overflow_bits != nullptr; }
 
+  result_t init() {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_home_view();
     FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
     FIXBROT_TRY(start_render(true));
-    paint_requested = true;
-
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
+  // Same as init(), but starts with the view saved in a snapshot, see
+  // load_snapshot(). If the snapshot cannot be loaded, the home view is
+  // rendered and the error returned.
+  template <typename TStream>
+  result_t init_from_snapshot(TStream &stream, builtin_palette_t *out_builtin,
+                              int *out_slope) {
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    init_home_view();
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    result_t res = load_snapshot(stream, out_builtin, out_slope);
+    if (res != result_t::SUCCESS && !is_busy()) {
+      FIXBROT_TRY(start_render(true));
+      request_full_repaint();
+    }
+    return res;
+  }
+
   result_t service() {
     uint64_t now_ms = get_time_ms();
     last_ms = now_ms;
 
     if (is_busy()) {
-      FIXBROT_TRY(iterate());
+      bool progress;
+      FIXBROT_TRY(iterate(NO_DEADLINE, &progress));
+    } else {
+      FIXBROT_TRY(prefetch_service());
     }
 
-    // zoom animation
-    paint_scale = 1.0f;
-    if (paint_zoom_inprog) {
-      int32_t t = (int32_t)(paint_zoom_end_ms - now_ms);
-      if (t < 0) {
-        t = 0;
-        paint_zoom_inprog = false;
-      }
-      paint_requested = true;
-      if (paint_zoom_dir_in) {
-        paint_scale = 1.0f + (float)t / ZOOM_DURATION_MS;
-      } else {
-        paint_scale = 1.0f - (float)t / (ZOOM_DURATION_MS * 2);
-      }
+    update_paint_request(now_ms);
+    update_zoom_animation(now_ms);
+    return result_t::SUCCESS;
+  }
+
+  // Does as much tracing, correction and fill work as fits before
+  // `deadline_us` (in get_time_us() time). Returns early when waiting for
+  // the workers.
+  result_t service(uint64_t deadline_us) {
+    uint64_t now_ms = get_time_ms();
+    last_ms = now_ms;
+
+    while (is_busy() && get_time_us() < deadline_us) {
+      bool progress;
+      FIXBROT_TRY(iterate(deadline_us, &progress));
+      if (!progress) break;
+      update_paint_request(get_time_ms());
+      if (paint_requested) break;
+    }
+    if (!is_busy()) {
+      FIXBROT_TRY(prefetch_service());
     }
 
+    update_zoom_animation(now_ms);
     return result_t::SUCCESS;
   }
 
+  FIXBROT_INLINE uint32_t get_paint_interval_ms() const {
+    return paint_interval_ms;
+  }
+
+  // target interval of progressive repaints while rendering
+  void set_paint_interval_ms(uint32_t ms) { paint_interval_ms = ms; }
+
+  // moving average of the time from paint_start() to paint_finished()
+  FIXBROT_INLINE uint32_t get_paint_cost_us() const { return paint_cost_us; }
+
   result_t scroll(pos_t delta_x, pos_t delta_y) {
     if (is_busy()) return result_t::ERROR_BUSY;
 
@@ -151,6 +472,7 @@ class Renderer {
 
     if (delta_x == 0 && delta_y == 0) return result_t::SUCCESS;
 
+    cache_store_tiles();
     scene.real += scene.step * delta_x;
     scene.imag += scene.step * delta_y;
 
@@ -251,6 +573,9 @@ class Renderer {
     }
 #endif
 
+    dirty_all = true;
+    paint_pending_pixels = true;
+
     // clear new area
     if (delta_x > 0) {
       FIXBROT_TRY(clear_rect(rect_t{dx1, 0, delta_x, height}));
@@ -264,7 +589,7 @@ class Renderer {
     }
 
     // render new area
-    FIXBROT_TRY(start_render(false));
+    FIXBROT_TRY(start_render_cached(false));
     if (delta_x != 0) {
       pos_t x0 = (delta_x > 0) ? (dx1 - 1) : dx0;
       pos_t x1 = (delta_x > 0) ? dx1 : (dx0 - 1);
@@ -282,6 +607,8 @@ class Renderer {
   result_t zoom_in() {
     if (is_busy()) return result_t::ERROR_BUSY;
 
+    cache_store_tiles();
+    history_push();
     scale_exp++;
     bool last_is_fixed32 = scene.step.is_fixed32();
     update_pixel_step();
@@ -291,27 +618,23 @@ class Renderer {
       // clear all
       FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
     } else {
-      // upscale last image and reuse pixels
+      // upscale last image and reuse pixels, rows in an order that reads
+      // each before it is overwritten
       for (pos_t i = 0; i < height; i++) {
         pos_t dy = (i < height / 2) ? i : (height * 3 / 2 - 1 - i);
-        pos_t sy = height / 4 + (dy / 2);
-        for (pos_t j = 0; j < width; j++) {
-          pos_t dx = (j < width / 2) ? j : (width * 3 / 2 - 1 - j);
-          pos_t sx = width / 4 + (dx / 2);
-          if ((dx & 1) == 0 && (dy & 1) == 0) {
-            work_buff_write(dx, dy, work_buff_read(sx, sy));
-          } else {
-            work_buff_write(dx, dy, ITER_BLANK);
-          }
+        if (dy & 1) {
+          FIXBROT_TRY(clear_rect(rect_t{0, dy, width, 1}));
+        } else {
+          upscale_row(dy, height / 4 + (dy / 2));
         }
       }
     }
-    FIXBROT_TRY(start_render(true));
+    FIXBROT_TRY(start_render_cached(true));
 
     paint_zoom_inprog = true;
     paint_zoom_dir_in = true;
     paint_zoom_end_ms = get_time_ms() + ZOOM_DURATION_MS;
-    paint_requested = true;
+    request_full_repaint();
 
     return result_t::SUCCESS;
   }
@@ -322,31 +645,31 @@ class Renderer {
       return result_t::SUCCESS;
     }
 
+    cache_store_tiles();
     scale_exp--;
     bool last_is_fixed32 = scene.step.is_fixed32();
     update_pixel_step();
     bool prec_changed = scene.step.is_fixed32() != last_is_fixed32;
 
-    if (prec_changed) {
+    if (history_pop()) {
+      // restored the view zoom_in() has left
+    } else if (prec_changed) {
       // clear all
       FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
-      FIXBROT_TRY(start_render(true));
+      FIXBROT_TRY(start_render_cached(true));
     } else {
-      // downscale last image and reuse pixels
+      // downscale last image and reuse pixels, rows in an order that reads
+      // each before it is overwritten
       for (pos_t i = 0; i < height; i++) {
         pos_t dy = (i < height / 2) ? (height / 2 - 1 - i) : i;
         pos_t sy = dy * 2 - height / 2;
-        for (pos_t j = 0; j < width; j++) {
-          pos_t dx = (j < width / 2) ? (width / 2 - 1 - j) : j;
-          pos_t sx = dx * 2 - width / 2;
-          if (0 <= sx && sx < width && 0 <= sy && sy < height) {
-            work_buff_write(dx, dy, work_buff_read(sx, sy));
-          } else {
-            work_buff_write(dx, dy, ITER_BLANK);
-          }
+        if (0 <= sy && sy < height) {
+          downscale_row(dy, sy);
+        } else {
+          FIXBROT_TRY(clear_rect(rect_t{0, dy, width, 1}));
         }
       }
-      FIXBROT_TRY(start_render(true));
+      FIXBROT_TRY(start_render_cached(true));
       rect_t rect{(pos_t)(width / 4), (pos_t)(height / 4), (pos_t)(width / 2),
                   (pos_t)(height / 2)};
       FIXBROT_TRY(scan_vert(rect.x, rect.x - 1, rect.y, rect.h));
@@ -358,8 +681,47 @@ class Renderer {
     paint_zoom_inprog = true;
     paint_zoom_end_ms = get_time_ms() + ZOOM_DURATION_MS;
     paint_zoom_dir_in = false;
-    paint_requested = true;
+    request_full_repaint();
+
+    return result_t::SUCCESS;
+  }
+
+  result_t set_view(formula_t formula, real_t real, real_t imag, int exp,
+                    iter_t max_iter) {
+    if (is_busy()) return result_t::ERROR_BUSY;
+
+    apply_view(formula, real, imag, exp, max_iter);
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    FIXBROT_TRY(start_render_cached(true));
+    request_full_repaint();
+    return result_t::SUCCESS;
+  }
+
+  // Same as set_view(), but the pixels on the edges of the view for which
+  // `edges(x, y)` returns other than ITER_BLANK are taken from it instead
+  // of being computed, e.g. those shared with adjacent views of a larger
+  // image rendered before. Tracing continues inward from them.
+  template <typename TEdges>
+  result_t set_view_with_edges(formula_t formula, real_t real, real_t imag,
+                               int exp, iter_t max_iter, TEdges &&edges) {
+    if (is_busy()) return result_t::ERROR_BUSY;
 
+    apply_view(formula, real, imag, exp, max_iter);
+    FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
+    for (pos_t x = 0; x < width; x++) {
+      work_buff_write(x, 0, edges(x, 0));
+      work_buff_write(x, height - 1, edges(x, (pos_t)(height - 1)));
+    }
+    for (pos_t y = 1; y < height - 1; y++) {
+      work_buff_write(0, y, edges(0, y));
+      work_buff_write(width - 1, y, edges((pos_t)(width - 1), y));
+    }
+    FIXBROT_TRY(start_render(true));
+    FIXBROT_TRY(scan_vert(0, 1, 0, height));
+    FIXBROT_TRY(scan_vert(width - 1, width - 2, 0, height));
+    FIXBROT_TRY(scan_hori(0, 0, 1, width));
+    FIXBROT_TRY(scan_hori(0, height - 1, height - 2, width));
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -367,10 +729,11 @@ class Renderer {
 
   result_t set_formula(formula_t f) {
     if (is_busy()) return result_t::ERROR_BUSY;
+    cache_store_tiles();
     scene.formula = f;
     FIXBROT_TRY(clear_rect(rect_t{0, 0, width, height}));
-    FIXBROT_TRY(start_render(true));
-    paint_requested = true;
+    FIXBROT_TRY(start_render_cached(true));
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -415,7 +778,7 @@ class Renderer {
         }
       }
     }
-    paint_requested = true;
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -424,7 +787,7 @@ class Renderer {
   result_t set_vert_flip(bool vf) {
     if (is_busy()) return result_t::ERROR_BUSY;
     vert_flip = vf;
-    paint_requested = true;
+    request_full_repaint();
     return result_t::SUCCESS;
   }
 
@@ -444,7 +807,8 @@ class Renderer {
         palette_load_heatmap(slope);
         break;
     }
-    paint_requested = true;
+    color_lut_valid = false;
+    request_full_repaint();
   }
 
   FIXBROT_INLINE int get_palette_size() const { return palette_size; }
@@ -453,7 +817,8 @@ class Renderer {
 
   void set_palette_phase(int phase) {
     palette_phase = phase % MAX_PALETTE_SIZE;
-    paint_requested = true;
+    color_lut_valid = false;
+    request_full_repaint();
   }
 
   int num_queued() const { return queue.size(); }
@@ -461,267 +826,1415 @@ class Renderer {
   bool dequeue(vec_t *out_loc) { return queue.dequeue(out_loc); }
 
   FIXBROT_INLINE bool is_busy() const {
-    return (busy_items > 0) || (correct_y < height);
+    return (busy_items > 0) || (correct_y < height) || (fill_y < height);
   }
 
   FIXBROT_INLINE bool is_repaint_requested() const { return paint_requested; }
 
+  // true if the next paint has to cover the whole screen
+  FIXBROT_INLINE bool is_full_repaint_requested() const { return dirty_all; }
+
+  // horizontal span of screen row `y` changed since the last paint
+  bool get_dirty_span(pos_t y, pos_t *x, pos_t *w) const {
+    if (dirty_all) {
+      *x = 0;
+      *w = width;
+      return true;
+    }
+    if (vert_flip) {
+      y = height - 1 - y;
+    }
+    pos_t ty = y >> COARSE_POS_BITS;
+    if (dirty_tx1[ty] < dirty_tx0[ty]) {
+      return false;
+    }
+    pos_t x0 = dirty_tx0[ty] << COARSE_POS_BITS;
+    pos_t x1 = (dirty_tx1[ty] + 1) << COARSE_POS_BITS;
+    if (x1 > width) x1 = width;
+    *x = x0;
+    *w = x1 - x0;
+    return true;
+  }
+
   FIXBROT_INLINE bool is_animating() const {
     return (last_ms < paint_zoom_end_ms);
   }
 
   result_t paint_start() {
-    // cache x coordinates
-    for (pos_t x = 0; x < width; x++) {
-      pos_t sx = x;
-      if (paint_scale != 1.0f) {
-        sx = (pos_t)((x - width / 2) * paint_scale + (width / 2));
-      }
-      paint_x_buff[x] = sx;
+    if (!has_buffers()) return result_t::ERROR_OUT_OF_MEMORY;
+    paint_start_us = get_time_us();
+    if (!color_lut_valid || color_lut_max_iter != scene.max_iter) {
+      update_color_lut();
     }
+    // cache source coordinates
+    scale_coords(paint_x_buff, width);
+    scale_coords(paint_y_buff, height);
+    paint_unscaled = (paint_scale == PAINT_SCALE_ONE);
     return result_t::SUCCESS;
   }
 
-  result_t paint_line(pos_t x_offset, pos_t y_offset, pos_t w,
-                      col_t *line_buff) {
-    if (vert_flip) {
-      y_offset = height - 1 - y_offset;
-    }
+  FIXBROT_INLINE result_t paint_line(pos_t x_offset, pos_t y_offset, pos_t w,
+                                     col_t *line_buff) const {
+    return paint_rect(x_offset, y_offset, w, 1, line_buff, w);
+  }
 
-    pos_t sy = y_offset;
-    if (paint_scale != 1.0f) {
-      sy = (pos_t)((y_offset - height / 2) * paint_scale + (height / 2));
+  // Paints the screen rectangle (x, y, w, h) to `dst`, rows are
+  // `dst_stride` pixels apart. The columns showing the work buffer are
+  // found once per rectangle, and while zooming in, rows and pixels
+  // showing the same source as the previous one are copied from it.
+  result_t paint_rect(pos_t x, pos_t y, pos_t w, pos_t h, col_t *dst,
+                      int dst_stride) const {
+    // columns [ix0, ix1) show the work buffer, the others are black
+    pos_t ix0 = 0, ix1 = w;
+    if (!paint_unscaled) {
+      while (ix0 < w && paint_x_buff[x + ix0] < 0) ix0++;
+      while (ix1 > ix0 && paint_x_buff[x + ix1 - 1] < 0) ix1--;
     }
 
-    for (pos_t ix = 0; ix < w; ix++) {
-      pos_t x = x_offset + ix;
-      pos_t sx = paint_x_buff[x];
-
-      if (sx < 0 || sx >= width || sy < 0 || sy >= height) {
-        line_buff[ix] = 0x0000;
-        continue;
+    const pos_t y_step = vert_flip ? -1 : 1;
+    pos_t y_offset = vert_flip ? (height - 1 - y) : y;
+    pos_t last_sy = -1;
+    const col_t *last_row = nullptr;
+    for (pos_t iy = 0; iy < h; iy++) {
+      pos_t sy = paint_y_buff[y_offset];
+      y_offset += y_step;
+      if (sy < 0 || sy >= height) {
+        for (pos_t ix = 0; ix < w; ix++) dst[ix] = 0x0000;
+      } else if (sy == last_sy) {
+        memcpy(dst, last_row, sizeof(col_t) * w);
+      } else {
+        paint_row(x, sy, w, ix0, ix1, dst);
+        last_sy = sy;
+        last_row = dst;
       }
+      dst += dst_stride;
+    }
+    return result_t::SUCCESS;
+  }
 
-      bool finished = true;
-      iter_t iter = work_buff_read(sx, sy);
-      if (iter == ITER_BLANK) {
-        finished = false;
-        iter = work_buff_read(sx & 0xFFFE, sy & 0xFFFE);
-        if (iter == ITER_BLANK || iter == ITER_QUEUED) {
-          constexpr pos_t MASK = ~(COARSE_POS_STEP - 1);
-          pos_t sx2 = (sx & MASK) + (COARSE_POS_STEP / 2);
-          pos_t sy2 = (sy & MASK) + (COARSE_POS_STEP / 2);
-          iter = work_buff_read(sx2, sy2);
-          if (iter == ITER_QUEUED) {
-            iter = ITER_BLANK;
-          }
-        }
+  // Same as paint_line() for a rectangle of the screen, in the pixel format
+  // `prm_TFormat` (see pixel_format.hpp). Rows of `dst` are `dst_stride`
+  // pixels apart. Indexed output does not darken unfinished pixels.
+  template <typename prm_TFormat>
+  result_t paint_rect_as(pos_t x, pos_t y, pos_t w, pos_t h,
+                         typename prm_TFormat::pixel_t *dst,
+                         int dst_stride) const {
+    using pixel_t = typename prm_TFormat::pixel_t;
+    const pixel_t black = prm_TFormat::from_color(0, INDEX8_BLANK);
+    const int shift8 = get_palette8_shift();
+
+    for (pos_t iy = 0; iy < h; iy++) {
+      pos_t y_offset = y + iy;
+      if (vert_flip) {
+        y_offset = height - 1 - y_offset;
       }
-
-      col_t c;
-      if (ITER_BLANK == iter) {
-        c = 0x0000;
-      } else if (iter <= ITER_MAX) {
-        c = max_iter_color;
-        if (iter < scene.max_iter) {
-          c = palette[(iter + palette_phase) & (palette_size - 1)];
+      pos_t sy = paint_y_buff[y_offset];
+      pixel_t *wr_ptr = dst;
+      dst += dst_stride;
+
+      for (pos_t ix = 0; ix < w; ix++) {
+        pos_t sx = paint_x_buff[x + ix];
+        if (sx < 0 || sx >= width || sy < 0 || sy >= height) {
+          wr_ptr[ix] = black;
+          continue;
         }
+
+        iter_t iter = work_buff_read(sx, sy);
+        bool finished = (iter != ITER_BLANK);
         if (!finished) {
-          c = color_div2(c);
+          iter = read_preview(sx, sy);
         }
-      } else {
-        c = color_pack_from_888(0xFF, 0xFF, 0x00);
+
+        rgb888_t c = iter_to_rgb(iter);
+        if (!finished && ITER_BLANK != iter && iter <= ITER_MAX) {
+          c = rgb888_div2(c);
+        }
+        wr_ptr[ix] = prm_TFormat::from_color(c, iter_to_index8(iter, shift8));
       }
-      line_buff[ix] = c;
     }
 
     return result_t::SUCCESS;
   }
 
+  // Colors of the indices written by indexed8_format_t. Palettes longer
+  // than MAX_PALETTE8_SIZE are subsampled. Returns the number of entries.
+  int export_palette8(rgb888_t *rgb) const {
+    const int shift8 = get_palette8_shift();
+    rgb[INDEX8_BLANK] = 0;
+    rgb[INDEX8_INSIDE] = max_iter_rgb;
+    rgb[INDEX8_QUEUED] = rgb888_pack(0xFF, 0xFF, 0x00);
+    int n = palette_size >> shift8;
+    for (int i = 0; i < n; i++) {
+      rgb[INDEX8_PALETTE + i] = palette_rgb[i << shift8];
+    }
+    return INDEX8_PALETTE + n;
+  }
+
   result_t paint_finished() {
+    uint32_t cost_us = (uint32_t)(get_time_us() - paint_start_us);
+    paint_cost_us = (paint_cost_us * 3 + cost_us) / 4;
+    last_paint_ms = get_time_ms();
     paint_requested = false;
+    paint_pending_pixels = false;
+    clear_dirty();
     return result_t::SUCCESS;
   }
 
  private:
-  FIXBROT_INLINE iter_t work_buff_read(pos_t x, pos_t y) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
-      return 0;
-    }
+  struct buffers_t {
+    uint8_t *heap_block = nullptr;
+    uint32_t queue_depth = 0;
+    vec_t *queue = nullptr;
 #if FIXBROT_ITER_12BIT
-    int i = y * stride + x * 3 / 2;
-    if (x % 2 == 0) {
-      return work_buff[i] | ((work_buff[i + 1] & 0x0F) << 8);
-    } else {
-      return ((work_buff[i] & 0xF0) >> 4) | (work_buff[i + 1] << 4);
-    }
+    uint8_t *work_buff = nullptr;
+    uint8_t *copy_buff = nullptr;
 #else
-    return work_buff[y * width + x];
+    iter_t *work_buff = nullptr;
 #endif
+    col_t *color_lut = nullptr;
+    pos_t *paint_x_buff = nullptr;
+    pos_t *paint_y_buff = nullptr;
+    pos_t *dirty_tx0 = nullptr;
+    pos_t *dirty_tx1 = nullptr;
+    bool *tile_loaded = nullptr;
+    uint32_t *overflow_bits = nullptr;
+  };
+
+  static constexpr pos_t num_dirty_rows(pos_t height) {
+    return (height + COARSE_POS_STEP - 1) / COARSE_POS_STEP;
   }
 
-  FIXBROT_INLINE void work_buff_write(pos_t x, pos_t y, iter_t val) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
-      return;
-    }
+  static constexpr uint32_t num_overflow_words(pos_t width, pos_t height) {
+    return ((uint32_t)width * height + 31) / 32;
+  }
+
+  static constexpr buffers_t carve_buffers(Arena &arena, pos_t width,
+                                           pos_t height,
+                                           uint32_t queue_depth) {
+    buffers_t b;
+    b.queue_depth = (queue_depth == 0) ? default_queue_depth(width, height)
+                    : (queue_depth < 2) ? 2
+                                        : queue_depth;
+    b.queue = arena.alloc<vec_t>(b.queue_depth);
 #if FIXBROT_ITER_12BIT
-    int i = y * stride + x * 3 / 2;
-    if (x % 2 == 0) {
-      work_buff[i] = val & 0xFF;
-      work_buff[i + 1] = (work_buff[i + 1] & 0xF0) | ((val >> 8) & 0x0F);
-    } else {
-      work_buff[i] = (work_buff[i] & 0x0F) | ((val << 4) & 0xF0);
-      work_buff[i + 1] = (val >> 4) & 0xFF;
-    }
+    b.work_buff = arena.alloc<uint8_t>((size_t)(width * 3 / 2) * height);
+    b.copy_buff = arena.alloc<uint8_t>(width * 3 / 2);
 #else
-    work_buff[y * width + x] = val;
+    b.work_buff = arena.alloc<iter_t>((size_t)width * height);
 #endif
+    // paint_row_simd() reads one entry past the end
+    b.color_lut = arena.alloc<col_t>(COLOR_LUT_SIZE + FIXBROT_COLOR_LUT_SIMD);
+    b.paint_x_buff = arena.alloc<pos_t>(width);
+    b.paint_y_buff = arena.alloc<pos_t>(height);
+    b.dirty_tx0 = arena.alloc<pos_t>(num_dirty_rows(height));
+    b.dirty_tx1 = arena.alloc<pos_t>(num_dirty_rows(height));
+    b.tile_loaded = arena.alloc<bool>((width / TileCache::TILE_SIZE + 2) *
+                                      (height / TileCache::TILE_SIZE + 2));
+    b.overflow_bits = arena.alloc<uint32_t>(num_overflow_words(width, height));
+    return b;
   }
 
-  void update_pixel_step() {
-    scene.step = real_exp2(-scale_exp - screen_size_clog2);
+#ifndef FIXBROT_NO_STDLIB
+  static buffers_t carve_heap(pos_t width, pos_t height,
+                              uint32_t queue_depth) {
+    size_t bytes = get_arena_bytes(width, height, queue_depth);
+    uint8_t *block = new uint8_t[bytes];
+    Arena arena(block, bytes);
+    buffers_t b = carve_buffers(arena, width, height, queue_depth);
+    b.heap_block = block;
+    return b;
   }
+#endif
 
-  result_t scan_vert(pos_t x0, pos_t x1, pos_t y0, pos_t h) {
-    cell_t a = get_cell(x0, y0);
-    cell_t c = get_cell(x1, y0);
-    for (pos_t y = y0; y < y0 + h - 1; y++) {
-      cell_t b = get_cell(x0, y + 1);
-      cell_t d = get_cell(x1, y + 1);
-      FIXBROT_TRY(compare(a, b, c, d));
-      a = b;
-      c = d;
+  Renderer(pos_t width, pos_t height, const buffers_t &b)
+      : width(width),
+        height(height),
+        heap_block(b.heap_block),
+        queue(b.queue_depth, b.queue),
+#if FIXBROT_ITER_12BIT
+        stride(width * 3 / 2),
+        work_buff(b.work_buff),
+        copy_buff(b.copy_buff),
+#else
+        work_buff(b.work_buff),
+#endif
+        color_lut(b.color_lut),
+        paint_x_buff(b.paint_x_buff),
+        paint_y_buff(b.paint_y_buff),
+        dirty_rows(num_dirty_rows(height)),
+        dirty_tx0(b.dirty_tx0),
+        dirty_tx1(b.dirty_tx1),
+        tile_loaded(b.tile_loaded),
+        overflow_bits(b.overflow_bits) {
+    pos_t p = width > height ? width : height;
+    while (p > 0) {
+      screen_size_clog2++;
+      p /= 2;
     }
-    return result_t::SUCCESS;
-  }
-
-  result_t scan_hori(pos_t x0, pos_t y0, pos_t y1, pos_t w) {
-    cell_t a = get_cell(x0, y0);
-    cell_t c = get_cell(x0, y1);
-    for (pos_t x = x0; x < x0 + w - 1; x++) {
-      cell_t b = get_cell(x + 1, y0);
-      cell_t d = get_cell(x + 1, y1);
-      FIXBROT_TRY(compare(a, b, c, d));
-      a = b;
-      c = d;
+    // an exhausted arena hands out nothing after the first failure, so the
+    // last buffer carved tells whether all of them were
+    if (!has_buffers()) return;
+    for (uint32_t i = 0; i < num_overflow_words(width, height); i++) {
+      overflow_bits[i] = 0;
     }
-    return result_t::SUCCESS;
+    clear_dirty();
   }
 
-  result_t clear_rect(rect_t view) {
-#if FIXBROT_ITER_12BIT
-    for (pos_t y = 0; y < view.h; y++) {
-      pos_t x0 = view.x;
-      pos_t x1 = view.x + view.w;
-      if (x0 % 2 == 1) {
-        work_buff_write(x0, view.y + y, 0);
-      }
-      int ix0 = (x0 + 1) / 2 * 3;
-      int ix1 = x1 / 2 * 3;
-      int n = ix1 - ix0;
-      if (n > 0) {
-        memset(work_buff + (view.y + y) * stride + ix0, 0, n);
-      }
-      if (x1 % 2 == 1) {
-        work_buff_write(x1 - 1, view.y + y, 0);
+  FIXBROT_INLINE iter_t read_preview(pos_t sx, pos_t sy) const {
+    iter_t iter = work_buff_read(sx & 0xFFFE, sy & 0xFFFE);
+    if (iter == ITER_BLANK || iter == ITER_QUEUED) {
+      constexpr pos_t MASK = ~(COARSE_POS_STEP - 1);
+      pos_t sx2 = (sx & MASK) + (COARSE_POS_STEP / 2);
+      pos_t sy2 = (sy & MASK) + (COARSE_POS_STEP / 2);
+      iter = work_buff_read(sx2, sy2);
+      if (iter == ITER_QUEUED) {
+        iter = ITER_BLANK;
       }
     }
-#else
-    iter_t *line_ptr = work_buff + (view.y * width + view.x);
-    for (pos_t i = 0; i < view.h; i++) {
-      memset(line_ptr, 0, sizeof(iter_t) * view.w);
-      line_ptr += width;
+    return iter;
+  }
+
+  // unfinished pixel, previewed with a darkened neighbor
+  FIXBROT_INLINE col_t preview_color(pos_t sx, pos_t sy) const {
+    iter_t iter = read_preview(sx, sy);
+    col_t c = lookup_color(iter);
+    if (ITER_BLANK != iter && iter <= ITER_MAX) {
+      c = color_to_display(color_div2(color_from_display(c)));
     }
-#endif
-    return result_t::SUCCESS;
+    return c;
   }
 
-  result_t fill_blank() {
-#if FIXBROT_ITER_12BIT
-    for (pos_t y = 0; y < height; y++) {
-      iter_t last = 1;
-      for (pos_t x = 0; x < width; x++) {
-        iter_t iter = work_buff_read(x, y);
-        if (iter == ITER_BLANK) {
-          work_buff_write(x, y, last);
-        } else {
-          last = iter;
-        }
-      }
+  FIXBROT_INLINE rgb888_t iter_to_rgb(iter_t iter) const {
+    if (ITER_BLANK == iter) {
+      return 0;
+    } else if (iter > ITER_MAX) {
+      return rgb888_pack(0xFF, 0xFF, 0x00);
+    } else if (iter >= scene.max_iter) {
+      return max_iter_rgb;
+    } else {
+      return palette_rgb[(iter + palette_phase) & (palette_size - 1)];
     }
-#else
-    iter_t *line_ptr = work_buff;
-    for (pos_t y = 0; y < height; y++) {
-      iter_t *ptr = line_ptr;
+  }
+
+  FIXBROT_INLINE uint8_t iter_to_index8(iter_t iter, int shift8) const {
+    if (ITER_BLANK == iter) {
+      return INDEX8_BLANK;
+    } else if (iter > ITER_MAX) {
+      return INDEX8_QUEUED;
+    } else if (iter >= scene.max_iter) {
+      return INDEX8_INSIDE;
+    } else {
+      int i = (iter + palette_phase) & (palette_size - 1);
+      return INDEX8_PALETTE + (i >> shift8);
+    }
+  }
+
+  int get_palette8_shift() const {
+    int shift = 0;
+    while ((palette_size >> shift) > MAX_PALETTE8_SIZE) shift++;
+    return shift;
+  }
+
+  // display color of a finished pixel
+  FIXBROT_INLINE col_t compute_color(iter_t iter) const {
+    col_t c;
+    if (ITER_BLANK == iter) {
+      c = 0x0000;
+    } else if (iter <= ITER_MAX) {
+      c = max_iter_color;
+      if (iter < scene.max_iter) {
+        c = palette[(iter + palette_phase) & (palette_size - 1)];
+      }
+    } else {
+      c = color_pack_from_888(0xFF, 0xFF, 0x00);
+    }
+    return color_to_display(c);
+  }
+
+  FIXBROT_INLINE col_t lookup_color(iter_t iter) const {
+    if (iter < COLOR_LUT_SIZE) {
+      return color_lut[iter];
+    }
+    return compute_color(iter);
+  }
+
+#if FIXBROT_COLOR_LUT_SIMD
+  // paint_line() of `w` pixels read 1:1 from (x, y), 8 at a time where all
+  // of them are finished and within the table
+  void paint_row_simd(pos_t x, pos_t y, pos_t w, col_t *dst) const {
+    static_assert(ITER_BLANK == 0, "blank lanes are found by comparing to 0");
+    const iter_t *src = work_buff + y * width + x;
+    const __m128i limit = _mm_set1_epi16(COLOR_LUT_SIZE - 1);
+    const __m128i zero = _mm_setzero_si128();
+    pos_t ix = 0;
+    for (; ix + 8 <= w; ix += 8) {
+      __m128i iters = _mm_loadu_si128((const __m128i *)(src + ix));
+      __m128i in_lut = _mm_cmpeq_epi16(_mm_min_epu16(iters, limit), iters);
+      __m128i blank = _mm_cmpeq_epi16(iters, zero);
+      if (_mm_movemask_epi8(_mm_andnot_si128(blank, in_lut)) != 0xFFFF) {
+        // blank pixels or counts above the table
+        for (int i = 0; i < 8; i++) {
+          iter_t iter = src[ix + i];
+          dst[ix + i] = (iter != ITER_BLANK) ? lookup_color(iter)
+                                             : preview_color(x + ix + i, y);
+        }
+        continue;
+      }
+#ifdef __AVX2__
+      // 32-bit gathers at 2-byte steps, the table has an entry of padding
+      __m256i colors = _mm256_i32gather_epi32(
+          (const int *)color_lut, _mm256_cvtepu16_epi32(iters), 2);
+      colors = _mm256_and_si256(colors, _mm256_set1_epi32(0xFFFF));
+      _mm_storeu_si128((__m128i *)(dst + ix),
+                       _mm_packus_epi32(_mm256_castsi256_si128(colors),
+                                        _mm256_extracti128_si256(colors, 1)));
+#else
+      const col_t *lut = color_lut;
+      __m128i colors = _mm_setr_epi16(
+          lut[_mm_extract_epi16(iters, 0)], lut[_mm_extract_epi16(iters, 1)],
+          lut[_mm_extract_epi16(iters, 2)], lut[_mm_extract_epi16(iters, 3)],
+          lut[_mm_extract_epi16(iters, 4)], lut[_mm_extract_epi16(iters, 5)],
+          lut[_mm_extract_epi16(iters, 6)], lut[_mm_extract_epi16(iters, 7)]);
+      _mm_storeu_si128((__m128i *)(dst + ix), colors);
+#endif
+    }
+    for (; ix < w; ix++) {
+      iter_t iter = src[ix];
+      dst[ix] = (iter != ITER_BLANK) ? lookup_color(iter)
+                                     : preview_color(x + ix, y);
+    }
+  }
+#endif
+
+  // one row of paint_rect() showing work buffer row `sy`
+  void paint_row(pos_t x, pos_t sy, pos_t w, pos_t ix0, pos_t ix1,
+                 col_t *dst) const {
+    if (paint_unscaled) {
+#if FIXBROT_COLOR_LUT_SIMD
+      paint_row_simd(x, sy, w, dst);
+#else
+      // screen and work buffer match, read the row sequentially
+      row_reader_t rd(*this, x, sy);
+      for (pos_t ix = 0; ix < w; ix++) {
+        iter_t iter = rd.next();
+        if (iter != ITER_BLANK) {
+          dst[ix] = lookup_color(iter);
+        } else {
+          dst[ix] = preview_color(x + ix, sy);
+        }
+      }
+#endif
+      return;
+    }
+
+    const pos_t *xs = paint_x_buff + x;
+    for (pos_t ix = 0; ix < ix0; ix++) dst[ix] = 0x0000;
+    pos_t last_sx = -1;
+    for (pos_t ix = ix0; ix < ix1; ix++) {
+      pos_t sx = xs[ix];
+      if (sx == last_sx) {
+        dst[ix] = dst[ix - 1];
+        continue;
+      }
+      last_sx = sx;
+      iter_t iter = work_buff_read(sx, sy);
+      if (iter != ITER_BLANK) {
+        dst[ix] = lookup_color(iter);
+      } else {
+        dst[ix] = preview_color(sx, sy);
+      }
+    }
+    for (pos_t ix = ix1; ix < w; ix++) dst[ix] = 0x0000;
+  }
+
+  void update_color_lut() {
+    for (int i = 0; i < COLOR_LUT_SIZE; i++) {
+      color_lut[i] = compute_color(i);
+    }
+    color_lut_max_iter = scene.max_iter;
+    color_lut_valid = true;
+  }
+
+  FIXBROT_INLINE void request_full_repaint() {
+    paint_requested = true;
+    dirty_all = true;
+  }
+
+  // every pixel affects only the preview of its own tile, see paint_line()
+  FIXBROT_INLINE void mark_dirty(pos_t x, pos_t y) {
+    pos_t tx = x >> COARSE_POS_BITS;
+    pos_t ty = y >> COARSE_POS_BITS;
+    if (tx < dirty_tx0[ty]) dirty_tx0[ty] = tx;
+    if (tx > dirty_tx1[ty]) dirty_tx1[ty] = tx;
+  }
+
+  void clear_dirty() {
+    for (pos_t ty = 0; ty < dirty_rows; ty++) {
+      dirty_tx0[ty] = width;
+      dirty_tx1[ty] = -1;
+    }
+    dirty_all = false;
+  }
+
+  void update_paint_request(uint64_t now_ms) {
+    if (paint_requested || !paint_pending_pixels) return;
+    uint32_t interval_ms = paint_interval_ms;
+    uint32_t cost_ms = paint_cost_us * (PAINT_COST_RATIO - 1) / 1000;
+    if (interval_ms < cost_ms) {
+      interval_ms = cost_ms;
+    }
+    if (now_ms - last_paint_ms >= interval_ms) {
+      paint_requested = true;
+    }
+  }
+
+  // Maps screen coordinates to work buffer coordinates around the center
+  // by stepping a fixed point position, no multiplication per element.
+  // The position takes 64 bits since size times scale may not fit in 32,
+  // and coordinates outside the buffer become -1.
+  void scale_coords(pos_t *buff, pos_t size) {
+    if (paint_scale == PAINT_SCALE_ONE) {
+      for (pos_t i = 0; i < size; i++) {
+        buff[i] = i;
+      }
+      return;
+    }
+    int64_t center = size / 2;
+    int64_t pos = center * (PAINT_SCALE_ONE - paint_scale);
+    for (pos_t i = 0; i < size; i++) {
+      int64_t coord = pos >> PAINT_SCALE_BITS;
+      buff[i] = (coord < 0 || coord >= size) ? -1 : (pos_t)coord;
+      pos += paint_scale;
+    }
+  }
+
+  void update_zoom_animation(uint64_t now_ms) {
+    paint_scale = PAINT_SCALE_ONE;
+    if (paint_zoom_inprog) {
+      int32_t t = (int32_t)(paint_zoom_end_ms - now_ms);
+      if (t < 0) {
+        t = 0;
+        paint_zoom_inprog = false;
+      }
+      request_full_repaint();
+      if (paint_zoom_dir_in) {
+        paint_scale = PAINT_SCALE_ONE + t * PAINT_SCALE_ONE / ZOOM_DURATION_MS;
+      } else {
+        paint_scale =
+            PAINT_SCALE_ONE - t * PAINT_SCALE_ONE / (ZOOM_DURATION_MS * 2);
+      }
+    }
+  }
+
+#if FIXBROT_ITER_12BIT
+  // Pixels 2n and 2n + 1 of a row are packed in 3 bytes and handled as one
+  // little-endian 24 bit word, the even pixel in the lower 12 bits. Words
+  // are assembled from bytes since they are not aligned.
+  static constexpr uint32_t PAIR_MASK = 0xFFF;
+  static constexpr int PAIR_SHIFT = 12;
+
+  FIXBROT_INLINE uint8_t *pair_pointer(pos_t x, pos_t y) const {
+    return work_buff + y * stride + (x >> 1) * 3;
+  }
+
+  static FIXBROT_INLINE uint32_t load_pair(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  }
+
+  static FIXBROT_INLINE void store_pair(uint8_t *p, uint32_t pair) {
+    p[0] = pair & 0xFF;
+    p[1] = (pair >> 8) & 0xFF;
+    p[2] = (pair >> 16) & 0xFF;
+  }
+#endif
+
+  // reads a row of the work buffer from left to right
+  class row_reader_t {
+   public:
+#if FIXBROT_ITER_12BIT
+    row_reader_t(const Renderer &r, pos_t x, pos_t y)
+        : row_reader_t(r.pair_pointer(0, y), x) {}
+
+    // from pixel `x` of a packed row, e.g. one copied to copy_buff
+    row_reader_t(const uint8_t *row, pos_t x)
+        : ptr(row + (x >> 1) * 3), odd(x & 1) {
+      if (odd) {
+        pair = load_pair(ptr);
+        ptr += 3;
+      }
+    }
+
+    FIXBROT_INLINE iter_t next() {
+      odd = !odd;
+      if (odd) {
+        pair = load_pair(ptr);
+        ptr += 3;
+        return pair & PAIR_MASK;
+      }
+      return pair >> PAIR_SHIFT;
+    }
+
+   private:
+    const uint8_t *ptr;
+    uint32_t pair = 0;
+    bool odd;
+#else
+    row_reader_t(const Renderer &r, pos_t x, pos_t y)
+        : ptr(r.work_buff + y * r.width + x) {}
+
+    FIXBROT_INLINE iter_t next() { return *(ptr++); }
+
+   private:
+    const iter_t *ptr;
+#endif
+  };
+
+  // writes a row of the work buffer from left to right, without marking it
+  // dirty; flush() stores a last pixel left without its pair
+  class row_writer_t {
+   public:
+#if FIXBROT_ITER_12BIT
+    row_writer_t(Renderer &r, pos_t x, pos_t y)
+        : ptr(r.pair_pointer(x, y)), odd(x & 1) {
+      if (odd) pair = load_pair(ptr) & PAIR_MASK;
+    }
+
+    FIXBROT_INLINE void put(iter_t iter) {
+      if (odd) {
+        store_pair(ptr, pair | ((uint32_t)iter << PAIR_SHIFT));
+        ptr += 3;
+      } else {
+        pair = iter;
+      }
+      odd = !odd;
+    }
+
+    FIXBROT_INLINE void flush() {
+      if (odd) store_pair(ptr, (load_pair(ptr) & ~PAIR_MASK) | pair);
+    }
+
+   private:
+    uint8_t *ptr;
+    uint32_t pair = 0;
+    bool odd;
+#else
+    row_writer_t(Renderer &r, pos_t x, pos_t y)
+        : ptr(r.work_buff + y * r.width + x) {}
+
+    FIXBROT_INLINE void put(iter_t iter) { *(ptr++) = iter; }
+    FIXBROT_INLINE void flush() {}
+
+   private:
+    iter_t *ptr;
+#endif
+  };
+
+  FIXBROT_INLINE iter_t work_buff_read(pos_t x, pos_t y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+      return 0;
+    }
+#if FIXBROT_ITER_12BIT
+    // the two bytes holding the pixel, odd pixels are 4 bits up
+    const uint8_t *p = pair_pointer(x, y) + (x & 1);
+    return ((p[0] | (p[1] << 8)) >> ((x & 1) * 4)) & PAIR_MASK;
+#else
+    return work_buff[y * width + x];
+#endif
+  }
+
+  FIXBROT_INLINE void work_buff_write(pos_t x, pos_t y, iter_t val) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+      return;
+    }
+    mark_dirty(x, y);
+#if FIXBROT_ITER_12BIT
+    // only the two bytes holding the pixel change
+    uint8_t *p = pair_pointer(x, y);
+    if (x & 1) {
+      p[1] = (p[1] & 0x0F) | ((val << 4) & 0xF0);
+      p[2] = (val >> 4) & 0xFF;
+    } else {
+      p[0] = val & 0xFF;
+      p[1] = (p[1] & 0xF0) | ((val >> 8) & 0x0F);
+    }
+#else
+    work_buff[y * width + x] = val;
+#endif
+  }
+
+  void init_home_view() {
+    scene.formula = formula_t::MANDELBROT;
+    scene.real = -0.5f;
+    scene.imag = 0;
+    scene.max_iter = 200;
+
+    scale_exp = -2;
+    update_pixel_step();
+
+    load_builtin_palette(builtin_palette_t::HEATMAP, DEFAULT_PALETTE_SLOPE);
+  }
+
+  void apply_view(formula_t formula, real_t real, real_t imag, int exp,
+                  iter_t max_iter) {
+    cache_store_tiles();
+    scene.formula = formula;
+    scene.real = real;
+    scene.imag = imag;
+    scene.max_iter = clamp((iter_t)100, ITER_MAX, max_iter);
+    scale_exp = (exp < MIN_SCALE_EXP) ? MIN_SCALE_EXP : exp;
+    update_pixel_step();
+  }
+
+  void update_pixel_step() {
+    scene.step = real_exp2(-scale_exp - screen_size_clog2);
+  }
+
+  result_t scan_vert(pos_t x0, pos_t x1, pos_t y0, pos_t h) {
+    cell_t a = get_cell(x0, y0);
+    cell_t c = get_cell(x1, y0);
+    for (pos_t y = y0; y < y0 + h - 1; y++) {
+      cell_t b = get_cell(x0, y + 1);
+      cell_t d = get_cell(x1, y + 1);
+      FIXBROT_TRY(compare(a, b, c, d));
+      a = b;
+      c = d;
+    }
+    return result_t::SUCCESS;
+  }
+
+  result_t scan_hori(pos_t x0, pos_t y0, pos_t y1, pos_t w) {
+    cell_t a = get_cell(x0, y0);
+    cell_t c = get_cell(x0, y1);
+    for (pos_t x = x0; x < x0 + w - 1; x++) {
+      cell_t b = get_cell(x + 1, y0);
+      cell_t d = get_cell(x + 1, y1);
+      FIXBROT_TRY(compare(a, b, c, d));
+      a = b;
+      c = d;
+    }
+    return result_t::SUCCESS;
+  }
+
+  // Row `dy` of the view zoomed in around its center: its even pixels are
+  // those of row `sy` from width / 4 on, the odd ones blank. `sy` may be
+  // `dy`.
+  void upscale_row(pos_t dy, pos_t sy) {
+#if FIXBROT_ITER_12BIT
+    memcpy(copy_buff, pair_pointer(0, sy), stride);
+    row_reader_t rd(copy_buff, width / 4);
+    uint8_t *dst = pair_pointer(0, dy);
+    for (pos_t x = 0; x < width; x += 2, dst += 3) {
+      store_pair(dst, rd.next() | ((uint32_t)ITER_BLANK << PAIR_SHIFT));
+    }
+#else
+    // outwards from the center, so that each pixel is read before the
+    // row overwrites it
+    const iter_t *src = work_buff + sy * width + width / 4;
+    iter_t *dst = work_buff + dy * width;
+    for (pos_t x = 0; x < width / 2; x++) {
+      dst[x] = (x & 1) ? ITER_BLANK : src[x / 2];
+    }
+    for (pos_t x = width - 1; x >= width / 2; x--) {
+      dst[x] = (x & 1) ? ITER_BLANK : src[x / 2];
+    }
+#endif
+    mark_dirty(0, dy);
+    mark_dirty(width - 1, dy);
+  }
+
+  // Row `dy` of the view zoomed out around its center: pixel x is pixel
+  // 2 * x - width / 2 of row `sy`, blank past its edges. `sy` may be `dy`.
+  void downscale_row(pos_t dy, pos_t sy) {
+    // pixels [x0, x1) are in row `sy`
+    const pos_t x0 = (width / 2 + 1) / 2;
+    const pos_t x1 = (width + width / 2 + 1) / 2;
+#if FIXBROT_ITER_12BIT
+    memcpy(copy_buff, pair_pointer(0, sy), stride);
+    row_reader_t rd(copy_buff, 2 * x0 - width / 2);
+    row_writer_t wr(*this, 0, dy);
+    for (pos_t x = 0; x < x0; x++) wr.put(ITER_BLANK);
+    for (pos_t x = x0; x < x1; x++) {
+      if (x > x0) rd.next();
+      wr.put(rd.next());
+    }
+    for (pos_t x = x1; x < width; x++) wr.put(ITER_BLANK);
+    wr.flush();
+#else
+    // inwards to the center, so that each pixel is read before the row
+    // overwrites it
+    const iter_t *src = work_buff + sy * width;
+    iter_t *dst = work_buff + dy * width;
+    for (pos_t x = width / 2 - 1; x >= 0; x--) {
+      dst[x] = (x < x0) ? ITER_BLANK : src[2 * x - width / 2];
+    }
+    for (pos_t x = width / 2; x < width; x++) {
+      dst[x] = (x >= x1) ? ITER_BLANK : src[2 * x - width / 2];
+    }
+#endif
+    mark_dirty(0, dy);
+    mark_dirty(width - 1, dy);
+  }
+
+  result_t clear_rect(rect_t view) {
+    dirty_all = true;
+#if FIXBROT_ITER_12BIT
+    for (pos_t y = 0; y < view.h; y++) {
+      pos_t x0 = view.x;
+      pos_t x1 = view.x + view.w;
+      if (x0 % 2 == 1) {
+        work_buff_write(x0, view.y + y, 0);
+      }
+      int ix0 = (x0 + 1) / 2 * 3;
+      int ix1 = x1 / 2 * 3;
+      int n = ix1 - ix0;
+      if (n > 0) {
+        memset(work_buff + (view.y + y) * stride + ix0, 0, n);
+      }
+      if (x1 % 2 == 1) {
+        work_buff_write(x1 - 1, view.y + y, 0);
+      }
+    }
+#else
+    iter_t *line_ptr = work_buff + (view.y * width + view.x);
+    for (pos_t i = 0; i < view.h; i++) {
+      memset(line_ptr, 0, sizeof(iter_t) * view.w);
+      line_ptr += width;
+    }
+#endif
+    return result_t::SUCCESS;
+  }
+
+  // fills blank pixels row by row until done or past the deadline
+  result_t fill_blank(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_FILL_BLANK);
+    while (fill_y < height) {
+      pos_t y = fill_y++;
+#if FIXBROT_ITER_12BIT
+      // two pixels per step, rewriting a pair only if it has a blank
+      uint8_t *ptr = pair_pointer(0, y);
+      iter_t last = 1;
+      pos_t x = 0;
+      for (; x + 1 < width; x += 2, ptr += 3) {
+        uint32_t pair = load_pair(ptr);
+        iter_t iter0 = pair & PAIR_MASK;
+        iter_t iter1 = pair >> PAIR_SHIFT;
+        if (iter0 != ITER_BLANK && iter1 != ITER_BLANK) {
+          last = iter1;
+          continue;
+        }
+        if (iter0 == ITER_BLANK) {
+          iter0 = last;
+          stats.fill_blank_pixels++;
+        }
+        if (iter1 == ITER_BLANK) {
+          iter1 = iter0;
+          stats.fill_blank_pixels++;
+        }
+        last = iter1;
+        store_pair(ptr, iter0 | ((uint32_t)iter1 << PAIR_SHIFT));
+        mark_dirty(x, y);
+      }
+      if (x < width && work_buff_read(x, y) == ITER_BLANK) {
+        work_buff_write(x, y, last);
+        stats.fill_blank_pixels++;
+      }
+#else
+      iter_t *ptr = work_buff + y * width;
       iter_t last = 1;
       for (pos_t x = 0; x < width; x++) {
         iter_t iter = *ptr;
         if (iter == ITER_BLANK) {
           *ptr = last;
+          mark_dirty(x, y);
+          stats.fill_blank_pixels++;
         } else {
           last = iter;
         }
         ptr++;
       }
-      line_ptr += width;
-    }
 #endif
+      if (is_past(deadline_us)) break;
+    }
     return result_t::SUCCESS;
   }
 
-  scene_t get_worker_args() {
-    scene_t s = scene;
-    s.real -= scene.step * (width / 2);
-    s.imag -= scene.step * (height / 2);
-    return s;
+  static FIXBROT_INLINE bool is_past(uint64_t deadline_us) {
+    return (deadline_us != NO_DEADLINE) && (get_time_us() >= deadline_us);
   }
 
   result_t start_render(bool post_correction) {
+    FIXBROT_TRY(reset_render(post_correction));
+
+    for (pos_t y = COARSE_POS_STEP / 2; y < height; y += COARSE_POS_STEP) {
+      for (pos_t x = COARSE_POS_STEP / 2; x < width; x += COARSE_POS_STEP) {
+        enqueue(vec_t{x, y});
+      }
+    }
+
+    for (pos_t x = 0; x < width; x++) {
+      enqueue(vec_t{x, 0});
+      enqueue(vec_t{x, (pos_t)(height - 1)});
+    }
+    for (pos_t y = 1; y < height - 1; y++) {
+      enqueue(vec_t{0, y});
+      enqueue(vec_t{(pos_t)(width - 1), y});
+    }
+
+    return result_t::SUCCESS;
+  }
+
+  // starts a render with nothing queued, the caller seeds it
+  result_t reset_render(bool post_correction) {
     if (is_busy()) {
       return result_t::ERROR_BUSY;
     }
 
     const scene_t s = get_worker_args();
     on_render_start(s);
+    render_max_iter = s.max_iter;
 
     queue.clear();
+    clear_overflowed();
+    prefetch_active = false;
     busy_items = 0;
     correct_x = 0;
     correct_y = post_correction ? 0 : height;
-    iter_accum = 0;
+    fill_y = 0;
 
-    for (pos_t y = COARSE_POS_STEP / 2; y < height; y += COARSE_POS_STEP) {
-      for (pos_t x = COARSE_POS_STEP / 2; x < width; x += COARSE_POS_STEP) {
-        enqueue(vec_t{x, y});
+    stats = render_stats_t{};
+    stats.queue_capacity = queue.depth - 1;
+    stats.start_ms = get_time_ms();
+    return result_t::SUCCESS;
+  }
+
+  // saves the finished view to the zoom history
+  void history_push() {
+    if (!zoom_history || is_busy() || !stats.finished) return;
+    zoom_history->push_begin(scene, scale_exp);
+    for (pos_t y = 0; y < height; y++) {
+      row_reader_t rd(*this, 0, y);
+      for (pos_t x = 0; x < width; x++) {
+        if (!zoom_history->push_pixel(rd.next())) return;
       }
     }
+    zoom_history->push_end();
+  }
 
-    for (pos_t x = 0; x < width; x++) {
-      enqueue(vec_t{x, 0});
-      enqueue(vec_t{x, (pos_t)(height - 1)});
+  // restores the view from the zoom history as a finished render, false if
+  // the newest saved view is a different one
+  bool history_pop() {
+    if (!zoom_history || !zoom_history->pop(scene, scale_exp)) return false;
+    for (pos_t y = 0; y < height; y++) {
+      row_writer_t wr(*this, 0, y);
+      for (pos_t x = 0; x < width; x++) wr.put(zoom_history->pop_pixel());
+      wr.flush();
     }
-    for (pos_t y = 1; y < height - 1; y++) {
-      enqueue(vec_t{0, y});
-      enqueue(vec_t{(pos_t)(width - 1), y});
+    restore_finished_view();
+    return true;
+  }
+
+  // marks the work buffer, filled with a saved view, as a finished render
+  void restore_finished_view() {
+    dirty_all = true;
+    paint_pending_pixels = true;
+
+    queue.clear();
+    clear_overflowed();
+    busy_items = 0;
+    correct_y = height;
+    fill_y = height;
+    render_max_iter = scene.max_iter;
+    stats = render_stats_t{};
+    stats.queue_capacity = queue.depth - 1;
+    stats.start_ms = get_time_ms();
+    stats.finished = true;
+    // the render this replaces may have been in progress
+    on_render_finished(result_t::SUCCESS);
+    prefetch_restart();
+  }
+
+  // the work buffer is partially overwritten, render the current view again
+  result_t rerender_after_bad_snapshot() {
+    clear_rect(rect_t{0, 0, width, height});
+    FIXBROT_TRY(start_render(true));
+    request_full_repaint();
+    return result_t::ERROR_BAD_SNAPSHOT;
+  }
+
+  // start_render() with whole tiles of the view taken from the tile cache
+  result_t start_render_cached(bool post_correction) {
+    int num_loaded = cache_load_tiles();
+    FIXBROT_TRY(start_render(post_correction));
+    stats.tiles_loaded = num_loaded;
+    if (num_loaded > 0) {
+      FIXBROT_TRY(cache_scan_seams());
     }
+    return result_t::SUCCESS;
+  }
 
+  // buffer position of the first whole tile and its key, false if the view
+  // is not aligned to the pixel grid of its scale (e.g. after set_view())
+  FIXBROT_INLINE bool get_tile_grid(pos_t *x0, pos_t *y0,
+                                    tile_key_t *key) const {
+    return get_tile_grid(scale_exp, x0, y0, key);
+  }
+
+  // same for the view with the same center at scale `exp`
+  bool get_tile_grid(int exp, pos_t *x0, pos_t *y0, tile_key_t *key) const {
+    constexpr int T = TileCache::TILE_SIZE;
+    int shift = fixed64_t::FRAC_BITS - exp - screen_size_clog2;
+    if (shift <= 0 || shift >= 63) return false;
+    const real_t step = real_exp2(-exp - screen_size_clog2);
+    const real_t re = scene.real - step * (width / 2);
+    const real_t im = scene.imag - step * (height / 2);
+    int64_t mask = ((int64_t)1 << shift) - 1;
+    if ((re.raw & mask) || (im.raw & mask)) return false;
+    int64_t gx = re.raw >> shift;
+    int64_t gy = im.raw >> shift;
+    *x0 = (pos_t)(-gx & (T - 1));
+    *y0 = (pos_t)(-gy & (T - 1));
+    key->formula = scene.formula;
+    key->scale_exp = exp;
+    key->max_iter = scene.max_iter;
+    key->tx = (gx + *x0) >> TileCache::TILE_SIZE_BITS;
+    key->ty = (gy + *y0) >> TileCache::TILE_SIZE_BITS;
+    return true;
+  }
+
+  // copies finished whole tiles of the view to the tile cache
+  void cache_store_tiles() {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (!tile_cache || is_busy() || !stats.finished) return;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return;
+    key.max_iter = render_max_iter;
+    int64_t tx0 = key.tx;
+    for (pos_t y = y0; y + T <= height; y += T, key.ty++) {
+      key.tx = tx0;
+      for (pos_t x = x0; x + T <= width; x += T, key.tx++) {
+        if (tile_cache->contains(key)) continue;
+        bool finished = true;
+        for (pos_t i = 0; finished && i < T; i++) {
+          row_reader_t rd(*this, x, y + i);
+          for (pos_t j = 0; j < T; j++) {
+            iter_t iter = rd.next();
+            if (iter == ITER_BLANK || iter > ITER_MAX) {
+              finished = false;
+              break;
+            }
+          }
+        }
+        if (!finished) continue;
+        iter_t *dst = tile_cache->insert(key);
+        if (!dst) return;
+        for (pos_t i = 0; i < T; i++) {
+          row_reader_t rd(*this, x, y + i);
+          for (pos_t j = 0; j < T; j++) *(dst++) = rd.next();
+        }
+      }
+    }
+  }
+
+  // fills tiles of the view, including those cut by its edges, that have
+  // blank pixels from the tile cache; returns the number of tiles filled
+  int cache_load_tiles() {
+    constexpr int T = TileCache::TILE_SIZE;
+    const int tiles_x = width / T + 2;
+    for (int i = 0; i < tiles_x * (height / T + 2); i++) {
+      tile_loaded[i] = false;
+    }
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!tile_cache || !get_tile_grid(&x0, &y0, &key)) return 0;
+    if (x0 > 0) {
+      x0 -= T;
+      key.tx--;
+    }
+    if (y0 > 0) {
+      y0 -= T;
+      key.ty--;
+    }
+    int num_loaded = 0;
+    int64_t tx0 = key.tx;
+    int row = 0;
+    for (pos_t y = y0; y < height; y += T, key.ty++, row++) {
+      key.tx = tx0;
+      int i_tile = row * tiles_x;
+      pos_t i0 = (y < 0) ? -y : 0;
+      pos_t i1 = (y + T > height) ? (height - y) : T;
+      for (pos_t x = x0; x < width; x += T, key.tx++, i_tile++) {
+        pos_t j0 = (x < 0) ? -x : 0;
+        pos_t j1 = (x + T > width) ? (width - x) : T;
+        bool has_blank = false;
+        for (pos_t i = i0; !has_blank && i < i1; i++) {
+          row_reader_t rd(*this, x + j0, y + i);
+          for (pos_t j = j0; j < j1; j++) {
+            if (rd.next() == ITER_BLANK) {
+              has_blank = true;
+              break;
+            }
+          }
+        }
+        if (!has_blank) continue;
+        const iter_t *src = tile_cache->find(key);
+        if (!src) continue;
+        for (pos_t i = i0; i < i1; i++) {
+          row_writer_t wr(*this, x + j0, y + i);
+          for (pos_t j = j0; j < j1; j++) wr.put(src[i * T + j]);
+          wr.flush();
+          mark_dirty(x + j0, y + i);
+          mark_dirty(x + j1 - 1, y + i);
+        }
+        tile_loaded[i_tile] = true;
+        num_loaded++;
+      }
+    }
+    return num_loaded;
+  }
+
+  // seeds tracing from the edges of the tiles filled by cache_load_tiles()
+  result_t cache_scan_seams() {
+    constexpr int T = TileCache::TILE_SIZE;
+    const int tiles_x = width / T + 2;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return result_t::SUCCESS;
+    if (x0 > 0) x0 -= T;
+    if (y0 > 0) y0 -= T;
+    int row = 0;
+    for (pos_t y = y0; y < height; y += T, row++) {
+      int i_tile = row * tiles_x;
+      for (pos_t x = x0; x < width; x += T, i_tile++) {
+        if (!tile_loaded[i_tile]) continue;
+        // edges outside the view are walls and seed nothing
+        FIXBROT_TRY(scan_vert(x, x - 1, y, T));
+        FIXBROT_TRY(scan_vert(x + T - 1, x + T, y, T));
+        FIXBROT_TRY(scan_hori(x, y, y - 1, T));
+        FIXBROT_TRY(scan_hori(x, y + T - 1, y + T, T));
+      }
+    }
     return result_t::SUCCESS;
   }
 
-  result_t iterate() {
+  void prefetch_restart() {
+    prefetch_active = (tile_cache != nullptr);
+    prefetch_tile_inprog = false;
+    prefetch_zoom = false;
+    prefetch_index = 0;
+    prefetch_pending = 0;
+  }
+
+  void prefetch_abort() {
+    queue.clear();
+    prefetch_pending = 0;
+    prefetch_tile_inprog = false;
+    prefetch_active = false;
+  }
+
+  // Collects results of the tile being prefetched and starts the next one
+  // when it is complete: first the tiles within PREFETCH_MARGIN of the
+  // view, then those of the view zoom_in() would show. Does nothing once
+  // all of them are cached.
+  //
+  // A tile is border-traced like the view, within its own square: from
+  // its edges and a coarse grid, then corrected and filled.
+  result_t prefetch_service() {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (!prefetch_active) return result_t::SUCCESS;
+
+    cell_t c;
+    while (prefetch_pending > 0 && on_collect(&c)) {
+      int j = c.loc.x - prefetch_x;
+      int i = c.loc.y - prefetch_y;
+      if (j < 0 || T <= j || i < 0 || T <= i) continue;
+      if (prefetch_pixels[i * T + j] != ITER_QUEUED) continue;
+      prefetch_pixels[i * T + j] = c.iter;
+      prefetch_pending--;
+      if (!prefetch_trace_around(j, i, c.iter)) return result_t::SUCCESS;
+    }
+    if (prefetch_pending > 0) return result_t::SUCCESS;
+
+    if (prefetch_tile_inprog) {
+      if (!prefetch_correct()) return result_t::SUCCESS;
+      if (prefetch_pending > 0) return result_t::SUCCESS;
+      prefetch_fill();
+      iter_t *dst = tile_cache->insert(prefetch_key);
+      if (dst) {
+        memcpy(dst, prefetch_pixels, sizeof(iter_t) * TileCache::TILE_PIXELS);
+        stats.tiles_prefetched++;
+      }
+      prefetch_tile_inprog = false;
+    }
+
+    if (render_max_iter != scene.max_iter) {
+      // pixels of the view do not match the current max_iter
+      prefetch_active = false;
+      return result_t::SUCCESS;
+    }
+    if (!prefetch_zoom) {
+      if (prefetch_start_margin_tile()) return result_t::SUCCESS;
+      prefetch_zoom = true;
+      prefetch_index = 0;
+    }
+    if (prefetch_active && prefetch_start_zoom_tile()) {
+      return result_t::SUCCESS;
+    }
+    prefetch_active = false;
+    return result_t::SUCCESS;
+  }
+
+  // starts computing the next uncached tile around the view, false if there
+  // is none
+  bool prefetch_start_margin_tile() {
+    constexpr int T = TileCache::TILE_SIZE;
+    pos_t x0, y0;
+    tile_key_t key;
+    if (!get_tile_grid(&x0, &y0, &key)) return false;
+
+    // tiles overlapping the margin, in row-major order
+    int nx0 = (x0 + PREFETCH_MARGIN + T - 1) / T;
+    int ny0 = (y0 + PREFETCH_MARGIN + T - 1) / T;
+    pos_t xa = x0 - nx0 * T;
+    pos_t ya = y0 - ny0 * T;
+    int nx = (width + PREFETCH_MARGIN - xa + T - 1) / T;
+    int ny = (height + PREFETCH_MARGIN - ya + T - 1) / T;
+    int64_t tx0 = key.tx - nx0;
+    int64_t ty0 = key.ty - ny0;
+
+    for (; prefetch_index < nx * ny; prefetch_index++) {
+      int col = prefetch_index % nx;
+      int row = prefetch_index / nx;
+      pos_t x = xa + col * T;
+      pos_t y = ya + row * T;
+      if (0 <= x && x + T <= width && 0 <= y && y + T <= height) continue;
+      key.tx = tx0 + col;
+      key.ty = ty0 + row;
+      if (tile_cache->contains(key)) continue;
+
+      // Pixels in the view are known already, trace the rest. As they lie
+      // outside the work buffer, late results can never be mistaken for
+      // those of a render started meanwhile.
+      prefetch_x = x;
+      prefetch_y = y;
+      for (pos_t i = 0; i < T; i++) {
+        pos_t py = y + i;
+        iter_t *dst = prefetch_pixels + i * T;
+        for (pos_t j = 0; j < T; j++) dst[j] = ITER_BLANK;
+        if (py < 0 || height <= py) continue;
+        // the span of the row within the view
+        pos_t j0 = (x < 0) ? -x : 0;
+        pos_t j1 = (x + T > width) ? (width - x) : T;
+        row_reader_t rd(*this, x + j0, py);
+        for (pos_t j = j0; j < j1; j++) dst[j] = rd.next();
+      }
+      if (!prefetch_seed()) return false;
+      prefetch_begin_tile(get_worker_args(), key);
+      return true;
+    }
+    return false;
+  }
+
+  // Starts computing the next uncached tile of the view at scale_exp + 1,
+  // false if there is none. Pixels on the even grid are those of the view,
+  // unless the precision changes with the scale.
+  bool prefetch_start_zoom_tile() {
+    constexpr int T = TileCache::TILE_SIZE;
+    pos_t cx0, cy0, x0, y0;
+    tile_key_t ckey, key;
+    if (!get_tile_grid(&cx0, &cy0, &ckey)) return false;
+    if (!get_tile_grid(scale_exp + 1, &x0, &y0, &key)) return false;
+
+    // pixel grid positions of both views
+    int64_t gx = ckey.tx * T - cx0;
+    int64_t gy = ckey.ty * T - cy0;
+    int64_t zgx = key.tx * T - x0;
+    int64_t zgy = key.ty * T - y0;
+
+    scene_t s = get_worker_args();
+    s.step = real_exp2(-scale_exp - 1 - screen_size_clog2);
+    s.real = scene.real - s.step * (width / 2);
+    s.imag = scene.imag - s.step * (height / 2);
+    bool reuse = (s.step.is_fixed32() == scene.step.is_fixed32());
+
+    // pixels are addressed right of the work buffer, see above
+    const pos_t loc_offset = width + T;
+    s.real -= s.step * loc_offset;
+
+    // tiles overlapping the view, in row-major order
+    if (x0 > 0) {
+      x0 -= T;
+      key.tx--;
+    }
+    if (y0 > 0) {
+      y0 -= T;
+      key.ty--;
+    }
+    int nx = (width - x0 + T - 1) / T;
+    int ny = (height - y0 + T - 1) / T;
+    int64_t tx0 = key.tx;
+    int64_t ty0 = key.ty;
+
+    for (; prefetch_index < nx * ny; prefetch_index++) {
+      int col = prefetch_index % nx;
+      int row = prefetch_index / nx;
+      pos_t x = x0 + col * T;
+      pos_t y = y0 + row * T;
+      key.tx = tx0 + col;
+      key.ty = ty0 + row;
+      if (tile_cache->contains(key)) continue;
+
+      prefetch_x = x + loc_offset;
+      prefetch_y = y;
+      for (pos_t i = 0; i < T; i++) {
+        int64_t zy = zgy + y + i;
+        pos_t sy = (pos_t)((zy >> 1) - gy);
+        for (pos_t j = 0; j < T; j++) {
+          int64_t zx = zgx + x + j;
+          pos_t sx = (pos_t)((zx >> 1) - gx);
+          bool even = ((zx | zy) & 1) == 0;
+          if (reuse && even && 0 <= sx && sx < width && 0 <= sy &&
+              sy < height) {
+            prefetch_pixels[i * T + j] = work_buff_read(sx, sy);
+          } else {
+            prefetch_pixels[i * T + j] = ITER_BLANK;
+          }
+        }
+      }
+      if (!prefetch_seed()) return false;
+      prefetch_begin_tile(s, key);
+      return true;
+    }
+    return false;
+  }
+
+  // queues a pixel of the tile being prefetched, aborts prefetching and
+  // returns false if the queue is full
+  bool prefetch_enqueue(pos_t x, pos_t y) {
+    if (queue.enqueue(vec_t{x, y}) != result_t::SUCCESS) {
+      prefetch_abort();
+      return false;
+    }
+    prefetch_pending++;
+    return true;
+  }
+
+  // queues pixel (j, i) of the tile being prefetched if it is blank, false
+  // if prefetching was aborted
+  FIXBROT_INLINE bool prefetch_trace(int j, int i) {
+    constexpr int T = TileCache::TILE_SIZE;
+    iter_t &p = prefetch_pixels[i * T + j];
+    if (p != ITER_BLANK) return true;
+    p = ITER_QUEUED;
+    return prefetch_enqueue(prefetch_x + j, prefetch_y + i);
+  }
+
+  // seeds tracing of the tile as start_render() seeds the view
+  bool prefetch_seed() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int k = 0; k < T; k++) {
+      if (!prefetch_trace(k, 0) || !prefetch_trace(k, T - 1) ||
+          !prefetch_trace(0, k) || !prefetch_trace(T - 1, k)) {
+        return false;
+      }
+    }
+    for (int i = COARSE_POS_STEP / 2; i < T; i += COARSE_POS_STEP) {
+      for (int j = COARSE_POS_STEP / 2; j < T; j += COARSE_POS_STEP) {
+        if (!prefetch_trace(j, i)) return false;
+      }
+    }
+    return true;
+  }
+
+  FIXBROT_INLINE iter_t prefetch_get(int j, int i) const {
+    constexpr int T = TileCache::TILE_SIZE;
+    if (j < 0 || T <= j || i < 0 || T <= i) return ITER_WALL;
+    return prefetch_pixels[i * T + j];
+  }
+
+  // see compare(), for the pixel of value `a` with neighbour (bj, bi)
+  FIXBROT_INLINE bool prefetch_compare(iter_t a, int bj, int bi, int cj,
+                                       int ci, int dj, int di) {
+    iter_t b = prefetch_get(bj, bi);
+    if (b == ITER_BLANK || b == ITER_QUEUED || b == ITER_WALL || b == a) {
+      return true;
+    }
+    if (prefetch_get(cj, ci) == ITER_BLANK && !prefetch_trace(cj, ci)) {
+      return false;
+    }
+    if (prefetch_get(dj, di) == ITER_BLANK && !prefetch_trace(dj, di)) {
+      return false;
+    }
+    return true;
+  }
+
+  // traces on from pixel (j, i) of the tile as iterate() does in the view
+  bool prefetch_trace_around(int j, int i, iter_t a) {
+    return prefetch_compare(a, j, i - 1, j - 1, i, j - 1, i - 1) &&
+           prefetch_compare(a, j, i + 1, j - 1, i, j - 1, i + 1) &&
+           prefetch_compare(a, j, i - 1, j + 1, i, j + 1, i - 1) &&
+           prefetch_compare(a, j, i + 1, j + 1, i, j + 1, i + 1) &&
+           prefetch_compare(a, j - 1, i, j, i - 1, j - 1, i - 1) &&
+           prefetch_compare(a, j + 1, i, j, i - 1, j + 1, i - 1) &&
+           prefetch_compare(a, j - 1, i, j, i + 1, j - 1, i + 1) &&
+           prefetch_compare(a, j + 1, i, j, i + 1, j + 1, i + 1);
+  }
+
+  // Queues the middle of each blank run between pixels of different values
+  // in a row, which tracing from its result closes as correct() does in the
+  // view. Nothing is queued once the runs can be filled; false if
+  // prefetching was aborted.
+  bool prefetch_correct() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int i = 0; i < T; i++) {
+      const iter_t *row = prefetch_pixels + i * T;
+      int j0 = 0;
+      for (int j = 1; j < T; j++) {
+        if (row[j] == ITER_BLANK) continue;
+        if (j - j0 > 1 && row[j] != row[j0] &&
+            !prefetch_trace((j0 + j) / 2, i)) {
+          return false;
+        }
+        j0 = j;
+      }
+    }
+    return true;
+  }
+
+  // fills blank pixels of the tile from their left neighbours, the edges
+  // are traced
+  void prefetch_fill() {
+    constexpr int T = TileCache::TILE_SIZE;
+    for (int i = 0; i < T; i++) {
+      iter_t *row = prefetch_pixels + i * T;
+      for (int j = 1; j < T; j++) {
+        if (row[j] == ITER_BLANK) row[j] = row[j - 1];
+      }
+    }
+  }
+
+  void prefetch_begin_tile(const scene_t &s, const tile_key_t &key) {
+    on_prefetch_start(s);
+    prefetch_key = key;
+    prefetch_tile_inprog = true;
+    prefetch_index++;
+  }
+
+  result_t iterate(uint64_t deadline_us, bool *progress) {
+    *progress = false;
     if (!is_busy()) {
       return result_t::SUCCESS;
     }
 
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_ITERATE);
+
     // border-tracing
     for (int i_batch = 0; i_batch < BATCH_SIZE; i_batch++) {
+      if ((i_batch & 15) == 15 && is_past(deadline_us)) break;
       cell_t c;
       if (!collect(&c)) break;
-      if (c.iter == ITER_MAX) {
-        iter_accum += scene.max_iter;
-      } else {
-        iter_accum += c.iter;
-      }
+      *progress = true;
+      stats.total_iters += (c.iter == ITER_MAX) ? scene.max_iter : c.iter;
       pos_t x = c.loc.x;
       pos_t y = c.loc.y;
       work_buff_write(x, y, c.iter);
@@ -743,46 +2256,50 @@ class Renderer {
       FIXBROT_TRY(compare(c, r, d, rd));
     }
 
-    uint32_t iter_thresh = (uint32_t)width * height * 4;
-    if (is_animating()) {
-      iter_thresh /= 8;
+    if (*progress) {
+      paint_pending_pixels = true;
     }
-    if (scene.step.is_fixed32()) {
-      iter_thresh *= 2;
+
+    if (num_overflowed > 0) {
+      requeue_overflowed();
     }
-    if (iter_accum >= iter_thresh) {
-      iter_accum = 0;
-      paint_requested = true;
+
+    if (busy_items == 0 && correct_y < height) {
+      correct(deadline_us);
+      *progress = true;
     }
 
-    if (busy_items == 0) {
-      correct();
+    if (busy_items == 0 && correct_y >= height && fill_y < height) {
+      fill_blank(deadline_us);
+      *progress = true;
     }
 
     if (!is_busy()) {
-      // fill blanks
-      fill_blank();
+      stats.render_ms = (uint32_t)(get_time_ms() - stats.start_ms);
+      stats.finished = true;
       on_render_finished(result_t::SUCCESS);
       paint_requested = true;
+      prefetch_restart();
     }
 
     return result_t::SUCCESS;
   }
 
-  void correct() {
+  void correct(uint64_t deadline_us) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::RENDERER_CORRECT);
     scene_t s = get_worker_args();
 
     while (correct_y < height) {
+      if (correct_x == 0 && is_past(deadline_us)) return;
       pos_t x0 = -1;
       iter_t iter0 = ITER_BLANK;
       int blank_count = 0;
+#if !FIXBROT_ITER_12BIT
       int line_ptr = correct_y * width;
-      while (correct_x < width) {
-#if FIXBROT_ITER_12BIT
-        iter_t iter1 = work_buff_read(correct_x, correct_y);
-#else
-        iter_t iter1 = work_buff[line_ptr + correct_x];
 #endif
+      row_reader_t rd(*this, correct_x, correct_y);
+      while (correct_x < width) {
+        iter_t iter1 = rd.next();
         if (iter1 == ITER_BLANK || ITER_MAX < iter1) {
           // count blank pixel
           blank_count++;
@@ -804,10 +2321,13 @@ class Renderer {
         while (x0 + 1 < x1) {
           pos_t xm = (x1 + x0) / 2;
           iter_t iter_m = Mandelbrot::compute(s, vec_t{xm, correct_y});
+          stats.correct_computes++;
+          stats.total_iters += iter_m;
 #if FIXBROT_ITER_12BIT
           work_buff_write(xm, correct_y, iter_m);
 #else
           work_buff[line_ptr + xm] = iter_m;
+          mark_dirty(xm, correct_y);
 #endif
           if (iter_m == iter0) {
             x0 = xm;
@@ -894,46 +2414,95 @@ class Renderer {
     work_buff_write(loc.x, loc.y, ITER_QUEUED);
 #else
     work_buff[i] = ITER_QUEUED;
+    mark_dirty(loc.x, loc.y);
 #endif
-    FIXBROT_TRY(queue.enqueue(loc));
     busy_items++;
+    stats.cells_enqueued++;
+    if (queue.enqueue(loc) != result_t::SUCCESS) {
+      // trace it later instead of aborting the render
+      uint32_t bit = (uint32_t)loc.y * width + loc.x;
+      overflow_bits[bit / 32] |= 1u << (bit % 32);
+      num_overflowed++;
+      stats.cells_overflowed++;
+      return result_t::SUCCESS;
+    }
+    uint32_t depth = queue.size();
+    if (depth > stats.queue_peak) {
+      stats.queue_peak = depth;
+    }
     return result_t::SUCCESS;
   }
 
+  // moves pixels of the overflow bitmap to the queue while it has room,
+  // resuming the scan where the last call stopped
+  void requeue_overflowed() {
+    const uint32_t num_words = num_overflow_words(width, height);
+    for (uint32_t n = 0; n < num_words && num_overflowed > 0; n++) {
+      uint32_t &word = overflow_bits[overflow_scan];
+      while (word != 0) {
+        if (queue.full()) return;
+        int bit = count_trailing_zeros(word);
+        uint32_t i = overflow_scan * 32 + bit;
+        queue.enqueue(vec_t{(pos_t)(i % width), (pos_t)(i / width)});
+        word &= word - 1;
+        num_overflowed--;
+      }
+      if (++overflow_scan >= num_words) overflow_scan = 0;
+    }
+  }
+
+  void clear_overflowed() {
+    if (num_overflowed > 0) {
+      for (uint32_t i = 0; i < num_overflow_words(width, height); i++) {
+        overflow_bits[i] = 0;
+      }
+      num_overflowed = 0;
+    }
+    overflow_scan = 0;
+  }
+
   bool collect(cell_t *cell) {
-    if (on_collect(cell)) {
+    while (on_collect(cell)) {
+      // drop late results of an aborted prefetch, which are outside the view
+      if (work_buff_read(cell->loc.x, cell->loc.y) != ITER_QUEUED) continue;
       busy_items--;
+      stats.cells_collected++;
       return true;
-    } else {
-      return false;
     }
+    return false;
+  }
+
+  void set_palette_color(int i, uint8_t r, uint8_t g, uint8_t b) {
+    palette[i] = color_pack_from_888(r, g, b);
+    palette_rgb[i] = rgb888_pack(r, g, b);
   }
 
   void palette_load_heatmap(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       int p = i * (256 * 6) / palette_size;
       int c = p / 256;
       int f = p % 256;
       switch (c) {
         case 0:
-          palette[i] = color_pack_from_888(0, f / 4, f);
+          set_palette_color(i, 0, f / 4, f);
           break;
         case 1:
-          palette[i] = color_pack_from_888(0, 64 + f / 2, 255);
+          set_palette_color(i, 0, 64 + f / 2, 255);
           break;
         case 2:
-          palette[i] = color_pack_from_888(f, 192 + f / 4, 255);
+          set_palette_color(i, f, 192 + f / 4, 255);
           break;
         case 3:
-          palette[i] = color_pack_from_888(255, 255 - f / 4, 255 - f);
+          set_palette_color(i, 255, 255 - f / 4, 255 - f);
           break;
         case 4:
-          palette[i] = color_pack_from_888(255, 191 - f / 2, 0);
+          set_palette_color(i, 255, 191 - f / 2, 0);
           break;
         default:
-          palette[i] = color_pack_from_888(255 - f, 63 - f / 4, 0);
+          set_palette_color(i, 255 - f, 63 - f / 4, 0);
           break;
       }
     }
@@ -942,28 +2511,29 @@ class Renderer {
   void palette_load_rainbow(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       int p = i * (256 * 6) / palette_size;
       int c = p / 256;
       int f = p % 256;
       switch (c) {
         case 0:
-          palette[i] = color_pack_from_888(255, f, 0);
+          set_palette_color(i, 255, f, 0);
           break;
         case 1:
-          palette[i] = color_pack_from_888(255 - f, 255, 0);
+          set_palette_color(i, 255 - f, 255, 0);
           break;
         case 2:
-          palette[i] = color_pack_from_888(0, 255, f);
+          set_palette_color(i, 0, 255, f);
           break;
         case 3:
-          palette[i] = color_pack_from_888(0, 255 - f, 255);
+          set_palette_color(i, 0, 255 - f, 255);
           break;
         case 4:
-          palette[i] = color_pack_from_888(f, 0, 255);
+          set_palette_color(i, f, 0, 255);
           break;
         default:
-          palette[i] = color_pack_from_888(255, 0, 255 - f);
+          set_palette_color(i, 255, 0, 255 - f);
           break;
       }
     }
@@ -972,23 +2542,25 @@ class Renderer {
   void palette_load_gray(int slope) {
     palette_size = MAX_PALETTE_SIZE >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       uint16_t gray = i * 512 / palette_size;
       if (gray >= 256) {
         gray = 511 - gray;
       }
-      palette[i] = color_pack_from_888(gray, gray, gray);
+      set_palette_color(i, gray, gray, gray);
     }
   }
 
   void palette_load_stripe(int slope) {
     palette_size = 64 >> slope;
     max_iter_color = 0x0000;
+    max_iter_rgb = 0;
     for (uint16_t i = 0; i < palette_size; i++) {
       if (i < palette_size / 2) {
-        palette[i] = color_pack_from_888(224, 224, 224);
+        set_palette_color(i, 224, 224, 224);
       } else {
-        palette[i] = color_pack_from_888(32, 32, 32);
+        set_palette_color(i, 32, 32, 32);
       }
     }
   }
@@ -0,0 +1,257 @@
+#ifndef FIXBROT_ROW_RLE_BUFFER_HPP
+#define FIXBROT_ROW_RLE_BUFFER_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include "fixbrot/common.hpp"
+
+// grows its rows on the heap
+#ifndef FIXBROT_NO_STDLIB
+
+namespace fixbrot {
+
+// Iteration counts stored as runs of equal values per row, for canvases too
+// large for a dense buffer. Border tracing leaves large areas of a single
+// count, so a finished row usually holds a few dozen runs instead of
+// `width` pixels.
+//
+// Each row remembers the run accessed last and searches from there, so
+// reading along a row or around a pixel (as painting and tracing do) costs
+// O(1) amortized. Writes split or merge runs in place.
+//
+// The renderer does not use it: a read costs several times a dense one,
+// and rows of fine detail, with runs of two or three pixels, take more
+// memory than dense. row_rle_bench in test/ measures both against the
+// dense layout.
+class RowRleBuffer {
+  // run counts and capacities of a row are at most `width`
+  static_assert(sizeof(pos_t) <= sizeof(uint16_t),
+                "row run counts must hold any width");
+
+ public:
+  // run of `iter` from `x` up to the start of the next run
+  struct run_t {
+    pos_t x;
+    iter_t iter;
+  };
+
+  const pos_t width;
+  const pos_t height;
+
+ private:
+  struct row_t {
+    run_t *runs;
+    uint16_t num_runs;
+    uint16_t capacity;
+    uint16_t cursor;
+  };
+
+  row_t *rows;
+
+ public:
+  RowRleBuffer(pos_t width, pos_t height)
+      : width(width), height(height), rows(new row_t[height]) {
+    for (pos_t y = 0; y < height; y++) {
+      rows[y].runs = nullptr;
+      rows[y].capacity = 0;
+    }
+    clear();
+  }
+
+  ~RowRleBuffer() {
+    for (pos_t y = 0; y < height; y++) {
+      delete[] rows[y].runs;
+    }
+    delete[] rows;
+  }
+
+  // makes every pixel ITER_BLANK
+  void clear() {
+    for (pos_t y = 0; y < height; y++) {
+      row_t &row = rows[y];
+      reserve(row, 1);
+      row.runs[0] = run_t{0, ITER_BLANK};
+      row.num_runs = 1;
+      row.cursor = 0;
+    }
+  }
+
+  // replaces row `y` with `width` pixels from `pixels`
+  void store_row(pos_t y, const iter_t *pixels) {
+    row_t &row = rows[y];
+    uint16_t n = 1;
+    for (pos_t x = 1; x < width; x++) {
+      if (pixels[x] != pixels[x - 1]) n++;
+    }
+    reserve(row, n);
+    row.runs[0] = run_t{0, pixels[0]};
+    n = 1;
+    for (pos_t x = 1; x < width; x++) {
+      if (pixels[x] != pixels[x - 1]) {
+        row.runs[n++] = run_t{x, pixels[x]};
+      }
+    }
+    row.num_runs = n;
+    row.cursor = 0;
+  }
+
+  // copies pixels [x0, x0 + w) of row `y` to `dst`
+  void read_row(pos_t y, pos_t x0, pos_t w, iter_t *dst) {
+    row_t &row = rows[y];
+    int i = find(row, x0);
+    pos_t x = x0;
+    const pos_t x1 = x0 + w;
+    while (x < x1) {
+      pos_t end = run_end(row, i);
+      if (end > x1) end = x1;
+      iter_t iter = row.runs[i].iter;
+      for (; x < end; x++) *(dst++) = iter;
+      i++;
+    }
+    row.cursor = (i > 0) ? (i - 1) : 0;
+  }
+
+  FIXBROT_INLINE iter_t read(pos_t x, pos_t y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return ITER_BLANK;
+    row_t &row = rows[y];
+    return row.runs[find(row, x)].iter;
+  }
+
+  void write(pos_t x, pos_t y, iter_t val) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    row_t &row = rows[y];
+    int i = find(row, x);
+    run_t *r = row.runs;
+    if (r[i].iter == val) return;
+
+    pos_t start = r[i].x;
+    pos_t end = run_end(row, i);
+    bool join_prev = (x == start) && (i > 0) && (r[i - 1].iter == val);
+    bool join_next =
+        (x == end - 1) && (i + 1 < row.num_runs) && (r[i + 1].iter == val);
+
+    if (start == end - 1) {
+      // the run is the pixel itself
+      if (join_prev && join_next) {
+        remove_runs(row, i, 2);
+        row.cursor = i - 1;
+      } else if (join_prev) {
+        remove_runs(row, i, 1);
+        row.cursor = i - 1;
+      } else if (join_next) {
+        remove_runs(row, i, 1);
+        row.runs[i].x = x;
+      } else {
+        r[i].iter = val;
+      }
+    } else if (x == start) {
+      if (join_prev) {
+        r[i].x = x + 1;
+        row.cursor = i - 1;
+      } else {
+        insert_runs(row, i, 1);
+        row.runs[i] = run_t{x, val};
+        row.runs[i + 1].x = x + 1;
+      }
+    } else if (x == end - 1) {
+      if (join_next) {
+        r[i + 1].x = x;
+        row.cursor = i + 1;
+      } else {
+        insert_runs(row, i + 1, 1);
+        row.runs[i + 1] = run_t{x, val};
+      }
+    } else {
+      // split the run around the pixel
+      insert_runs(row, i + 1, 2);
+      row.runs[i + 1] = run_t{x, val};
+      row.runs[i + 2] = run_t{(pos_t)(x + 1), row.runs[i].iter};
+      row.cursor = i + 1;
+    }
+  }
+
+  // total number of runs of all rows
+  uint32_t get_num_runs() const {
+    uint32_t n = 0;
+    for (pos_t y = 0; y < height; y++) n += rows[y].num_runs;
+    return n;
+  }
+
+  // bytes allocated for the rows and their runs
+  size_t get_memory_bytes() const {
+    size_t bytes = sizeof(row_t) * height;
+    for (pos_t y = 0; y < height; y++) {
+      bytes += sizeof(run_t) * rows[y].capacity;
+    }
+    return bytes;
+  }
+
+ private:
+  FIXBROT_INLINE pos_t run_end(const row_t &row, int i) const {
+    return (i + 1 < row.num_runs) ? row.runs[i + 1].x : width;
+  }
+
+  // index of the run containing `x`, searching outward from the cursor and
+  // falling back to bisection for distant pixels
+  FIXBROT_INLINE int find(row_t &row, pos_t x) {
+    int i = row.cursor;
+    const run_t *r = row.runs;
+    if (r[i].x <= x && x < run_end(row, i)) return i;
+    if (i + 1 < row.num_runs && r[i + 1].x <= x && x < run_end(row, i + 1)) {
+      row.cursor = i + 1;
+      return i + 1;
+    }
+    if (i > 0 && r[i - 1].x <= x && x < r[i].x) {
+      row.cursor = i - 1;
+      return i - 1;
+    }
+    int lo = 0, hi = row.num_runs - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (r[mid].x <= x) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    row.cursor = lo;
+    return lo;
+  }
+
+  void reserve(row_t &row, int n) {
+    if (n <= row.capacity) return;
+    int cap = row.capacity ? row.capacity : 4;
+    while (cap < n) cap *= 2;
+    if (cap > width) cap = width;
+    run_t *runs = new run_t[cap];
+    if (row.runs) {
+      memcpy(runs, row.runs, sizeof(run_t) * row.num_runs);
+      delete[] row.runs;
+    }
+    row.runs = runs;
+    row.capacity = cap;
+  }
+
+  void insert_runs(row_t &row, int i, int n) {
+    reserve(row, row.num_runs + n);
+    memmove(row.runs + i + n, row.runs + i,
+            sizeof(run_t) * (row.num_runs - i));
+    row.num_runs += n;
+  }
+
+  void remove_runs(row_t &row, int i, int n) {
+    memmove(row.runs + i, row.runs + i + n,
+            sizeof(run_t) * (row.num_runs - i - n));
+    row.num_runs -= n;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef FIXBROT_SNAPSHOT_HPP
+#define FIXBROT_SNAPSHOT_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+// Snapshot of a view saved by Renderer::save_snapshot(). All integers are
+// little-endian:
+//
+//   u32 magic "FXBS"    u16 version        u16 width, height
+//   u8  formula         u8  vert_flip      u8  palette, palette_slope
+//   u16 palette_phase   i32 scale_exp      i64 real, imag, step (raw)
+//   u16 max_iter
+//   runs of pixels in row-major order: u16 iteration count followed by the
+//     run length minus one as LEB128, until width * height pixels
+//   u32 FNV-1a hash of the run bytes
+//
+// Iteration counts are stored with SNAPSHOT_ITER_MAX and
+// SNAPSHOT_ITER_QUEUED for the special values, so that snapshots are
+// exchangeable between 12 and 16 bit builds as long as max_iter fits.
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x53425846;
+static constexpr uint16_t SNAPSHOT_VERSION = 1;
+static constexpr uint16_t SNAPSHOT_ITER_MAX = 0xFFFD;
+static constexpr uint16_t SNAPSHOT_ITER_QUEUED = 0xFFFE;
+
+static FIXBROT_INLINE uint16_t snapshot_iter_from(iter_t iter) {
+  if (iter == ITER_MAX) return SNAPSHOT_ITER_MAX;
+  if (iter == ITER_QUEUED) return SNAPSHOT_ITER_QUEUED;
+  return iter;
+}
+
+// ITER_WALL for values that do not fit this build
+static FIXBROT_INLINE iter_t snapshot_iter_to(uint16_t value) {
+  if (value == SNAPSHOT_ITER_MAX) return ITER_MAX;
+  if (value == SNAPSHOT_ITER_QUEUED) return ITER_QUEUED;
+  if (value >= ITER_MAX) return ITER_WALL;
+  return value;
+}
+
+// Buffered output to a stream. `prm_TStream` provides:
+//
+//   // false on failure
+//   bool write(const void *data, size_t size);
+template <typename prm_TStream>
+class SnapshotWriter {
+ public:
+  static constexpr int BUFF_SIZE = 64;
+
+ private:
+  prm_TStream &stream;
+  uint8_t buff[BUFF_SIZE];
+  int buff_len = 0;
+  uint32_t hash = 2166136261u;
+  bool failed = false;
+
+ public:
+  SnapshotWriter(prm_TStream &stream) : stream(stream) {}
+
+  FIXBROT_INLINE void put_u8(uint8_t val) {
+    if (buff_len >= BUFF_SIZE) flush();
+    buff[buff_len++] = val;
+    hash = (hash ^ val) * 16777619u;
+  }
+
+  void put_u16(uint16_t val) {
+    put_u8(val);
+    put_u8(val >> 8);
+  }
+
+  void put_u32(uint32_t val) {
+    put_u16(val);
+    put_u16(val >> 16);
+  }
+
+  void put_u64(uint64_t val) {
+    put_u32(val);
+    put_u32(val >> 32);
+  }
+
+  void put_varint(uint32_t val) {
+    while (val >= 0x80) {
+      put_u8((val & 0x7F) | 0x80);
+      val >>= 7;
+    }
+    put_u8(val);
+  }
+
+  // hash of the bytes since the last reset_hash()
+  FIXBROT_INLINE uint32_t get_hash() const { return hash; }
+  FIXBROT_INLINE void reset_hash() { hash = 2166136261u; }
+
+  // false if any write to the stream has failed
+  bool flush() {
+    if (buff_len > 0 && !failed) {
+      failed = !stream.write(buff, buff_len);
+    }
+    buff_len = 0;
+    return !failed;
+  }
+};
+
+// Buffered input from a stream, which may be read up to BUFF_SIZE bytes
+// past the end of the snapshot. `prm_TStream` provides:
+//
+//   // number of bytes read into `data`, at most `size`; 0 at the end of
+//   // the stream or on failure
+//   size_t read(void *data, size_t size);
+template <typename prm_TStream>
+class SnapshotReader {
+ public:
+  static constexpr int BUFF_SIZE = 64;
+
+ private:
+  prm_TStream &stream;
+  uint8_t buff[BUFF_SIZE];
+  int buff_len = 0;
+  int buff_pos = 0;
+  uint32_t hash = 2166136261u;
+  bool failed = false;
+
+ public:
+  SnapshotReader(prm_TStream &stream) : stream(stream) {}
+
+  // 0 past the end of the stream, see is_failed()
+  FIXBROT_INLINE uint8_t get_u8() {
+    if (buff_pos >= buff_len && !fill()) return 0;
+    uint8_t val = buff[buff_pos++];
+    hash = (hash ^ val) * 16777619u;
+    return val;
+  }
+
+  uint16_t get_u16() {
+    uint16_t val = get_u8();
+    return val | ((uint16_t)get_u8() << 8);
+  }
+
+  uint32_t get_u32() {
+    uint32_t val = get_u16();
+    return val | ((uint32_t)get_u16() << 16);
+  }
+
+  uint64_t get_u64() {
+    uint64_t val = get_u32();
+    return val | ((uint64_t)get_u32() << 32);
+  }
+
+  uint32_t get_varint() {
+    uint32_t val = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b = get_u8();
+      val |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return val;
+    }
+    failed = true;
+    return 0;
+  }
+
+  FIXBROT_INLINE uint32_t get_hash() const { return hash; }
+  FIXBROT_INLINE void reset_hash() { hash = 2166136261u; }
+
+  // true if the stream ended early or a varint was malformed
+  FIXBROT_INLINE bool is_failed() const { return failed; }
+
+ private:
+  bool fill() {
+    buff_pos = 0;
+    buff_len = failed ? 0 : (int)stream.read(buff, BUFF_SIZE);
+    if (buff_len <= 0) {
+      buff_len = 0;
+      failed = true;
+      return false;
+    }
+    return true;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef FIXBROT_TILE_CACHE_HPP
+#define FIXBROT_TILE_CACHE_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#include "fixbrot/arena.hpp"
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+// Identifies a square of finished pixels. Tile coordinates are in units of
+// TileCache::TILE_SIZE pixels of the scale's pixel grid.
+struct tile_key_t {
+  formula_t formula;
+  int scale_exp;
+  iter_t max_iter;
+  int64_t tx;
+  int64_t ty;
+
+  FIXBROT_INLINE bool operator==(const tile_key_t &other) const {
+    return formula == other.formula && scale_exp == other.scale_exp &&
+           max_iter == other.max_iter && tx == other.tx && ty == other.ty;
+  }
+};
+
+// Least-recently-used cache of finished tiles within a fixed memory budget.
+// Tiles are found through a hash table of chained buckets and kept in a
+// list from the most to the least recently used, so lookups and inserts
+// take constant time however many tiles fit.
+class TileCache {
+ public:
+  static constexpr int TILE_SIZE_BITS = 5;
+  static constexpr int TILE_SIZE = 1 << TILE_SIZE_BITS;
+  static constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+  struct tile_t {
+    tile_key_t key;
+    // next tile of the same bucket, and neighbours in the recency list,
+    // -1 at the ends
+    int32_t bucket_next;
+    int32_t newer;
+    int32_t older;
+    bool valid;
+    iter_t pixels[TILE_PIXELS];
+  };
+
+  const int capacity;
+  const int num_buckets;
+
+ private:
+  // `capacity` cached tiles followed by one scratch tile
+  tile_t *tiles;
+  // first tile of each bucket, -1 if empty
+  int32_t *buckets;
+  bool owns_tiles = false;
+  int32_t newest = -1;
+  int32_t oldest = -1;
+  uint32_t num_hits = 0;
+  uint32_t num_misses = 0;
+
+ public:
+  TileCache(uint32_t budget_bytes, Arena &arena)
+      : capacity(num_tiles(budget_bytes)),
+        num_buckets(bucket_count(capacity)),
+        tiles(arena.alloc<tile_t>(capacity + 1)),
+        buckets(arena.alloc<int32_t>(num_buckets)) {
+    if (tiles && buckets) clear();
+  }
+
+#ifndef FIXBROT_NO_STDLIB
+  TileCache(uint32_t budget_bytes)
+      : capacity(num_tiles(budget_bytes)),
+        num_buckets(bucket_count(capacity)),
+        tiles(new tile_t[capacity + 1]),
+        buckets(new int32_t[num_buckets]),
+        owns_tiles(true) {
+    clear();
+  }
+
+  ~TileCache() {
+    if (owns_tiles) {
+      delete[] tiles;
+      delete[] buckets;
+    }
+  }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(uint32_t budget_bytes) {
+    return Arena::align_up(sizeof(tile_t) * (num_tiles(budget_bytes) + 1)) +
+           Arena::align_up(sizeof(int32_t) *
+                           bucket_count(num_tiles(budget_bytes)));
+  }
+
+  void clear() {
+    for (int i = 0; i < num_buckets; i++) {
+      buckets[i] = -1;
+    }
+    // every tile free, from the newest to the oldest
+    for (int i = 0; i < capacity; i++) {
+      tiles[i].valid = false;
+      tiles[i].bucket_next = -1;
+      tiles[i].newer = i - 1;
+      tiles[i].older = (i + 1 < capacity) ? (i + 1) : -1;
+    }
+    newest = (capacity > 0) ? 0 : -1;
+    oldest = capacity - 1;
+  }
+
+  // pixels of the tile, nullptr if not cached
+  const iter_t *find(const tile_key_t &key) {
+    int32_t i = lookup(key);
+    if (i < 0) {
+      num_misses++;
+      return nullptr;
+    }
+    num_hits++;
+    touch(i);
+    return tiles[i].pixels;
+  }
+
+  FIXBROT_INLINE bool contains(const tile_key_t &key) {
+    int32_t i = lookup(key);
+    if (i >= 0) touch(i);
+    return i >= 0;
+  }
+
+  // buffer to store the pixels of a new tile to, replacing the least
+  // recently used one; nullptr if the cache has no capacity
+  iter_t *insert(const tile_key_t &key) {
+    if (capacity <= 0) return nullptr;
+    int32_t i = lookup(key);
+    if (i < 0) {
+      i = oldest;
+      tile_t &t = tiles[i];
+      if (t.valid) unlink_bucket(i);
+      t.key = key;
+      t.valid = true;
+      int32_t &head = buckets[hash(key)];
+      t.bucket_next = head;
+      head = i;
+    }
+    touch(i);
+    return tiles[i].pixels;
+  }
+
+  // pixels of a tile outside the cache, for collecting one before insert()
+  FIXBROT_INLINE iter_t *get_scratch() { return tiles[capacity].pixels; }
+
+  FIXBROT_INLINE uint32_t get_num_hits() const { return num_hits; }
+  FIXBROT_INLINE uint32_t get_num_misses() const { return num_misses; }
+
+ private:
+  // tiles fitting in the budget besides the scratch tile, counting up to
+  // two bucket entries per tile
+  static constexpr int num_tiles(uint32_t budget_bytes) {
+    return (budget_bytes > sizeof(tile_t) + 2 * sizeof(int32_t))
+               ? (int)(budget_bytes /
+                       (sizeof(tile_t) + 2 * sizeof(int32_t))) -
+                     1
+               : 0;
+  }
+
+  // power of two of at least one bucket per tile
+  static constexpr int bucket_count(int capacity) {
+    int n = 1;
+    while (n < capacity) n *= 2;
+    return n;
+  }
+
+  FIXBROT_INLINE uint32_t hash(const tile_key_t &key) const {
+    uint32_t h = (uint32_t)key.tx * 0x9E3779B1u;
+    h ^= (uint32_t)key.ty * 0x85EBCA77u;
+    h ^= (uint32_t)key.scale_exp * 0xC2B2AE3Du;
+    h ^= ((uint32_t)key.max_iter << 8) | (uint32_t)key.formula;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 13;
+    return h & (num_buckets - 1);
+  }
+
+  int32_t lookup(const tile_key_t &key) const {
+    if (capacity <= 0) return -1;
+    for (int32_t i = buckets[hash(key)]; i >= 0; i = tiles[i].bucket_next) {
+      if (tiles[i].key == key) return i;
+    }
+    return -1;
+  }
+
+  void unlink_bucket(int32_t i) {
+    int32_t *link = &buckets[hash(tiles[i].key)];
+    while (*link != i) link = &tiles[*link].bucket_next;
+    *link = tiles[i].bucket_next;
+  }
+
+  // moves tile `i` to the front of the recency list
+  void touch(int32_t i) {
+    if (i == newest) return;
+    tile_t &t = tiles[i];
+    tiles[t.newer].older = t.older;
+    if (t.older >= 0) {
+      tiles[t.older].newer = t.newer;
+    } else {
+      oldest = t.newer;
+    }
+    t.newer = -1;
+    t.older = newest;
+    tiles[newest].newer = i;
+    newest = i;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef FIXBROT_TRACE_HPP
+#define FIXBROT_TRACE_HPP
+
+#ifndef FIXBROT_TRACE
+#define FIXBROT_TRACE (0)
+#endif
+
+#ifndef FIXBROT_TRACE_NUM_CORES
+#define FIXBROT_TRACE_NUM_CORES (2)
+#endif
+
+// number of records per core, must be a power of 2
+#ifndef FIXBROT_TRACE_DEPTH
+#define FIXBROT_TRACE_DEPTH (4096)
+#endif
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <stdio.h>
+#endif
+
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+enum class trace_event_t : uint8_t {
+  GUI_SERVICE,
+  GUI_PAINT_START,
+  GUI_PAINT_LINE,
+  RENDERER_ITERATE,
+  RENDERER_CORRECT,
+  RENDERER_FILL_BLANK,
+  FEED,
+  WORKER_SERVICE,
+  LAST,
+};
+
+static inline const char *get_trace_event_name(trace_event_t ev) {
+  switch (ev) {
+    case trace_event_t::GUI_SERVICE:
+      return "GUI::service";
+    case trace_event_t::GUI_PAINT_START:
+      return "GUI::paint_start";
+    case trace_event_t::GUI_PAINT_LINE:
+      return "GUI::paint_line";
+    case trace_event_t::RENDERER_ITERATE:
+      return "Renderer::iterate";
+    case trace_event_t::RENDERER_CORRECT:
+      return "Renderer::correct";
+    case trace_event_t::RENDERER_FILL_BLANK:
+      return "Renderer::fill_blank";
+    case trace_event_t::FEED:
+      return "feed";
+    case trace_event_t::WORKER_SERVICE:
+      return "Worker::service";
+    default:
+      return "(Unknown)";
+  }
+}
+
+#if FIXBROT_TRACE
+
+int get_core_id();
+
+struct trace_record_t {
+  uint32_t time_us;
+  trace_event_t event;
+  bool begin;
+};
+
+// Fixed-size ring of trace records. Each core writes only its own ring, so
+// recording needs no lock. Old records are overwritten when the ring is full.
+struct trace_ring_t {
+  static constexpr uint32_t DEPTH = FIXBROT_TRACE_DEPTH;
+  trace_record_t records[DEPTH];
+  volatile uint32_t wr_ptr;
+
+  FIXBROT_INLINE void record(trace_event_t ev, bool begin) {
+    uint32_t wp = wr_ptr;
+    trace_record_t &r = records[wp & (DEPTH - 1)];
+    r.time_us = (uint32_t)get_time_us();
+    r.event = ev;
+    r.begin = begin;
+    wr_ptr = wp + 1;
+  }
+
+  FIXBROT_INLINE uint32_t size() const {
+    return (wr_ptr < DEPTH) ? wr_ptr : DEPTH;
+  }
+
+  // i-th oldest record
+  FIXBROT_INLINE const trace_record_t &at(uint32_t i) const {
+    return records[(wr_ptr - size() + i) & (DEPTH - 1)];
+  }
+};
+
+trace_ring_t trace_rings[FIXBROT_TRACE_NUM_CORES];
+
+static FIXBROT_INLINE void trace_record(trace_event_t ev, bool begin) {
+  int core = get_core_id();
+  if (0 <= core && core < FIXBROT_TRACE_NUM_CORES) {
+    trace_rings[core].record(ev, begin);
+  }
+}
+
+static inline void trace_clear() {
+  for (int i = 0; i < FIXBROT_TRACE_NUM_CORES; i++) {
+    trace_rings[i].wr_ptr = 0;
+  }
+}
+
+class TraceScope {
+ public:
+  const trace_event_t event;
+  FIXBROT_INLINE TraceScope(trace_event_t ev) : event(ev) {
+    trace_record(event, true);
+  }
+  FIXBROT_INLINE ~TraceScope() { trace_record(event, false); }
+};
+
+#define FIXBROT_TRACE_BEGIN(ev) fixbrot::trace_record((ev), true)
+#define FIXBROT_TRACE_END(ev) fixbrot::trace_record((ev), false)
+#define FIXBROT_TRACE_SCOPE(ev) fixbrot::TraceScope fixbrot_trace_scope((ev))
+
+#ifndef FIXBROT_NO_STDLIB
+using trace_write_t = void (*)(void *ctx, const char *str, int len);
+
+// Writes recorded events in Chrome trace (chrome://tracing, Perfetto) JSON
+// format, one thread per core. Recording should be paused while exporting.
+static inline void trace_export_chrome_json(trace_write_t write, void *ctx) {
+  char buf[128];
+  int n;
+  bool first = true;
+
+  // time stamps are 32 bit, so take the oldest record of all cores as zero
+  bool has_base = false;
+  uint32_t base_us = 0;
+  for (int core = 0; core < FIXBROT_TRACE_NUM_CORES; core++) {
+    const trace_ring_t &ring = trace_rings[core];
+    if (ring.size() == 0) continue;
+    uint32_t t = ring.at(0).time_us;
+    if (!has_base || (int32_t)(t - base_us) < 0) {
+      base_us = t;
+      has_base = true;
+    }
+  }
+
+  n = snprintf(buf, sizeof(buf), "{\"traceEvents\":[\n");
+  write(ctx, buf, n);
+
+  for (int core = 0; core < FIXBROT_TRACE_NUM_CORES; core++) {
+    const trace_ring_t &ring = trace_rings[core];
+    uint32_t num_records = ring.size();
+    if (num_records == 0) continue;
+
+    n = snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                 "\"tid\":%d,\"args\":{\"name\":\"Core%d\"}}",
+                 first ? "" : ",\n", core, core);
+    write(ctx, buf, n);
+    first = false;
+
+    // unwrap time stamps while walking the ring
+    uint32_t last_us = ring.at(0).time_us;
+    uint64_t ts_us = (uint32_t)(last_us - base_us);
+    int depth = 0;
+    for (uint32_t i = 0; i < num_records; i++) {
+      const trace_record_t &r = ring.at(i);
+      ts_us += (uint32_t)(r.time_us - last_us);
+      last_us = r.time_us;
+
+      // drop end events whose begin was overwritten
+      if (r.begin) {
+        depth++;
+      } else if (depth > 0) {
+        depth--;
+      } else {
+        continue;
+      }
+
+      n = snprintf(buf, sizeof(buf),
+                   ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,"
+                   "\"pid\":0,\"tid\":%d}",
+                   get_trace_event_name(r.event), r.begin ? 'B' : 'E',
+                   (unsigned long long)ts_us, core);
+      write(ctx, buf, n);
+    }
+  }
+
+  n = snprintf(buf, sizeof(buf), "\n]}\n");
+  write(ctx, buf, n);
+}
+#endif
+
+#else
+
+#define FIXBROT_TRACE_BEGIN(ev) \
+  do {                          \
+  } while (0)
+#define FIXBROT_TRACE_END(ev) \
+  do {                        \
+  } while (0)
+#define FIXBROT_TRACE_SCOPE(ev) \
+  do {                          \
+  } while (0)
+
+#endif
+
+}  // namespace fixbrot
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef FIXBROT_VERIFIER_HPP
+#define FIXBROT_VERIFIER_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#endif
+
+#include "fixbrot/common.hpp"
+#include "fixbrot/mandelbrot.hpp"
+#include "fixbrot/renderer.hpp"
+
+namespace fixbrot {
+
+struct verify_scene_t {
+  formula_t formula;
+  real_t real;
+  real_t imag;
+  int scale_exp;
+  iter_t max_iter;
+};
+
+// scenes known to stress the border tracer
+static const verify_scene_t VERIFY_SCENES[] = {
+    {formula_t::MANDELBROT, -0.5f, 0, -2, 200},
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 8, 1000},
+    // fixed32 / fixed64 boundary
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 16, 1000},
+    {formula_t::MANDELBROT, -0.743643f, 0.131825f, 17, 1000},
+    {formula_t::BURNING_SHIP, -0.5f, 0, -2, 200},
+    {formula_t::BURNING_SHIP, -1.762f, -0.028f, 6, 500},
+    {formula_t::CELTIC, -0.5f, 0, -2, 200},
+    {formula_t::BUFFALO, -0.5f, 0, -2, 200},
+    {formula_t::PERP_BURNING_SHIP, -0.5f, 0, -2, 200},
+    {formula_t::AIRSHIP, -0.5f, 0, -2, 200},
+    {formula_t::SHARK_FIN, -0.5f, 0, -2, 200},
+    {formula_t::POWER_DRILL, -0.5f, 0, -2, 200},
+    {formula_t::CROWN, -0.5f, 0, -2, 200},
+    {formula_t::SUPER, -0.5f, 0, -2, 200},
+    {formula_t::CUBIC_MANDELBROT, 0, 0, -2, 200},
+    {formula_t::CUBIC_01344, 0, 0, -2, 200},
+    {formula_t::CUBIC_01417, 0, 0, -2, 200},
+    {formula_t::CUBIC_01479, 0, 0, -2, 200},
+    {formula_t::CUBIC_01856, 0, 0, -2, 200},
+    {formula_t::CUBIC_09601, 0, 0, -2, 200},
+    {formula_t::CUBIC_09743, 0, 0, -2, 200},
+    {formula_t::FEATHER, 0, 0, -2, 200},
+};
+static constexpr int NUM_VERIFY_SCENES =
+    sizeof(VERIFY_SCENES) / sizeof(VERIFY_SCENES[0]);
+
+struct mismatch_t {
+  vec_t loc;
+  iter_t expected;
+  iter_t actual;
+};
+
+struct verify_report_t {
+  static constexpr int MAX_LOCATIONS = 16;
+
+  uint32_t num_pixels;
+  uint32_t num_mismatches;
+  uint32_t num_unfinished;
+  rect_t bounds;
+  int num_locations;
+  mismatch_t locations[MAX_LOCATIONS];
+
+  // pass if mismatches are within `max_mismatches` and `max_ppm` of pixels
+  FIXBROT_INLINE bool passed(uint32_t max_mismatches = 0,
+                             uint32_t max_ppm = 0) const {
+    if (num_unfinished > 0) return false;
+    if (num_mismatches <= max_mismatches) return true;
+    return (uint64_t)num_mismatches * 1000000 <=
+           (uint64_t)num_pixels * max_ppm;
+  }
+};
+
+// Compares the iteration buffer of a finished render against an exhaustive
+// per-pixel Mandelbrot::compute sweep of the same scene.
+class Verifier {
+ public:
+  static result_t load_scene(Renderer &renderer, const verify_scene_t &vs) {
+    return renderer.set_view(vs.formula, vs.real, vs.imag, vs.scale_exp,
+                             vs.max_iter);
+  }
+
+  static result_t compare(const Renderer &renderer, verify_report_t *report) {
+    if (renderer.is_busy()) return result_t::ERROR_BUSY;
+
+    const scene_t s = renderer.get_worker_args();
+    pos_t x0 = renderer.width, y0 = renderer.height, x1 = -1, y1 = -1;
+
+    report->num_pixels = (uint32_t)renderer.width * renderer.height;
+    report->num_mismatches = 0;
+    report->num_unfinished = 0;
+    report->num_locations = 0;
+
+    for (pos_t y = 0; y < renderer.height; y++) {
+      for (pos_t x = 0; x < renderer.width; x++) {
+        iter_t expected = normalize(s, Mandelbrot::compute(s, vec_t{x, y}));
+        iter_t actual = renderer.get_iter(x, y);
+        if (actual == ITER_BLANK || actual > ITER_MAX) {
+          report->num_unfinished++;
+        } else {
+          actual = normalize(s, actual);
+        }
+        if (actual == expected) continue;
+
+        report->num_mismatches++;
+        if (report->num_locations < verify_report_t::MAX_LOCATIONS) {
+          report->locations[report->num_locations++] =
+              mismatch_t{vec_t{x, y}, expected, actual};
+        }
+        if (x < x0) x0 = x;
+        if (y < y0) y0 = y;
+        if (x > x1) x1 = x;
+        if (y > y1) y1 = y;
+      }
+    }
+
+    if (report->num_mismatches > 0) {
+      report->bounds = rect_t{x0, y0, (pos_t)(x1 - x0 + 1),
+                              (pos_t)(y1 - y0 + 1)};
+    } else {
+      report->bounds = rect_t{0, 0, 0, 0};
+    }
+    return result_t::SUCCESS;
+  }
+
+ private:
+  // the tracer stores ITER_MAX for points inside the set while post
+  // correction stores max_iter itself, both mean the same thing
+  static FIXBROT_INLINE iter_t normalize(const scene_t &s, iter_t iter) {
+    return (iter >= s.max_iter) ? ITER_MAX : iter;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
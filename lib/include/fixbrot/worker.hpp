@@ -8,6 +8,7 @@
 
 #include "fixbrot/common.hpp"
 #include "fixbrot/mandelbrot.hpp"
+#include "fixbrot/trace.hpp"
 
 namespace fixbrot {
 
@@ -21,19 +22,38 @@ class Worker {
   volatile index_t wr_ptr = 0;
   volatile index_t proc_ptr = 0;
   volatile index_t rd_ptr = 0;
+  volatile uint32_t num_computed = 0;
   scene_t scene;
 
+  // scenes passed to init(), alternately, and the number of init() calls
+  // requested and applied by service()
+  scene_t next_scenes[2];
+  volatile uint32_t init_seq = 0;
+  volatile uint32_t applied_seq = 0;
+
  public:
+  // Discards the queued cells and switches to `scene`. Called from the
+  // core that feeds the worker while another core may be inside service(),
+  // so it only posts the request: service() applies it before it computes
+  // the next cell, and until then full() is true and collect() returns
+  // nothing.
   result_t init(const scene_t &scene) {
-    this->scene = scene;
-    wr_ptr = 0;
-    proc_ptr = 0;
-    rd_ptr = 0;
+    uint32_t seq = init_seq + 1;
+    next_scenes[seq & 1] = scene;
+    __sync_synchronize();
+    init_seq = seq;
     return result_t::SUCCESS;
   }
 
+  FIXBROT_INLINE bool is_init_pending() const {
+    return init_seq != applied_seq;
+  }
+
+  // number of cells computed by this worker since the last init()
+  FIXBROT_INLINE uint32_t get_num_computed() const { return num_computed; }
+
   FIXBROT_INLINE bool full() const {
-    return ((wr_ptr + 1) & (DEPTH - 1)) == rd_ptr;
+    return is_init_pending() || ((wr_ptr + 1) & (DEPTH - 1)) == rd_ptr;
   }
 
   FIXBROT_INLINE bool empty() const { return rd_ptr == wr_ptr; }
@@ -43,13 +63,14 @@ class Worker {
   }
 
   FIXBROT_INLINE index_t num_processed() const {
+    if (is_init_pending()) return 0;
     return (proc_ptr - rd_ptr) & (DEPTH - 1);
   }
 
   FIXBROT_INLINE result_t dispatch(vec_t loc) {
     index_t wp = wr_ptr;
     index_t next_wp = (wp + 1) & (DEPTH - 1);
-    if (next_wp == rd_ptr) {
+    if (next_wp == rd_ptr || is_init_pending()) {
       return result_t::ERROR_QUEUE_OVERFLOW;
     }
     queue[wp].loc = loc;
@@ -58,6 +79,7 @@ class Worker {
   }
 
   FIXBROT_INLINE bool collect(cell_t *resp) {
+    if (is_init_pending()) return false;
     index_t rp = rd_ptr;
     if (rp == proc_ptr) return false;
     *resp = queue[rp];
@@ -65,10 +87,18 @@ class Worker {
     return true;
   }
 
-  result_t service() {
+  // computes queued cells, stops early when past `deadline_us`
+  result_t service(uint64_t deadline_us = NO_DEADLINE) {
+    FIXBROT_TRACE_SCOPE(trace_event_t::WORKER_SERVICE);
+    if (is_init_pending()) apply_init();
     int n = num_queued();
     vec_t loc;
     while (n-- > 0 && fetch(&loc)) {
+      if (deadline_us != NO_DEADLINE && get_time_us() >= deadline_us) break;
+      if (is_init_pending()) {
+        apply_init();
+        return result_t::SUCCESS;
+      }
       cell_t resp;
       resp.loc = loc;
       resp.iter = Mandelbrot::compute(scene, loc);
@@ -76,11 +106,32 @@ class Worker {
         resp.iter = ITER_MAX;
       }
       advance(resp.iter);
+      num_computed++;
     }
     return result_t::SUCCESS;
   }
 
  private:
+  // runs on the core of service(), the feeding core leaves the pointers
+  // alone while the request is pending
+  void apply_init() {
+    uint32_t seq;
+    do {
+      // init() only writes the other slot unless it is called again
+      // during the copy, which changes init_seq
+      seq = init_seq;
+      __sync_synchronize();
+      scene = next_scenes[seq & 1];
+      __sync_synchronize();
+    } while (seq != init_seq);
+    wr_ptr = 0;
+    proc_ptr = 0;
+    rd_ptr = 0;
+    num_computed = 0;
+    __sync_synchronize();
+    applied_seq = seq;
+  }
+
   FIXBROT_INLINE bool fetch(vec_t *loc) {
     index_t pp = proc_ptr;
     if (pp == wr_ptr) return false;
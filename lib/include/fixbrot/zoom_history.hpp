@@ -0,0 +1,175 @@
+#ifndef FIXBROT_ZOOM_HISTORY_HPP
+#define FIXBROT_ZOOM_HISTORY_HPP
+
+#ifndef FIXBROT_NO_STDLIB
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include "fixbrot/arena.hpp"
+#include "fixbrot/common.hpp"
+
+namespace fixbrot {
+
+// Stack of finished views saved by zoom_in(), so that zoom_out() can
+// restore them instead of rendering again. Pixels are run-length encoded
+// as pairs of (run length, iteration count) words in a buffer of fixed
+// size; the oldest snapshots are dropped when it is full.
+class ZoomHistory {
+ public:
+  static constexpr int MAX_DEPTH = 16;
+
+ private:
+  struct entry_t {
+    scene_t scene;
+    int scale_exp;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  const uint32_t capacity;
+  uint16_t *data;
+  bool owns_data = false;
+  entry_t entries[MAX_DEPTH];
+  int depth = 0;
+
+  // snapshot being written
+  bool pushing = false;
+  uint32_t wr_ptr = 0;
+  uint16_t run_len = 0;
+  iter_t run_iter = 0;
+
+  // snapshot being read
+  uint32_t rd_ptr = 0;
+  uint16_t rd_len = 0;
+
+ public:
+  ZoomHistory(uint32_t budget_bytes, Arena &arena)
+      : capacity(budget_bytes / sizeof(uint16_t)),
+        data(arena.alloc<uint16_t>(capacity)) {}
+
+#ifndef FIXBROT_NO_STDLIB
+  ZoomHistory(uint32_t budget_bytes)
+      : capacity(budget_bytes / sizeof(uint16_t)),
+        data(new uint16_t[capacity > 0 ? capacity : 1]),
+        owns_data(true) {}
+
+  ~ZoomHistory() {
+    if (owns_data) delete[] data;
+  }
+#endif
+
+  // arena bytes taken by the constructor
+  static constexpr size_t get_arena_bytes(uint32_t budget_bytes) {
+    return Arena::align_up(budget_bytes / sizeof(uint16_t) *
+                           sizeof(uint16_t));
+  }
+
+  void clear() {
+    depth = 0;
+    pushing = false;
+  }
+
+  FIXBROT_INLINE int get_depth() const { return depth; }
+
+  // starts a snapshot of the view `scene`, followed by push_pixel() for
+  // each pixel in row-major order and push_end()
+  void push_begin(const scene_t &scene, int scale_exp) {
+    if (depth >= MAX_DEPTH) drop_oldest();
+    entry_t &e = entries[depth];
+    e.scene = scene;
+    e.scale_exp = scale_exp;
+    e.offset = 0;
+    if (depth > 0) {
+      e.offset = entries[depth - 1].offset + entries[depth - 1].size;
+    }
+    e.size = 0;
+    wr_ptr = e.offset;
+    run_len = 0;
+    pushing = true;
+  }
+
+  // false if the snapshot does not fit and has been discarded
+  bool push_pixel(iter_t iter) {
+    if (!pushing) return false;
+    if (run_len > 0 && iter == run_iter && run_len < 0xFFFF) {
+      run_len++;
+      return true;
+    }
+    if (run_len > 0 && !flush_run()) return false;
+    run_iter = iter;
+    run_len = 1;
+    return true;
+  }
+
+  void push_end() {
+    if (!pushing) return;
+    pushing = false;
+    if (run_len > 0 && !flush_run()) return;
+    entries[depth].size = wr_ptr - entries[depth].offset;
+    depth++;
+  }
+
+  // Pops the newest snapshot. Returns true if it shows `scene` at
+  // `scale_exp`, the pixels are then read by pop_pixel() in row-major
+  // order before the next push.
+  bool pop(const scene_t &scene, int scale_exp) {
+    if (depth == 0) return false;
+    const entry_t &e = entries[--depth];
+    if (e.scale_exp != scale_exp || e.scene.formula != scene.formula ||
+        e.scene.real.raw != scene.real.raw ||
+        e.scene.imag.raw != scene.imag.raw ||
+        e.scene.step.raw != scene.step.raw ||
+        e.scene.max_iter != scene.max_iter) {
+      return false;
+    }
+    rd_ptr = e.offset;
+    rd_len = 0;
+    return true;
+  }
+
+  FIXBROT_INLINE iter_t pop_pixel() {
+    if (rd_len == 0) {
+      rd_len = data[rd_ptr];
+      rd_ptr += 2;
+    }
+    rd_len--;
+    return data[rd_ptr - 1];
+  }
+
+ private:
+  bool flush_run() {
+    if (wr_ptr + 2 > capacity) {
+      // make room by dropping older snapshots, give up if there are none
+      uint32_t used = wr_ptr - entries[depth].offset;
+      if (depth == 0 || !drop_oldest()) {
+        pushing = false;
+        return false;
+      }
+      wr_ptr = entries[depth].offset + used;
+      if (wr_ptr + 2 > capacity) return flush_run();
+    }
+    data[wr_ptr++] = run_len;
+    data[wr_ptr++] = run_iter;
+    return true;
+  }
+
+  // moves everything above the oldest snapshot down over it
+  bool drop_oldest() {
+    if (depth == 0) return false;
+    uint32_t shift = entries[0].size;
+    uint32_t end = pushing ? wr_ptr : (entries[depth - 1].offset +
+                                       entries[depth - 1].size);
+    memmove(data, data + shift, sizeof(uint16_t) * (end - shift));
+    for (int i = 1; i <= depth && i < MAX_DEPTH; i++) {
+      entries[i - 1] = entries[i];
+      entries[i - 1].offset -= shift;
+    }
+    depth--;
+    return true;
+  }
+};
+
+}  // namespace fixbrot
+
+#endif
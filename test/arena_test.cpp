@@ -0,0 +1,88 @@
+// Constructs a Renderer and a GUI from arenas of exactly get_arena_bytes()
+// and one byte short of it. The exact ones render and paint; the short ones
+// must report the overflow, write nothing through the missing buffers and
+// refuse init() and paint_start() with ERROR_OUT_OF_MEMORY.
+//
+// The plans round up to Arena::ALIGN, so the sizes are ones whose last
+// buffer ends aligned, where one byte less does not fit.
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+// a block of `bytes`, aligned to Arena::ALIGN
+static std::vector<uint64_t> block(size_t bytes) {
+  return std::vector<uint64_t>((bytes + 7) / 8);
+}
+
+static void check_renderer(fb::pos_t width, fb::pos_t height) {
+  const size_t bytes = fb::Renderer::get_arena_bytes(width, height);
+  printf("Renderer %dx%d, %zu bytes\n", width, height, bytes);
+
+  std::vector<uint64_t> exact = block(bytes);
+  fb::Arena arena(exact.data(), bytes);
+  fb::Renderer r(width, height, arena);
+  expect(!arena.has_overflowed(), "exact arena suffices");
+  expect(r.has_buffers(), "exact arena carves every buffer");
+  expect(r.init() == fb::result_t::SUCCESS, "init");
+  host::finish(r);
+  expect(r.get_iter(0, 0) != fb::ITER_BLANK, "renders");
+  expect(r.paint_start() == fb::result_t::SUCCESS, "paint_start");
+
+  std::vector<uint64_t> short_block = block(bytes - 1);
+  fb::Arena short_arena(short_block.data(), bytes - 1);
+  fb::Renderer s(width, height, short_arena);
+  expect(short_arena.has_overflowed(), "short arena overflows");
+  expect(!s.has_buffers(), "short arena leaves a buffer missing");
+  expect(s.init() == fb::result_t::ERROR_OUT_OF_MEMORY, "init refused");
+  expect(s.paint_start() == fb::result_t::ERROR_OUT_OF_MEMORY,
+         "paint_start refused");
+  expect(!s.is_busy(), "nothing to render");
+}
+
+static void check_gui(fb::pos_t width, fb::pos_t height) {
+  const size_t bytes = fb::GUI::get_arena_bytes(width, height);
+  printf("GUI %dx%d, %zu bytes\n", width, height, bytes);
+
+  std::vector<uint64_t> exact = block(bytes);
+  fb::Arena arena(exact.data(), bytes);
+  fb::GUI gui(width, height, arena);
+  expect(!arena.has_overflowed(), "exact arena suffices");
+  expect(gui.has_buffers(), "exact arena carves every buffer");
+  expect(gui.init() == fb::result_t::SUCCESS, "init");
+  expect(gui.paint_start() == fb::result_t::SUCCESS, "paint_start");
+  gui.paint_end();
+
+  // the menu bitmap is carved last and goes missing
+  std::vector<uint64_t> short_block = block(bytes - 1);
+  fb::Arena short_arena(short_block.data(), bytes - 1);
+  fb::GUI s(width, height, short_arena);
+  expect(short_arena.has_overflowed(), "short arena overflows");
+  expect(s.renderer.has_buffers(), "renderer fits");
+  expect(!s.has_buffers(), "short arena leaves a buffer missing");
+  expect(s.init() == fb::result_t::ERROR_OUT_OF_MEMORY, "init refused");
+  expect(s.paint_start() == fb::result_t::ERROR_OUT_OF_MEMORY,
+         "paint_start refused");
+}
+
+int main() {
+  check_renderer(240, 240);
+  check_renderer(320, 240);
+  check_renderer(64, 40);
+  check_gui(240, 240);
+  check_gui(320, 240);
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// Paints a session through DisplaySink into a mock display and counts the
+// bytes sent. Checks that the partial trace after raising max_iter, which
+// only revisits pixels that reached the old limit, sends fewer bytes than
+// one full frame, that no frame sends more than a full frame, and that the
+// display always ends up showing the same image as a full paint. The menu
+// is also checked against redrawing it whole, after another GUI drew the
+// same item values to its own menu.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host.hpp"
+#include "host_display.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+static constexpr fb::pos_t BAND_HEIGHT = 16;
+static constexpr uint64_t FULL_FRAME_BYTES =
+    (uint64_t)WIDTH * HEIGHT * sizeof(fb::col_t);
+
+static fb::GUI gui(WIDTH, HEIGHT);
+static host::SimDriver driver(WIDTH, HEIGHT, 0);
+static fb::DisplaySink<host::SimDriver> sink(driver, WIDTH, BAND_HEIGHT);
+
+static int num_errors = 0;
+
+struct session_t {
+  uint32_t frames;
+  uint32_t partial_frames;
+  uint64_t partial_bytes;
+};
+
+static void paint_frame(session_t *s) {
+  driver.reset_counters();
+  sink.paint(gui);
+  sink.flush();
+  uint64_t bytes = driver.get_bytes_sent();
+  s->frames++;
+  if (bytes > FULL_FRAME_BYTES) {
+    printf("frame %u: %llu bytes sent\n", s->frames,
+           (unsigned long long)bytes);
+    num_errors++;
+  }
+  if (!gui.is_full_paint()) {
+    s->partial_frames++;
+    s->partial_bytes += bytes;
+  }
+}
+
+static void check_screen(const char *label) {
+  static fb::col_t expected[WIDTH * HEIGHT];
+  gui.paint_start();
+  for (fb::pos_t y = 0; y < HEIGHT; y++) {
+    gui.paint_line(y, expected + y * WIDTH);
+  }
+  gui.paint_end();
+  for (int i = 0; i < WIDTH * HEIGHT; i++) {
+    if (driver.screen[i] != expected[i]) {
+      printf("%s: display differs from a full paint at (%d, %d)\n", label,
+             i % WIDTH, i / WIDTH);
+      num_errors++;
+      return;
+    }
+  }
+}
+
+static void press(fb::GUI &g, fb::button_t button) {
+  g.button_update(button);
+  g.button_update(fb::button_t::NONE);
+}
+
+// runs until nothing is left to render or paint
+static session_t run(const char *label) {
+  session_t s = {};
+  do {
+    host::advance_fake_time(1000);
+    host::step(gui);
+    if (gui.is_paint_requested()) paint_frame(&s);
+  } while (gui.renderer.is_busy() || gui.is_paint_requested() ||
+           gui.renderer.is_animating());
+  check_screen(label);
+
+  double ratio = s.partial_frames ? (double)s.partial_bytes /
+                                        (s.partial_frames * FULL_FRAME_BYTES)
+                                  : 0;
+  printf("%-8s %2u frames, %2u partial sending %5.1f%% of a full frame\n",
+         label, s.frames, s.partial_frames, ratio * 100);
+  return s;
+}
+
+int main() {
+  host::set_fake_time(1000000);
+  gui.init();
+  run("init");
+
+  gui.renderer.scroll(37, -21);
+  run("scroll");
+
+  gui.renderer.set_max_iter(500);
+  session_t partial = run("max_iter");
+  if (partial.partial_frames == 0 ||
+      partial.partial_bytes >= FULL_FRAME_BYTES) {
+    printf("max_iter: partial trace sent %llu bytes, full frame is %llu\n",
+           (unsigned long long)partial.partial_bytes,
+           (unsigned long long)FULL_FRAME_BYTES);
+    num_errors++;
+  }
+
+  press(gui, fb::button_t::X);
+  run("menu");
+
+  // items drawn to the menu of another GUI are not drawn to this one
+  static fb::GUI other(WIDTH, HEIGHT);
+  press(other, fb::button_t::X);
+  other.menu_cursor = fb::menu_key_t::PALETTE_SLOPE;
+  press(other, fb::button_t::RIGHT);
+  other.paint_start();
+  other.paint_end();
+  gui.menu_cursor = fb::menu_key_t::PALETTE_SLOPE;
+  press(gui, fb::button_t::RIGHT);
+  run("slope");
+  gui.menu_bmp_valid = false;
+  check_screen("redrawn menu");
+
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+// Compares DisplaySink::paint(), which paints the next band while the
+// previous one is being sent, with painting and sending one line at a
+// time and waiting for each transfer, as the apps did before. The display
+// link is simulated by SimDriver at a given bandwidth. Every frame shifts
+// the palette so that all of it is repainted.
+//
+// A host paints a line in well under a microsecond, so each line is
+// padded to a device-like cost (40 us for 240 pixels by default, set 0 to
+// measure the host as is). With a paint time P and a transfer time T per
+// frame, the line-by-line loop takes about P + T and the double-buffered
+// one about max(P, T); both are printed next to the measured times. The
+// rest is the cost of handing each transfer to the link thread.
+//
+// usage: display_sink_bench [frames [line_us [bytes_per_us...]]]
+//   default bandwidths: 7.8 (62.5 MHz SPI) and the one that makes T = P
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "host.hpp"
+#include "host_display.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+static constexpr fb::pos_t BAND_HEIGHT = 16;
+static constexpr double FRAME_BYTES =
+    (double)WIDTH * HEIGHT * sizeof(fb::col_t);
+
+static fb::GUI gui(WIDTH, HEIGHT);
+
+// the paint interface of GUI, with each line taking at least `line_us`
+struct SlowGui {
+  fb::GUI &gui;
+  const fb::pos_t height;
+  const double line_us;
+
+  SlowGui(fb::GUI &gui, double line_us)
+      : gui(gui), height(gui.height), line_us(line_us) {}
+
+  fb::result_t paint_start() { return gui.paint_start(); }
+  fb::result_t paint_end() { return gui.paint_end(); }
+  bool get_dirty_span(fb::pos_t y, fb::pos_t *x, fb::pos_t *w) {
+    return gui.get_dirty_span(y, x, w);
+  }
+
+  fb::result_t paint_line(fb::pos_t y, fb::col_t *line_buff) {
+    auto end = std::chrono::steady_clock::now() +
+               std::chrono::nanoseconds((int64_t)(line_us * 1000));
+    FIXBROT_TRY(gui.paint_line(y, line_buff));
+    while (std::chrono::steady_clock::now() < end) {
+    }
+    return fb::result_t::SUCCESS;
+  }
+};
+
+static void next_frame() {
+  gui.renderer.set_palette_phase(gui.renderer.get_palette_phase() + 1);
+}
+
+// paint only, to a band buffer that is never sent
+static double bench_paint(SlowGui &painter, int frames) {
+  std::vector<fb::col_t> band((size_t)WIDTH * BAND_HEIGHT);
+  uint64_t t0 = host::now_us();
+  for (int i = 0; i < frames; i++) {
+    next_frame();
+    painter.paint_start();
+    for (fb::pos_t y = 0; y < HEIGHT; y++) {
+      painter.paint_line(y, band.data() + (y % BAND_HEIGHT) * WIDTH);
+    }
+    painter.paint_end();
+  }
+  return (double)(host::now_us() - t0) / frames;
+}
+
+// one line at a time, each sent before the next is painted
+static double bench_lines(SlowGui &painter, host::SimDriver &driver,
+                          int frames) {
+  std::vector<fb::col_t> line(WIDTH);
+  uint64_t t0 = host::now_us();
+  for (int i = 0; i < frames; i++) {
+    next_frame();
+    painter.paint_start();
+    for (fb::pos_t y = 0; y < HEIGHT; y++) {
+      painter.paint_line(y, line.data());
+      driver.start(0, y, WIDTH, 1, line.data(), WIDTH);
+      driver.wait();
+    }
+    painter.paint_end();
+  }
+  return (double)(host::now_us() - t0) / frames;
+}
+
+static double bench_sink(SlowGui &painter, host::SimDriver &driver,
+                         int frames) {
+  fb::DisplaySink<host::SimDriver> sink(driver, WIDTH, BAND_HEIGHT);
+  uint64_t t0 = host::now_us();
+  for (int i = 0; i < frames; i++) {
+    next_frame();
+    sink.paint(painter);
+  }
+  sink.flush();
+  return (double)(host::now_us() - t0) / frames;
+}
+
+int main(int argc, char **argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 50;
+  double line_us = argc > 2 ? atof(argv[2]) : 40;
+
+  gui.init();
+  fb::result_t res = host::finish(gui.renderer);
+  if (res != fb::result_t::SUCCESS) {
+    printf("render failed: %s\n", host::result_name(res));
+    return 1;
+  }
+
+  SlowGui painter(gui, line_us);
+  double paint_us = bench_paint(painter, frames);
+  std::vector<double> bandwidths;
+  for (int i = 3; i < argc; i++) bandwidths.push_back(atof(argv[i]));
+  if (bandwidths.empty()) {
+    bandwidths.push_back(7.8);
+    bandwidths.push_back(FRAME_BYTES / paint_us);
+  }
+
+  printf("%dx%d, band %d rows, paint %.1f us/frame\n", WIDTH, HEIGHT,
+         BAND_HEIGHT, paint_us);
+  printf("%9s %9s %9s %9s %9s %9s\n", "bytes/us", "xfer us", "P+T us",
+         "lines us", "max us", "sink us");
+  for (double bw : bandwidths) {
+    double xfer_us = FRAME_BYTES / bw;
+    host::SimDriver driver(WIDTH, HEIGHT, bw);
+    double lines_us = bench_lines(painter, driver, frames);
+    double sink_us = bench_sink(painter, driver, frames);
+    double max_us = xfer_us > paint_us ? xfer_us : paint_us;
+    printf("%9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", bw, xfer_us,
+           paint_us + xfer_us, lines_us, max_us, sink_us);
+  }
+  return 0;
+}
@@ -0,0 +1,146 @@
+#ifndef FIXBROT_TEST_HOST_HPP
+#define FIXBROT_TEST_HOST_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+
+#include "fixbrot/fixbrot.hpp"
+
+// Host stand-ins for the application callbacks of the library, shared by
+// the programs in this directory. Each program includes this header from
+// its only translation unit.
+
+namespace fb = fixbrot;
+
+namespace host {
+
+static constexpr int NUM_WORKERS = 2;
+
+fb::Worker workers[NUM_WORKERS];
+static int feed_index = 0;
+
+// get_time_us() follows the wall clock unless set_fake_time() is called,
+// for tests that must not depend on the speed of the host
+static bool fake_time = false;
+static uint64_t fake_time_us = 0;
+
+inline void set_fake_time(uint64_t us) {
+  fake_time = true;
+  fake_time_us = us;
+}
+
+inline void advance_fake_time(uint64_t us) { fake_time_us += us; }
+
+// called by get_time_us(), lets a test act where the library reads the
+// clock, e.g. between two cells of Worker::service()
+static void (*time_hook)() = nullptr;
+
+#if FIXBROT_TRACE
+// core that get_core_id() reports
+static int core_id = 0;
+#endif
+
+// hands queued pixels of `renderer` to the workers until they are full
+inline fb::result_t feed(fb::Renderer &renderer) {
+  bool stall = false;
+  int n = renderer.num_queued();
+  while (n-- > 0 && !stall) {
+    stall = true;
+    for (int i = 0; i < NUM_WORKERS; i++) {
+      fb::Worker &w = workers[feed_index];
+      feed_index = (feed_index + 1) % NUM_WORKERS;
+      fb::vec_t loc;
+      if (!w.full() && renderer.dequeue(&loc)) {
+        FIXBROT_TRY(w.dispatch(loc));
+        stall = false;
+        break;
+      }
+    }
+  }
+  return fb::result_t::SUCCESS;
+}
+
+// one round of the application loop: service, feed and compute
+inline fb::result_t step(fb::Renderer &renderer) {
+  FIXBROT_TRY(renderer.service());
+  FIXBROT_TRY(feed(renderer));
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    FIXBROT_TRY(workers[i].service());
+  }
+  return fb::result_t::SUCCESS;
+}
+
+inline fb::result_t step(fb::GUI &gui) {
+  FIXBROT_TRY(gui.service());
+  FIXBROT_TRY(feed(gui.renderer));
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    FIXBROT_TRY(workers[i].service());
+  }
+  return fb::result_t::SUCCESS;
+}
+
+// runs the render in progress to the end
+inline fb::result_t finish(fb::Renderer &renderer) {
+  while (renderer.is_busy()) {
+    FIXBROT_TRY(step(renderer));
+  }
+  return renderer.service();
+}
+
+inline uint64_t now_us() {
+  if (fake_time) return fake_time_us;
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline const char *result_name(fb::result_t res) {
+  switch (res) {
+    case fb::result_t::SUCCESS: return "SUCCESS";
+    case fb::result_t::ERROR_QUEUE_OVERFLOW: return "ERROR_QUEUE_OVERFLOW";
+    case fb::result_t::ERROR_BUSY: return "ERROR_BUSY";
+    case fb::result_t::ERROR_TOO_MANY_TOUCHES: return "ERROR_TOO_MANY_TOUCHES";
+    case fb::result_t::ERROR_IO: return "ERROR_IO";
+    case fb::result_t::ERROR_BAD_SNAPSHOT: return "ERROR_BAD_SNAPSHOT";
+    case fb::result_t::ERROR_OUT_OF_MEMORY: return "ERROR_OUT_OF_MEMORY";
+  }
+  return "?";
+}
+
+}  // namespace host
+
+uint64_t fb::get_time_ms() { return host::now_us() / 1000; }
+uint64_t fb::get_time_us() {
+  if (host::time_hook) host::time_hook();
+  return host::now_us();
+}
+
+#if FIXBROT_TRACE
+int fb::get_core_id() { return host::core_id; }
+#endif
+
+void fb::on_render_start(const fb::scene_t &scene) {
+  for (int i = 0; i < host::NUM_WORKERS; i++) {
+    host::workers[i].init(scene);
+  }
+}
+
+void fb::on_render_finished(fb::result_t res) {}
+
+void fb::on_prefetch_start(const fb::scene_t &scene) {
+  for (int i = 0; i < host::NUM_WORKERS; i++) {
+    host::workers[i].init(scene);
+  }
+}
+
+bool fb::on_collect(fb::cell_t *resp) {
+  if (host::workers[0].num_processed() > host::workers[1].num_processed()) {
+    return host::workers[0].collect(resp);
+  } else {
+    return host::workers[1].collect(resp);
+  }
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef FIXBROT_TEST_HOST_DISPLAY_HPP
+#define FIXBROT_TEST_HOST_DISPLAY_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "fixbrot/fixbrot.hpp"
+
+namespace host {
+
+// Simulated display for DisplaySink, with the link on its own thread like
+// a DMA channel. A transfer takes (bytes / bytes_per_us) microseconds of
+// wall time, slept rather than spun so that the link costs no CPU time as
+// on the device, then the pixels are copied to `screen`, so they are read
+// from the band buffer at the end of the transfer as a slow DMA would. A band
+// overwritten while in flight therefore shows up as corruption on
+// `screen`. A bandwidth of zero sends instantly.
+class SimDriver {
+ public:
+  const fb::pos_t width;
+  const fb::pos_t height;
+  const double bytes_per_us;
+  fb::col_t *const screen;
+
+ private:
+  struct transfer_t {
+    fb::pos_t x, y, w, h;
+    const fb::col_t *pixels;
+    int stride;
+  };
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  transfer_t pending;
+  bool busy = false;
+  bool quit = false;
+
+  uint64_t bytes_sent = 0;
+  uint32_t num_transfers = 0;
+  uint64_t wait_us = 0;
+
+  // last, so that everything it touches is constructed before it starts
+  std::thread thread;
+
+ public:
+  SimDriver(fb::pos_t width, fb::pos_t height, double bytes_per_us)
+      : width(width),
+        height(height),
+        bytes_per_us(bytes_per_us),
+        screen(new fb::col_t[width * height]),
+        thread(&SimDriver::thread_main, this) {
+    memset(screen, 0, sizeof(fb::col_t) * width * height);
+  }
+
+  ~SimDriver() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    cond.notify_all();
+    thread.join();
+    delete[] screen;
+  }
+
+  void start(fb::pos_t x, fb::pos_t y, fb::pos_t w, fb::pos_t h,
+             const fb::col_t *pixels, int stride) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // a second start() before wait() would be a bug in the caller
+    cond.wait(lock, [this] { return !busy; });
+    pending = transfer_t{x, y, w, h, pixels, stride};
+    busy = true;
+    bytes_sent += (uint64_t)w * h * sizeof(fb::col_t);
+    num_transfers++;
+    cond.notify_all();
+  }
+
+  void wait() {
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this] { return !busy; });
+    wait_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - t0)
+                   .count();
+  }
+
+  uint64_t get_bytes_sent() const { return bytes_sent; }
+  uint32_t get_num_transfers() const { return num_transfers; }
+  // time the producer spent blocked in wait()
+  uint64_t get_wait_us() const { return wait_us; }
+
+  void reset_counters() {
+    bytes_sent = 0;
+    num_transfers = 0;
+    wait_us = 0;
+  }
+
+ private:
+  void thread_main() {
+#ifdef __linux__
+    // the default slack of 50 us would be longer than a line transfer
+    prctl(PR_SET_TIMERSLACK, 1UL);
+#endif
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cond.wait(lock, [this] { return busy || quit; });
+      if (quit) return;
+      transfer_t t = pending;
+      lock.unlock();
+
+      if (bytes_per_us > 0) {
+        double bytes = (double)t.w * t.h * sizeof(fb::col_t);
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds((int64_t)(bytes * 1000 / bytes_per_us)));
+      }
+      for (fb::pos_t iy = 0; iy < t.h; iy++) {
+        memcpy(screen + (t.y + iy) * width + t.x, t.pixels + iy * t.stride,
+               sizeof(fb::col_t) * t.w);
+      }
+
+      lock.lock();
+      busy = false;
+      cond.notify_all();
+    }
+  }
+};
+
+}  // namespace host
+
+#endif
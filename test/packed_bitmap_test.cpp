@@ -0,0 +1,88 @@
+// Checks that the table-driven PackedBitmap::render_to() (expansion made by
+// build_expansion()) writes the same pixels as the per-pixel one, for 1, 2
+// and 4 bits per pixel. Every start column and width of a narrow bitmap of
+// random bytes is tried, so both ends hit every offset within a byte, then
+// random rectangles of a screen-wide one. Pixels around the rectangle in
+// the destination must be left alone.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::col_t GUARD = 0xA5A5;
+
+static int num_errors = 0;
+
+template <typename TBitmap>
+static void fill_random(TBitmap &bmp) {
+  for (fb::pos_t y = 0; y < bmp.height; y++) {
+    uint8_t *p = bmp.pixel_pointer(0, y);
+    for (fb::pos_t i = 0; i < bmp.stride; i++) p[i] = rand();
+  }
+}
+
+// The per-pixel render_to() loads the byte after the last pixel of a
+// row, so the bitmaps have one row more than is rendered from.
+template <typename TBitmap>
+static bool check_rect(const TBitmap &bmp, const fb::col_t *palette,
+                       const typename TBitmap::expansion_t &exp,
+                       fb::pos_t sx, fb::pos_t sy, fb::pos_t w,
+                       fb::pos_t h) {
+  const int stride = w + 2;
+  std::vector<fb::col_t> expected((size_t)stride * h, GUARD);
+  std::vector<fb::col_t> actual((size_t)stride * h, GUARD);
+  bmp.render_to(sx, sy, w, h, expected.data() + 1, stride, palette);
+  bmp.render_to(sx, sy, w, h, actual.data() + 1, stride, exp);
+  for (size_t i = 0; i < actual.size(); i++) {
+    if (actual[i] != expected[i]) {
+      printf("BPP=%d: (%d, %d, %d, %d) differs at (%d, %d): %04x, %04x\n",
+             TBitmap::BPP, sx, sy, w, h, (int)(i % stride) - 1,
+             (int)(i / stride), actual[i], expected[i]);
+      num_errors++;
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename TBitmap>
+static void test_bpp() {
+  fb::col_t palette[1 << TBitmap::BPP];
+  for (int i = 0; i < (1 << TBitmap::BPP); i++) {
+    palette[i] = 0x1111 * (i + 1) + i * 0x0102;
+  }
+  static typename TBitmap::expansion_t exp;
+  TBitmap::build_expansion(palette, &exp);
+
+  // every start and end column
+  TBitmap narrow(37, 5);
+  fill_random(narrow);
+  for (fb::pos_t sx = 0; sx < narrow.width; sx++) {
+    for (fb::pos_t w = 0; sx + w <= narrow.width; w++) {
+      if (!check_rect(narrow, palette, exp, sx, 1, w, 3)) return;
+    }
+  }
+
+  // random rectangles of a screen-wide bitmap
+  TBitmap wide(240, 65);
+  fill_random(wide);
+  for (int i = 0; i < 2000; i++) {
+    fb::pos_t sx = rand() % wide.width;
+    fb::pos_t w = rand() % (wide.width - sx + 1);
+    fb::pos_t sy = rand() % (wide.height - 1);
+    fb::pos_t h = 1 + rand() % (wide.height - 1 - sy);
+    if (!check_rect(wide, palette, exp, sx, sy, w, h)) return;
+  }
+  printf("BPP=%d: ok\n", TBitmap::BPP);
+}
+
+int main() {
+  srand(1);
+  test_bpp<fb::MonoBitmap>();
+  test_bpp<fb::Gray2Bitmap>();
+  test_bpp<fb::Gray4Bitmap>();
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+// Measures Renderer::paint_line() over full unscaled frames of a finished
+// render. Built with and without FIXBROT_COLOR_LUT_SIMD to compare the
+// vector color lookup of x86 hosts against the scalar loop.
+//
+// usage: paint_bench [width height [frames]]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+int main(int argc, char **argv) {
+  fb::pos_t width = argc > 2 ? atoi(argv[1]) : 240;
+  fb::pos_t height = argc > 2 ? atoi(argv[2]) : 240;
+  int frames = argc > 3 ? atoi(argv[3]) : 2000;
+
+  fb::Renderer renderer(width, height);
+  renderer.init();
+  fb::result_t res = host::finish(renderer);
+  if (res != fb::result_t::SUCCESS) {
+    printf("render failed: %s\n", host::result_name(res));
+    return 1;
+  }
+
+  std::vector<fb::col_t> frame((size_t)width * height);
+  uint32_t checksum = 0;
+  uint64_t t0 = host::now_us();
+  for (int i = 0; i < frames; i++) {
+    renderer.paint_start();
+    for (fb::pos_t y = 0; y < height; y++) {
+      renderer.paint_line(0, y, width, frame.data() + y * width);
+    }
+    checksum += frame[(size_t)(i % height) * width + i % width];
+  }
+  uint64_t elapsed = host::now_us() - t0;
+
+  printf("%dx%d, SIMD=%d: %.1f us/frame (checksum %08x)\n", width, height,
+         FIXBROT_COLOR_LUT_SIMD, (double)elapsed / frames, checksum);
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Paints a render in progress, where finished pixels sit next to blank ones
+// previewed from their neighbours, with whole-row paint_line() calls and
+// checks them against painting the same pixels one at a time, which takes
+// the scalar lookup. Built with and without FIXBROT_COLOR_LUT_SIMD, so the
+// vector path of x86 hosts is checked against it as well. Spans start at
+// every offset within a block of 8 pixels.
+//
+// Then paints rectangles with paint_rect() while zooming in and out, where
+// rows and pixels repeat or fall outside the work buffer, also flipped
+// vertically, and checks them against single pixels likewise.
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+
+int main() {
+  fb::Renderer renderer(WIDTH, HEIGHT);
+  renderer.init();
+  host::finish(renderer);
+  renderer.set_formula(fb::formula_t::BURNING_SHIP);
+
+  int num_errors = 0;
+  for (int pass = 0; pass < 4; pass++) {
+    for (int i = 0; i < 3; i++) host::step(renderer);
+
+    // blocks of 8 mixing blank and finished pixels
+    int mixed = 0;
+    for (fb::pos_t y = 0; y < HEIGHT; y++) {
+      for (fb::pos_t x = 0; x + 8 <= WIDTH; x += 8) {
+        int blank = 0;
+        for (int i = 0; i < 8; i++) {
+          if (renderer.get_iter(x + i, y) == fb::ITER_BLANK) blank++;
+        }
+        if (0 < blank && blank < 8) mixed++;
+      }
+    }
+
+    renderer.paint_start();
+    std::vector<fb::col_t> row(WIDTH), pixel(1);
+    int wrong = 0;
+    for (fb::pos_t y = 0; y < HEIGHT; y++) {
+      for (fb::pos_t x0 = 0; x0 < 8; x0++) {
+        fb::pos_t w = WIDTH - x0 - (y % 8);
+        renderer.paint_line(x0, y, w, row.data());
+        for (fb::pos_t ix = 0; ix < w; ix++) {
+          renderer.paint_line(x0 + ix, y, 1, pixel.data());
+          if (row[ix] != pixel[0]) wrong++;
+        }
+      }
+    }
+    renderer.paint_finished();
+
+    printf("pass %d: %d mixed blocks, %d pixels differ\n", pass, mixed,
+           wrong);
+    if (mixed == 0) {
+      printf("  failed: no blank pixels next to finished ones\n");
+      num_errors++;
+    }
+    if (wrong) num_errors++;
+  }
+
+  // rectangles of odd sizes tiling the screen, and the whole screen
+  static const fb::pos_t SIZES[][2] = {
+      {37, 13}, {240, 7}, {1, 240}, {240, 240}};
+  for (int pass = 0; pass < 4; pass++) {
+    host::finish(renderer);
+    renderer.set_vert_flip(pass & 1);
+    if (pass & 2) {
+      renderer.zoom_out();
+    } else {
+      renderer.zoom_in();
+    }
+    renderer.service();
+    renderer.paint_start();
+    bool scaled = renderer.is_animating();
+
+    std::vector<fb::col_t> rect(WIDTH * HEIGHT), pixel(1);
+    int wrong = 0;
+    for (const fb::pos_t *size : SIZES) {
+      for (fb::pos_t y = 0; y < HEIGHT; y += size[1]) {
+        for (fb::pos_t x = 0; x < WIDTH; x += size[0]) {
+          fb::pos_t w = (x + size[0] < WIDTH) ? size[0] : WIDTH - x;
+          fb::pos_t h = (y + size[1] < HEIGHT) ? size[1] : HEIGHT - y;
+          renderer.paint_rect(x, y, w, h, rect.data() + y * WIDTH + x, WIDTH);
+        }
+      }
+      for (fb::pos_t y = 0; y < HEIGHT; y++) {
+        for (fb::pos_t x = 0; x < WIDTH; x++) {
+          renderer.paint_line(x, y, 1, pixel.data());
+          if (rect[y * WIDTH + x] != pixel[0]) wrong++;
+        }
+      }
+    }
+    renderer.paint_finished();
+
+    printf("zoom %s%s: %d pixels differ\n", (pass & 2) ? "out" : "in",
+           (pass & 1) ? ", flipped" : "", wrong);
+    if (!scaled) {
+      printf("  failed: not painted scaled\n");
+      num_errors++;
+    }
+    if (wrong) num_errors++;
+  }
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// Renders a poster of several tiles, stopping after a few of them and
+// resuming from the file, and compares every pixel with a brute-force
+// sweep of the same view as one screen. Also checks that read_row() agrees
+// with get_iter(), that a file cut short is rendered again to the same
+// pixels and that a file of another view is started over.
+//
+// As in verify, border tracing misses a few details smaller than a pixel,
+// so up to 1000 ppm of mismatches pass.
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr int32_t WIDTH = 700;
+static constexpr int32_t HEIGHT = 530;
+static constexpr int EXP = 4;
+static constexpr fb::iter_t MAX_ITER = 400;
+static constexpr uint32_t MAX_PPM = 1000;
+static const char *const PATH = "poster_test.bin";
+
+static const fb::real_t REAL = -0.16f;
+static const fb::real_t IMAG = 1.04f;
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static fb::iter_t norm(fb::iter_t iter, fb::iter_t max_iter) {
+  return iter >= max_iter ? fb::ITER_MAX : iter;
+}
+
+static fb::result_t open(fb::PosterRenderer &p, fb::iter_t max_iter) {
+  return p.open(PATH, fb::formula_t::MANDELBROT, REAL, IMAG, EXP, max_iter);
+}
+
+// renders until `stop_after` tiles are finished, or to the end if negative
+static void render(fb::PosterRenderer &p, int stop_after) {
+  while (p.is_busy()) {
+    if (stop_after >= 0 && (int)p.get_num_done() >= stop_after) return;
+    fb::result_t res = p.service();
+    if (res != fb::result_t::SUCCESS) {
+      printf("  service: %s\n", host::result_name(res));
+      num_errors++;
+      return;
+    }
+    fb::Renderer &view = p.get_tile_renderer();
+    host::feed(view);
+    for (int i = 0; i < host::NUM_WORKERS; i++) host::workers[i].service();
+  }
+}
+
+// compares the poster with the brute-force sweep, returns its pixels
+static std::vector<fb::iter_t> check_pixels(fb::PosterRenderer &p,
+                                            const fb::scene_t &scene) {
+  std::vector<fb::iter_t> pixels;
+  uint32_t wrong = 0;
+  int wrong_rows = 0;
+  std::vector<fb::iter_t> row(WIDTH + 20);
+  for (int32_t y = 0; y < HEIGHT; y++) {
+    for (int32_t x = 0; x < WIDTH; x++) {
+      fb::vec_t loc{(fb::pos_t)x, (fb::pos_t)y};
+      fb::iter_t expected = norm(fb::Mandelbrot::compute(scene, loc), MAX_ITER);
+      pixels.push_back(p.get_iter(x, y));
+      if (norm(pixels.back(), MAX_ITER) != expected) wrong++;
+    }
+    // a span crossing every tile boundary and both edges of the image
+    p.read_row(y, -10, WIDTH + 20, row.data());
+    for (int32_t x = -10; x < WIDTH + 10; x++) {
+      if (row[x + 10] != p.get_iter(x, y)) {
+        wrong_rows++;
+        break;
+      }
+    }
+  }
+  uint32_t ppm = (uint64_t)wrong * 1000000 / (WIDTH * HEIGHT);
+  printf("  %u of %d pixels differ from the sweep (%u ppm)\n", wrong,
+         WIDTH * HEIGHT, ppm);
+  expect(ppm <= MAX_PPM, "pixels match the brute-force sweep");
+  expect(wrong_rows == 0, "read_row() matches get_iter()");
+  return pixels;
+}
+
+int main() {
+  // the same view as one screen, for the scene of the brute-force sweep
+  fb::Renderer ref(WIDTH, HEIGHT);
+  ref.set_view(fb::formula_t::MANDELBROT, REAL, IMAG, EXP, MAX_ITER);
+  const fb::scene_t scene = ref.get_worker_args();
+
+  unlink(PATH);
+  fb::PosterRenderer p(WIDTH, HEIGHT);
+  printf("interrupted:\n");
+  expect(open(p, MAX_ITER) == fb::result_t::SUCCESS, "open");
+  render(p, 3);
+  expect(p.get_num_done() == 3, "three tiles finished");
+  p.close();
+
+  printf("resumed:\n");
+  expect(open(p, MAX_ITER) == fb::result_t::SUCCESS, "reopen");
+  expect(p.get_num_done() == 3, "finished tiles resume");
+  render(p, -1);
+  expect(!p.is_busy() && p.get_num_done() == p.num_tiles, "all tiles");
+  const std::vector<fb::iter_t> resumed = check_pixels(p, scene);
+  p.close();
+
+  struct stat st;
+  expect(stat(PATH, &st) == 0 && (size_t)st.st_size == p.get_file_bytes(),
+         "file size");
+
+  printf("cut short:\n");
+  expect(truncate(PATH, st.st_size - 1) == 0, "truncate");
+  expect(open(p, MAX_ITER) == fb::result_t::SUCCESS, "reopen");
+  expect(p.get_num_done() == 0, "started over");
+  render(p, -1);
+  expect(check_pixels(p, scene) == resumed, "same pixels as before");
+  p.close();
+
+  printf("other view:\n");
+  expect(open(p, MAX_ITER * 2) == fb::result_t::SUCCESS, "open");
+  expect(p.get_num_done() == 0, "started over");
+  expect(p.get_iter(WIDTH / 2, HEIGHT / 2) == fb::ITER_BLANK, "blank");
+  p.close();
+
+  unlink(PATH);
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+// Lets a renderer with a TileCache prefetch while its workers are idle,
+// then scrolls onto the tiles prefetched around the view and zooms into
+// those prefetched for the next scale. Right after each move the pixels
+// loaded from the cache are compared with a brute-force sweep, and the
+// finished view is checked with Verifier. Tiles are border-traced, so far
+// fewer cells than their pixels must be computed.
+//
+// As in verify, border tracing misses a few details smaller than a pixel,
+// so up to 1000 ppm of mismatches pass.
+
+#include <stdio.h>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+static constexpr int T = fb::TileCache::TILE_SIZE;
+static constexpr uint32_t MAX_PPM = 1000;
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static bool passed(uint32_t mismatches, uint32_t pixels) {
+  return (uint64_t)mismatches * 1000000 <= (uint64_t)pixels * MAX_PPM;
+}
+
+// runs the workers until prefetching is done
+static void prefetch(fb::Renderer &r) {
+  const uint32_t tiles0 = r.get_stats().tiles_prefetched;
+  uint32_t cells = 0;
+  while (r.is_prefetching()) {
+    r.service();
+    cells += r.num_queued();
+    host::feed(r);
+    cells -= r.num_queued();
+    for (int i = 0; i < host::NUM_WORKERS; i++) host::workers[i].service();
+  }
+  const uint32_t tiles = r.get_stats().tiles_prefetched - tiles0;
+  printf("prefetched %3u tiles, %6u cells computed (%u per tile)\n", tiles,
+         cells, tiles > 0 ? cells / tiles : 0);
+  expect(tiles > 0, "tiles prefetched");
+  expect(cells < tiles * T * T / 2, "tiles traced");
+}
+
+// compares the pixels known right after a move, i.e. those kept from the
+// last view and those loaded from the cache, then finishes the render
+static void check_view(fb::Renderer &r, const char *name) {
+  const fb::scene_t s = r.get_worker_args();
+  uint32_t known = 0, wrong = 0;
+  for (fb::pos_t y = 0; y < HEIGHT; y++) {
+    for (fb::pos_t x = 0; x < WIDTH; x++) {
+      fb::iter_t iter = r.get_iter(x, y);
+      if (iter == fb::ITER_BLANK || iter > fb::ITER_MAX) continue;
+      fb::iter_t expected = fb::Mandelbrot::compute(s, fb::vec_t{x, y});
+      if (iter >= s.max_iter) iter = fb::ITER_MAX;
+      if (expected >= s.max_iter) expected = fb::ITER_MAX;
+      known++;
+      if (iter != expected) wrong++;
+    }
+  }
+  const uint32_t loaded = r.get_stats().tiles_loaded;
+
+  fb::verify_report_t report = {};
+  expect(host::finish(r) == fb::result_t::SUCCESS, "finish");
+  expect(fb::Verifier::compare(r, &report) == fb::result_t::SUCCESS,
+         "compare");
+  printf("%-12s %3u tiles loaded, %u of %u known pixels wrong, "
+         "%u mismatches when finished\n",
+         name, loaded, wrong, known, report.num_mismatches);
+  expect(loaded > 0, "tiles loaded from the cache");
+  expect(passed(wrong, known), "known pixels match the brute-force sweep");
+  expect(report.passed(0, MAX_PPM), "matches the brute-force sweep");
+}
+
+int main() {
+  fb::TileCache cache(2 * 1024 * 1024);
+  fb::Renderer r(WIDTH, HEIGHT);
+  r.set_tile_cache(&cache);
+  r.init();
+  host::finish(r);
+  r.zoom_in();
+  host::finish(r);
+
+  // the margin is one tile wide on each side
+  prefetch(r);
+  r.scroll(T, 0);
+  check_view(r, "right");
+  prefetch(r);
+  r.scroll(0, -T);
+  check_view(r, "up");
+
+  prefetch(r);
+  r.zoom_in();
+  check_view(r, "zoomed in");
+  prefetch(r);
+  r.set_formula(fb::formula_t::BURNING_SHIP);
+  host::finish(r);
+  prefetch(r);
+  r.zoom_in();
+  check_view(r, "burning ship");
+
+  // a view of fine detail in seahorse valley, centered on the pixel grid
+  // of its scale so that it is cached in tiles
+  r.set_view(fb::formula_t::MANDELBROT, -12183.0f / 16384, 2160.0f / 16384, 6,
+             1000);
+  host::finish(r);
+  prefetch(r);
+  r.scroll(-T, T);
+  check_view(r, "seahorse");
+  prefetch(r);
+  r.zoom_in();
+  check_view(r, "seahorse in");
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// Compares RowRleBuffer with a dense buffer of one iter_t per pixel.
+// Each view is rendered once, then copied into both layouts and read back
+// as painting (whole rows), lookups (random pixels) and tracing (the four
+// neighbours of each pixel) do. Each figure is the best of several runs.
+//
+// usage: row_rle_bench [width height [runs]]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "host.hpp"
+
+struct view_t {
+  const char *name;
+  float real;
+  float imag;
+  int exp;
+  fb::iter_t max_iter;
+};
+
+static const view_t VIEWS[] = {
+    {"whole set", -0.5f, 0.0f, 0, 256},
+    {"seahorse valley", -0.743643f, 0.131825f, 6, 1000},
+    {"spiral", -0.16f, 1.04f, 4, 400},
+};
+
+static double now_s() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// best time of `runs` calls of `f`, per `n` operations in ns
+template <typename TFunc>
+static double best_ns(int runs, double n, TFunc f) {
+  double best = 1e9;
+  for (int i = 0; i < runs; i++) {
+    double t0 = now_s();
+    f();
+    double t = now_s() - t0;
+    if (t < best) best = t;
+  }
+  return best / n * 1e9;
+}
+
+static void bench_view(const view_t &v, fb::pos_t width, fb::pos_t height,
+                       int runs) {
+  fb::Renderer r(width, height);
+  r.set_view(fb::formula_t::MANDELBROT, v.real, v.imag, v.exp, v.max_iter);
+  host::finish(r);
+
+  std::vector<fb::iter_t> dense((size_t)width * height);
+  for (fb::pos_t y = 0; y < height; y++) {
+    for (fb::pos_t x = 0; x < width; x++) {
+      dense[(size_t)y * width + x] = r.get_iter(x, y);
+    }
+  }
+  fb::RowRleBuffer rle(width, height);
+  std::vector<fb::iter_t> row(width);
+  const double pixels = (double)width * height;
+
+  double store[2], rows[2], rnd[2], nbr[2];
+  store[0] = best_ns(runs, pixels, [&] {
+    for (fb::pos_t y = 0; y < height; y++) {
+      for (fb::pos_t x = 0; x < width; x++) {
+        dense[(size_t)y * width + x] = r.get_iter(x, y);
+      }
+    }
+  });
+  store[1] = best_ns(runs, pixels, [&] {
+    for (fb::pos_t y = 0; y < height; y++) {
+      for (fb::pos_t x = 0; x < width; x++) row[x] = r.get_iter(x, y);
+      rle.store_row(y, row.data());
+    }
+  });
+
+  uint32_t sum[2] = {0, 0};
+  rows[0] = best_ns(runs, pixels, [&] {
+    for (fb::pos_t y = 0; y < height; y++) {
+      memcpy(row.data(), &dense[(size_t)y * width],
+             sizeof(fb::iter_t) * width);
+      sum[0] += row[y % width];
+    }
+  });
+  rows[1] = best_ns(runs, pixels, [&] {
+    for (fb::pos_t y = 0; y < height; y++) {
+      rle.read_row(y, 0, width, row.data());
+      sum[1] += row[y % width];
+    }
+  });
+
+  const int reads = 4 * width * height;
+  rnd[0] = best_ns(runs, reads, [&] {
+    uint32_t s = 1;
+    for (int k = 0; k < reads; k++) {
+      s = s * 1664525u + 1013904223u;
+      size_t i = (size_t)((s >> 20) % height) * width + (s >> 8) % width;
+      sum[0] += dense[i];
+    }
+  });
+  rnd[1] = best_ns(runs, reads, [&] {
+    uint32_t s = 1;
+    for (int k = 0; k < reads; k++) {
+      s = s * 1664525u + 1013904223u;
+      sum[1] += rle.read((s >> 8) % width, (s >> 20) % height);
+    }
+  });
+
+  const double inner = (double)(width - 2) * (height - 2);
+  nbr[0] = best_ns(runs, inner, [&] {
+    for (fb::pos_t y = 1; y < height - 1; y++) {
+      const fb::iter_t *p = &dense[(size_t)y * width];
+      for (fb::pos_t x = 1; x < width - 1; x++) {
+        sum[0] += p[x - 1] + p[x + 1] + p[x - width] + p[x + width];
+      }
+    }
+  });
+  nbr[1] = best_ns(runs, inner, [&] {
+    for (fb::pos_t y = 1; y < height - 1; y++) {
+      for (fb::pos_t x = 1; x < width - 1; x++) {
+        sum[1] += rle.read(x - 1, y) + rle.read(x + 1, y) +
+                  rle.read(x, y - 1) + rle.read(x, y + 1);
+      }
+    }
+  });
+
+  printf("%s, %d runs (%.1f per row)%s\n", v.name, rle.get_num_runs(),
+         (double)rle.get_num_runs() / height,
+         sum[0] == sum[1] ? "" : ", READS DIFFER");
+  printf("                    dense       rle\n");
+  printf("  memory        %9zu %9zu bytes\n",
+         dense.size() * sizeof(fb::iter_t), rle.get_memory_bytes());
+  printf("  store         %9.2f %9.2f ns/pixel\n", store[0], store[1]);
+  printf("  read_row      %9.2f %9.2f ns/pixel\n", rows[0], rows[1]);
+  printf("  random read   %9.2f %9.2f ns\n", rnd[0], rnd[1]);
+  printf("  4 neighbours  %9.2f %9.2f ns/pixel\n", nbr[0], nbr[1]);
+}
+
+int main(int argc, char **argv) {
+  fb::pos_t width = argc > 2 ? atoi(argv[1]) : 320;
+  fb::pos_t height = argc > 2 ? atoi(argv[2]) : 240;
+  int runs = argc > 3 ? atoi(argv[3]) : 5;
+
+  printf("%dx%d, %s iteration counts\n", width, height,
+         FIXBROT_ITER_12BIT ? "12-bit" : "16-bit");
+  for (const view_t &v : VIEWS) bench_view(v, width, height, runs);
+  return 0;
+}
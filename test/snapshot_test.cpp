@@ -0,0 +1,162 @@
+// Saves a render in progress with save_snapshot(), loads it into another
+// renderer and checks that every pixel queued when saved is queued once,
+// and nothing else, and that the resumed render ends with the same pixels
+// as the original. Also checks that a finished view loads as finished and
+// that corrupt or truncated snapshots are rejected.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 200;
+
+struct MemStream {
+  std::vector<uint8_t> data;
+  size_t pos = 0;
+
+  bool write(const void *p, size_t n) {
+    data.insert(data.end(), (const uint8_t *)p, (const uint8_t *)p + n);
+    return true;
+  }
+
+  size_t read(void *p, size_t n) {
+    size_t k = data.size() - pos;
+    if (k > n) k = n;
+    memcpy(p, data.data() + pos, k);
+    pos += k;
+    return k;
+  }
+};
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static uint64_t hash_view(const fb::Renderer &r) {
+  uint64_t h = 0;
+  for (fb::pos_t y = 0; y < r.height; y++) {
+    for (fb::pos_t x = 0; x < r.width; x++) h = h * 31 + r.get_iter(x, y);
+  }
+  return h;
+}
+
+static std::set<int> queued_pixels(const fb::Renderer &r) {
+  std::set<int> pixels;
+  for (fb::pos_t y = 0; y < r.height; y++) {
+    for (fb::pos_t x = 0; x < r.width; x++) {
+      if (r.get_iter(x, y) == fb::ITER_QUEUED) pixels.insert(y * r.width + x);
+    }
+  }
+  return pixels;
+}
+
+// host::finish(), failing instead of hanging if the render never ends
+static void finish(fb::Renderer &r) {
+  for (int i = 0; r.is_busy(); i++) {
+    if (i >= 1000000) {
+      expect(false, "render finishes");
+      return;
+    }
+    host::step(r);
+  }
+  r.service();
+}
+
+// Starts a render of `a` with `start`, saves it after a few steps and
+// resumes it in `b`. Returns the snapshot.
+template <typename TStart>
+static MemStream check_resume(fb::Renderer &a, fb::Renderer &b,
+                              const char *label, TStart start) {
+  printf("%s:\n", label);
+  start();
+  for (int i = 0; i < 5; i++) host::step(a);
+  expect(a.is_busy(), "render in progress");
+  std::set<int> saved_queue = queued_pixels(a);
+  MemStream part;
+  a.save_snapshot(part, fb::builtin_palette_t::HEATMAP, 0);
+  finish(a);
+
+  expect(b.load_snapshot(part, nullptr, nullptr) == fb::result_t::SUCCESS,
+         "load in progress");
+  expect(b.is_busy(), "resumes rendering");
+  expect(b.get_stats().cells_enqueued == saved_queue.size(),
+         "cells enqueued on load");
+  // drain the queue by hand to see what was put in it
+  std::vector<fb::vec_t> locs;
+  fb::vec_t loc;
+  while (b.dequeue(&loc)) locs.push_back(loc);
+  std::set<int> requeued;
+  for (const fb::vec_t &l : locs) {
+    int i = l.y * b.width + l.x;
+    expect(requeued.insert(i).second, "pixel queued once");
+    expect(saved_queue.count(i) == 1, "only saved pixels queued");
+  }
+  for (const fb::vec_t &l : locs) {
+    while (host::workers[0].dispatch(l) != fb::result_t::SUCCESS) {
+      host::step(b);
+    }
+  }
+  finish(b);
+  expect(hash_view(b) == hash_view(a), "resumed render pixels");
+  printf("  %d of %d pixels queued when saved\n", (int)saved_queue.size(),
+         b.width * b.height);
+  return part;
+}
+
+int main() {
+  fb::Renderer a(WIDTH, HEIGHT), b(WIDTH, HEIGHT);
+  a.init();
+  finish(a);
+  a.zoom_in();
+  finish(a);
+
+  // finished view
+  MemStream fin;
+  expect(a.save_snapshot(fin, fb::builtin_palette_t::HEATMAP, 0) ==
+             fb::result_t::SUCCESS,
+         "save finished");
+  b.init();
+  finish(b);
+  expect(b.load_snapshot(fin, nullptr, nullptr) == fb::result_t::SUCCESS,
+         "load finished");
+  expect(!b.is_busy(), "finished view loads finished");
+  expect(hash_view(b) == hash_view(a), "finished view pixels");
+
+  // render in progress, from scratch and as the partial trace of
+  // set_max_iter(), which leaves pixels of the coarse grid blank
+  MemStream part = check_resume(a, b, "formula", [&] {
+    a.set_formula(fb::formula_t::BURNING_SHIP);
+  });
+  check_resume(a, b, "max_iter",
+               [&] { a.set_max_iter(a.get_max_iter() * 2); });
+
+  // corrupt pixels render the view again
+  MemStream bad;
+  bad.data = part.data;
+  bad.data[bad.data.size() / 2] ^= 0x55;
+  expect(b.load_snapshot(bad, nullptr, nullptr) ==
+             fb::result_t::ERROR_BAD_SNAPSHOT,
+         "corrupt rejected");
+  finish(b);
+  expect(queued_pixels(b).empty(), "render after corrupt snapshot");
+
+  MemStream trunc;
+  trunc.data.assign(part.data.begin(), part.data.begin() + 10);
+  expect(b.load_snapshot(trunc, nullptr, nullptr) ==
+             fb::result_t::ERROR_BAD_SNAPSHOT,
+         "truncated rejected");
+  expect(!b.is_busy(), "truncated header leaves the view alone");
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
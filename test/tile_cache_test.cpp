@@ -0,0 +1,137 @@
+// Checks TileCache against a plain least-recently-used list under random
+// inserts and lookups, then renders a sequence of views that return to
+// cached tiles (scrolling back, zooming out and switching the formula
+// back) and compares each with a brute-force sweep through Verifier.
+//
+// As in verify, border tracing misses a few details smaller than a pixel,
+// so up to 1000 ppm of mismatches pass.
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+static constexpr uint32_t MAX_PPM = 1000;
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static fb::tile_key_t make_key(uint32_t n) {
+  fb::tile_key_t key;
+  key.formula = (n & 1) ? fb::formula_t::BURNING_SHIP
+                        : fb::formula_t::MANDELBROT;
+  key.scale_exp = (int)(n >> 1) % 3 - 1;
+  key.max_iter = 200;
+  key.tx = (int64_t)(n % 37) - 18 + ((int64_t)(n & 4) << 40);
+  key.ty = (int64_t)(n / 37) - 5;
+  return key;
+}
+
+// random operations on a cache of `budget_bytes`, with keys drawn from
+// `num_keys`, compared with a list ordered from the newest
+static void check_lru(uint32_t budget_bytes, uint32_t num_keys) {
+  fb::TileCache cache(budget_bytes);
+  std::vector<uint32_t> lru;
+  printf("TileCache of %d tiles, %u keys\n", cache.capacity, num_keys);
+
+  uint32_t seed = 12345;
+  int wrong_hits = 0, wrong_pixels = 0;
+  for (int op = 0; op < 200000; op++) {
+    seed = seed * 1664525u + 1013904223u;
+    uint32_t n = (seed >> 8) % num_keys;
+    fb::tile_key_t key = make_key(n);
+    int pos = -1;
+    for (size_t i = 0; i < lru.size(); i++) {
+      if (lru[i] == n) pos = (int)i;
+    }
+    if (pos >= 0) lru.erase(lru.begin() + pos);
+
+    if ((seed >> 28) < 5) {
+      // a tile's pixels tell which key stored them
+      fb::iter_t *dst = cache.insert(key);
+      if (cache.capacity == 0) {
+        expect(dst == nullptr, "no tiles, no insert");
+        continue;
+      }
+      for (int i = 0; i < fb::TileCache::TILE_PIXELS; i++) {
+        dst[i] = (fb::iter_t)(n + i);
+      }
+      lru.insert(lru.begin(), n);
+      if ((int)lru.size() > cache.capacity) lru.pop_back();
+    } else {
+      const fb::iter_t *src = cache.find(key);
+      if ((src != nullptr) != (pos >= 0)) wrong_hits++;
+      if (src) {
+        if (src[0] != (fb::iter_t)n ||
+            src[fb::TileCache::TILE_PIXELS - 1] !=
+                (fb::iter_t)(n + fb::TileCache::TILE_PIXELS - 1)) {
+          wrong_pixels++;
+        }
+      }
+      if (pos >= 0) lru.insert(lru.begin(), n);
+    }
+  }
+  printf("  %u hits, %u misses\n", cache.get_num_hits(),
+         cache.get_num_misses());
+  expect(wrong_hits == 0, "hits and misses match the list");
+  expect(wrong_pixels == 0, "hits return the pixels inserted");
+}
+
+// renders to the end and compares the view with the brute-force sweep
+static void check_view(fb::Renderer &r, const char *name, bool from_cache) {
+  fb::result_t res = host::finish(r);
+  fb::verify_report_t report;
+  if (res == fb::result_t::SUCCESS) res = fb::Verifier::compare(r, &report);
+  if (res != fb::result_t::SUCCESS) {
+    printf("%s: %s\n", name, host::result_name(res));
+    num_errors++;
+    return;
+  }
+  const fb::render_stats_t &st = r.get_stats();
+  printf("%-16s %3u tiles loaded, %u mismatches, %u unfinished\n", name,
+         st.tiles_loaded, report.num_mismatches, report.num_unfinished);
+  expect(report.passed(0, MAX_PPM), "matches the brute-force sweep");
+  if (from_cache) expect(st.tiles_loaded > 0, "tiles loaded from the cache");
+}
+
+int main() {
+  check_lru(0, 10);
+  check_lru(sizeof(fb::TileCache::tile_t) * 9, 20);
+  check_lru(sizeof(fb::TileCache::tile_t) * 300, 1000);
+  check_lru(2 * 1024 * 1024, 2000);
+
+  fb::TileCache cache(1024 * 1024);
+  fb::Renderer r(WIDTH, HEIGHT);
+  r.set_tile_cache(&cache);
+  r.init();
+  check_view(r, "home", false);
+  r.scroll(70, 0);
+  check_view(r, "scrolled", false);
+  r.scroll(-70, 0);
+  check_view(r, "scrolled back", true);
+  r.scroll(0, -90);
+  check_view(r, "scrolled up", false);
+  r.scroll(0, 90);
+  check_view(r, "scrolled down", true);
+  r.zoom_in();
+  check_view(r, "zoomed in", false);
+  r.zoom_out();
+  check_view(r, "zoomed out", true);
+  r.set_formula(fb::formula_t::BURNING_SHIP);
+  check_view(r, "burning ship", false);
+  r.set_formula(fb::formula_t::MANDELBROT);
+  check_view(r, "mandelbrot", true);
+  printf("%u hits, %u misses\n", cache.get_num_hits(), cache.get_num_misses());
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
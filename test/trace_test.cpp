@@ -0,0 +1,169 @@
+// Built with FIXBROT_TRACE and rings small enough to wrap. Renders and
+// paints with the GUI on core 0 and the workers on core 1, exports the
+// trace with trace_export_chrome_json() and checks that the output is
+// valid JSON, that every event has a known name and both cores appear,
+// and that per core the time stamps never go back and every end event
+// closes a begin event.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static void write_string(void *ctx, const char *str, int len) {
+  ((std::string *)ctx)->append(str, len);
+}
+
+// minimal JSON syntax check, advances `p` past one value
+static bool parse_value(const char *&p);
+
+static void skip_space(const char *&p) {
+  while (isspace((unsigned char)*p)) p++;
+}
+
+static bool parse_string(const char *&p) {
+  if (*p != '"') return false;
+  for (p++; *p && *p != '"'; p++) {
+    if (*p == '\\' && !*++p) return false;
+  }
+  if (*p != '"') return false;
+  p++;
+  return true;
+}
+
+static bool parse_value(const char *&p) {
+  skip_space(p);
+  if (*p == '{' || *p == '[') {
+    const char close = (*p == '{') ? '}' : ']';
+    const bool object = (*p == '{');
+    p++;
+    skip_space(p);
+    if (*p == close) {
+      p++;
+      return true;
+    }
+    while (true) {
+      if (object) {
+        skip_space(p);
+        if (!parse_string(p)) return false;
+        skip_space(p);
+        if (*p++ != ':') return false;
+      }
+      if (!parse_value(p)) return false;
+      skip_space(p);
+      if (*p == close) {
+        p++;
+        return true;
+      }
+      if (*p++ != ',') return false;
+    }
+  }
+  if (*p == '"') return parse_string(p);
+  if (*p == '-' || isdigit((unsigned char)*p)) {
+    char *end;
+    strtod(p, &end);
+    p = end;
+    return true;
+  }
+  return false;
+}
+
+static bool is_event_name(const char *name) {
+  for (int i = 0; i < (int)fb::trace_event_t::LAST; i++) {
+    if (strcmp(name, fb::get_trace_event_name((fb::trace_event_t)i)) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int main() {
+  fb::GUI gui(WIDTH, HEIGHT);
+  std::vector<fb::col_t> line(WIDTH);
+  fb::trace_clear();
+  gui.init();
+  gui.renderer.zoom_in();
+  do {
+    host::core_id = 0;
+    gui.service();
+    {
+      FIXBROT_TRACE_SCOPE(fb::trace_event_t::FEED);
+      host::feed(gui.renderer);
+    }
+    host::core_id = 1;
+    for (int i = 0; i < host::NUM_WORKERS; i++) host::workers[i].service();
+    host::core_id = 0;
+    if (gui.is_paint_requested()) {
+      gui.paint_start();
+      for (fb::pos_t y = 0; y < HEIGHT; y++) gui.paint_line(y, line.data());
+      gui.paint_end();
+    }
+  } while (gui.renderer.is_busy() || gui.renderer.is_animating());
+
+  std::string json;
+  fb::trace_export_chrome_json(write_string, &json);
+  const char *p = json.c_str();
+  bool valid = parse_value(p);
+  skip_space(p);
+  expect(valid && *p == '\0', "valid JSON");
+
+  // one event per line after the header
+  int events[FIXBROT_TRACE_NUM_CORES] = {};
+  int depth[FIXBROT_TRACE_NUM_CORES] = {};
+  unsigned long long last_ts[FIXBROT_TRACE_NUM_CORES] = {};
+  bool names_ok = true, order_ok = true, nesting_ok = true;
+  for (size_t pos = 0; pos < json.size();) {
+    size_t eol = json.find('\n', pos);
+    if (eol == std::string::npos) eol = json.size();
+    std::string ln = json.substr(pos, eol - pos);
+    pos = eol + 1;
+    char name[64], ph;
+    unsigned long long ts;
+    int tid;
+    if (sscanf(ln.c_str(),
+               "{\"name\":\"%63[^\"]\",\"ph\":\"%c\",\"ts\":%llu,"
+               "\"pid\":0,\"tid\":%d}",
+               name, &ph, &ts, &tid) != 4) {
+      continue;
+    }
+    if (tid < 0 || tid >= FIXBROT_TRACE_NUM_CORES) {
+      names_ok = false;
+      continue;
+    }
+    if (!is_event_name(name) || (ph != 'B' && ph != 'E')) names_ok = false;
+    if (events[tid] > 0 && ts < last_ts[tid]) order_ok = false;
+    last_ts[tid] = ts;
+    depth[tid] += (ph == 'B') ? 1 : -1;
+    if (depth[tid] < 0) nesting_ok = false;
+    events[tid]++;
+  }
+
+  for (int core = 0; core < FIXBROT_TRACE_NUM_CORES; core++) {
+    printf("core %d: %d events\n", core, events[core]);
+    expect(events[core] > 0, "events recorded");
+    expect(events[core] <= FIXBROT_TRACE_DEPTH, "at most a ring of events");
+  }
+  expect(names_ok, "known event names and phases");
+  expect(order_ok, "time stamps in order");
+  expect(nesting_ok, "end events close begin events");
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+// Renders every scene of VERIFY_SCENES and compares the traced pixels
+// against a brute-force sweep. Exits non-zero if any scene fails.
+//
+// usage: verify [width height [max_mismatches max_ppm]]
+//
+// Border tracing misses details smaller than a pixel that do not touch a
+// boundary it follows, so a few mismatches per scene are expected. The
+// default of 1000 ppm is well above those and far below what a broken
+// tracer leaves.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.hpp"
+
+int main(int argc, char **argv) {
+  fb::pos_t width = 240, height = 240;
+  uint32_t max_mismatches = 0, max_ppm = 1000;
+  if (argc >= 3) {
+    width = atoi(argv[1]);
+    height = atoi(argv[2]);
+  }
+  if (argc >= 5) {
+    max_mismatches = atoi(argv[3]);
+    max_ppm = atoi(argv[4]);
+  }
+
+  fb::Renderer renderer(width, height);
+  int num_failed = 0;
+  for (int i = 0; i < fb::NUM_VERIFY_SCENES; i++) {
+    const fb::verify_scene_t &vs = fb::VERIFY_SCENES[i];
+    fb::result_t res = fb::Verifier::load_scene(renderer, vs);
+    if (res == fb::result_t::SUCCESS) res = host::finish(renderer);
+
+    fb::verify_report_t report;
+    if (res == fb::result_t::SUCCESS) {
+      res = fb::Verifier::compare(renderer, &report);
+    }
+    if (res != fb::result_t::SUCCESS) {
+      printf("scene %2d: %s\n", i, host::result_name(res));
+      num_failed++;
+      continue;
+    }
+
+    bool passed = report.passed(max_mismatches, max_ppm);
+    printf("scene %2d: formula %2d exp %3d: %u mismatches, %u unfinished %s\n",
+           i, (int)vs.formula, vs.scale_exp, report.num_mismatches,
+           report.num_unfinished, passed ? "ok" : "FAILED");
+    if (passed) continue;
+
+    num_failed++;
+    const fb::rect_t &b = report.bounds;
+    printf("  bounds (%d, %d) %dx%d\n", b.x, b.y, b.w, b.h);
+    for (int j = 0; j < report.num_locations; j++) {
+      const fb::mismatch_t &m = report.locations[j];
+      printf("  (%d, %d): expected %u, actual %u\n", m.loc.x, m.loc.y,
+             m.expected, m.actual);
+    }
+  }
+
+  printf("%d of %d scenes failed\n", num_failed, fb::NUM_VERIFY_SCENES);
+  return num_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+// Measures the operations that go through the work buffer accessors:
+// full-frame paint_line(), a full render after set_formula(), zoom in and
+// out, and get_iter() at random pixels. The 12-bit build is the PicoSystem
+// layout, where two pixels share three bytes. Each figure is the best of
+// several runs. Renders run on a fake clock so that animations and paint
+// pacing do not depend on the host.
+//
+// usage: work_buff_bench [width height [runs]]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "host.hpp"
+
+static double now_s() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// renders and animates to the end, frames are painted nowhere
+static void run(fb::GUI &gui) {
+  do {
+    host::advance_fake_time(1000);
+    host::step(gui);
+    if (gui.is_paint_requested()) {
+      gui.paint_start();
+      gui.paint_end();
+    }
+  } while (gui.renderer.is_busy() || gui.renderer.is_animating());
+  host::advance_fake_time(1000000);
+  gui.service();
+}
+
+int main(int argc, char **argv) {
+  fb::pos_t width = argc > 2 ? atoi(argv[1]) : 240;
+  fb::pos_t height = argc > 2 ? atoi(argv[2]) : 240;
+  int runs = argc > 3 ? atoi(argv[3]) : 6;
+  constexpr int PAINTS = 50;
+  constexpr int RENDERS = 4;
+  constexpr int ZOOMS = 4;
+  const int reads = 50 * width * height;
+
+  host::set_fake_time(1000000);
+  fb::GUI gui(width, height);
+  fb::Renderer &r = gui.renderer;
+  gui.init();
+  run(gui);
+
+  std::vector<fb::col_t> line(width);
+  double best[4] = {1e9, 1e9, 1e9, 1e9};
+  uint32_t sum = 0;
+  for (int i = 0; i < runs; i++) {
+    double t0 = now_s();
+    for (int k = 0; k < PAINTS; k++) {
+      r.paint_start();
+      for (fb::pos_t y = 0; y < height; y++) {
+        r.paint_line(0, y, width, line.data());
+      }
+      r.paint_finished();
+    }
+
+    // clears the view, then traces, corrects and fills it
+    double t1 = now_s();
+    for (int k = 0; k < RENDERS; k++) {
+      r.set_formula((k & 1) ? fb::formula_t::MANDELBROT
+                            : fb::formula_t::BURNING_SHIP);
+      run(gui);
+    }
+
+    double t2 = now_s();
+    uint32_t rnd = 1;
+    for (int k = 0; k < reads; k++) {
+      rnd = rnd * 1664525u + 1013904223u;
+      sum += r.get_iter((rnd >> 8) % width, (rnd >> 20) % height);
+    }
+
+    double t3 = now_s();
+    for (int k = 0; k < ZOOMS; k++) {
+      r.zoom_in();
+      run(gui);
+      r.zoom_out();
+      run(gui);
+    }
+    double t4 = now_s();
+
+    double d[4] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3};
+    for (int j = 0; j < 4; j++) {
+      if (d[j] < best[j]) best[j] = d[j];
+    }
+  }
+
+  printf("%dx%d, %s work buffer (checksum %08x)\n", width, height,
+         FIXBROT_ITER_12BIT ? "12-bit" : "16-bit", sum);
+  printf("  full-frame paint_line  %8.1f us\n", best[0] / PAINTS * 1e6);
+  printf("  set_formula render     %8.2f ms\n", best[1] / RENDERS * 1e3);
+  printf("  random get_iter        %8.2f ns\n", best[2] / reads * 1e9);
+  printf("  zoom in + out          %8.2f ms\n", best[3] / ZOOMS * 1e3);
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Worker::init() is called by the core that feeds the worker while the
+// other core may be inside Worker::service(). Calls init() from the clock
+// read of service(), between fetching a cell and storing its result, and
+// checks that no cell of the old scene comes out afterwards and that the
+// next cell is computed in the new scene.
+
+#include <stdio.h>
+
+#include "host.hpp"
+
+static fb::Worker worker;
+static fb::scene_t next_scene;
+static bool init_armed = false;
+
+static void init_from_other_core() {
+  if (!init_armed) return;
+  init_armed = false;
+  worker.init(next_scene);
+}
+
+int main() {
+  fb::Renderer renderer(64, 64);
+  renderer.init();
+  fb::scene_t scene = renderer.get_worker_args();
+  renderer.zoom_in();
+  next_scene = renderer.get_worker_args();
+
+  int num_errors = 0;
+  worker.init(scene);
+  for (fb::pos_t x = 0; x < 4; x++) {
+    worker.dispatch(fb::vec_t{x, 0});
+  }
+
+  host::time_hook = init_from_other_core;
+  init_armed = true;
+  worker.service(host::now_us() + 1000000000);
+  host::time_hook = nullptr;
+
+  fb::cell_t c;
+  while (worker.collect(&c)) {
+    printf("cell (%d, %d) of the old scene collected\n", c.loc.x, c.loc.y);
+    num_errors++;
+    break;
+  }
+
+  worker.service();
+  fb::vec_t loc{17, 23};
+  if (worker.dispatch(loc) != fb::result_t::SUCCESS) {
+    printf("dispatch failed after init\n");
+    num_errors++;
+  }
+  worker.service();
+  fb::iter_t expected = fb::Mandelbrot::compute(next_scene, loc);
+  if (expected == next_scene.max_iter) expected = fb::ITER_MAX;
+  int n = 0;
+  while (worker.collect(&c)) {
+    n++;
+    if (c.loc.x != loc.x || c.loc.y != loc.y || c.iter != expected) {
+      printf("got (%d, %d) = %d, expected (%d, %d) = %d\n", c.loc.x,
+             c.loc.y, c.iter, loc.x, loc.y, expected);
+      num_errors++;
+      break;
+    }
+  }
+  if (n != 1) {
+    printf("%d cells collected, expected 1\n", n);
+    num_errors++;
+  }
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}
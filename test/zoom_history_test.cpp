@@ -0,0 +1,111 @@
+// Zooms in a few times with a ZoomHistory and back out, and checks that
+// each zoom_out() restores the saved view as a finished render whose
+// pixels are those rendered before and pass Verifier against a
+// brute-force sweep. Also zooms out of views the history does not hold, a
+// scrolled one and one too large for a small history, which must be
+// rendered again.
+//
+// As in verify, border tracing misses a few details smaller than a pixel,
+// so up to 1000 ppm of mismatches pass.
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "host.hpp"
+
+static constexpr fb::pos_t WIDTH = 240;
+static constexpr fb::pos_t HEIGHT = 240;
+static constexpr uint32_t MAX_PPM = 1000;
+static constexpr int DEPTH = 4;
+
+static int num_errors = 0;
+
+static void expect(bool cond, const char *what) {
+  if (!cond) {
+    printf("  failed: %s\n", what);
+    num_errors++;
+  }
+}
+
+static std::vector<fb::iter_t> pixels(const fb::Renderer &r) {
+  std::vector<fb::iter_t> p;
+  for (fb::pos_t y = 0; y < HEIGHT; y++) {
+    for (fb::pos_t x = 0; x < WIDTH; x++) p.push_back(r.get_iter(x, y));
+  }
+  return p;
+}
+
+static void check_verifier(const fb::Renderer &r, const char *name) {
+  fb::verify_report_t report;
+  fb::result_t res = fb::Verifier::compare(r, &report);
+  if (res != fb::result_t::SUCCESS) {
+    printf("%s: %s\n", name, host::result_name(res));
+    num_errors++;
+    return;
+  }
+  printf("%-20s %u mismatches, %u unfinished\n", name, report.num_mismatches,
+         report.num_unfinished);
+  expect(report.passed(0, MAX_PPM), "matches the brute-force sweep");
+}
+
+// a view the history does not hold is rendered again
+static void check_rerendered(fb::Renderer &r, const char *name) {
+  expect(r.is_busy(), "rendered again");
+  expect(host::finish(r) == fb::result_t::SUCCESS, "finish");
+  check_verifier(r, name);
+}
+
+int main() {
+  fb::ZoomHistory history(1024 * 1024);
+  fb::Renderer r(WIDTH, HEIGHT);
+  r.set_zoom_history(&history);
+  r.set_view(fb::formula_t::MANDELBROT, -0.743643f, 0.131825f, 2, 500);
+  host::finish(r);
+
+  std::vector<fb::iter_t> views[DEPTH + 1];
+  views[0] = pixels(r);
+  for (int i = 1; i <= DEPTH; i++) {
+    r.zoom_in();
+    host::finish(r);
+    views[i] = pixels(r);
+  }
+  expect(history.get_depth() == DEPTH, "every zoom saved");
+
+  char name[32];
+  for (int i = DEPTH - 1; i >= 0; i--) {
+    r.zoom_out();
+    snprintf(name, sizeof(name), "restored %d", i);
+    expect(!r.is_busy(), "restored without rendering");
+    expect(r.get_stats().finished, "restored as finished");
+    expect(pixels(r) == views[i], "pixels of the saved view");
+    check_verifier(r, name);
+  }
+  expect(history.get_depth() == 0, "history emptied");
+
+  // the restored view is saved again by the next zoom
+  r.zoom_in();
+  host::finish(r);
+  r.zoom_out();
+  expect(!r.is_busy() && pixels(r) == views[0], "restored view saved again");
+
+  // a view moved since it was saved
+  r.zoom_in();
+  host::finish(r);
+  r.scroll(30, 0);
+  host::finish(r);
+  r.zoom_out();
+  check_rerendered(r, "scrolled");
+
+  // a view too large for the history
+  fb::ZoomHistory small(4096);
+  r.set_zoom_history(&small);
+  r.zoom_in();
+  host::finish(r);
+  expect(small.get_depth() == 0, "view not saved");
+  r.zoom_out();
+  check_rerendered(r, "not saved");
+
+  if (num_errors == 0) printf("ok\n");
+  return num_errors > 0 ? 1 : 0;
+}